@@ -96,6 +96,9 @@
 #include "otb_wifi.h"
 #include "otb_mqtt.h"
 #include "otb_conf.h"
+#include "otb_conf_journal.h"
+#include "otb_power.h"
+#include "otb_i2c_bus.h"
 #include "otb_i2c.h"
 #include "otb_i2c_pca9685.h"
 #include "otb_i2c_mcp23017.h"
@@ -109,6 +112,7 @@
 #include "otb_serial.h"
 #include "otb_mbus.h"
 #include "otb_eeprom.h"
+#include "otb_eeprom_image.h"
 #include "otb_flash.h"
 #include "otb_relay.h"
 #include "otb_brzo_i2c.h"
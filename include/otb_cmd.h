@@ -134,6 +134,7 @@ extern otb_cmd_handler_fn otb_nixie_cycle;
 extern otb_cmd_handler_fn otb_nixie_power;
 extern otb_cmd_handler_fn otb_i2c_pca_gpio_cmd;
 extern otb_cmd_handler_fn otb_cmd_get_ip_info;
+extern otb_cmd_handler_fn otb_i2c_stats_cmd;
 
 #define OTB_CMD_GPIO_MIN         0
 #define OTB_CMD_GPIO_GET         0
@@ -257,6 +258,7 @@ typedef struct otb_cmd_control
 //       ram
 //     rssi
 //     heap_size
+//     eeprom_heap
 //     reason
 //       reboot
 //     chip_id
@@ -290,7 +292,13 @@ typedef struct otb_cmd_control
 //         <location>
 //     ds18b20
 //       <addr>  // xx-yyyyyyyyyyyy format
-//         <name>
+//         <name>  // max 30 chars
+//         res
+//           0|9|10|11|12  // resolution in bits, 0 to leave the sensor as it is
+//         alarm
+//           <low>     // degrees C, -55 to 125
+//             <high>  // degrees C, above low
+//           off
 //     ads
 //       <addr>
 //         add - used to initialize this one
@@ -310,6 +318,20 @@ typedef struct otb_cmd_control
 //           <value>
 //         loc
 //           <value>
+//         rdy
+//           <pin>  // GPIO wired to ALERT/RDY, 0 for none (poll instead) - needs cont 0
+//         burden
+//           <value>  // CT burden resistor in mOhm, 0 for default (22140)
+//         turns
+//           <value>  // CT turns ratio, 0 for default (2000)
+//         mains
+//           <value>  // mains voltage, 0 for default (245)
+//         energy
+//           <value>  // minutes between publishing energy (instead of power), 0 for off
+//         harmonics
+//           <value>  // harmonics to analyse, up to 8 binary digits - rightmost = fundamental, 0 for off
+//         hz
+//           <value>  // mains frequency, 50 or 60, 0 for default (50)
 //     relay (external relay module)
 //       <id> (1-8)
 //         loc (location, 31 chars max)
@@ -460,6 +482,11 @@ typedef struct otb_cmd_control
 //     temp
 //       ds18b20
 //         refresh
+//     adc
+//       ads
+//         <addr>
+//           capture  // burst of raw samples at max rate, streamed to capture/<loc>
+//             <samples>  // 1-256
 //   mbus
 //     on  // Powers on the M-Bus
 //     off // Powers off the M-Bus
@@ -515,6 +542,8 @@ extern OTB_CMD_CONTROL(otb_cmd_control_delete_config_ads)[];
 extern OTB_CMD_CONTROL(otb_cmd_control_trigger)[];
 extern OTB_CMD_CONTROL(otb_cmd_control_trigger_ow)[];
 extern OTB_CMD_CONTROL(otb_cmd_control_trigger_i2c)[];
+extern OTB_CMD_CONTROL(otb_cmd_control_trigger_i2c_stats)[];
+extern OTB_CMD_CONTROL(otb_cmd_control_get_i2c)[];
 extern OTB_CMD_CONTROL(otb_cmd_control_trigger_test)[];
 extern OTB_CMD_CONTROL(otb_cmd_control_trigger_test_led)[];
 extern OTB_CMD_CONTROL(otb_cmd_control_get_gpio)[];
@@ -539,6 +568,9 @@ extern OTB_CMD_CONTROL(otb_cmd_control_trigger_neo)[];
 extern OTB_CMD_CONTROL(otb_cmd_control_trigger_sensor)[];
 extern OTB_CMD_CONTROL(otb_cmd_control_trigger_sensor_temp)[];
 extern OTB_CMD_CONTROL(otb_cmd_control_trigger_sensor_temp_ds18b20)[];
+extern OTB_CMD_CONTROL(otb_cmd_control_trigger_sensor_adc)[];
+extern OTB_CMD_CONTROL(otb_cmd_control_trigger_sensor_adc_ads)[];
+extern OTB_CMD_CONTROL(otb_cmd_control_trigger_sensor_adc_ads_valid)[];
 extern OTB_CMD_CONTROL(otb_cmd_control_trigger_mbus)[];
 extern OTB_CMD_CONTROL(otb_cmd_control_set_config_wifi)[];
 extern OTB_CMD_CONTROL(otb_cmd_control_set_config_mqtt)[];
@@ -588,6 +620,7 @@ OTB_CMD_CONTROL(otb_cmd_control_get)[] =
   {"gpio",             otb_gpio_valid_pin, NULL, otb_gpio_cmd, (void *)OTB_CMD_GPIO_GET_CONFIG},
   {"hat",              NULL, otb_cmd_control_get_hat,       OTB_CMD_NO_FN},
   {"mbus",             NULL, otb_cmd_control_get_mbus,       OTB_CMD_NO_FN},
+  {"i2c",              NULL, otb_cmd_control_get_i2c,        OTB_CMD_NO_FN},
   {OTB_CMD_FINISH}    
 };
 
@@ -737,6 +770,7 @@ OTB_CMD_CONTROL(otb_cmd_control_get_info)[] =
   {"logs",              NULL, otb_cmd_control_get_info_logs,     OTB_CMD_NO_FN},
   {"rssi",              NULL, NULL,     otb_cmd_get_rssi,          NULL},
   {"heap_size",         NULL, NULL,     otb_cmd_get_heap_size,     NULL},
+  {"eeprom_heap",       NULL, NULL,     otb_eeprom_heap_get,       NULL},
   {"reason",            NULL, otb_cmd_control_get_reason,         OTB_CMD_NO_FN},
   {"chip_id",           NULL, NULL,     otb_cmd_get_string,        OTB_MAIN_CHIPID},
   {"hw_info",           NULL, NULL,     otb_cmd_get_string,        otb_hw_info},
@@ -801,6 +835,13 @@ OTB_CMD_CONTROL(otb_cmd_control_get_mbus)[] =
   {OTB_CMD_FINISH}    
 };
 
+// get->i2c commands
+OTB_CMD_CONTROL(otb_cmd_control_get_i2c)[] =
+{
+  {"stats",          NULL, NULL,     otb_i2c_stats_cmd,     (void *)OTB_CMD_I2C_STATS_GET},
+  {OTB_CMD_FINISH}    
+};
+
 // set commands
 OTB_CMD_CONTROL(otb_cmd_control_set)[] =
 {
@@ -880,6 +921,13 @@ OTB_CMD_CONTROL(otb_cmd_control_set_config_ads_valid)[] =
   {"period",   NULL, NULL, otb_i2c_ads_conf_set, (void *)OTB_CMD_ADS_PERIOD}, 
   {"samples",  NULL, NULL, otb_i2c_ads_conf_set, (void *)OTB_CMD_ADS_SAMPLES}, 
   {"loc",      NULL, NULL, otb_i2c_ads_conf_set, (void *)OTB_CMD_ADS_LOC}, 
+  {"rdy",      NULL, NULL, otb_i2c_ads_conf_set, (void *)OTB_CMD_ADS_RDY}, 
+  {"burden",   NULL, NULL, otb_i2c_ads_conf_set, (void *)OTB_CMD_ADS_BURDEN}, 
+  {"turns",    NULL, NULL, otb_i2c_ads_conf_set, (void *)OTB_CMD_ADS_TURNS}, 
+  {"mains",    NULL, NULL, otb_i2c_ads_conf_set, (void *)OTB_CMD_ADS_MAINS}, 
+  {"energy",   NULL, NULL, otb_i2c_ads_conf_set, (void *)OTB_CMD_ADS_ENERGY}, 
+  {"harmonics", NULL, NULL, otb_i2c_ads_conf_set, (void *)OTB_CMD_ADS_HARMONICS}, 
+  {"hz",       NULL, NULL, otb_i2c_ads_conf_set, (void *)OTB_CMD_ADS_HZ}, 
   {OTB_CMD_FINISH}
 };
 
@@ -1090,10 +1138,17 @@ OTB_CMD_CONTROL(otb_cmd_control_trigger_ow)[] =
 // trigger->i2c commands
 OTB_CMD_CONTROL(otb_cmd_control_trigger_i2c)[] =
 {
-  // XXX TBC
+  {"stats",             NULL, otb_cmd_control_trigger_i2c_stats, OTB_CMD_NO_FN},
   {OTB_CMD_FINISH}    
 };
 
+// trigger->i2c->stats commands
+OTB_CMD_CONTROL(otb_cmd_control_trigger_i2c_stats)[] =
+{
+  {"reset",             NULL, NULL,     otb_i2c_stats_cmd,         (void *)OTB_CMD_I2C_STATS_RESET},
+  {OTB_CMD_FINISH}
+};
+
 // trigger->test commands
 OTB_CMD_CONTROL(otb_cmd_control_trigger_test)[] =
 {
@@ -1187,6 +1242,7 @@ OTB_CMD_CONTROL(otb_cmd_control_trigger_neo)[] =
 OTB_CMD_CONTROL(otb_cmd_control_trigger_sensor)[] =
 {
   {"temp",            NULL, otb_cmd_control_trigger_sensor_temp,   OTB_CMD_NO_FN},
+  {"adc",             NULL, otb_cmd_control_trigger_sensor_adc,    OTB_CMD_NO_FN},
   {OTB_CMD_FINISH}    
 };
 
@@ -1204,6 +1260,27 @@ OTB_CMD_CONTROL(otb_cmd_control_trigger_sensor_temp_ds18b20)[] =
   {OTB_CMD_FINISH}    
 };
 
+// trigger->sensor->adc commands
+OTB_CMD_CONTROL(otb_cmd_control_trigger_sensor_adc)[] =
+{
+  {"ads",             NULL, otb_cmd_control_trigger_sensor_adc_ads,   OTB_CMD_NO_FN},
+  {OTB_CMD_FINISH}    
+};
+
+// trigger->sensor->adc->ads commands
+OTB_CMD_CONTROL(otb_cmd_control_trigger_sensor_adc_ads)[] =
+{
+  {NULL, otb_i2c_ads_configured_addr, otb_cmd_control_trigger_sensor_adc_ads_valid, OTB_CMD_NO_FN},
+  {OTB_CMD_FINISH}    
+};
+
+// trigger->sensor->adc->ads-><addr> commands
+OTB_CMD_CONTROL(otb_cmd_control_trigger_sensor_adc_ads_valid)[] =
+{
+  {"capture",          NULL, NULL, otb_i2c_ads_capture_cmd,   NULL},
+  {OTB_CMD_FINISH}    
+};
+
 // trigger->mbus commands
 OTB_CMD_CONTROL(otb_cmd_control_trigger_mbus)[] =
 {
@@ -1237,6 +1314,7 @@ void ICACHE_FLASH_ATTR otb_cmd_control_check_sizes_do_not_call()
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_get_info_logs);
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_get_hat);
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_get_mbus);
+  OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_get_i2c);
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_set);
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_set_config);
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_set_config_status_led);
@@ -1253,6 +1331,7 @@ void ICACHE_FLASH_ATTR otb_cmd_control_check_sizes_do_not_call()
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_trigger);
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_trigger_ow);
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_trigger_i2c);
+  OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_trigger_i2c_stats);
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_trigger_test);
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_trigger_test_led);
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_get_gpio);
@@ -1275,6 +1354,9 @@ void ICACHE_FLASH_ATTR otb_cmd_control_check_sizes_do_not_call()
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_trigger_sensor);
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_trigger_sensor_temp);
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_trigger_sensor_temp_ds18b20);
+  OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_trigger_sensor_adc);
+  OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_trigger_sensor_adc_ads);
+  OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_trigger_sensor_adc_ads_valid);
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_trigger_mbus);
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_set_config_wifi);
   OTB_CMD_CONTROL_SIZE_CHECK(otb_cmd_control_set_config_mqtt);
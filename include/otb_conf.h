@@ -24,6 +24,12 @@
 #define OTB_CONF_LOCATION OTB_BOOT_CONF_LOCATION
 #define OTB_CONF_MAX_CONF_SIZE OTB_BOOT_CONF_LEN
 
+// The config is saved to a journal (see otb_conf_journal.h).  Config at
+// OTB_CONF_LOCATION, from before the journal, is only read if there's no
+// journal - it is moved into the journal the next time the config is saved.
+#define OTB_CONF_JOURNAL_LOCATION OTB_BOOT_CONF_JOURNAL_LOCATION
+#define OTB_CONF_JOURNAL_SECTORS  (OTB_BOOT_CONF_JOURNAL_LEN / OTB_CONF_JOURNAL_SECTOR_LEN)
+
 // Randomly generated 32-bit int
 #define OTB_CONF_MAGIC 0x3B1EC363  
 
@@ -54,11 +60,40 @@ typedef struct otb_conf_ds18b20
 #define OTB_CONF_DS18B20_MAX_ID_LEN  16
   char id[OTB_CONF_DS18B20_MAX_ID_LEN];
   
-  // Location of this sensor.  Maximum 31 chars, so 32 with padding.
-#define OTB_CONF_DS18B20_LOCATION_MAX_LEN  32  
+  // Location of this sensor.  Maximum 30 chars, so 31 with padding.  (Was
+  // previously 32 - older configs may have 31 chars here, using res as the
+  // terminator, which is fine as res will be 0.)
+#define OTB_CONF_DS18B20_LOCATION_MAX_LEN  31  
   char loc[OTB_CONF_DS18B20_LOCATION_MAX_LEN];
+
+  // Resolution to configure the sensor for, in bits (9-12).  0 means leave the
+  // sensor at whatever it's currently set to (12 bits from power on).
+#define OTB_CONF_DS18B20_RES_DEFAULT  0
+#define OTB_CONF_DS18B20_RES_MIN      9
+#define OTB_CONF_DS18B20_RES_MAX     12
+  uint8 res;
 } otb_conf_ds18b20;
 
+typedef struct otb_conf_ds18b20_alarm
+{
+  // 4 bytes
+
+  // Alarm thresholds, in whole degrees C.  The sensor alarms when its
+  // temperature is at or below low, or above high.
+#define OTB_CONF_DS18B20_ALARM_MIN  -55
+#define OTB_CONF_DS18B20_ALARM_MAX  125
+  sint8 low;
+  sint8 high;
+
+  // Whether alarm thresholds are configured for this sensor
+#define OTB_CONF_DS18B20_ALARM_DISABLED  0
+#define OTB_CONF_DS18B20_ALARM_ENABLED   1
+  uint8 enabled;
+
+  uint8 pad1[1];
+
+} otb_conf_ds18b20_alarm;
+
 // ADS1115 family sensors
 typedef struct otb_conf_ads
 {
@@ -120,8 +155,15 @@ typedef struct otb_conf_ads
   // 1 = RMS
   char rms;
 
-  // Unused, must be set to zero
-  char pad1[1];
+  // GPIO connected to this ADS's ALERT/RDY pin.  If set, samples are read when
+  // the ADS signals a conversion is ready, rather than by polling on a timer.
+  // 0 means not connected (GPIO0 is the internal I2C bus's SDA).
+  // GPIO16 can't generate interrupts, so isn't supported.
+#define OTB_CONF_ADS_RDY_NONE     0
+#define OTB_CONF_ADS_RDY_PIN_MAX  15
+  // ALERT/RDY only fires repeatedly in continuous mode, so rdy needs cont 0
+#define OTB_CONF_ADS_RDY_CONT_OK(RDY, CONT)  (((RDY) == OTB_CONF_ADS_RDY_NONE) || ((CONT) == 0))
+  char rdy;
 
   // Period to sample over, set to seconds.  Will run number of samples as indicated
   // below every period seconds - assuming set to continuous mode.
@@ -132,11 +174,53 @@ typedef struct otb_conf_ads
   // Number of samples to take every second seconds.
   // 0xffff is invalid
   // 0x0 means this function is off for this ADS.
-  // > 1024 is unsupported
+  // Samples are accumulated as they're read, so this isn't limited by memory.
+#define OTB_CONF_ADS_MAX_SAMPLES  0xfffe
   uint16_t samples;
 
 } otb_conf_ads;
 
+// Calibration of the current transformer (CT) connected to an ADS, and energy
+// metering settings.  Kept separately from otb_conf_ads, at the end of the
+// config, so older configs remain valid.  Same index as ads.
+// 0 in burden_mohm, turns or mains_v means use the default.
+typedef struct otb_conf_ads_cal
+{
+  // 12 bytes
+
+  // Burden resistor across the CT's secondary, in mOhm
+#define OTB_CONF_ADS_CAL_BURDEN_DEFAULT   22140
+#define OTB_CONF_ADS_CAL_BURDEN_MAX       1000000
+  uint32_t burden_mohm;
+
+  // CT turns ratio (primary:secondary is 1:turns)
+#define OTB_CONF_ADS_CAL_TURNS_DEFAULT    2000
+  uint16_t turns;
+
+  // Assumed mains voltage, V
+#define OTB_CONF_ADS_CAL_MAINS_V_DEFAULT  245
+#define OTB_CONF_ADS_CAL_MAINS_V_MAX      500
+  uint16_t mains_v;
+
+  // How often to publish cumulative energy, in minutes.  When set, energy is
+  // published instead of power every sample period.
+  // 0 means energy is not published.
+#define OTB_CONF_ADS_CAL_ENERGY_OFF       0
+#define OTB_CONF_ADS_CAL_ENERGY_MAX       1440
+  uint16_t energy;
+
+  // Harmonics of the mains frequency to analyse each sample period, as a
+  // bitmask - bit 0 is the fundamental, bit 2 the 3rd harmonic, etc.  If the
+  // fundamental is analysed, an approximate power factor is published too.
+  // 0 means no analysis.
+  uint8_t harmonics;
+
+  // Mains frequency, Hz - 50 or 60.  0 means use the default.
+#define OTB_CONF_ADS_CAL_MAINS_HZ_DEFAULT  50
+  uint8_t mains_hz;
+
+} otb_conf_ads_cal;
+
 typedef struct otb_conf_mqtt
 {
   // 100 bytes
@@ -313,6 +397,16 @@ typedef struct otb_conf_struct
   uint8_t mqtt_httpd;  
   uint8_t pad4[3];
 
+  // Alarm thresholds for each of the sensors in ds18b20, with the same index.
+  // Older configs don't have these - see otb_conf_verify.
+  // Size is 4 bytes * 8 = 32 bytes
+  otb_conf_ds18b20_alarm ds18b20_alarm[OTB_DS18B20_MAX_DS18B20S];
+
+  // CT calibration for each of the ADSs in ads, with the same index.
+  // Older configs don't have these - see otb_conf_verify.
+  // Size is 12 bytes * 4 = 48 bytes
+  otb_conf_ads_cal ads_cal[OTB_CONF_ADS_MAX_ADSS];
+
   // Adding any configuration past this point needs to be supported by a different
   // version or default to 0xFF and/or 0x00
 
@@ -0,0 +1,160 @@
+/*
+ * OTB-IOT - Out of The Box Internet Of Things
+ *
+ * Copyright (C) 2020 Piers Finlayson
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OTB_CONF_JOURNAL_H_INCLUDED
+#define OTB_CONF_JOURNAL_H_INCLUDED
+
+//
+// Config journal - stores the config in a ring of flash sectors, so that a
+// change only appends the blocks of the config which changed, rather than
+// erasing and rewriting a whole sector.
+//
+// Each sector starts with an otb_conf_journal_sector_hdr, followed by records
+// - each an otb_conf_journal_rec_hdr and then rec_hdr.blocks
+// otb_conf_journal_blocks.  The first record in a sector is a snapshot,
+// holding every block.  A record's CRC covers the whole record, so a record
+// torn by a power cut is ignored, and the config is as it was before that
+// save.
+//
+// When a record doesn't fit in the current sector, the next sector in the
+// ring is erased and a snapshot written to it.  The sector header, with a
+// higher seq than the previous sector's, is written last - until then the
+// previous sector, which hasn't been touched, is still the one used.  Moving
+// round the ring spreads erases evenly over the sectors.
+//
+// Which blocks changed is found from a CRC of each block as last saved,
+// rather than a copy of the config, to save RAM.
+//
+
+#define OTB_CONF_JOURNAL_SECTOR_LEN  0x1000
+
+// Bytes of config per block, and the maximum number of blocks
+#define OTB_CONF_JOURNAL_BLOCK_LEN   16
+#define OTB_CONF_JOURNAL_MAX_BLOCKS  128
+
+// otb_conf_journal.sector before a valid sector has been found or written
+#define OTB_CONF_JOURNAL_SECTOR_NONE  0xffffffff
+
+typedef struct otb_conf_journal_sector_hdr
+{
+#define OTB_CONF_JOURNAL_MAGIC  0x7d2c91e4
+  uint32_t magic;
+
+  // Incremented for each new sector - the valid sector with the highest seq
+  // holds the config
+  uint32_t seq;
+
+  // Length of the config, and OTB_CONF_JOURNAL_BLOCK_LEN, when this sector
+  // was started
+  uint16_t conf_len;
+  uint16_t block_len;
+
+  // CRC of the fields above
+  uint32_t crc;
+
+} otb_conf_journal_sector_hdr;
+
+typedef struct otb_conf_journal_rec_hdr
+{
+  // 0xffff (with blocks also 0xffff) means the rest of the sector is unused
+#define OTB_CONF_JOURNAL_REC_MAGIC  0xc0f5
+  uint16_t magic;
+
+  // Number of otb_conf_journal_blocks following
+  uint16_t blocks;
+
+  // CRC of magic, blocks and all of the blocks
+  uint32_t crc;
+
+} otb_conf_journal_rec_hdr;
+
+typedef struct otb_conf_journal_block
+{
+  // Which block of the config this is
+  uint32_t index;
+
+  // Past the end of the config is 0
+  uint8_t data[OTB_CONF_JOURNAL_BLOCK_LEN];
+
+} otb_conf_journal_block;
+
+typedef struct otb_conf_journal
+{
+  // Flash location of the first sector, and the number of sectors
+  uint32_t location;
+  uint32_t sectors;
+
+  // Length of the config
+  uint32_t conf_len;
+
+  // Sector being appended to (OTB_CONF_JOURNAL_SECTOR_NONE if none), its seq,
+  // and the offset within it of the next record
+  uint32_t sector;
+  uint32_t seq;
+  uint32_t next;
+
+  // The sector has a bad record - so it must not be appended to, and the
+  // next save goes to a new sector
+  bool dirty;
+  uint8_t pad1[3];
+
+  // CRC of each block of the config as last saved or loaded
+  uint32_t block_crc[OTB_CONF_JOURNAL_MAX_BLOCKS];
+
+  // Statistics
+  uint32_t appends;
+  uint32_t compactions;
+  uint32_t bytes_written;
+
+} otb_conf_journal;
+
+void otb_conf_journal_init(otb_conf_journal *journal,
+                           uint32_t location,
+                           uint32_t sectors,
+                           uint32_t conf_len);
+uint32_t otb_conf_journal_crc(uint32_t crc, const uint8_t *data, uint32_t len);
+uint32_t otb_conf_journal_blocks(uint32_t conf_len);
+void otb_conf_journal_block_fill(otb_conf_journal *journal,
+                                 const uint8_t *conf,
+                                 uint32_t index,
+                                 otb_conf_journal_block *block);
+bool otb_conf_journal_sector_hdr_read(otb_conf_journal *journal,
+                                      uint32_t sector,
+                                      otb_conf_journal_sector_hdr *hdr);
+bool otb_conf_journal_replay(otb_conf_journal *journal,
+                             uint32_t sector,
+                             otb_conf_journal_sector_hdr *hdr,
+                             uint8_t *conf);
+bool otb_conf_journal_load(otb_conf_journal *journal, uint8_t *conf);
+uint32_t otb_conf_journal_changed(otb_conf_journal *journal, const uint8_t *conf);
+bool otb_conf_journal_write_rec(otb_conf_journal *journal,
+                                uint32_t addr,
+                                const uint8_t *conf,
+                                bool snapshot);
+bool otb_conf_journal_compact(otb_conf_journal *journal, const uint8_t *conf);
+bool otb_conf_journal_save(otb_conf_journal *journal, const uint8_t *conf);
+void otb_conf_journal_erase(otb_conf_journal *journal);
+
+#ifdef OTB_CONF_JOURNAL_C
+otb_conf_journal otb_conf_journal_main;
+#else // OTB_CONF_JOURNAL_C
+extern otb_conf_journal otb_conf_journal_main;
+#endif // OTB_CONF_JOURNAL_C
+
+#endif // OTB_CONF_JOURNAL_H_INCLUDED
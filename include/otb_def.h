@@ -32,6 +32,7 @@
 #define OTB_WIFI_DEFAULT_DISCONNECTED_TIMEOUT 300000 // 5 minutes
 #define OTB_WIFI_MAC_ADDRESS_STRING_LENGTH 18 // 6 * 2 + 5 + 1
 #define OTB_DS18B20_MAX_DS18B20S 8
+#define OTB_DS18B20_MAX_BUSES 4
 #ifndef OTB_IOT_V0_3
 #define OTB_DS18B20_DEFAULT_GPIO 2
 #else
@@ -41,6 +42,7 @@
 #define OTB_DS18B20_REPORT_INTERVAL 60000 // 1 minute
 #define OTB_DS18B20_INTERNAL_ERROR_TEMP "-128"
 #define OTB_DS18B20_REFRESH_DEVICE_INTERVAL 305000 // 5 minutes, 5 seconds - max timer is 428,496ms
+#define OTB_DS18B20_ALARM_INTERVAL 10000 // 10 seconds
 #define OTB_MQTT_INITIAL_CONNECT_TIMER 10000
 #define OTB_MQTT_HEARTBEAT_INTERVAL 60000 // 1 minute
 #define OTB_MQTT_DISCONNECTED_REBOOT_INTERVAL 180000 // 3 minutes
@@ -56,6 +58,9 @@
 #define OTB_MQTT_TEMPERATURE "temp"
 #define OTB_MQTT_ADC "adc"
 #define OTB_MQTT_POWER "power"
+#define OTB_MQTT_ENERGY "energy"
+#define OTB_MQTT_CAPTURE "capture"
+#define OTB_MQTT_HARMONICS "harmonics"
 #define OTB_MQTT_PUB_LOG "log"
 
 // Fixed stuff
@@ -36,8 +36,24 @@ typedef struct otbDs18b20DeviceAddress
   // Index in array
   uint8_t index;
 
-  // Timer interval
-  uint32_t timer_int;
+  // Index of the bus this device is on
+  uint8_t bus;
+
+  // Resolution the device was last read as running at, in bits (0 if unknown)
+  uint8_t res;
+
+  // Bitmask of OTB_DS18B20_DEVICE_*
+#define OTB_DS18B20_DEVICE_SEEN  0x01  // Found by the current search of its bus
+#define OTB_DS18B20_DEVICE_READ  0x02  // To be read by the current sample
+  uint8_t flags;
+
+  // Index of this device's entry in otb_conf->ds18b20, or OTB_DS18B20_NO_CONF.
+  // Only valid while otb_ds18b20_conf_resolved is TRUE - use
+  // otb_ds18b20_device_conf() rather than reading this directly.
+#define OTB_DS18B20_NO_CONF  0xff
+  uint8_t conf;
+
+  uint8_t pad1[3];
 
   // Actual one wire address
   char addr[OTB_DS18B20_DEVICE_ADDRESS_LENGTH];
@@ -46,46 +62,239 @@ typedef struct otbDs18b20DeviceAddress
   char friendly[OTB_DS18B20_MAX_ADDRESS_STRING_LENGTH];
 } otbDs18b20DeviceAddress;
 
+// Validity of a stored reading
+typedef enum otb_ds18b20_temp_state
+{
+  // No reading taken yet
+  OTB_DS18B20_TEMP_NONE = 0,
+
+  // Good reading
+  OTB_DS18B20_TEMP_VALID,
+
+  // Device returned its power-on reset value of 85.00, so didn't convert
+  OTB_DS18B20_TEMP_POWER_ON,
+
+  // Couldn't read a valid scratchpad from the device
+  OTB_DS18B20_TEMP_ERROR,
+} otb_ds18b20_temp_state;
+
+// Last reading from a device
+typedef struct otb_ds18b20_temp
+{
+  // Temperature in hundredths of a degree C
+  int16_t centi;
+
+  // One of otb_ds18b20_temp_state
+  uint8_t state;
+
+  uint8_t pad1[1];
+} otb_ds18b20_temp;
+
+// DS18x20 range, and power-on reset value, in hundredths of a degree C
+#define OTB_DS18B20_CENTI_MIN       -5500
+#define OTB_DS18B20_CENTI_MAX       12500
+#define OTB_DS18B20_CENTI_POWER_ON  8500
+
+// 1-Wire engine states.  Each bus is driven by a state machine which performs
+// a single step - a reset, or at most one byte's worth of bit slots - each time
+// its timer fires.  Interrupts are only disabled for the duration of a single
+// bit slot, and the conversion wait is a timer rather than a busy loop.  As
+// each bus has its own timer, steps on different buses interleave, so buses
+// are searched and sampled in parallel.
+#define OTB_DS18B20_OW_STATE_IDLE            0
+#define OTB_DS18B20_OW_STATE_CONV_RESET      1
+#define OTB_DS18B20_OW_STATE_CONV_SKIP_ROM   2
+#define OTB_DS18B20_OW_STATE_CONV_CMD        3
+#define OTB_DS18B20_OW_STATE_CONV_WAIT       4
+#define OTB_DS18B20_OW_STATE_SELECT_RESET    5
+#define OTB_DS18B20_OW_STATE_SELECT_MATCH    6
+#define OTB_DS18B20_OW_STATE_SELECT_ROM      7
+#define OTB_DS18B20_OW_STATE_READ_CMD        8
+#define OTB_DS18B20_OW_STATE_READ_DATA       9
+#define OTB_DS18B20_OW_STATE_SEARCH_RESET   10
+#define OTB_DS18B20_OW_STATE_SEARCH_CMD     11
+#define OTB_DS18B20_OW_STATE_SEARCH_ROM     12
+#define OTB_DS18B20_OW_STATE_WRITE_CMD      13
+#define OTB_DS18B20_OW_STATE_WRITE_DATA     14
+
+// Work which can be queued for the engine.  If more than one is pending the
+// search is run first, so any new devices are included in the sample.  An
+// alarm check converts all devices, but then only reads those an alarm search
+// finds - so is skipped if a full sample is pending.
+#define OTB_DS18B20_OW_PENDING_SEARCH  0x01
+#define OTB_DS18B20_OW_PENDING_SAMPLE  0x02
+#define OTB_DS18B20_OW_PENDING_ALARM   0x04
+
+// Job the engine is currently running
+#define OTB_DS18B20_OW_JOB_NONE    0
+#define OTB_DS18B20_OW_JOB_SEARCH  1
+#define OTB_DS18B20_OW_JOB_SAMPLE  2
+#define OTB_DS18B20_OW_JOB_ALARM   3
+
+// Gap between engine steps in us - this is the minimum os_timer_arm_us supports
+#define OTB_DS18B20_OW_STEP_US            100
+
+// Time to leave the bus after sampling the presence pulse, in us
+#define OTB_DS18B20_OW_RESET_RECOVERY_US  410
+
+// Maximum time a conversion takes at each resolution, in ms.  DS18S20s always
+// take the 12-bit time, as do devices whose resolution isn't yet known.
+#define OTB_DS18B20_OW_CONVERT_9_MS        94
+#define OTB_DS18B20_OW_CONVERT_10_MS      188
+#define OTB_DS18B20_OW_CONVERT_11_MS      375
+#define OTB_DS18B20_OW_CONVERT_MS         750
+
+// Number of times to read a device's scratchpad before giving up
+#define OTB_DS18B20_OW_READ_TRIES         4
+
+// Scratchpad length, including CRC byte
+#define OTB_DS18B20_SCRATCHPAD_LEN        9
+
+// Scratchpad bytes written by DS1820_WRITE_SCRATCHPAD - TH, TL and config (the
+// DS18S20 has no config register)
+#define OTB_DS18B20_SCRATCHPAD_TH         2
+#define OTB_DS18B20_SCRATCHPAD_TL         3
+#define OTB_DS18B20_SCRATCHPAD_CONFIG     4
+#define OTB_DS18B20_SCRATCHPAD_WRITE_LEN  3
+#define OTB_DS18S20_SCRATCHPAD_WRITE_LEN  2
+
+// Known devices are looked up by ROM in an open addressed hash table, keyed
+// on the ROM's CRC byte (which is already well distributed).  Must be a power
+// of 2, larger than OTB_DS18B20_MAX_DS18B20S.
+#define OTB_DS18B20_HASH_SIZE  16
+
+// Resolution is stored in bits 5-6 of the config register, as (bits - 9)
+#define OTB_DS18B20_CONFIG_TO_RES(X)  ((((X) >> 5) & 0x3) + 9)
+#define OTB_DS18B20_RES_TO_CONFIG(X)  ((((X) - 9) << 5) | 0x1f)
+
+// One of these per bus
+typedef struct otb_ds18b20_ow_engine
+{
+  // Index of this bus in otb_ds18b20_ow
+  uint8_t bus;
+
+  // GPIO the bus is on
+  uint8_t gpio;
+
+  // One of OTB_DS18B20_OW_STATE_*
+  uint8_t state;
+
+  // Bitmask of OTB_DS18B20_OW_PENDING_* - work to do when current job is done
+  uint8_t pending;
+
+  // Index of device currently being read
+  uint8_t device;
+
+  // Byte within the current state - ROM byte being written/searched, or
+  // scratchpad byte being read
+  uint8_t byte;
+
+  // Number of attempts made so far at reading the current device
+  uint8_t tries;
+
+  // Number of devices added by the current search
+  uint8_t added;
+
+  // Search state carried between ROM bytes
+  uint8_t id_bit_number;
+  uint8_t last_zero;
+
+  // Search state carried between devices
+  uint8_t rom[OTB_DS18B20_DEVICE_ADDRESS_LENGTH];
+  uint8_t last_discrepancy;
+  uint8_t last_family_discrepancy;
+  uint8_t last_device_flag;
+
+  // Scratchpad read from the current device
+  uint8_t data[OTB_DS18B20_SCRATCHPAD_LEN];
+
+  // Whether the device is being selected in order to write its scratchpad
+  // (rather than read it)
+  uint8_t writing;
+
+  // One of OTB_DS18B20_OW_JOB_*
+  uint8_t job;
+
+  // Whether the current search was cut short, so can't be used to tell which
+  // devices have been removed
+  uint8_t search_failed;
+
+  uint8_t pad1[3];
+
+  // Used to schedule the next step
+  volatile os_timer_t timer;
+
+} otb_ds18b20_ow_engine;
+
 extern struct otbDs18b20DeviceAddress otb_ds18b20_addresses[OTB_DS18B20_MAX_DS18B20S];
 extern uint8_t otb_ds18b20_count;
-extern char otb_ds18b20_last_temp_s[OTB_DS18B20_MAX_DS18B20S][OTB_DS18B20_MAX_TEMP_LEN];
+extern otb_ds18b20_temp otb_ds18b20_last_temp[OTB_DS18B20_MAX_DS18B20S];
 
 #ifdef OTB_DS18B20_C
 // Globals
 uint8_t otb_ds18b20_mqtt_disconnected_counter = 0;
 struct otbDs18b20DeviceAddress otb_ds18b20_addresses[OTB_DS18B20_MAX_DS18B20S];
 uint8_t otb_ds18b20_count = 0;
-char otb_ds18b20_last_temp_s[OTB_DS18B20_MAX_DS18B20S][OTB_DS18B20_MAX_TEMP_LEN];
-static volatile os_timer_t otb_ds18b20_timer[OTB_DS18B20_MAX_DS18B20S];
+otb_ds18b20_temp otb_ds18b20_last_temp[OTB_DS18B20_MAX_DS18B20S];
+static otb_ds18b20_ow_engine otb_ds18b20_ow[OTB_DS18B20_MAX_BUSES];
+static uint8_t otb_ds18b20_buses = 0;
+static volatile os_timer_t otb_ds18b20_sample_timer;
 static volatile os_timer_t otb_ds18b20_device_timer;
+static volatile os_timer_t otb_ds18b20_alarm_timer;
+static uint8_t otb_ds18b20_hash[OTB_DS18B20_HASH_SIZE];
+static bool otb_ds18b20_conf_resolved = FALSE;
 #endif
 
 extern void otb_ds18b20_initialize(uint8_t bus);
 extern int otb_ds18b20_valid_index(unsigned char *next_cmd);
 void otb_ds18b20_device_callback(void *arg);
-bool otb_ds18b20_check_existing_device(char *ds18b20);
+int otb_ds18b20_find_device(uint8_t *rom);
+void otb_ds18b20_hash_add(uint8_t index);
+void otb_ds18b20_hash_rebuild(void);
+bool otb_ds18b20_add_device(uint8_t bus, uint8_t *ds18b20);
+void otb_ds18b20_remove_device(uint8_t index);
+void otb_ds18b20_alarm_device(otb_ds18b20_ow_engine *ow);
+void otb_ds18b20_publish_event(otbDs18b20DeviceAddress *addr, char *event);
 extern void otb_ds18b20_callback(void *arg);
+extern void otb_ds18b20_alarm_callback(void *arg);
+otb_conf_ds18b20_alarm *otb_ds18b20_device_alarm(otbDs18b20DeviceAddress *addr);
+extern void otb_ds18b20_conf_changed(void);
+void otb_ds18b20_conf_resolve(void);
+otb_conf_ds18b20 *otb_ds18b20_device_conf(otbDs18b20DeviceAddress *addr);
+void otb_ds18b20_publish_temp(otbDs18b20DeviceAddress *addr, int tries);
 void otb_ds18b20_cmd(char *cmd0, char *cmd1, char *cmd2);
-extern bool otb_ds18b20_get_devices(void);
 extern char *otb_ds18b20_get_sensor_name(char *addr, otb_conf_ds18b20 **ds);
 extern char *otb_ds18b20_get_addr(char *name, otb_conf_ds18b20 **ds);
 bool otb_ds18b20_check_addr_format(char *addr);
 bool otb_ds18b20_conf_set(unsigned char *next_cmd, void *arg, unsigned char *prev_cmd);
 extern void otb_ds18b20_conf_get(char *sensor, char *index);
 bool otb_ds18b20_trigger_device_refresh(unsigned char *next_cmd, void *arg, unsigned char *prev_cmd);
-extern void otb_ds18b20_prepare_to_read(void);
-extern bool otb_ds18b20_request_temp(char *addr, char *temp_s);
+extern bool otb_ds18b20_decode_temp(char *addr, uint8_t *data, otb_ds18b20_temp *temp);
+extern void otb_ds18b20_temp_to_str(otb_ds18b20_temp *temp, char *temp_s);
+void otb_ds18b20_ow_request(uint8_t work);
+void otb_ds18b20_ow_queue(otb_ds18b20_ow_engine *ow, uint8_t work);
+uint8_t otb_ds18b20_ow_next_device(otb_ds18b20_ow_engine *ow, uint8_t from);
+uint8_t otb_ds18b20_ow_bus_count(otb_ds18b20_ow_engine *ow);
+uint8_t otb_ds18b20_ow_next_read(otb_ds18b20_ow_engine *ow, uint8_t from);
+bool otb_ds18b20_ow_alarms(otb_ds18b20_ow_engine *ow);
+void otb_ds18b20_ow_next_job(otb_ds18b20_ow_engine *ow);
+void otb_ds18b20_ow_start_search(otb_ds18b20_ow_engine *ow);
+void otb_ds18b20_ow_schedule(otb_ds18b20_ow_engine *ow, uint32_t us);
+void otb_ds18b20_ow_step(void *arg);
+void otb_ds18b20_ow_read_done(otb_ds18b20_ow_engine *ow);
+void otb_ds18b20_ow_read_from(otb_ds18b20_ow_engine *ow, uint8_t from);
+uint8_t otb_ds18b20_configured_res(otbDs18b20DeviceAddress *addr);
+uint32_t otb_ds18b20_ow_conv_time(otb_ds18b20_ow_engine *ow);
+otb_conf_ds18b20 *otb_ds18b20_conf_get_slot(unsigned char *addr);
+void otb_ds18b20_ow_search_done(otb_ds18b20_ow_engine *ow);
 void otb_ds18b20_init(int gpio);
-static int ds_search( uint8_t *addr );
-static void reset_search();
-static void write_bit( int v );
-static void write( uint8_t v, int parasitePower );
-static inline int read_bit(void);
-static inline void write_bit( int v );
-static void select(const uint8_t rom[8]);
-void ds_init( int gpio );
-static uint8_t reset(void);
-static uint8_t read();
+static bool search_rom_byte(otb_ds18b20_ow_engine *ow);
+static void reset_search(otb_ds18b20_ow_engine *ow);
+static void write( int pin, uint8_t v, int parasitePower );
+static inline int read_bit( int pin );
+static inline void write_bit( int pin, int v );
+static uint8_t reset( int pin );
+static uint8_t read( int pin );
 static uint8_t crc8(const uint8_t *addr, uint8_t len);
 
 #define DS1820_WRITE_SCRATCHPAD	0x4E
@@ -527,6 +527,96 @@ typedef struct otb_eeprom_main_module_info
   otb_eeprom_main_board_module *main_board_mod;
 } otb_eeprom_main_module_info;
 
+// Cache of the components read from the main board and (non RPi Hat) module
+// eeproms, kept in flash at OTB_BOOT_EEPROM_CACHE_LOCATION so later boots
+// only need to read each eeprom's otb_eeprom_info header to check nothing has
+// changed.  Written only when the cache didn't match what was read.  Lazily
+// loaded components (otb_eeprom_lazy_comps) aren't cached.
+//
+// Layout is an otb_eeprom_cache_hdr, followed by cache_hdr.rec_num records,
+// each an otb_eeprom_cache_rec followed by the component (padded to 4 bytes).
+
+// Identifies an eeprom's contents - from its otb_eeprom_info header.  All 0
+// (other than addr) for an eeprom which couldn't be read.
+typedef struct otb_eeprom_cache_key
+{
+  uint8 addr;
+  uint8 pad1[3];
+
+  uint32 checksum;
+
+  uint32 length;
+
+  uint32 write_date;
+
+} otb_eeprom_cache_key;
+
+typedef struct otb_eeprom_cache_hdr
+{
+#define OTB_EEPROM_CACHE_MAGIC    0x6ec4c0a7
+  uint32 magic;
+
+  // Incremented whenever the layout changes
+#define OTB_EEPROM_CACHE_VERSION  2
+  uint32 version;
+
+  // Of the whole cache, including this header
+  uint32 length;
+
+  // As otb_eeprom_hdr's checksum, across the whole cache
+  uint32 checksum;
+
+  uint32 rec_num;
+
+  // Main board eeprom first, then modules'
+#define OTB_EEPROM_CACHE_MAX_KEYS  (1 + OTB_EEPROM_MAX_MODULES)
+  uint32 key_num;
+  otb_eeprom_cache_key key[OTB_EEPROM_CACHE_MAX_KEYS];
+
+} otb_eeprom_cache_hdr;
+
+typedef struct otb_eeprom_cache_rec
+{
+  // OTB_EEPROM_INFO_TYPE_...
+  uint32 type;
+
+  // Module (index into otb_eeprom_main_module_info_g) this component was read
+  // from, or MAIN for the main board
+#define OTB_EEPROM_CACHE_SLOT_MAIN  0xff
+  uint8 slot;
+
+  // Instance, for types with more than one
+  uint8 num;
+
+  uint8 pad1[2];
+
+  // Followed by the component itself
+  uint32 comp[];
+
+} otb_eeprom_cache_rec;
+
+// A main board component which is located at boot (so it's known whether, and
+// where, it's on the eeprom) but only read and validated the first time
+// otb_eeprom_get_main_comp() is asked for it.  Not cached in flash.
+typedef struct otb_eeprom_lazy_comp
+{
+  // OTB_EEPROM_INFO_TYPE_...
+  uint32 type;
+
+  // Location and length on the main board eeprom
+  uint32 loc;
+  uint32 length;
+
+#define OTB_EEPROM_LAZY_STATE_ABSENT   0
+#define OTB_EEPROM_LAZY_STATE_LOCATED  1
+#define OTB_EEPROM_LAZY_STATE_LOADED   2
+#define OTB_EEPROM_LAZY_STATE_FAILED   3
+  uint8 state;
+
+  uint8 pad1[3];
+
+} otb_eeprom_lazy_comp;
+
 // Raspberry Pi Hat eeprom data
 //
 // See https://github.com/raspberrypi/hats/blob/master/eeprom-format.md
@@ -669,6 +759,9 @@ extern otb_eeprom_main_board_gpio_pins *otb_eeprom_main_board_gpio_pins_g;
 extern otb_eeprom_main_board_sdk_init_data *otb_eeprom_main_board_sdk_init_data_g;
 extern otb_eeprom_main_module_info otb_eeprom_main_module_info_g[OTB_EEPROM_MAX_MODULES];
 extern otb_eeprom_rpi_hat_info *otb_eeprom_rpi_hat_info_g;
+#define OTB_EEPROM_LAZY_COMPS  2
+extern otb_eeprom_lazy_comp otb_eeprom_lazy_comps[OTB_EEPROM_LAZY_COMPS];
+extern uint32_t otb_eeprom_heap_used;
 #else // OTB_EEPROM_C
 
 otb_eeprom_info *otb_eeprom_info_g;
@@ -680,6 +773,15 @@ otb_eeprom_main_board_gpio_pins *otb_eeprom_main_board_gpio_pins_g;
 otb_eeprom_main_board_sdk_init_data *otb_eeprom_main_board_sdk_init_data_g;
 otb_eeprom_main_module_info otb_eeprom_main_module_info_g[OTB_EEPROM_MAX_MODULES];
 otb_eeprom_rpi_hat_info *otb_eeprom_rpi_hat_info_g;
+#define OTB_EEPROM_LAZY_COMPS  2
+otb_eeprom_lazy_comp otb_eeprom_lazy_comps[OTB_EEPROM_LAZY_COMPS] =
+{
+  {OTB_EEPROM_INFO_TYPE_GPIO_PINS},
+  {OTB_EEPROM_INFO_TYPE_SDK_INIT_DATA},
+};
+
+// Heap allocated for components read from the eeproms (and the flash cache)
+uint32_t otb_eeprom_heap_used;
 #endif // OTB_EEPROM_C
 
 #ifndef OTB_EEPROM_C
@@ -767,7 +869,7 @@ otb_eeprom_main_comp_type otb_eeprom_main_comp_types[OTB_EEPROM_INFO_TYPE_NUM] =
 };
 #endif // OTB_EEPROM_C
 
-#ifndef OTB_HWINFO_C
+#if !defined(OTB_HWINFO_C) && !defined(OTB_HWINFO)
 void otb_eeprom_read(void);
 uint32_t otb_eeprom_load_rpi_eeprom(uint8_t addr,
                                     brzo_i2c_info *i2c_info,
@@ -813,10 +915,33 @@ uint32_t otb_eeprom_read_main_comp(uint8_t addr,
                                    uint32_t num,
                                    void *read_buf,
                                    uint32_t buf_len);
+uint32 otb_eeprom_calc_checksum(char *data,
+                                int size,
+                                int checksum_loc,
+                                int checksum_size);
 char otb_eeprom_check_checksum(char *data,
                                int size,
                                int checksum_loc,
                                int checksum_size);
+void otb_eeprom_process_main_comp(uint32_t type, void *comp);
+bool otb_eeprom_cache_key_read(uint8_t addr,
+                               brzo_i2c_info *i2c_info,
+                               otb_eeprom_cache_key *key);
+void otb_eeprom_cache_key_set(uint8_t addr,
+                              otb_eeprom_info *eeprom_info,
+                              otb_eeprom_cache_key *key);
+void otb_eeprom_cache_clear(void);
+bool otb_eeprom_cache_load(brzo_i2c_info *i2c_info);
+uint32_t otb_eeprom_cache_add(uint8_t *buf,
+                              uint32_t type,
+                              uint8_t slot,
+                              uint8_t num,
+                              void *comp);
+void otb_eeprom_cache_save(brzo_i2c_info *i2c_info);
+void otb_eeprom_lazy_locate(void);
+void *otb_eeprom_get_main_comp(uint32_t type);
+uint32_t otb_eeprom_heap_deferred(void);
+bool otb_eeprom_heap_get(unsigned char *next_cmd, void *arg, unsigned char *prev_cmd);
 bool otb_eeprom_rpi_hat_get(unsigned char *next_cmd, void *arg, unsigned char *prev_cmd);
 #endif // OTB_EEPROM_C
 
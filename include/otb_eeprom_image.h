@@ -0,0 +1,97 @@
+/*
+ * OTB-IOT - Out of The Box Internet Of Things
+ *
+ * Copyright (C) 2020 Piers Finlayson
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OTB_EEPROM_IMAGE_H_INCLUDED
+#define OTB_EEPROM_IMAGE_H_INCLUDED
+
+//
+// Encodes and decodes eeprom images - the otb_eeprom_hdr based format written
+// by hwinfo and read by otb_eeprom.c, in the firmware and the bootloader.
+//
+// Images are handled as bytes in the eeprom's (little endian) order, using the
+// offsets below, so the results are the same on any host and don't depend on
+// how the structs in otb_eeprom.h are laid out there.  Nothing from the SDK is
+// used.  Component types are described by an otb_eeprom_main_comp_type table,
+// passed in (normally otb_eeprom_main_comp_types).
+//
+// Functions returning a uint32_t return OTB_EEPROM_ERR_OK, or a mask of
+// OTB_EEPROM_ERR_... bits.
+//
+// otb_eeprom_image_mezz_init maps a mezzanine's module type to how it's
+// initialised, and is only in the firmware.
+//
+
+// otb_eeprom_hdr
+#define OTB_EEPROM_IMAGE_HDR_MAGIC        0
+#define OTB_EEPROM_IMAGE_HDR_TYPE         4
+#define OTB_EEPROM_IMAGE_HDR_STRUCT_SIZE  8
+#define OTB_EEPROM_IMAGE_HDR_VERSION      12
+#define OTB_EEPROM_IMAGE_HDR_LENGTH       16
+#define OTB_EEPROM_IMAGE_HDR_CHECKSUM     20
+#define OTB_EEPROM_IMAGE_HDR_LEN          24
+
+// otb_eeprom_info, which is at the start of the image
+#define OTB_EEPROM_IMAGE_INFO_EEPROM_SIZE  24
+#define OTB_EEPROM_IMAGE_INFO_COMP_NUM     28
+#define OTB_EEPROM_IMAGE_INFO_WRITE_DATE   32
+#define OTB_EEPROM_IMAGE_INFO_COMP         36
+
+// otb_eeprom_info_comp - OTB_EEPROM_IMAGE_INFO_COMP_LEN each, from
+// OTB_EEPROM_IMAGE_INFO_COMP
+#define OTB_EEPROM_IMAGE_COMP_TYPE      0
+#define OTB_EEPROM_IMAGE_COMP_LOCATION  4
+#define OTB_EEPROM_IMAGE_COMP_LENGTH    8
+#define OTB_EEPROM_IMAGE_INFO_COMP_LEN  12
+
+// How to initialise a mezzanine module, from otb_eeprom_image_mezz_init
+#define OTB_EEPROM_IMAGE_MEZZ_INIT_NONE     0
+#define OTB_EEPROM_IMAGE_MEZZ_INIT_DS18B20  1
+#define OTB_EEPROM_IMAGE_MEZZ_INIT_ADS      2
+#define OTB_EEPROM_IMAGE_MEZZ_INIT_RELAY    3
+#define OTB_EEPROM_IMAGE_MEZZ_INIT_MBUS     4
+
+uint32_t otb_eeprom_image_get32(const uint8_t *data);
+void otb_eeprom_image_put32(uint8_t *data, uint32_t val);
+uint32_t otb_eeprom_image_checksum(const uint8_t *data,
+                                   uint32_t len,
+                                   uint32_t checksum_loc);
+void otb_eeprom_image_hdr_set(uint8_t *comp,
+                              uint32_t type,
+                              const otb_eeprom_main_comp_type *type_info,
+                              uint32_t length);
+void otb_eeprom_image_seal(uint8_t *comp);
+bool otb_eeprom_image_checksum_ok(const uint8_t *comp);
+uint32_t otb_eeprom_image_hdr_check(const uint8_t *comp,
+                                    uint32_t type,
+                                    const otb_eeprom_main_comp_type *type_info,
+                                    uint32_t buf_len);
+uint32_t otb_eeprom_image_verify(const uint8_t *image,
+                                 uint32_t len,
+                                 const otb_eeprom_main_comp_type *types,
+                                 uint32_t types_num);
+bool otb_eeprom_image_find(const uint8_t *image,
+                           uint32_t type,
+                           uint32_t num,
+                           uint32_t *loc,
+                           uint32_t *length);
+uint32_t otb_eeprom_image_mezz_init(uint32_t module_type,
+                                    uint32_t gpios,
+                                    void **param);
+
+#endif // OTB_EEPROM_IMAGE_H_INCLUDED
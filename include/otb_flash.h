@@ -61,7 +61,12 @@ typedef struct{
 #define OTB_BOOT_RESERVED3           0x102000  // length 0xFE000 = 1016KB
 #define OTB_BOOT_CONF_LOCATION       0x200000  // length 0x1000  = 4KB
 #define OTB_BOOT_CONF_LEN              0x1000
-#define OTB_BOOT_RESERVED5           0x201000  // length 0x7000  = 28KB
+#define OTB_BOOT_ENERGY_LOCATION     0x201000  // length 0x2000  = 8KB
+#define OTB_BOOT_ENERGY_LEN            0x2000
+#define OTB_BOOT_EEPROM_CACHE_LOCATION 0x203000 // length 0x1000  = 4KB
+#define OTB_BOOT_EEPROM_CACHE_LEN      0x1000
+#define OTB_BOOT_CONF_JOURNAL_LOCATION 0x204000 // length 0x4000  = 16KB
+#define OTB_BOOT_CONF_JOURNAL_LEN      0x4000
 #define OTB_BOOT_ROM_1_LOCATION      0x208000  // length 0xF8000 = 992KB
 #define OTB_BOOT_ROM_1_LEN            0xf4000
 #define OTB_BOOT_RESERVED6           0x300000  // length 0x1000  = 4KB
@@ -23,6 +23,27 @@
 #define OTB_I2C_BUS_INTERNAL_SDA_PIN  0
 #define OTB_I2C_BUS_INTERNAL_SCL_PIN  2
 
+// Running totals for a window of ADS samples.  Updated as each sample is read,
+// so memory use doesn't depend on the number of samples in the window.
+typedef struct otb_i2c_ads_accum
+{
+  long long sum;
+
+  unsigned long long sum_sq;
+
+  uint32_t count;
+
+  int16_t min;
+
+  int16_t max;
+
+  // Most recent sample
+  int16_t last;
+
+  uint8_t pad1[2];
+
+} otb_i2c_ads_accum;
+
 typedef struct otb_i2c_ads_samples
 {
   otb_conf_ads *ads;
@@ -37,28 +58,147 @@ typedef struct otb_i2c_ads_samples
 
   uint16_t dupes;
 
+  // Only used if the ADS's ALERT/RDY pin is connected.  rdy_pending is set by
+  // the interrupt handler when a conversion is ready and cleared once it has
+  // been read.  If the ADS signals again before then a sample has been missed.
+  volatile uint8_t rdy_pending;
+
+  uint8_t pad1[1];
+
+  uint16_t missed;
+
+  otb_i2c_ads_accum accum;
+
+  // Harmonic analysis, if configured for this ADS
+  otb_power_goertzel goertzel;
+
 } otb_i2c_ads_samples;
 
-#define OTB_I2C_ADS_MAX_SAMPLES 1024
-typedef struct otb_i2c_ads_rms_samples
+// Bus level sampler.  All polled ADSs in a sample period are read one after
+// the other, in the same order, from a single timer - so they don't contend
+// for the bus, and each ADS is sampled at evenly spaced intervals.  ADSs using
+// ALERT/RDY are read when they signal instead.
+#define OTB_I2C_ADS_SAMPLER_MIN_US     ((1000000/860)+1)  // just under 860Hz
+#define OTB_I2C_ADS_SAMPLER_MARGIN_US  100
+
+// Harmonics are only published if the analysis covered at least this many
+// cycles of the fundamental
+#define OTB_I2C_ADS_HARMONICS_MIN_CYCLES  4
+typedef struct otb_i2c_ads_sampler
 {
-  otb_i2c_ads_samples hdr;
-  
-  int16_t samples[OTB_I2C_ADS_MAX_SAMPLES];
+  volatile os_timer_t timer;
 
-  uint16_t final_val;
-  
-} otb_i2c_ads_rms_samples;
+  // ADSs currently in a sample period, read in this order every tick
+  otb_i2c_ads_samples *active[OTB_CONF_ADS_MAX_ADSS];
+
+  uint8_t num_active;
+
+  uint8_t pad1[3];
+
+  // Time between ticks.  Starts at the fastest ADS rate, and is stretched if
+  // reading all the active ADSs takes longer than that.
+  uint32_t tick_us;
 
-typedef struct otb_i2c_ads_nonrms_samples
+} otb_i2c_ads_sampler;
+
+// Energy metering state for an ADS, same index as config.  Unlike
+// otb_i2c_ads_samples this persists from one sample period to the next.
+typedef struct otb_i2c_ads_meter
 {
-  otb_i2c_ads_samples hdr;
+  // Built from the ADS's otb_conf_ads_cal when the config changes
+  otb_power_cal cal;
 
-  int16_t samples[OTB_I2C_ADS_MAX_SAMPLES];
+  otb_power_energy energy;
 
-  int16_t final_val;
-  
-} otb_i2c_ads_nonrms_samples;
+  // system_get_time() when the last sample period finished, 0 if none yet
+  uint32_t last_finish;
+
+  // Time since energy was last published, ms
+  uint32_t since_publish;
+
+} otb_i2c_ads_meter;
+
+// Energy checkpoint records in flash - see otb_power_checkpoint
+#define OTB_I2C_ADS_CHECKPOINTS_PER_SECTOR  (0x1000 / sizeof(otb_power_checkpoint))
+#define OTB_I2C_ADS_CHECKPOINTS  (OTB_BOOT_ENERGY_LEN / sizeof(otb_power_checkpoint))
+
+// Burst capture of raw samples from one ADS, for looking at load waveforms.
+// Samples are read at the ADS's fastest rate into a preallocated buffer, then
+// streamed out as binary MQTT messages in chunks.  Only one capture runs at a
+// time, and the ADS's regular sample periods are skipped while it does - other
+// ADSs carry on as normal.
+#define OTB_I2C_ADS_CAPTURE_MAX_SAMPLES    256
+#define OTB_I2C_ADS_CAPTURE_CHUNK_SAMPLES  64
+#define OTB_I2C_ADS_CAPTURE_CHUNK_MS       50  // between chunks, so MQTT keeps up
+#define OTB_I2C_ADS_CAPTURE_RATE           0b111  // 860SPS
+typedef struct otb_i2c_ads_capture
+{
+  // The configured ADS, or NULL if no capture is running
+  otb_conf_ads *ads;
+
+  // Copy of the ADS's config as used for the capture (fastest rate, continuous)
+  otb_conf_ads conf;
+
+  volatile os_timer_t timer;
+
+#define OTB_I2C_ADS_CAPTURE_STATE_IDLE     0
+#define OTB_I2C_ADS_CAPTURE_STATE_READING  1
+#define OTB_I2C_ADS_CAPTURE_STATE_SENDING  2
+  uint8_t state;
+
+  // As for otb_i2c_ads_samples
+  volatile uint8_t rdy_pending;
+
+  // Samples requested
+  uint16_t count;
+
+  // Next sample to read while reading, next chunk to send while sending
+  uint16_t next;
+
+  uint16_t missed;
+
+  // system_get_time() of the first sample
+  uint32_t start;
+
+  // Time of each sample relative to start, us
+  uint32_t us[OTB_I2C_ADS_CAPTURE_MAX_SAMPLES];
+
+  int16_t val[OTB_I2C_ADS_CAPTURE_MAX_SAMPLES];
+
+} otb_i2c_ads_capture;
+
+// Each capture chunk is published as a header, then (us, val) for each sample
+// in the chunk.  All fields little endian.
+//   0     version (1)
+//   1     gain
+//   2     mux
+//   3     rate
+//   4-5   chunk index
+//   6-7   number of chunks
+//   8-9   samples in capture
+//   10-11 samples missed (only counted if ALERT/RDY is connected)
+//   12-13 samples in this chunk
+//   then per sample: 4 bytes us since first sample, 2 bytes signed value
+#define OTB_I2C_ADS_CAPTURE_VERSION      1
+#define OTB_I2C_ADS_CAPTURE_HDR_LEN      14
+#define OTB_I2C_ADS_CAPTURE_SAMPLE_LEN   6
+#define OTB_I2C_ADS_CAPTURE_CHUNK_LEN    (OTB_I2C_ADS_CAPTURE_HDR_LEN + \
+                                          (OTB_I2C_ADS_CAPTURE_CHUNK_SAMPLES * \
+                                           OTB_I2C_ADS_CAPTURE_SAMPLE_LEN))
+
+// Limit for the range and rmsrange commands.  These busy-wait between reads,
+// so are bounded to keep the watchdog happy rather than by memory.
+#define OTB_I2C_ADS_MAX_RANGE_SAMPLES 1024
+
+// How long to wait for ALERT/RDY before giving up on a sample run - must be
+// longer than a conversion at the slowest rate (8SPS)
+#define OTB_I2C_ADS_RDY_TIMEOUT  250  // ms
+
+// ADS1115 register pointer values
+#define OTB_I2C_ADS_REG_CONV     0b00000000
+#define OTB_I2C_ADS_REG_CONF     0b00000001
+#define OTB_I2C_ADS_REG_LO       0b00000010
+#define OTB_I2C_ADS_REG_HI       0b00000011
 
 void i2c_master_gpio_init(void);
 void i2c_master_init(void);
@@ -76,9 +216,34 @@ void i2c_master_send_ack(void);
 void i2c_master_send_nack(void);
 
 #define OTB_I2C_MQTT_ERROR_LEN 256
+// Range of I2C addresses an ADS can be strapped to
+#define OTB_I2C_ADS_ADDR_MIN  0x48
+#define OTB_I2C_ADS_ADDR_MAX  0x4b
+#define OTB_I2C_ADS_ADDRS     (OTB_I2C_ADS_ADDR_MAX - OTB_I2C_ADS_ADDR_MIN + 1)
+
 #ifdef OTB_I2C_C
 char otb_i2c_mqtt_error[OTB_I2C_MQTT_ERROR_LEN];
 uint8_t otb_i2c_ads_last_addr;
+
+// Config slot for each possible ADS address (indexed by address -
+// OTB_I2C_ADS_ADDR_MIN), or -1 if not configured.  Rebuilt when next needed
+// after the ADS config changes.
+int8_t otb_i2c_ads_conf_slot[OTB_I2C_ADS_ADDRS];
+bool otb_i2c_ads_conf_indexed = FALSE;
+
+otb_i2c_ads_meter otb_i2c_ads_meters[OTB_CONF_ADS_MAX_ADSS];
+
+// Energy totals are loaded from flash when first needed.  next is the index of
+// the record to write the next checkpoint to.
+bool otb_i2c_ads_checkpoint_loaded = FALSE;
+uint32_t otb_i2c_ads_checkpoint_seq;
+uint16_t otb_i2c_ads_checkpoint_next;
+uint32_t otb_i2c_ads_checkpoint_wh[OTB_CONF_ADS_MAX_ADSS];
+uint32_t otb_i2c_ads_since_checkpoint;
+
+otb_i2c_ads_capture otb_i2c_ads_capture_buf;
+
+otb_i2c_ads_sampler otb_i2c_ads_bus_sampler;
 #else
 extern char otb_i2c_mqtt_error[];
 #endif // OTB_I2C_C
@@ -93,15 +258,36 @@ void otb_ads_build_msb_lsb_conf(otb_conf_ads *ads, uint8 *msb, uint8 *lsb);
 bool otb_ads_configure(otb_conf_ads *ads);
 void otb_ads_initialize(void);
 void otb_i2c_ads_init_samples(otb_conf_ads *ads, otb_i2c_ads_samples *samples);
+void otb_i2c_ads_harmonics_init(otb_i2c_ads_samples *samples);
 void otb_i2c_ads_on_timer(void *arg);
-void otb_i2c_ads_sample_timer(void *arg);
+void otb_i2c_ads_sampler_add(otb_i2c_ads_samples *samples);
+void otb_i2c_ads_sampler_timer(void *arg);
+void otb_i2c_ads_rdy_interrupt(void *arg);
+void otb_i2c_ads_rdy_timer(void *arg);
 void otb_i2c_ads_start_sample(otb_i2c_ads_samples *samples);
-bool otb_i2c_ads_read_rms_sample(otb_i2c_ads_samples *samples);
-bool otb_i2c_ads_read_nonrms_sample(otb_i2c_ads_samples *samples);
-uint16_t otb_i2c_ads_finish_rms_samples(otb_i2c_ads_samples *samples);
-int16_t otb_i2c_ads_finish_nonrms_samples(otb_i2c_ads_samples *samples);
+void otb_i2c_ads_accum_init(otb_i2c_ads_accum *accum);
+void otb_i2c_ads_accum_add(otb_i2c_ads_accum *accum, int16_t sample);
+int16_t otb_i2c_ads_accum_mean(otb_i2c_ads_accum *accum);
+uint16_t otb_i2c_ads_accum_ac_rms(otb_i2c_ads_accum *accum);
+uint16_t otb_i2c_ads_accum_rms(otb_i2c_ads_accum *accum);
+bool otb_i2c_ads_read_sample(otb_i2c_ads_samples *samples);
 bool otb_i2c_ads_get_sample(otb_i2c_ads_samples *samples);
 void otb_i2c_ads_finish_sample(otb_i2c_ads_samples *samples);
+bool otb_i2c_ads_cal_init(otb_conf_ads_cal *conf_cal, otb_power_cal *cal);
+uint32_t otb_i2c_ads_sample_mhz(otb_conf_ads *ads);
+void otb_i2c_ads_harmonics_publish(otb_i2c_ads_samples *samples, int val, otb_power_cal *cal);
+void otb_i2c_ads_energy_update(otb_i2c_ads_samples *samples, int32_t w);
+void otb_i2c_ads_energy_publish(otb_conf_ads *ads, otb_i2c_ads_meter *meter);
+void otb_i2c_ads_checkpoint_load(void);
+void otb_i2c_ads_checkpoint_save(void);
+bool otb_i2c_ads_capturing(otb_conf_ads *ads);
+bool otb_i2c_ads_capture_cmd(unsigned char *next_cmd, void *arg, unsigned char *prev_cmd);
+bool otb_i2c_ads_capture_start(otb_i2c_ads_capture *capture);
+void otb_i2c_ads_capture_interrupt(void *arg);
+void otb_i2c_ads_capture_timer(void *arg);
+void otb_i2c_ads_capture_read(otb_i2c_ads_capture *capture);
+void otb_i2c_ads_capture_send(otb_i2c_ads_capture *capture);
+void otb_i2c_ads_capture_finish(otb_i2c_ads_capture *capture);
 extern bool otb_i2c_init();
 char *otb_i2c_mqtt_error_write(char *error);
 bool otb_i2c_mqtt_get_addr(char *byte, uint8 *addr);
@@ -110,6 +296,8 @@ bool otb_i2c_ads_get_binary_val(char *byte, uint8_t *num);
 extern void otb_i2c_mqtt(char *, char **);
 void otb_i2c_ads_mqtt(char *cmd, char **sub_cmd);
 bool otb_i2c_test(uint8 addr);
+void otb_i2c_ads_conf_changed(void);
+void otb_i2c_ads_conf_index(void);
 bool otb_i2c_ads_set_cont_mode(uint8 addr, uint8 msb, uint8 lsb);
 bool otb_i2c_ads_set_read_mode(uint8 addr, uint8 mode);
 bool otb_i2c_ads_read(uint8 addr, int16_t *val);
@@ -126,55 +314,20 @@ bool otb_i2c_write_val(uint8_t val);
 void otb_i2c_bus_start();
 void otb_i2c_bus_stop();
 bool otb_i2c_bus_call(uint8_t addr, bool read);
-bool otb_i2c_write_one_reg(uint8_t addr, uint8_t reg, uint8_t val);
-bool otb_i2c_write_reg_seq(uint8_t addr, uint8_t reg, uint8_t count, uint8_t *val);
-bool otb_i2c_read_one_reg(uint8_t addr, uint8_t reg, uint8_t *val);
-bool otb_i2c_read_reg_seq(uint8_t addr, uint8_t reg, uint8_t count, uint8_t *val);
-bool otb_i2c_write_seq_vals(uint8_t addr, uint8_t count, uint8_t *val);
-bool otb_i2c_read_one_val(uint8_t addr, uint8_t *val);
-bool otb_i2c_write_one_val(uint8_t addr, uint8_t val);
-bool otb_i2c_write_one_reg_info(uint8_t addr, uint8_t reg, uint8_t val, brzo_i2c_info *info);
-bool otb_i2c_write_reg_seq_info(uint8_t addr, uint8_t reg, uint8_t count, uint8_t *val, brzo_i2c_info *info);
-bool otb_i2c_read_one_reg_info(uint8_t addr, uint8_t reg, uint8_t *val, brzo_i2c_info *info);
-bool otb_i2c_read_reg_seq_info(uint8_t addr, uint8_t reg, uint8_t count, uint8_t *val, brzo_i2c_info *info);
-bool otb_i2c_write_seq_vals_info(uint8_t addr, uint8_t count, uint8_t *val, brzo_i2c_info *info);
-bool otb_i2c_read_one_val_info(uint8_t addr, uint8_t *val, brzo_i2c_info *info);
-bool otb_i2c_write_one_val_info(uint8_t addr, uint8_t val, brzo_i2c_info *info);
 
+// Full scale for each gain setting is in otb_power_ads_lsb_uv
 #define OTB_I2C_ADC_GAIN_VALUES 8
-#ifndef OTB_I2C_C  
-extern float otb_i2c_ads_gain_to_v[OTB_I2C_ADC_GAIN_VALUES];
-#else
-float otb_i2c_ads_gain_to_v[OTB_I2C_ADC_GAIN_VALUES] = 
-{
-  // From ADS1115 data sheet:
-  // Gain amplifier setting - valid values 0-7
-  // 000 : FS = ±6.144V(1)
-  // 001 : FS = ±4.096V(1)
-  // 010 : FS = ±2.048V (default)
-  // 011 : FS = ±1.024V
-  // 100 : FS = ±0.512V
-  // 101 : FS = ±0.256V
-  // 110 : FS = ±0.256V
-  // 111 : FS = ±0.256V
-
-  6.144,
-  4.096,
-  2.048,
-  1.024,
-  0.512,
-  0.256,
-  0.256,
-  0.256,
-};
-#endif //OTB_I2C_C
 
 typedef struct otb_i2c_ads_conf_entry
 {
 #define OTB_I2C_ADS_CONF_VAL_TYPE_BYTE    0
 #define OTB_I2C_ADS_CONF_VAL_TYPE_UINT16  1
 #define OTB_I2C_ADS_CONF_VAL_TYPE_OTHER   2
-#define OTB_I2C_ADS_CONF_VAL_TYPE_NUM     3
+// Calibration fields are offsets into otb_conf_ads_cal, not otb_conf_ads
+#define OTB_I2C_ADS_CONF_VAL_TYPE_CAL_UINT16  3
+#define OTB_I2C_ADS_CONF_VAL_TYPE_CAL_UINT32  4
+#define OTB_I2C_ADS_CONF_VAL_TYPE_CAL_BYTE    5
+#define OTB_I2C_ADS_CONF_VAL_TYPE_NUM     6
   uint8_t type;
   int offset;
   int min;
@@ -190,7 +343,14 @@ typedef struct otb_i2c_ads_conf_entry
 #define OTB_CMD_ADS_PERIOD   6
 #define OTB_CMD_ADS_SAMPLES  7
 #define OTB_CMD_ADS_LOC      8
-#define OTB_CMD_ADS_NUM      9
+#define OTB_CMD_ADS_RDY      9
+#define OTB_CMD_ADS_BURDEN   10
+#define OTB_CMD_ADS_TURNS    11
+#define OTB_CMD_ADS_MAINS    12
+#define OTB_CMD_ADS_ENERGY   13
+#define OTB_CMD_ADS_HARMONICS 14
+#define OTB_CMD_ADS_HZ       15
+#define OTB_CMD_ADS_NUM      16
 
 #ifdef OTB_I2C_C
 otb_i2c_ads_conf_entry otb_i2c_ads_conf[OTB_CMD_ADS_NUM] = 
@@ -201,9 +361,16 @@ otb_i2c_ads_conf_entry otb_i2c_ads_conf[OTB_CMD_ADS_NUM] =
   {OTB_I2C_ADS_CONF_VAL_TYPE_BYTE,  offsetof(otb_conf_ads, gain),    0, 7},      // Gain
   {OTB_I2C_ADS_CONF_VAL_TYPE_BYTE,  offsetof(otb_conf_ads, cont),    0, 7},      // Cont
   {OTB_I2C_ADS_CONF_VAL_TYPE_BYTE,  offsetof(otb_conf_ads, rms),     0, 7},      // RMS
-  {OTB_I2C_ADS_CONF_VAL_TYPE_BYTE,  offsetof(otb_conf_ads, period),  0, 65535},  // Period
-  {OTB_I2C_ADS_CONF_VAL_TYPE_BYTE,  offsetof(otb_conf_ads, samples), 0, 1024},   // Samples
+  {OTB_I2C_ADS_CONF_VAL_TYPE_UINT16, offsetof(otb_conf_ads, period),  0, 65534},  // Period
+  {OTB_I2C_ADS_CONF_VAL_TYPE_UINT16, offsetof(otb_conf_ads, samples), 0, OTB_CONF_ADS_MAX_SAMPLES},  // Samples
   {OTB_I2C_ADS_CONF_VAL_TYPE_OTHER, offsetof(otb_conf_ads, loc),     0, 0},     // Loc
+  {OTB_I2C_ADS_CONF_VAL_TYPE_OTHER, offsetof(otb_conf_ads, rdy),     0, OTB_CONF_ADS_RDY_PIN_MAX},  // RDY
+  {OTB_I2C_ADS_CONF_VAL_TYPE_CAL_UINT32, offsetof(otb_conf_ads_cal, burden_mohm), 0, OTB_CONF_ADS_CAL_BURDEN_MAX},  // Burden
+  {OTB_I2C_ADS_CONF_VAL_TYPE_CAL_UINT16, offsetof(otb_conf_ads_cal, turns),   0, 65535},  // Turns
+  {OTB_I2C_ADS_CONF_VAL_TYPE_CAL_UINT16, offsetof(otb_conf_ads_cal, mains_v), 0, OTB_CONF_ADS_CAL_MAINS_V_MAX},  // Mains
+  {OTB_I2C_ADS_CONF_VAL_TYPE_CAL_UINT16, offsetof(otb_conf_ads_cal, energy),  0, OTB_CONF_ADS_CAL_ENERGY_MAX},  // Energy
+  {OTB_I2C_ADS_CONF_VAL_TYPE_CAL_BYTE,   offsetof(otb_conf_ads_cal, harmonics), 0, 0xff},  // Harmonics
+  {OTB_I2C_ADS_CONF_VAL_TYPE_CAL_BYTE,   offsetof(otb_conf_ads_cal, mains_hz),  0, 60},  // Hz
 };
 #endif // OTB_I2C_C
 
@@ -76,6 +76,8 @@
 // 24XX08 - 16 bytes
 // 24XX16 - 16 bytes
 // 24XX32 - 32 bytes
+// 24XX64 - 32 bytes
+// 24XX128 - 64 bytes
 //
 // Reading is done as follows:
 //
@@ -100,6 +102,30 @@
 // Number of bytes supported by a 24AA00 - 4 bits
 #define OTB_I2C_24AA00_BYTES            0x10
 
+// Maximum bytes read in a single transaction when reading sequentially.  brzo
+// bit-bangs the bus, so this bounds how long the CPU is tied up by any one
+// transaction (~3ms at 100KHz), while keeping the number of transactions needed
+// to read a whole hardware info EEPROM low.
+#define OTB_I2C_24XXYY_READ_CHUNK       32
+
+// Page sizes, for page writes.  The 24XX00 doesn't support them, so writes a
+// byte at a time.
+#define OTB_I2C_24XX00_PAGE_SIZE        1
+#define OTB_I2C_24XX01_PAGE_SIZE        8
+#define OTB_I2C_24XX02_PAGE_SIZE        8
+#define OTB_I2C_24XX04_PAGE_SIZE        16
+#define OTB_I2C_24XX08_PAGE_SIZE        16
+#define OTB_I2C_24XX16_PAGE_SIZE        16
+#define OTB_I2C_24XX32_PAGE_SIZE        32
+#define OTB_I2C_24XX64_PAGE_SIZE        32
+#define OTB_I2C_24XX128_PAGE_SIZE       64
+#define OTB_I2C_24XXYY_MAX_PAGE_SIZE    64
+
+// Ack polling after a page write.  The write cycle is at most 5ms, so this
+// allows double that.
+#define OTB_I2C_24XXYY_WRITE_POLLS      100
+#define OTB_I2C_24XXYY_WRITE_POLL_US    100
+
 
 // Note 24XXYY has no registers except IO pin state, and no configuration
 
@@ -117,9 +143,12 @@ uint8_t otb_i2c_24xxyy_next_byte;
 
 void otb_i2c_24xxyy_test_timerfunc(void);
 void otb_i2c_24xxyy_test_init(void);
+bool otb_i2c_24xxyy_read_seq(uint8_t addr, uint8_t *word_addr, uint8_t word_addr_len, uint8_t *buf, uint16_t num_bytes, brzo_i2c_info *info);
 bool otb_i2c_24xxyy_read_bytes(uint8_t addr, uint8_t word_addr, uint8_t *bytes, uint8_t num_bytes, brzo_i2c_info *info);
-bool otb_i2c_24xxyy_write_bytes(uint8_t addr, uint8_t word_addr, uint8_t *bytes, uint8_t num_bytes, brzo_i2c_info *info);
+bool otb_i2c_24xxyy_write_seq(uint8_t addr, uint16_t word_addr, uint8_t word_addr_len, uint8_t page_size, uint8_t *buf, uint16_t num_bytes, brzo_i2c_info *info);
+bool otb_i2c_24xxyy_write_bytes(uint8_t addr, uint8_t word_addr, uint8_t *bytes, uint8_t num_bytes, uint8_t page_size, brzo_i2c_info *info);
 bool otb_i2c_24xxyy_init(uint8_t addr, brzo_i2c_info *info);
 bool otb_i2c_24xx128_read_data(uint8_t addr, uint16_t start_addr, uint16_t bytes, uint8_t *buf, brzo_i2c_info *info);
+bool otb_i2c_24xx128_write_data(uint8_t addr, uint16_t start_addr, uint16_t bytes, uint8_t *buf, brzo_i2c_info *info);
 
 #endif // OTB_I2C_24XXYY_H
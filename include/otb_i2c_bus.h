@@ -0,0 +1,205 @@
+/*
+ * OTB-IOT - Out of The Box Internet Of Things
+ *
+ * Copyright (C) 2020 Piers Finlayson
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. 
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OTB_I2C_BUS_H
+#define OTB_I2C_BUS_H
+
+// Wrappers around brzo for common I2C operations, and the asynchronous
+// transaction queue.  Kept separate from otb_i2c.c so drivers using them can
+// be built and tested on their own.
+
+// Asynchronous I2C transactions.  Callers fill in a descriptor and submit it
+// (or a batch of them, chained via next) to the bus's queue.  Queued
+// transactions are run back-to-back from a timer, for at most a time slice
+// before yielding to the SDK, and each descriptor's callback is called as it
+// completes.  The descriptor, and its buffers, must remain valid until then.
+struct otb_i2c_txn;
+typedef void otb_i2c_txn_cb(struct otb_i2c_txn *txn);
+
+typedef struct otb_i2c_txn
+{
+  // Bus - NULL for brzo's default bus (the non _info brzo functions)
+  brzo_i2c_info *info;
+
+  uint8_t addr;
+
+  // OTB_I2C_TXN_FLAG_*
+#define OTB_I2C_TXN_FLAG_STOP_ON_ERROR  0x01  // Skip the rest of the batch if this fails
+  uint8_t flags;
+
+  // Bytes to write, then bytes to read - either may be 0
+  uint8_t wr_len;
+  uint8_t rd_len;
+  uint8_t *wr;
+  uint8_t *rd;
+
+  // Called (may be NULL) when the transaction completes or is skipped.  May
+  // submit further transactions, including this one.
+  otb_i2c_txn_cb *cb;
+  void *arg;
+
+  // Result - 0 on success, otherwise a brzo error or OTB_I2C_TXN_SKIPPED
+#define OTB_I2C_TXN_SKIPPED  0xff
+  uint8_t brzo_rc;
+
+  // Set while the transaction is queued
+  bool queued;
+
+  // Set on the last transaction of a batch
+  bool batch_end;
+
+  uint8_t pad1[1];
+
+  struct otb_i2c_txn *next;
+
+} otb_i2c_txn;
+
+// One queue per bus, allocated on first use
+#define OTB_I2C_QUEUE_MAX_BUSES  4
+#define OTB_I2C_QUEUE_SLICE_US   2000
+typedef struct otb_i2c_queue
+{
+  brzo_i2c_info *info;
+
+  otb_i2c_txn *head;
+  otb_i2c_txn *tail;
+
+  os_timer_t timer;
+
+  bool in_use;
+
+  // Whether the timer is armed
+  bool scheduled;
+
+  // Skipping the rest of a batch after a failure
+  bool skipping;
+
+  uint8_t pad1[1];
+
+} otb_i2c_queue;
+
+// brzo_i2c_end_transaction return code bits
+#define OTB_I2C_BRZO_RC_BUS_BUSY       0x01
+#define OTB_I2C_BRZO_RC_WRITE_NAK      0x02  // Address or data NAKed on a write
+#define OTB_I2C_BRZO_RC_READ_NAK       0x04  // Address NAKed on a read
+#define OTB_I2C_BRZO_RC_CLOCK_STRETCH  0x08
+
+// Counters for each device, on each bus, updated by the wrappers and the
+// transaction queue - so a saturated or erroring bus can be spotted in the
+// field.  Devices are added on first use, and once the table is full any
+// further devices go uncounted.
+#define OTB_I2C_STATS_MAX  16
+typedef struct otb_i2c_stats
+{
+  // Bus - NULL for brzo's default bus
+  brzo_i2c_info *info;
+
+  uint8_t addr;
+
+  bool in_use;
+
+  uint8_t pad1[2];
+
+  uint32_t transactions;
+
+  // Written and read
+  uint32_t bytes;
+
+  // Failed transactions, for whatever reason
+  uint32_t errors;
+
+  // Transactions failing with a NAK, or with a clock stretch timeout
+  uint32_t naks;
+  uint32_t stretch_timeouts;
+
+  // Time spent in transactions, carried into whole ms
+  uint32_t busy_ms;
+  uint32_t busy_us;
+
+} otb_i2c_stats;
+
+// Longest otb_i2c_stats_cmd response for one entry
+#define OTB_I2C_STATS_RSP_LEN  96
+
+#define OTB_CMD_I2C_STATS_GET    0
+#define OTB_CMD_I2C_STATS_RESET  1
+
+// Shadow copies of write-only or rarely changing registers (such as GPIO
+// expanders' output latches), so drivers can change a single pin without a
+// read-modify-write, and skip writes which wouldn't change anything.  Which
+// register is which is up to the driver.  A register's valid bit is only set
+// once the device is known to hold that value - drivers clear it if a write
+// fails.
+#define OTB_I2C_SHADOW_MAX   16
+#define OTB_I2C_SHADOW_REGS  4
+typedef struct otb_i2c_shadow
+{
+  // Bus - NULL for brzo's default bus
+  brzo_i2c_info *info;
+
+  uint8_t addr;
+
+  bool in_use;
+
+  // Bit set for each reg whose value is known
+  uint8_t valid;
+
+  uint8_t pad1[1];
+
+  uint8_t reg[OTB_I2C_SHADOW_REGS];
+
+} otb_i2c_shadow;
+
+#ifdef OTB_I2C_BUS_C
+otb_i2c_shadow otb_i2c_shadows[OTB_I2C_SHADOW_MAX];
+otb_i2c_queue otb_i2c_queues[OTB_I2C_QUEUE_MAX_BUSES];
+otb_i2c_stats otb_i2c_stats_table[OTB_I2C_STATS_MAX];
+
+// Index of the last entry updated - usually the next one wanted
+uint8_t otb_i2c_stats_last;
+#endif // OTB_I2C_BUS_C
+
+bool otb_i2c_write_one_reg(uint8_t addr, uint8_t reg, uint8_t val);
+bool otb_i2c_write_reg_seq(uint8_t addr, uint8_t reg, uint8_t count, uint8_t *val);
+bool otb_i2c_read_one_reg(uint8_t addr, uint8_t reg, uint8_t *val);
+bool otb_i2c_read_reg_seq(uint8_t addr, uint8_t reg, uint8_t count, uint8_t *val);
+bool otb_i2c_write_seq_vals(uint8_t addr, uint8_t count, uint8_t *val);
+bool otb_i2c_read_one_val(uint8_t addr, uint8_t *val);
+bool otb_i2c_write_one_val(uint8_t addr, uint8_t val);
+bool otb_i2c_write_one_reg_info(uint8_t addr, uint8_t reg, uint8_t val, brzo_i2c_info *info);
+bool otb_i2c_write_reg_seq_info(uint8_t addr, uint8_t reg, uint8_t count, uint8_t *val, brzo_i2c_info *info);
+bool otb_i2c_read_one_reg_info(uint8_t addr, uint8_t reg, uint8_t *val, brzo_i2c_info *info);
+bool otb_i2c_read_reg_seq_info(uint8_t addr, uint8_t reg, uint8_t count, uint8_t *val, brzo_i2c_info *info);
+bool otb_i2c_write_seq_vals_info(uint8_t addr, uint8_t count, uint8_t *val, brzo_i2c_info *info);
+bool otb_i2c_read_one_val_info(uint8_t addr, uint8_t *val, brzo_i2c_info *info);
+bool otb_i2c_write_one_val_info(uint8_t addr, uint8_t val, brzo_i2c_info *info);
+uint8_t otb_i2c_txn_exec(otb_i2c_txn *txn);
+otb_i2c_queue *otb_i2c_queue_get(brzo_i2c_info *info);
+bool otb_i2c_txn_submit(otb_i2c_txn *txns);
+void otb_i2c_queue_timer(void *arg);
+otb_i2c_stats *otb_i2c_stats_get(brzo_i2c_info *info, uint8_t addr);
+void otb_i2c_stats_record(brzo_i2c_info *info, uint8_t addr, uint32_t start, uint16_t bytes, uint8_t brzo_rc);
+void otb_i2c_stats_reset(void);
+void otb_i2c_stats_sum(brzo_i2c_info *info, otb_i2c_stats *total);
+bool otb_i2c_stats_cmd(unsigned char *next_cmd, void *arg, unsigned char *prev_cmd);
+otb_i2c_shadow *otb_i2c_shadow_get(brzo_i2c_info *info, uint8_t addr);
+void otb_i2c_shadow_reset(void);
+void otb_i2c_shadow_reset_bus(brzo_i2c_info *info);
+
+#endif // OTB_I2C_BUS_H
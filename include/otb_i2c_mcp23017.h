@@ -59,8 +59,13 @@
 #define OTB_I2C_MCP23017_CONF_ODR         0b00000100
 #define OTB_I2C_MCP23017_CONF_INTPOL      0b00000010
 
+// otb_i2c_shadow registers
+#define OTB_I2C_MCP23017_SHADOW_OLATA     0
+#define OTB_I2C_MCP23017_SHADOW_OLATB     1
+
 bool otb_i2c_mcp23017_init(uint8_t addr, brzo_i2c_info *info);
 bool otb_i2c_mcp23017_write_gpios(uint8_t gpa, uint8_t gpb, uint8_t addr, brzo_i2c_info *info);
+bool otb_i2c_mcp23017_write_gpio(uint8_t pin, bool value, uint8_t addr, brzo_i2c_info *info);
 bool otb_i2c_mcp23017_read_gpios(uint8_t *gpa, uint8_t *gpb, uint8_t addr, brzo_i2c_info *info);
 
 #endif // OTB_I2C_MCP23017_H
@@ -63,6 +63,36 @@
 // PCA9685 default pre-scale (from datasheet) = 200Hz PWM
 #define OTB_I2C_PCA9685_PRESCALE_DEFAULT  0x1E
 
+// otb_i2c_pca9685_current_state value for a pin which hasn't been written
+// (successfully) since init
+#define OTB_I2C_PCA9685_STATE_UNKNOWN  0xff
+
+// A frame of LEDn register values.  Channels are staged, then written with
+// one auto-increment transaction per contiguous run of staged channels - so
+// staging all 16 costs a single transaction.  Needs MODE1 AI set, which the
+// init functions do.
+#define OTB_I2C_PCA9685_FRAME_MAX_RUNS  (OTB_I2C_PCA9685_NUM_PINS / 2)
+#define OTB_I2C_PCA9685_FRAME_WR_LEN    (OTB_I2C_PCA9685_FRAME_MAX_RUNS + \
+                                         (OTB_I2C_PCA9685_NUM_PINS * OTB_I2C_PCA9685_REG_IO_LEN))
+typedef struct otb_i2c_pca9685_frame
+{
+  // Bit set for each channel staged and not yet written
+  uint16_t staged;
+
+  // Transactions built by otb_i2c_pca9685_frame_build()
+  uint8_t txns;
+
+  uint8_t pad1[1];
+
+  // Staged values, laid out as LEDn_ON_L to LEDn_OFF_H
+  uint8_t led[OTB_I2C_PCA9685_NUM_PINS][OTB_I2C_PCA9685_REG_IO_LEN];
+
+  // A transaction per run, and their buffers - register, then values
+  otb_i2c_txn txn[OTB_I2C_PCA9685_FRAME_MAX_RUNS];
+  uint8_t wr[OTB_I2C_PCA9685_FRAME_WR_LEN];
+
+} otb_i2c_pca9685_frame;
+
 #ifndef OTB_I2C_PCA9685_C
 
 #else
@@ -73,6 +103,7 @@ uint8_t otb_i2c_pca9685_test_addr;
 
 uint8_t otb_i2c_pca9685_desired_state[OTB_I2C_PCA9685_NUM_PINS];
 uint8_t otb_i2c_pca9685_current_state[OTB_I2C_PCA9685_NUM_PINS];
+otb_i2c_pca9685_frame otb_i2c_pca9685_gpio_frame;
 
 brzo_i2c_info otb_i2c_pca9685_brzo_i2c_info;
 bool otb_i2c_pca9685_inited = FALSE;
@@ -93,5 +124,12 @@ void otb_i2c_pca9685_test_init(void);
 bool otb_i2c_pca9685_led_conf(uint8_t, uint8_t led, uint16_t on, uint16_t off);
 bool otb_i2c_pca9685_init(uint8_t addr);
 bool otb_i2c_pca9685_set_mode(uint8_t addr, uint16_t mode);
+void otb_i2c_pca9685_check_led(uint8_t led, uint16_t on, uint16_t off);
+void otb_i2c_pca9685_frame_clear(otb_i2c_pca9685_frame *frame);
+void otb_i2c_pca9685_frame_set(otb_i2c_pca9685_frame *frame, uint8_t led, uint16_t on, uint16_t off);
+void otb_i2c_pca9685_frame_set_state(otb_i2c_pca9685_frame *frame, uint8_t led, bool on);
+uint8_t otb_i2c_pca9685_frame_build(otb_i2c_pca9685_frame *frame, uint8_t addr, brzo_i2c_info *info);
+void otb_i2c_pca9685_frame_txn_leds(otb_i2c_txn *txn, uint8_t *first, uint8_t *num);
+bool otb_i2c_pca9685_frame_write(otb_i2c_pca9685_frame *frame, uint8_t addr, brzo_i2c_info *info);
 
 #endif // OTB_I2C_PCA9685_H
@@ -28,6 +28,9 @@
 
 // Note PCF8574 has no registers except IO pin state, and no configuration
 
+// otb_i2c_shadow register holding the last value written
+#define OTB_I2C_PCF8574_SHADOW_LATCH  0
+
 #ifndef OTB_I2C_PCF8574_C
 
 
@@ -42,6 +45,7 @@ uint8_t otb_i2c_pcf8574_test_addr;
 void otb_i2c_pcf8574_test_timerfunc(void);
 void otb_i2c_pcf8574_test_init(void);
 bool otb_i2c_pcf8574_led_conf(uint8_t, uint8_t led, bool on);
+bool otb_i2c_pcf8574_write(uint8_t addr, uint8_t val);
 bool otb_i2c_pcf8574_init(uint8_t addr);
 
 #endif // OTB_I2C_PCF8574_H
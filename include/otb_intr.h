@@ -29,6 +29,14 @@ typedef struct otb_intr_reg
 
   void *arg;
 
+  // Which edge(s) to interrupt on - values as for gpio_pin_intr_state_set()
+#define OTB_INTR_EDGE_POS  1
+#define OTB_INTR_EDGE_NEG  2
+#define OTB_INTR_EDGE_ANY  3
+  uint8_t edge;
+
+  uint8_t pad1[3];
+
 } otb_intr_reg;
 
 extern otb_intr_reg otb_intr_reg_info[OTB_GPIO_ESP_GPIO_PINS];
@@ -40,6 +48,7 @@ void ICACHE_FLASH_ATTR otb_intr_init(void);
 void ICACHE_FLASH_ATTR otb_intr_clear(uint32_t gpio_status);
 void ICACHE_FLASH_ATTR otb_intr_set();
 bool ICACHE_FLASH_ATTR otb_intr_register(otb_intr_handler_fn *fn, void *arg, uint8_t pin);
+bool ICACHE_FLASH_ATTR otb_intr_register_edge(otb_intr_handler_fn *fn, void *arg, uint8_t pin, uint8_t edge);
 void ICACHE_FLASH_ATTR otb_intr_unreg(uint8_t pin);
 void ICACHE_FLASH_ATTR otb_intr_main_handler(void *arg);
 
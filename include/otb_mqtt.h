@@ -263,7 +263,21 @@ char *otb_mqtt_reasons[OTB_MQTT_REASON_LAST_ + 1] =
 #define OTB_MQTT_I2C_ADS_FIELD_SAMPLES_  6
 #define OTB_MQTT_I2C_ADS_FIELD_LOC       "loc"
 #define OTB_MQTT_I2C_ADS_FIELD_LOC_      7
-#define OTB_MQTT_I2C_ADS_FIELD_LAST_     7
+#define OTB_MQTT_I2C_ADS_FIELD_RDY       "rdy"
+#define OTB_MQTT_I2C_ADS_FIELD_RDY_      8
+#define OTB_MQTT_I2C_ADS_FIELD_BURDEN    "burden"
+#define OTB_MQTT_I2C_ADS_FIELD_BURDEN_   9
+#define OTB_MQTT_I2C_ADS_FIELD_TURNS     "turns"
+#define OTB_MQTT_I2C_ADS_FIELD_TURNS_    10
+#define OTB_MQTT_I2C_ADS_FIELD_MAINS     "mains"
+#define OTB_MQTT_I2C_ADS_FIELD_MAINS_    11
+#define OTB_MQTT_I2C_ADS_FIELD_ENERGY    "energy"
+#define OTB_MQTT_I2C_ADS_FIELD_ENERGY_   12
+#define OTB_MQTT_I2C_ADS_FIELD_HARMONICS  "harmonics"
+#define OTB_MQTT_I2C_ADS_FIELD_HARMONICS_ 13
+#define OTB_MQTT_I2C_ADS_FIELD_HZ        "hz"
+#define OTB_MQTT_I2C_ADS_FIELD_HZ_       14
+#define OTB_MQTT_I2C_ADS_FIELD_LAST_     14
 
 extern char *otb_mqtt_i2c_ads_fields[];
 #ifdef OTB_MQTT_C
@@ -277,6 +291,13 @@ char *otb_mqtt_i2c_ads_fields[OTB_MQTT_I2C_ADS_FIELD_LAST_ + 1] =
   OTB_MQTT_I2C_ADS_FIELD_PERIOD,
   OTB_MQTT_I2C_ADS_FIELD_SAMPLES,
   OTB_MQTT_I2C_ADS_FIELD_LOC,
+  OTB_MQTT_I2C_ADS_FIELD_RDY,
+  OTB_MQTT_I2C_ADS_FIELD_BURDEN,
+  OTB_MQTT_I2C_ADS_FIELD_TURNS,
+  OTB_MQTT_I2C_ADS_FIELD_MAINS,
+  OTB_MQTT_I2C_ADS_FIELD_ENERGY,
+  OTB_MQTT_I2C_ADS_FIELD_HARMONICS,
+  OTB_MQTT_I2C_ADS_FIELD_HZ,
 };
 #endif // OTB_MQTT_C
 
@@ -299,6 +320,14 @@ extern void otb_mqtt_publish(MQTT_Client *mqtt_client,
                              bool retain,
                              char *buf,
                              uint16_t buf_len);
+extern bool otb_mqtt_publish_bin(MQTT_Client *mqtt_client,
+                                 char *subtopic,
+                                 char *extra_subtopic,
+                                 uint8_t *data,
+                                 uint16_t len,
+                                 uint8_t qos,
+                                 bool retain);
+void otb_mqtt_build_topic(char *subtopic, char *extra_subtopic);
 void otb_mqtt_handle_loc(char **loc1,
                          char **loc1_,
                          char **loc2,
@@ -0,0 +1,194 @@
+/*
+ * OTB-IOT - Out of The Box Internet Of Things
+ *
+ * Copyright (C) 2020 Piers Finlayson
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OTB_POWER_H_INCLUDED
+#define OTB_POWER_H_INCLUDED
+
+// Fixed point conversion of ADS readings from a current transformer (CT) into
+// voltage, current and power.  The ESP8266 has no FPU, so this avoids doubles
+// entirely - all runtime maths is integer, with 64-bit intermediates.
+
+// Number of fractional bits in the otb_power_cal multipliers
+#define OTB_POWER_CAL_Q  24
+
+// Calibration for a CT with a burden resistor, precalculated from the CT's
+// parameters so converting a reading is just a couple of multiplies and shifts
+typedef struct otb_power_cal
+{
+  // uA through the burden resistor per uV across it, Q24
+  uint32_t sens_ua;
+
+  // mA through the CT's primary per uV across the burden resistor, Q24
+  uint32_t primary_ma;
+
+  // W drawn at mains_v per uV across the burden resistor, Q24
+  uint32_t w;
+
+  // Assumed mains voltage
+  uint16_t mains_v;
+
+  uint8_t pad1[2];
+
+} otb_power_cal;
+
+// Result of converting one ADS reading
+typedef struct otb_power_reading
+{
+  // Voltage across the burden resistor, uV
+  int32_t uv;
+
+  // Current through the burden resistor, uA
+  int32_t sens_ua;
+
+  // Current through the CT's primary, mA
+  int32_t primary_ma;
+
+  // Power, W
+  int32_t w;
+
+} otb_power_reading;
+
+// Cumulative energy.  Power is integrated over time as W.ms, which is carried
+// into whole Wh, so no energy is lost to rounding however short the interval.
+#define OTB_POWER_WMS_PER_WH  3600000
+typedef struct otb_power_energy
+{
+  // Whole Wh
+  uint32_t wh;
+
+  // Remainder not yet making up a whole Wh, W.ms
+  uint32_t wms;
+
+} otb_power_energy;
+
+// Checkpoint of each ADS's cumulative energy, periodically written to flash so
+// totals survive a reboot.  Records are appended through the energy sectors,
+// and the valid one with the highest seq is the latest - so a sector is only
+// erased when the records wrap around to it, and the previous checkpoint is
+// always still in the other sector.
+#define OTB_POWER_CHECKPOINT_MAGIC     0x45474e45  // "ENGE"
+#define OTB_POWER_CHECKPOINT_INTERVAL  3600000     // ms
+typedef struct otb_power_checkpoint
+{
+  uint32_t magic;
+
+  uint32_t seq;
+
+  // Wh for each ADS, same index as config
+  uint32_t wh[OTB_CONF_ADS_MAX_ADSS];
+
+  // See otb_power_checkpoint_sum
+  uint32_t checksum;
+
+  uint8_t pad1[4];
+
+} otb_power_checkpoint;
+
+// Harmonic analysis of a window of samples, using the Goertzel algorithm - so
+// each harmonic costs a multiply and a couple of adds per sample as the
+// samples are read, and no samples need to be stored.
+#define OTB_POWER_HARMONICS_MAX       8
+#define OTB_POWER_GOERTZEL_Q          14
+// Beyond this many samples the filter state could overflow, so the analysis
+// only covers the start of longer windows
+#define OTB_POWER_GOERTZEL_MAX_SAMPLES 4096
+typedef struct otb_power_goertzel
+{
+  // 2cos(w) for each harmonic being analysed, Q14
+  int32_t coeff[OTB_POWER_HARMONICS_MAX];
+
+  // Filter state for each harmonic
+  int32_t s1[OTB_POWER_HARMONICS_MAX];
+  int32_t s2[OTB_POWER_HARMONICS_MAX];
+
+  uint32_t count;
+
+  // Which harmonic (1 = fundamental) each entry is
+  uint8_t harmonic[OTB_POWER_HARMONICS_MAX];
+
+  // Number of harmonics being analysed - 0 if analysis is off
+  uint8_t num;
+
+  uint8_t pad1[3];
+
+} otb_power_goertzel;
+
+// cos over a quarter turn, Q14, in 64 steps - interpolated by otb_power_cos
+#define OTB_POWER_COS_STEPS  64
+#ifndef OTB_POWER_C
+extern const uint16_t otb_power_cos_table[OTB_POWER_COS_STEPS+1];
+#else
+const uint16_t otb_power_cos_table[OTB_POWER_COS_STEPS+1] =
+{
+  16384, 16379, 16364, 16340, 16305, 16261, 16207, 16143,
+  16069, 15986, 15893, 15791, 15679, 15557, 15426, 15286,
+  15137, 14978, 14811, 14635, 14449, 14256, 14053, 13842,
+  13623, 13395, 13160, 12916, 12665, 12406, 12140, 11866,
+  11585, 11297, 11003, 10702, 10394, 10080, 9760, 9434,
+  9102, 8765, 8423, 8076, 7723, 7366, 7005, 6639,
+  6270, 5897, 5520, 5139, 4756, 4370, 3981, 3590,
+  3196, 2801, 2404, 2006, 1606, 1205, 804, 402,
+  0,
+};
+#endif // OTB_POWER_C
+
+// Size of one ADS LSB in uV, Q8, for each ADS gain setting.  These are exact:
+// full scale is +/-(6.144V >> n) over 0x8000 counts.
+#define OTB_POWER_ADS_GAIN_VALUES  8
+#define OTB_POWER_ADS_LSB_Q        8
+#ifndef OTB_POWER_C
+extern const uint32_t otb_power_ads_lsb_uv[OTB_POWER_ADS_GAIN_VALUES];
+#else
+const uint32_t otb_power_ads_lsb_uv[OTB_POWER_ADS_GAIN_VALUES] =
+{
+  48000,  // 000 : FS = +/-6.144V - 187.5uV
+  32000,  // 001 : FS = +/-4.096V - 125uV
+  16000,  // 010 : FS = +/-2.048V - 62.5uV
+  8000,   // 011 : FS = +/-1.024V - 31.25uV
+  4000,   // 100 : FS = +/-0.512V - 15.625uV
+  2000,   // 101 : FS = +/-0.256V - 7.8125uV
+  2000,   // 110 : FS = +/-0.256V
+  2000,   // 111 : FS = +/-0.256V
+};
+#endif // OTB_POWER_C
+
+bool otb_power_cal_init(otb_power_cal *cal,
+                        uint32_t burden_mohm,
+                        uint16_t turns,
+                        uint16_t mains_v);
+int32_t otb_power_ads_to_uv(int16_t val, uint8_t gain);
+void otb_power_convert(otb_power_cal *cal,
+                       int16_t val,
+                       uint8_t gain,
+                       otb_power_reading *reading);
+int otb_power_milli_to_str(char *buf, int len, int32_t milli, uint8_t dp);
+void otb_power_energy_add(otb_power_energy *energy, int32_t w, uint32_t ms);
+uint32_t otb_power_checkpoint_sum(otb_power_checkpoint *cp);
+int32_t otb_power_cos(uint16_t phase);
+unsigned long long otb_power_isqrt(unsigned long long x);
+int32_t otb_power_counts_to_ma(otb_power_cal *cal, uint32_t counts_q8, uint8_t gain);
+void otb_power_goertzel_init(otb_power_goertzel *g,
+                             uint8_t harmonics,
+                             uint16_t fundamental_hz,
+                             uint32_t sample_mhz);
+void otb_power_goertzel_add(otb_power_goertzel *g, int16_t sample);
+uint32_t otb_power_goertzel_rms(otb_power_goertzel *g, uint8_t index);
+bool otb_power_checkpoint_valid(otb_power_checkpoint *cp);
+
+#endif // OTB_POWER_H_INCLUDED
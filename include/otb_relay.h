@@ -36,6 +36,11 @@ typedef struct otb_relay
   // Expected state of the relays on this module
   sint8_t known_state[16];
 
+  // Bit set for each relay whose known_state was the last value successfully
+  // written - so writing it again can be skipped.  All cleared if any write to
+  // the module fails, as it may have been power cycled.
+  uint16_t known_written;
+
 } otb_relay;
  
 typedef struct otb_relay_mezz_info
@@ -48,7 +53,37 @@ typedef struct otb_relay_mezz_info
 
 } otb_relay_mezz_info;
 
+// Connecting to a relay module is done as a batch of I2C transactions - set
+// the mode, then the status LED and relays as a PCA9685 frame (the relays
+// are one contiguous run, the LED another).  One module is connected at a
+// time.
+#define OTB_RELAY_INIT_RELAYS  8
+#define OTB_RELAY_INIT_RETRY   100  // ms, if another module is connecting
+typedef struct otb_relay_init_batch
+{
+  // Module being connected to - NULL if none
+  otb_relay *relay;
+
+  otb_i2c_txn mode_txn;
+
+  uint8_t mode_bytes[2];
+
+  // State each relay is being set to
+  uint8_t desired_state[OTB_RELAY_INIT_RELAYS];
+
+  otb_i2c_pca9685_frame frame;
+
+  // Relays triggered while the batch is in progress (bit n-1 for relay n), and
+  // the state each was set to.  The frame was built from the states when the
+  // batch was submitted, so would overwrite these - they're written once the
+  // batch is done instead.
+  uint8_t pending;
+  uint8_t pending_state[OTB_RELAY_INIT_RELAYS];
+
+} otb_relay_init_batch;
+
 #ifdef OTB_RELAY_C
+otb_relay_init_batch otb_relay_init_txns;
 otb_relay_mezz_info otb_relay_mezz;
 uint8_t otb_relay_num;
 int8_t otb_relay_id;
@@ -68,12 +103,13 @@ otb_relay *otb_relay_find_status(uint8_t id);
 bool otb_relay_trigger(unsigned char *next_cmd,
                        void *arg,
                        unsigned char *prev_cmd);
-bool otb_relay_trigger_relay(otb_relay *relay_status, uint8_t num, uint8_t state);
+bool otb_relay_trigger_relay(otb_relay *relay_status, uint8_t num, uint8_t state, bool force);
 bool otb_relay_conf_set(unsigned char *next_cmd,
                         void *arg,
                         unsigned char *prev_cmd);
 bool otb_relay_configured(void);
 void otb_relay_init(void);
 void otb_relay_on_timer(void *arg);
+void otb_relay_init_txn_done(otb_i2c_txn *txn);
 
 #endif // OTB_RELAY_H_INCLUDED
\ No newline at end of file
@@ -259,8 +259,15 @@ void do_factory_reset(uint8 *buf)
   uint32 written;
   uint32 *buffer = (uint32 *)buf;
 
-  // Erase config sector - that's all we need to do to clear config
+  // Erase config sector and config journal - that's all we need to do to
+  // clear config
   SPIEraseSector(OTB_BOOT_CONF_LOCATION/0x1000);
+  for (to_loc = OTB_BOOT_CONF_JOURNAL_LOCATION;
+       to_loc < (OTB_BOOT_CONF_JOURNAL_LOCATION + OTB_BOOT_CONF_JOURNAL_LEN);
+       to_loc += 0x1000)
+  {
+    SPIEraseSector(to_loc/0x1000);
+  }
   ets_printf("BOOT: otb-iot boot config cleared\r\n");
 
   ets_printf("BOOT: Write factory image into slot 0\r\n");
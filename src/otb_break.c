@@ -271,6 +271,7 @@ bool ICACHE_FLASH_ATTR otb_break_options_select(char option)
     case 'W':
       INFO("Wipe stored config");
       uint8 spi_rc = spi_flash_erase_sector(OTB_BOOT_CONF_LOCATION / 0x1000);
+      otb_conf_journal_erase(&otb_conf_journal_main);
       INFO(" Wiped");
       otb_reset(otb_break_config_reboot_string);
       break;
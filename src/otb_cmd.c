@@ -801,13 +801,15 @@ bool ICACHE_FLASH_ATTR otb_cmd_control_get_sensor_temp_ds18b20_value(unsigned ch
 {
   bool rc = FALSE;
   int index;
+  char temp_s[OTB_DS18B20_MAX_TEMP_LEN];
   
   ENTRY;
 
   index = otb_ds18b20_valid_index(next_cmd);
   if (index >= 0)
   {
-    otb_cmd_rsp_append(otb_ds18b20_last_temp_s[index]);
+    otb_ds18b20_temp_to_str(otb_ds18b20_last_temp + index, temp_s);
+    otb_cmd_rsp_append(temp_s);
     rc = TRUE;
   }
   else
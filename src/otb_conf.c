@@ -31,6 +31,10 @@ void ICACHE_FLASH_ATTR otb_conf_init(void)
 
   os_memset((void *)&otb_conf_private, 0, sizeof(otb_conf));
   otb_conf = &otb_conf_private;
+  otb_conf_journal_init(&otb_conf_journal_main,
+                        OTB_CONF_JOURNAL_LOCATION,
+                        OTB_CONF_JOURNAL_SECTORS,
+                        sizeof(otb_conf_struct));
 
   EXIT;
 
@@ -63,6 +67,7 @@ void ICACHE_FLASH_ATTR otb_conf_ads_init(otb_conf_struct *conf)
   
   // Belt and braces:
   os_memset(conf->ads, 0, OTB_CONF_ADS_MAX_ADSS * sizeof(otb_conf_ads));
+  os_memset(conf->ads_cal, 0, sizeof(conf->ads_cal));
   
   // Now reset each ADS individually
   for (ii = 0; ii < OTB_CONF_ADS_MAX_ADSS; ii++)
@@ -107,14 +112,40 @@ bool ICACHE_FLASH_ATTR otb_conf_verify(otb_conf_struct *conf)
   {
     // Checksum test failed.  This either means
     // - config is corrupt, in which case we'll wipe and start again
+    // - the otb-iot didn't know about the ads_cal field, in which case
+    //   we'll let the failed check slide - and clear out ads_cal
+    // - the otb-iot didn't know about the ds18b20_alarm field either, in which
+    //   case we'll let the failed check slide - and clear out ds18b20_alarm
+    //   and ads_cal
     // - the otb-iot didn't know about the ip, mqtt_httpd and pad4 fields
-    //   in which case we'll let the failed check slide - and clear out
-    //   the ip, mqtt_httpd and pad4 fields
-    if (otb_conf_verify_checksum(conf, (sizeof(*conf) - sizeof(conf->ip) - 4)))
+    //   either, in which case we'll let the failed check slide - and clear out
+    //   the ip, mqtt_httpd, pad4, ds18b20_alarm and ads_cal fields
+    if (otb_conf_verify_checksum(conf, (sizeof(*conf) - sizeof(conf->ads_cal))))
+    {
+      os_memset((void *)(conf->ads_cal), 0, sizeof(conf->ads_cal));
+      modified = TRUE;
+      MWARN("ADS calibration not in config - correcting");
+    }
+    else if (otb_conf_verify_checksum(conf, (sizeof(*conf) -
+                                             sizeof(conf->ads_cal) -
+                                             sizeof(conf->ds18b20_alarm))))
+    {
+      os_memset((void *)(conf->ds18b20_alarm), 0, sizeof(conf->ds18b20_alarm));
+      os_memset((void *)(conf->ads_cal), 0, sizeof(conf->ads_cal));
+      modified = TRUE;
+      MWARN("DS18B20 alarms not in config - correcting");
+    }
+    else if (otb_conf_verify_checksum(conf, (sizeof(*conf) -
+                                             sizeof(conf->ads_cal) -
+                                             sizeof(conf->ds18b20_alarm) -
+                                             sizeof(conf->ip) -
+                                             4)))
     {
       os_memset((void *)&(conf->ip), 0, sizeof(conf->ip));
       conf->mqtt_httpd = OTB_CONF_MQTT_HTTPD_DISABLED;
       os_memset((void *)(conf->pad4), 0, 3);
+      os_memset((void *)(conf->ds18b20_alarm), 0, sizeof(conf->ds18b20_alarm));
+      os_memset((void *)(conf->ads_cal), 0, sizeof(conf->ads_cal));
       modified = TRUE;
       MWARN("IP info not in config - correcting");
     }
@@ -156,20 +187,44 @@ bool ICACHE_FLASH_ATTR otb_conf_verify(otb_conf_struct *conf)
       MWARN("Invalid number of DS18B20s");
       conf->ds18b20s = 0;
       os_memset(conf->ds18b20, 0, OTB_DS18B20_MAX_DS18B20S * sizeof(otb_conf_ds18b20));
+      os_memset(conf->ds18b20_alarm, 0, sizeof(conf->ds18b20_alarm));
     }
   
     for (ii = 0; ii < OTB_DS18B20_MAX_DS18B20S; ii++)
     {
-      // Check DS18B20 id is right length (or 0), and location is null terminated
+      // Check DS18B20 id is right length (or 0), and location is null terminated.
+      // Location may use the res byte as its terminator (older configs).
       if (((os_strnlen(conf->ds18b20[ii].id, OTB_CONF_DS18B20_MAX_ID_LEN) !=
                                                          OTB_CONF_DS18B20_MAX_ID_LEN-1) &&
            (conf->ds18b20[ii].id[0] != 0)) ||
-          (os_strnlen(conf->ds18b20[ii].loc, OTB_CONF_DS18B20_LOCATION_MAX_LEN) >=
-                                                       OTB_CONF_DS18B20_LOCATION_MAX_LEN))
+          ((os_strnlen(conf->ds18b20[ii].loc, OTB_CONF_DS18B20_LOCATION_MAX_LEN) >=
+                                                       OTB_CONF_DS18B20_LOCATION_MAX_LEN) &&
+           (conf->ds18b20[ii].res != 0)))
       {
         MWARN("DS18B20 index %d id or location invalid", ii);
-        os_memset(conf->ds18b20[ii].id, 0, OTB_CONF_DS18B20_MAX_ID_LEN);
-        os_memset(conf->ds18b20[ii].loc, 0, OTB_CONF_DS18B20_LOCATION_MAX_LEN);
+        os_memset(conf->ds18b20 + ii, 0, sizeof(otb_conf_ds18b20));
+        os_memset(conf->ds18b20_alarm + ii, 0, sizeof(otb_conf_ds18b20_alarm));
+        modified = TRUE;
+      }
+
+      if ((conf->ds18b20[ii].res != OTB_CONF_DS18B20_RES_DEFAULT) &&
+          ((conf->ds18b20[ii].res < OTB_CONF_DS18B20_RES_MIN) ||
+           (conf->ds18b20[ii].res > OTB_CONF_DS18B20_RES_MAX)))
+      {
+        MWARN("DS18B20 index %d resolution invalid %d", ii, conf->ds18b20[ii].res);
+        conf->ds18b20[ii].res = OTB_CONF_DS18B20_RES_DEFAULT;
+        modified = TRUE;
+      }
+
+      if (((conf->ds18b20_alarm[ii].enabled != OTB_CONF_DS18B20_ALARM_DISABLED) &&
+           ((conf->ds18b20_alarm[ii].enabled != OTB_CONF_DS18B20_ALARM_ENABLED) ||
+            (conf->ds18b20_alarm[ii].low < OTB_CONF_DS18B20_ALARM_MIN) ||
+            (conf->ds18b20_alarm[ii].high > OTB_CONF_DS18B20_ALARM_MAX) ||
+            (conf->ds18b20_alarm[ii].low >= conf->ds18b20_alarm[ii].high))) ||
+          (conf->ds18b20_alarm[ii].pad1[0] != 0))
+      {
+        MWARN("DS18B20 index %d alarm invalid", ii);
+        os_memset(conf->ds18b20_alarm + ii, 0, sizeof(otb_conf_ds18b20_alarm));
         modified = TRUE;
       }
     }
@@ -224,29 +279,50 @@ bool ICACHE_FLASH_ATTR otb_conf_verify(otb_conf_struct *conf)
            (conf->ads[ii].addr != 0x4a) &&
            (conf->ads[ii].addr != 0x4b)) ||
           (conf->ads[ii].index != ii) ||
-          (conf->ads[ii].pad1[0] != 0) ||
+          ((conf->ads[ii].rdy < 0) || (conf->ads[ii].rdy > OTB_CONF_ADS_RDY_PIN_MAX)) ||
+          !OTB_CONF_ADS_RDY_CONT_OK(conf->ads[ii].rdy, conf->ads[ii].cont) ||
           ((conf->ads[ii].mux < 0) || (conf->ads[ii].mux > 7)) ||
           ((conf->ads[ii].gain < 0) || (conf->ads[ii].gain > 7)) ||
           ((conf->ads[ii].rate < 0) || (conf->ads[ii].rate > 7)) ||
           ((conf->ads[ii].cont < 0) || (conf->ads[ii].cont > 1)) ||
           ((conf->ads[ii].rms < 0) || (conf->ads[ii].rms > 1)) ||
           ((conf->ads[ii].period < 0) || (conf->ads[ii].period >= 0xffff)) ||
-          ((conf->ads[ii].samples < 0) || (conf->ads[ii].samples >= 1024)))
+          ((conf->ads[ii].samples < 0) || (conf->ads[ii].samples > OTB_CONF_ADS_MAX_SAMPLES)))
       {
         MWARN("ADS index %d something invalid", ii);
         conf->ads[ii].loc[OTB_CONF_ADS_LOCATION_MAX_LEN-1] = 0; // Null terminate just in case!
         MDETAIL("ADS %d index:     %d", ii, conf->ads[ii].index);
         MDETAIL("ADS %d address:   0x%02x", ii, conf->ads[ii].addr);
         MDETAIL("ADS %d location:  %s", ii, conf->ads[ii].loc);
-        MDETAIL("ADS %d pad1:      0x%x", ii, conf->ads[ii].pad1[0]);
         MDETAIL("ADS %d mux:       0x%x", ii, conf->ads[ii].mux);
         MDETAIL("ADS %d gain:      0x%x", ii, conf->ads[ii].gain);
         MDETAIL("ADS %d rate:      0x%x", ii, conf->ads[ii].rate);
         MDETAIL("ADS %d cont:      0x%x", ii, conf->ads[ii].cont);
         MDETAIL("ADS %d rms:       0x%x", ii, conf->ads[ii].rms);
+        MDETAIL("ADS %d rdy:       %d", ii, conf->ads[ii].rdy);
         MDETAIL("ADS %d period:    %ds", ii, conf->ads[ii].period);
         MDETAIL("ADS %d samples:   %d", ii, conf->ads[ii].samples);
         otb_conf_ads_init_one(&(conf->ads[ii]), ii);
+        os_memset(conf->ads_cal + ii, 0, sizeof(otb_conf_ads_cal));
+        modified = TRUE;
+      }
+
+      if ((conf->ads_cal[ii].burden_mohm > OTB_CONF_ADS_CAL_BURDEN_MAX) ||
+          (conf->ads_cal[ii].mains_v > OTB_CONF_ADS_CAL_MAINS_V_MAX) ||
+          (conf->ads_cal[ii].energy > OTB_CONF_ADS_CAL_ENERGY_MAX) ||
+          ((conf->ads_cal[ii].mains_hz != 0) &&
+           (conf->ads_cal[ii].mains_hz != 50) &&
+           (conf->ads_cal[ii].mains_hz != 60)) ||
+          (!otb_i2c_ads_cal_init(conf->ads_cal + ii, NULL)))
+      {
+        MWARN("ADS index %d calibration invalid", ii);
+        MDETAIL("ADS %d burden:    %dmOhm", ii, conf->ads_cal[ii].burden_mohm);
+        MDETAIL("ADS %d turns:     %d", ii, conf->ads_cal[ii].turns);
+        MDETAIL("ADS %d mains:     %dV", ii, conf->ads_cal[ii].mains_v);
+        MDETAIL("ADS %d energy:    %dmins", ii, conf->ads_cal[ii].energy);
+        MDETAIL("ADS %d harmonics: 0x%02x", ii, conf->ads_cal[ii].harmonics);
+        MDETAIL("ADS %d mains hz:  %d", ii, conf->ads_cal[ii].mains_hz);
+        os_memset(conf->ads_cal + ii, 0, sizeof(otb_conf_ads_cal));
         modified = TRUE;
       }
     }
@@ -505,7 +581,12 @@ bool ICACHE_FLASH_ATTR otb_conf_load(void)
 
   ENTRY;
 
-  rc = otb_util_flash_read(OTB_CONF_LOCATION, (uint32 *)otb_conf, sizeof(otb_conf_struct));
+  rc = otb_conf_journal_load(&otb_conf_journal_main, (uint8 *)otb_conf);
+  if (!rc)
+  {
+    MDETAIL("Reading config from 0x%x", OTB_CONF_LOCATION);
+    rc = otb_util_flash_read(OTB_CONF_LOCATION, (uint32 *)otb_conf, sizeof(otb_conf_struct));
+  }
   if (rc)
   {
     // Check it's OK
@@ -566,6 +647,14 @@ void ICACHE_FLASH_ATTR otb_conf_log(otb_conf_struct *conf)
   {
     MDETAIL("DS18B20 #%d address:  %s", ii, conf->ds18b20[ii].id);
     MDETAIL("DS18B20 #%d location: %s", ii, conf->ds18b20[ii].loc);
+    MDETAIL("DS18B20 #%d res:      %d", ii, conf->ds18b20[ii].res);
+    if (conf->ds18b20_alarm[ii].enabled)
+    {
+      MDETAIL("DS18B20 #%d alarm:    %d to %d",
+              ii,
+              conf->ds18b20_alarm[ii].low,
+              conf->ds18b20_alarm[ii].high);
+    }
   }
   MDETAIL("Status LED behaviour: %d", conf->status_led);
   MDETAIL("ADSs:  %d", conf->adss);
@@ -580,6 +669,12 @@ void ICACHE_FLASH_ATTR otb_conf_log(otb_conf_struct *conf)
     MDETAIL("ADS %d rms:       0x%x", ii, conf->ads[ii].rms);
     MDETAIL("ADS %d period:    %ds", ii, conf->ads[ii].period);
     MDETAIL("ADS %d samples:   %d", ii, conf->ads[ii].samples);
+    MDETAIL("ADS %d burden:    %dmOhm", ii, conf->ads_cal[ii].burden_mohm);
+    MDETAIL("ADS %d turns:     %d", ii, conf->ads_cal[ii].turns);
+    MDETAIL("ADS %d mains:     %dV", ii, conf->ads_cal[ii].mains_v);
+    MDETAIL("ADS %d energy:    %dmins", ii, conf->ads_cal[ii].energy);
+    MDETAIL("ADS %d harmonics: 0x%02x", ii, conf->ads_cal[ii].harmonics);
+    MDETAIL("ADS %d mains hz:  %d", ii, conf->ads_cal[ii].mains_hz);
   }
   otb_conf_log_ip(conf, FALSE);
   MDETAIL("MQTT HTTPD enabled: %d", conf->mqtt_httpd);
@@ -652,10 +747,11 @@ bool ICACHE_FLASH_ATTR otb_conf_save(otb_conf_struct *conf)
 
   ENTRY;
 
-  spi_flash_erase_sector(OTB_CONF_LOCATION/0x1000);
-  rc = otb_util_flash_write((uint32)OTB_CONF_LOCATION,
-                            (uint32 *)conf,
-                            sizeof(otb_conf_struct));
+  rc = otb_conf_journal_save(&otb_conf_journal_main, (uint8 *)conf);
+  if (!rc)
+  {
+    MERROR("Failed to save config");
+  }
 
   EXIT;
 
@@ -0,0 +1,619 @@
+/*
+ * OTB-IOT - Out of The Box Internet Of Things
+ *
+ * Copyright (C) 2020 Piers Finlayson
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Config journal - see otb_conf_journal.h.  Kept apart from otb_conf.c (and
+// only using spi_flash_ functions) so it can be tested on the host.
+
+#define OTB_CONF_JOURNAL_C
+#include "otb.h"
+
+MLOG("CONF");
+
+void ICACHE_FLASH_ATTR otb_conf_journal_init(otb_conf_journal *journal,
+                                             uint32_t location,
+                                             uint32_t sectors,
+                                             uint32_t conf_len)
+{
+  ENTRY;
+
+  OTB_ASSERT((location % OTB_CONF_JOURNAL_SECTOR_LEN) == 0);
+  OTB_ASSERT((sectors >= 2) && (sectors <= 32));
+  OTB_ASSERT(otb_conf_journal_blocks(conf_len) <= OTB_CONF_JOURNAL_MAX_BLOCKS);
+
+  // A snapshot must fit in a sector
+  OTB_ASSERT((sizeof(otb_conf_journal_sector_hdr) +
+              sizeof(otb_conf_journal_rec_hdr) +
+              (otb_conf_journal_blocks(conf_len) * sizeof(otb_conf_journal_block))) <=
+                                                         OTB_CONF_JOURNAL_SECTOR_LEN);
+
+  os_memset(journal, 0, sizeof(*journal));
+  journal->location = location;
+  journal->sectors = sectors;
+  journal->conf_len = conf_len;
+  journal->sector = OTB_CONF_JOURNAL_SECTOR_NONE;
+
+  EXIT;
+
+  return;
+}
+
+// CRC-32 (polynomial 0xedb88320), a bit at a time to avoid a 1KB table.
+// Start with crc 0xffffffff.
+uint32_t ICACHE_FLASH_ATTR otb_conf_journal_crc(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+  uint32_t ii;
+  int jj;
+
+  for (ii = 0; ii < len; ii++)
+  {
+    crc ^= data[ii];
+    for (jj = 0; jj < 8; jj++)
+    {
+      crc = (crc & 1) ? ((crc >> 1) ^ 0xedb88320) : (crc >> 1);
+    }
+  }
+
+  return crc;
+}
+
+uint32_t ICACHE_FLASH_ATTR otb_conf_journal_blocks(uint32_t conf_len)
+{
+  return (conf_len + OTB_CONF_JOURNAL_BLOCK_LEN - 1) / OTB_CONF_JOURNAL_BLOCK_LEN;
+}
+
+void ICACHE_FLASH_ATTR otb_conf_journal_block_fill(otb_conf_journal *journal,
+                                                   const uint8_t *conf,
+                                                   uint32_t index,
+                                                   otb_conf_journal_block *block)
+{
+  uint32_t start;
+  uint32_t len;
+
+  os_memset(block, 0, sizeof(*block));
+  block->index = index;
+  start = index * OTB_CONF_JOURNAL_BLOCK_LEN;
+  len = journal->conf_len - start;
+  if (len > OTB_CONF_JOURNAL_BLOCK_LEN)
+  {
+    len = OTB_CONF_JOURNAL_BLOCK_LEN;
+  }
+  os_memcpy(block->data, conf + start, len);
+
+  return;
+}
+
+bool ICACHE_FLASH_ATTR otb_conf_journal_sector_hdr_read(otb_conf_journal *journal,
+                                                        uint32_t sector,
+                                                        otb_conf_journal_sector_hdr *hdr)
+{
+  bool rc = FALSE;
+  uint32_t crc;
+
+  ENTRY;
+
+  if (spi_flash_read(journal->location + (sector * OTB_CONF_JOURNAL_SECTOR_LEN),
+                     (uint32 *)hdr,
+                     sizeof(*hdr)) != SPI_FLASH_RESULT_OK)
+  {
+    MWARN("Failed to read config journal sector %d", sector);
+    goto EXIT_LABEL;
+  }
+
+  if ((hdr->magic != OTB_CONF_JOURNAL_MAGIC) ||
+      (hdr->block_len != OTB_CONF_JOURNAL_BLOCK_LEN) ||
+      (hdr->conf_len == 0) ||
+      (otb_conf_journal_blocks(hdr->conf_len) > OTB_CONF_JOURNAL_MAX_BLOCKS))
+  {
+    goto EXIT_LABEL;
+  }
+
+  crc = otb_conf_journal_crc(0xffffffff,
+                             (uint8_t *)hdr,
+                             (uint8_t *)&(hdr->crc) - (uint8_t *)hdr);
+  if (crc != hdr->crc)
+  {
+    MDETAIL("Config journal sector %d bad header checksum", sector);
+    goto EXIT_LABEL;
+  }
+
+  rc = TRUE;
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return rc;
+}
+
+//
+// Rebuilds the config from a sector's records, stopping at unused flash or
+// the first bad record.  Each record is checked before any of it is used.
+// Fails if there's no good snapshot at the start of the sector.
+//
+bool ICACHE_FLASH_ATTR otb_conf_journal_replay(otb_conf_journal *journal,
+                                               uint32_t sector,
+                                               otb_conf_journal_sector_hdr *hdr,
+                                               uint8_t *conf)
+{
+  bool rc = FALSE;
+  uint32_t base;
+  uint32_t off;
+  uint32_t rec_len;
+  uint32_t sector_blocks;
+  uint32_t copy_len;
+  uint32_t start;
+  uint32_t crc;
+  uint32_t records = 0;
+  uint32_t ii;
+  bool dirty = FALSE;
+  otb_conf_journal_rec_hdr rec;
+  otb_conf_journal_block block;
+
+  ENTRY;
+
+  base = journal->location + (sector * OTB_CONF_JOURNAL_SECTOR_LEN);
+  sector_blocks = otb_conf_journal_blocks(hdr->conf_len);
+  copy_len = (hdr->conf_len < journal->conf_len) ? hdr->conf_len : journal->conf_len;
+  os_memset(conf, 0, journal->conf_len);
+
+  off = sizeof(*hdr);
+  while ((off + sizeof(rec)) <= OTB_CONF_JOURNAL_SECTOR_LEN)
+  {
+    if (spi_flash_read(base + off, (uint32 *)&rec, sizeof(rec)) != SPI_FLASH_RESULT_OK)
+    {
+      goto EXIT_LABEL;
+    }
+    if ((rec.magic == 0xffff) && (rec.blocks == 0xffff))
+    {
+      // Unused from here
+      break;
+    }
+
+    rec_len = sizeof(rec) + (rec.blocks * sizeof(block));
+    if ((rec.magic != OTB_CONF_JOURNAL_REC_MAGIC) ||
+        (rec.blocks == 0) ||
+        (rec.blocks > sector_blocks) ||
+        ((off + rec_len) > OTB_CONF_JOURNAL_SECTOR_LEN) ||
+        ((records == 0) && (rec.blocks != sector_blocks)))
+    {
+      MWARN("Config journal sector %d bad record at 0x%x", sector, off);
+      dirty = TRUE;
+      break;
+    }
+
+    crc = otb_conf_journal_crc(0xffffffff,
+                               (uint8_t *)&rec,
+                               (uint8_t *)&(rec.crc) - (uint8_t *)&rec);
+    for (ii = 0; ii < rec.blocks; ii++)
+    {
+      if (spi_flash_read(base + off + sizeof(rec) + (ii * sizeof(block)),
+                         (uint32 *)&block,
+                         sizeof(block)) != SPI_FLASH_RESULT_OK)
+      {
+        goto EXIT_LABEL;
+      }
+      if (block.index >= sector_blocks)
+      {
+        break;
+      }
+      crc = otb_conf_journal_crc(crc, (uint8_t *)&block, sizeof(block));
+    }
+    if ((ii < rec.blocks) || (crc != rec.crc))
+    {
+      MWARN("Config journal sector %d bad record at 0x%x", sector, off);
+      dirty = TRUE;
+      break;
+    }
+
+    for (ii = 0; ii < rec.blocks; ii++)
+    {
+      if (spi_flash_read(base + off + sizeof(rec) + (ii * sizeof(block)),
+                         (uint32 *)&block,
+                         sizeof(block)) != SPI_FLASH_RESULT_OK)
+      {
+        goto EXIT_LABEL;
+      }
+      start = block.index * OTB_CONF_JOURNAL_BLOCK_LEN;
+      if (start < copy_len)
+      {
+        os_memcpy(conf + start,
+                  block.data,
+                  ((copy_len - start) < OTB_CONF_JOURNAL_BLOCK_LEN) ?
+                                      (copy_len - start) : OTB_CONF_JOURNAL_BLOCK_LEN);
+      }
+    }
+
+    off += rec_len;
+    records++;
+  }
+
+  if (records == 0)
+  {
+    MWARN("Config journal sector %d has no snapshot", sector);
+    goto EXIT_LABEL;
+  }
+
+  // A sector started with a different length config can't take records for
+  // this one
+  if (hdr->conf_len != journal->conf_len)
+  {
+    MDETAIL("Config length changed from %d to %d", hdr->conf_len, journal->conf_len);
+    dirty = TRUE;
+  }
+
+  MDETAIL("Config journal sector %d seq %d: %d records, %d bytes",
+          sector,
+          hdr->seq,
+          records,
+          off);
+  journal->sector = sector;
+  journal->seq = hdr->seq;
+  journal->next = off;
+  journal->dirty = dirty;
+  rc = TRUE;
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return rc;
+}
+
+//
+// Loads the config from the newest sector which can be replayed - falling
+// back to older sectors.  Returns FALSE if there's no journal.
+//
+bool ICACHE_FLASH_ATTR otb_conf_journal_load(otb_conf_journal *journal, uint8_t *conf)
+{
+  bool rc = FALSE;
+  otb_conf_journal_sector_hdr hdr;
+  otb_conf_journal_block block;
+  uint32_t tried = 0;
+  uint32_t best;
+  uint32_t best_seq;
+  uint32_t max_seq = 0;
+  uint32_t ii;
+
+  ENTRY;
+
+  journal->sector = OTB_CONF_JOURNAL_SECTOR_NONE;
+  journal->seq = 0;
+  journal->next = 0;
+  journal->dirty = FALSE;
+  os_memset(journal->block_crc, 0, sizeof(journal->block_crc));
+
+  while (!rc)
+  {
+    best = OTB_CONF_JOURNAL_SECTOR_NONE;
+    best_seq = 0;
+    for (ii = 0; ii < journal->sectors; ii++)
+    {
+      if (!(tried & (1 << ii)) &&
+          otb_conf_journal_sector_hdr_read(journal, ii, &hdr) &&
+          ((best == OTB_CONF_JOURNAL_SECTOR_NONE) || (hdr.seq > best_seq)))
+      {
+        best = ii;
+        best_seq = hdr.seq;
+      }
+    }
+    if (best == OTB_CONF_JOURNAL_SECTOR_NONE)
+    {
+      break;
+    }
+
+    // New sectors must be numbered after every valid header, even unusable
+    // ones
+    if (best_seq > max_seq)
+    {
+      max_seq = best_seq;
+    }
+
+    tried |= (1 << best);
+    if (otb_conf_journal_sector_hdr_read(journal, best, &hdr))
+    {
+      rc = otb_conf_journal_replay(journal, best, &hdr, conf);
+    }
+  }
+
+  journal->seq = max_seq;
+  if (!rc)
+  {
+    MDETAIL("No config journal");
+    goto EXIT_LABEL;
+  }
+
+  for (ii = 0; ii < otb_conf_journal_blocks(journal->conf_len); ii++)
+  {
+    otb_conf_journal_block_fill(journal, conf, ii, &block);
+    journal->block_crc[ii] = otb_conf_journal_crc(0xffffffff,
+                                                  block.data,
+                                                  OTB_CONF_JOURNAL_BLOCK_LEN);
+  }
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return rc;
+}
+
+// Number of blocks which differ from when the config was last saved or loaded
+uint32_t ICACHE_FLASH_ATTR otb_conf_journal_changed(otb_conf_journal *journal, const uint8_t *conf)
+{
+  otb_conf_journal_block block;
+  uint32_t changed = 0;
+  uint32_t ii;
+
+  ENTRY;
+
+  for (ii = 0; ii < otb_conf_journal_blocks(journal->conf_len); ii++)
+  {
+    otb_conf_journal_block_fill(journal, conf, ii, &block);
+    if (otb_conf_journal_crc(0xffffffff, block.data, OTB_CONF_JOURNAL_BLOCK_LEN) !=
+                                                                   journal->block_crc[ii])
+    {
+      changed++;
+    }
+  }
+
+  EXIT;
+
+  return changed;
+}
+
+//
+// Writes a record at addr of either every block (a snapshot) or the blocks
+// which have changed.  The header, with the CRC, goes first - so a record
+// which is only partly written fails its CRC.
+//
+bool ICACHE_FLASH_ATTR otb_conf_journal_write_rec(otb_conf_journal *journal,
+                                                  uint32_t addr,
+                                                  const uint8_t *conf,
+                                                  bool snapshot)
+{
+  bool rc = FALSE;
+  otb_conf_journal_rec_hdr rec;
+  otb_conf_journal_block block;
+  uint32_t crc;
+  uint32_t ii;
+  int pass;
+
+  ENTRY;
+
+  os_memset(&rec, 0, sizeof(rec));
+  rec.magic = OTB_CONF_JOURNAL_REC_MAGIC;
+  rec.blocks = snapshot ? otb_conf_journal_blocks(journal->conf_len) :
+                          otb_conf_journal_changed(journal, conf);
+  crc = otb_conf_journal_crc(0xffffffff,
+                             (uint8_t *)&rec,
+                             (uint8_t *)&(rec.crc) - (uint8_t *)&rec);
+
+  // First pass calculates the CRC, second writes the blocks
+  for (pass = 0; pass < 2; pass++)
+  {
+    if (pass == 1)
+    {
+      rec.crc = crc;
+      if (spi_flash_write(addr, (uint32 *)&rec, sizeof(rec)) != SPI_FLASH_RESULT_OK)
+      {
+        goto EXIT_LABEL;
+      }
+      addr += sizeof(rec);
+      journal->bytes_written += sizeof(rec);
+    }
+
+    for (ii = 0; ii < otb_conf_journal_blocks(journal->conf_len); ii++)
+    {
+      otb_conf_journal_block_fill(journal, conf, ii, &block);
+      if (!snapshot &&
+          (otb_conf_journal_crc(0xffffffff, block.data, OTB_CONF_JOURNAL_BLOCK_LEN) ==
+                                                                  journal->block_crc[ii]))
+      {
+        continue;
+      }
+
+      if (pass == 0)
+      {
+        crc = otb_conf_journal_crc(crc, (uint8_t *)&block, sizeof(block));
+      }
+      else
+      {
+        if (spi_flash_write(addr, (uint32 *)&block, sizeof(block)) != SPI_FLASH_RESULT_OK)
+        {
+          goto EXIT_LABEL;
+        }
+        addr += sizeof(block);
+        journal->bytes_written += sizeof(block);
+      }
+    }
+  }
+
+  rc = TRUE;
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return rc;
+}
+
+//
+// Starts the next sector in the ring with a snapshot of conf.  The previous
+// sector stays in use until this one's header is written.
+//
+bool ICACHE_FLASH_ATTR otb_conf_journal_compact(otb_conf_journal *journal, const uint8_t *conf)
+{
+  bool rc = FALSE;
+  otb_conf_journal_sector_hdr hdr;
+  uint32_t sector;
+  uint32_t base;
+
+  ENTRY;
+
+  if (journal->sector == OTB_CONF_JOURNAL_SECTOR_NONE)
+  {
+    sector = 0;
+  }
+  else
+  {
+    sector = (journal->sector + 1) % journal->sectors;
+  }
+  base = journal->location + (sector * OTB_CONF_JOURNAL_SECTOR_LEN);
+
+  if (spi_flash_erase_sector(base / OTB_CONF_JOURNAL_SECTOR_LEN) != SPI_FLASH_RESULT_OK)
+  {
+    MWARN("Failed to erase config journal sector %d", sector);
+    goto EXIT_LABEL;
+  }
+
+  if (!otb_conf_journal_write_rec(journal, base + sizeof(hdr), conf, TRUE))
+  {
+    MWARN("Failed to write config snapshot to sector %d", sector);
+    goto EXIT_LABEL;
+  }
+
+  os_memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = OTB_CONF_JOURNAL_MAGIC;
+  hdr.seq = journal->seq + 1;
+  hdr.conf_len = journal->conf_len;
+  hdr.block_len = OTB_CONF_JOURNAL_BLOCK_LEN;
+  hdr.crc = otb_conf_journal_crc(0xffffffff,
+                                 (uint8_t *)&hdr,
+                                 (uint8_t *)&(hdr.crc) - (uint8_t *)&hdr);
+  if (spi_flash_write(base, (uint32 *)&hdr, sizeof(hdr)) != SPI_FLASH_RESULT_OK)
+  {
+    MWARN("Failed to write config journal sector %d header", sector);
+    goto EXIT_LABEL;
+  }
+  journal->bytes_written += sizeof(hdr);
+
+  MDETAIL("Config journal moved to sector %d seq %d", sector, hdr.seq);
+  journal->sector = sector;
+  journal->seq = hdr.seq;
+  journal->next = sizeof(hdr) +
+                  sizeof(otb_conf_journal_rec_hdr) +
+                  (otb_conf_journal_blocks(journal->conf_len) * sizeof(otb_conf_journal_block));
+  journal->dirty = FALSE;
+  journal->compactions++;
+  rc = TRUE;
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return rc;
+}
+
+//
+// Saves conf - appending the blocks which changed to the current sector if
+// they fit, otherwise moving to the next sector.  Nothing is written if
+// nothing has changed.
+//
+bool ICACHE_FLASH_ATTR otb_conf_journal_save(otb_conf_journal *journal, const uint8_t *conf)
+{
+  bool rc = FALSE;
+  otb_conf_journal_block block;
+  uint32_t changed;
+  uint32_t rec_len;
+  uint32_t ii;
+
+  ENTRY;
+
+  changed = otb_conf_journal_changed(journal, conf);
+  if ((journal->sector != OTB_CONF_JOURNAL_SECTOR_NONE) && (changed == 0))
+  {
+    MDEBUG("Config unchanged");
+    rc = TRUE;
+    goto EXIT_LABEL;
+  }
+
+  rec_len = sizeof(otb_conf_journal_rec_hdr) + (changed * sizeof(otb_conf_journal_block));
+  if ((journal->sector != OTB_CONF_JOURNAL_SECTOR_NONE) &&
+      !journal->dirty &&
+      ((journal->next + rec_len) <= OTB_CONF_JOURNAL_SECTOR_LEN))
+  {
+    rc = otb_conf_journal_write_rec(journal,
+                                    journal->location +
+                                      (journal->sector * OTB_CONF_JOURNAL_SECTOR_LEN) +
+                                      journal->next,
+                                    conf,
+                                    FALSE);
+    if (rc)
+    {
+      MDEBUG("Config journal: %d blocks changed", changed);
+      journal->next += rec_len;
+      journal->appends++;
+    }
+    else
+    {
+      // Whatever was written is junk - so start afresh in a new sector
+      MWARN("Failed to append to config journal");
+      journal->dirty = TRUE;
+    }
+  }
+
+  if (!rc)
+  {
+    rc = otb_conf_journal_compact(journal, conf);
+    if (!rc)
+    {
+      goto EXIT_LABEL;
+    }
+  }
+
+  for (ii = 0; ii < otb_conf_journal_blocks(journal->conf_len); ii++)
+  {
+    otb_conf_journal_block_fill(journal, conf, ii, &block);
+    journal->block_crc[ii] = otb_conf_journal_crc(0xffffffff,
+                                                  block.data,
+                                                  OTB_CONF_JOURNAL_BLOCK_LEN);
+  }
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return rc;
+}
+
+// Erases the whole journal - so the next save starts it again
+void ICACHE_FLASH_ATTR otb_conf_journal_erase(otb_conf_journal *journal)
+{
+  uint32_t ii;
+
+  ENTRY;
+
+  for (ii = 0; ii < journal->sectors; ii++)
+  {
+    if (spi_flash_erase_sector((journal->location / OTB_CONF_JOURNAL_SECTOR_LEN) + ii) !=
+                                                                      SPI_FLASH_RESULT_OK)
+    {
+      MWARN("Failed to erase config journal sector %d", ii);
+    }
+  }
+  journal->sector = OTB_CONF_JOURNAL_SECTOR_NONE;
+  journal->seq = 0;
+  journal->next = 0;
+  journal->dirty = FALSE;
+  os_memset(journal->block_crc, 0, sizeof(journal->block_crc));
+
+  EXIT;
+
+  return;
+}
@@ -38,34 +38,86 @@
 
 MLOG("DS18B20");
 
+// Brings up a 1-Wire bus on the specified GPIO - may be called once per bus
 void ICACHE_FLASH_ATTR otb_ds18b20_initialize(uint8_t bus)
 {
-  bool rc;
   int ii;
+  bool first;
+  otb_ds18b20_ow_engine *ow;
 
   ENTRY;
 
   MDETAIL("Initialize one wire bus on GPIO pin %d", bus);
 
+  // GPIO16 can't be driven using the standard GPIO registers
+  if (!otb_gpio_is_valid(bus) || (bus == 16))
+  {
+    MWARN("Can't run one wire bus on GPIO %d", bus);
+    goto EXIT_LABEL;
+  }
+
+  for (ii = 0; ii < otb_ds18b20_buses; ii++)
+  {
+    if (otb_ds18b20_ow[ii].gpio == bus)
+    {
+      MDETAIL("Already have one wire bus on GPIO %d", bus);
+      goto EXIT_LABEL;
+    }
+  }
+
+  if (otb_ds18b20_buses >= OTB_DS18B20_MAX_BUSES)
+  {
+    MWARN("Already have %d one wire buses - not adding GPIO %d",
+          OTB_DS18B20_MAX_BUSES,
+          bus);
+    goto EXIT_LABEL;
+  }
+
+  first = (otb_ds18b20_buses == 0);
+
   otb_ds18b20_init(bus);
 
-  INFO("OTB: One wire bus initialized");
+  // Set up the 1-Wire engine for this bus
+  ow = otb_ds18b20_ow + otb_ds18b20_buses;
+  os_memset(ow, 0, sizeof(*ow));
+  ow->bus = otb_ds18b20_buses;
+  ow->gpio = bus;
+  ow->state = OTB_DS18B20_OW_STATE_IDLE;
+  os_timer_disarm((os_timer_t*)&ow->timer);
+  os_timer_setfn((os_timer_t*)&ow->timer, (os_timer_func_t *)otb_ds18b20_ow_step, ow);
+  otb_ds18b20_buses++;
+
+  INFO("OTB: One wire bus %d initialized", ow->bus);
   
-  // Initialize last temp
-  for (ii = 0; ii < OTB_DS18B20_MAX_DS18B20S; ii++)
+  if (first)
   {
-    os_strncpy(otb_ds18b20_last_temp_s[ii], OTB_DS18B20_INTERNAL_ERROR_TEMP, OTB_DS18B20_MAX_TEMP_LEN);
-    otb_ds18b20_last_temp_s[ii][OTB_DS18B20_MAX_TEMP_LEN-1] - 0;
+    // Initialize last temp
+    os_memset(otb_ds18b20_last_temp, 0, sizeof(otb_ds18b20_last_temp));
+    otb_ds18b20_count = 0;
+    otb_ds18b20_hash_rebuild();
+
+    // Set timer to periodically rescan buses for more devices
+    os_timer_disarm((os_timer_t*)&otb_ds18b20_device_timer);
+    os_timer_setfn((os_timer_t*)&otb_ds18b20_device_timer, (os_timer_func_t *)otb_ds18b20_device_callback, NULL);
+    os_timer_arm((os_timer_t*)&otb_ds18b20_device_timer, OTB_DS18B20_REFRESH_DEVICE_INTERVAL, 1);
+
+    // Set timer to sample all devices on all buses once per report interval
+    os_timer_disarm((os_timer_t*)&otb_ds18b20_sample_timer);
+    os_timer_setfn((os_timer_t*)&otb_ds18b20_sample_timer, (os_timer_func_t *)otb_ds18b20_callback, NULL);
+    os_timer_arm((os_timer_t*)&otb_ds18b20_sample_timer, OTB_DS18B20_REPORT_INTERVAL, 1);
+
+    // Set timer to check more frequently for devices outside their alarm
+    // thresholds
+    os_timer_disarm((os_timer_t*)&otb_ds18b20_alarm_timer);
+    os_timer_setfn((os_timer_t*)&otb_ds18b20_alarm_timer, (os_timer_func_t *)otb_ds18b20_alarm_callback, NULL);
+    os_timer_arm((os_timer_t*)&otb_ds18b20_alarm_timer, OTB_DS18B20_ALARM_INTERVAL, 1);
   }
 
-  // Get devices
-  otb_ds18b20_count = 0;
-  otb_ds18b20_device_callback(NULL);  
+  // Get devices - this completes asynchronously, and kicks off a sample of
+  // this bus if any devices are found
+  otb_ds18b20_ow_queue(ow, OTB_DS18B20_OW_PENDING_SEARCH);
 
-  // Set timer to periodically rescan bus for more devices
-  os_timer_disarm((os_timer_t*)&otb_ds18b20_device_timer);
-  os_timer_setfn((os_timer_t*)&otb_ds18b20_device_timer, (os_timer_func_t *)otb_ds18b20_device_callback, NULL);
-  os_timer_arm((os_timer_t*)&otb_ds18b20_device_timer, OTB_DS18B20_REFRESH_DEVICE_INTERVAL, 1);
+EXIT_LABEL:
 
   EXIT;
   
@@ -94,203 +146,432 @@ int ICACHE_FLASH_ATTR otb_ds18b20_valid_index(unsigned char *next_cmd)
 
 void ICACHE_FLASH_ATTR otb_ds18b20_device_callback(void *arg)
 {
-  bool rc;
-  uint8_t prev_count;
+  ENTRY;
+
+  MDEBUG("Checking for new DS18B20s");
+
+  otb_ds18b20_ow_request(OTB_DS18B20_OW_PENDING_SEARCH);
+
+  EXIT;
+
+  return;
+}
+
+// Returns the index of the device with this ROM in otb_ds18b20_addresses, or
+// -1 if it isn't known.  The ROM's CRC must already have been checked.
+int ICACHE_FLASH_ATTR otb_ds18b20_find_device(uint8_t *rom)
+{
+  int index = -1;
+  uint8_t slot;
+  uint8_t entry;
   int ii;
-  uint32_t timer_int;
-  
+
   ENTRY;
 
-  prev_count = otb_ds18b20_count;
+  slot = rom[OTB_DS18B20_DEVICE_ADDRESS_LENGTH-1] & (OTB_DS18B20_HASH_SIZE-1);
+  for (ii = 0; ii < OTB_DS18B20_HASH_SIZE; ii++)
+  {
+    // Entries are the index + 1, so 0 is empty
+    entry = otb_ds18b20_hash[slot];
+    if (entry == 0)
+    {
+      break;
+    }
+    if (!os_memcmp(otb_ds18b20_addresses[entry-1].addr,
+                   rom,
+                   OTB_DS18B20_DEVICE_ADDRESS_LENGTH))
+    {
+      index = entry - 1;
+      break;
+    }
+    slot = (slot + 1) & (OTB_DS18B20_HASH_SIZE-1);
+  }
 
-  MDEBUG("Checking for new DS18B20s");
+  EXIT;
 
-  rc = otb_ds18b20_get_devices();
-  if (rc)
+  return index;
+}
+
+void ICACHE_FLASH_ATTR otb_ds18b20_hash_add(uint8_t index)
+{
+  uint8_t slot;
+
+  ENTRY;
+
+  slot = otb_ds18b20_addresses[index].addr[OTB_DS18B20_DEVICE_ADDRESS_LENGTH-1] &
+                                                           (OTB_DS18B20_HASH_SIZE-1);
+
+  // There are more slots than devices, so this will find a free one
+  while (otb_ds18b20_hash[slot] != 0)
+  {
+    slot = (slot + 1) & (OTB_DS18B20_HASH_SIZE-1);
+  }
+  otb_ds18b20_hash[slot] = index + 1;
+
+  EXIT;
+
+  return;
+}
+
+// Called when devices are removed, as this changes their indexes
+void ICACHE_FLASH_ATTR otb_ds18b20_hash_rebuild(void)
+{
+  uint8_t ii;
+
+  ENTRY;
+
+  os_memset(otb_ds18b20_hash, 0, sizeof(otb_ds18b20_hash));
+  for (ii = 0; ii < otb_ds18b20_count; ii++)
   {
-    MWARN("More than %d DS18B20 devices - only reading from first %d",
+    otb_ds18b20_hash_add(ii);
+  }
+
+  EXIT;
+
+  return;
+}
+
+// Called with each ROM found during a search of a bus.  Returns FALSE if the
+// ROM was corrupt.
+bool ICACHE_FLASH_ATTR otb_ds18b20_add_device(uint8_t bus, uint8_t *ds18b20)
+{
+  bool rc = FALSE;
+  uint8_t crc;
+  int index;
+  otbDs18b20DeviceAddress *addr;
+
+  ENTRY;
+
+  // Only progress if crc is good
+  crc = crc8(ds18b20, 7);
+  if (crc != ds18b20[7])
+  {
+    MWARN("CRC error: %02x-%02x%02x%02x%02x%02x%02x, crc=0x%x",
+         ds18b20[0],
+         ds18b20[6],
+         ds18b20[5],
+         ds18b20[4],
+         ds18b20[3],
+         ds18b20[2],
+         ds18b20[1],
+         crc);
+    goto EXIT_LABEL;
+  }
+  rc = TRUE;
+
+  // Only actually add this device if we haven't already added it when
+  // previously scanning the bus
+  index = otb_ds18b20_find_device(ds18b20);
+  if (index >= 0)
+  {
+    otb_ds18b20_addresses[index].flags |= OTB_DS18B20_DEVICE_SEEN;
+    goto EXIT_LABEL;
+  }
+
+  if (otb_ds18b20_count >= OTB_DS18B20_MAX_DS18B20S)
+  {
+    MWARN("More than %d DS18B20 devices - ignoring %02x-%02x%02x%02x%02x%02x%02x",
          OTB_DS18B20_MAX_DS18B20S,
-         OTB_DS18B20_MAX_DS18B20S);
+         ds18b20[0],
+         ds18b20[6],
+         ds18b20[5],
+         ds18b20[4],
+         ds18b20[3],
+         ds18b20[2],
+         ds18b20[1]);
+    goto EXIT_LABEL;
+  }
+
+  addr = otb_ds18b20_addresses + otb_ds18b20_count;
+  os_memcpy(addr->addr,
+            ds18b20, 
+            OTB_DS18B20_DEVICE_ADDRESS_LENGTH);
+  // I want the address format in the same format as debian/raspbian
+  // Which reverses the order of all but the first byte, and drops the CRC8
+  // byte at the end (which we'll check).
+  os_snprintf((char*)addr->friendly,
+              OTB_DS18B20_MAX_ADDRESS_STRING_LENGTH,
+              "%02x-%02x%02x%02x%02x%02x%02x",
+              ds18b20[0],
+              ds18b20[6],
+              ds18b20[5],
+              ds18b20[4],
+              ds18b20[3],
+              ds18b20[2],
+              ds18b20[1]);
+  addr->index = otb_ds18b20_count;
+  addr->bus = bus;
+  addr->res = 0;
+  addr->flags = OTB_DS18B20_DEVICE_SEEN;
+  os_memset(otb_ds18b20_last_temp + otb_ds18b20_count, 0, sizeof(otb_ds18b20_temp));
+  otb_ds18b20_hash_add(otb_ds18b20_count);
+  otb_ds18b20_conf_changed();
+  MDEBUG("Successfully added device %s on bus %d",
+        addr->friendly,
+        bus);
+  otb_ds18b20_count++;
+  otb_ds18b20_ow[bus].added++;
+  otb_ds18b20_publish_event(addr, "added");
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return rc;
+}
+
+// Called when a device is no longer found on its bus.  Later devices are moved
+// down to fill the gap.
+void ICACHE_FLASH_ATTR otb_ds18b20_remove_device(uint8_t index)
+{
+  uint8_t ii;
+
+  ENTRY;
+
+  MDETAIL("Removing device %s from bus %d",
+          otb_ds18b20_addresses[index].friendly,
+          otb_ds18b20_addresses[index].bus);
+  otb_ds18b20_publish_event(otb_ds18b20_addresses + index, "removed");
+
+  for (ii = index; ii < (otb_ds18b20_count - 1); ii++)
+  {
+    otb_ds18b20_addresses[ii] = otb_ds18b20_addresses[ii+1];
+    otb_ds18b20_addresses[ii].index = ii;
+    otb_ds18b20_last_temp[ii] = otb_ds18b20_last_temp[ii+1];
   }
+  otb_ds18b20_count--;
 
-  if (otb_ds18b20_count > prev_count)
+  // Other buses may be part way through reading their devices
+  for (ii = 0; ii < otb_ds18b20_buses; ii++)
   {
-    MDETAIL("DS18B20 device count changed was %u now %u", prev_count, otb_ds18b20_count);
-    for (ii = 0; ii < otb_ds18b20_count; ii++)
+    if (otb_ds18b20_ow[ii].device > index)
     {
-      // Stagger timer for each temperature sensor - and do any we already had as well
-      MDETAIL("Index %d Address %s", ii, otb_ds18b20_addresses[ii].friendly);
-      timer_int = OTB_DS18B20_REPORT_INTERVAL * (ii + 1) / otb_ds18b20_count;
-      otb_ds18b20_addresses[ii].timer_int = timer_int;
-      os_timer_disarm((os_timer_t*)(otb_ds18b20_timer + ii));
-      os_timer_setfn((os_timer_t*)(otb_ds18b20_timer + ii), (os_timer_func_t *)otb_ds18b20_callback, otb_ds18b20_addresses + ii);
-      if (timer_int != OTB_DS18B20_REPORT_INTERVAL)
-      {
-        os_timer_arm((os_timer_t*)(otb_ds18b20_timer + ii), timer_int, 0);
-      }
-      else
-      {
-        os_timer_arm((os_timer_t*)(otb_ds18b20_timer + ii), timer_int, 1);
-      }
+      otb_ds18b20_ow[ii].device--;
     }
   }
 
+  otb_ds18b20_hash_rebuild();
+
   EXIT;
 
   return;
 }
 
-// Returns TRUE if have already got this device
-bool ICACHE_FLASH_ATTR otb_ds18b20_check_existing_device(char *ds18b20)
+// Called with each ROM found during an alarm search of a bus - marks it to be
+// read, if it's a device with alarm thresholds configured
+void ICACHE_FLASH_ATTR otb_ds18b20_alarm_device(otb_ds18b20_ow_engine *ow)
 {
-  int ii;
-  bool rc = FALSE;
+  int index;
+  otbDs18b20DeviceAddress *addr;
 
   ENTRY;
 
-  for (ii = 0; ii < otb_ds18b20_count; ii++)
+  if (crc8(ow->rom, 7) != ow->rom[7])
+  {
+    MWARN("CRC error in alarm search on bus %d", ow->bus);
+    goto EXIT_LABEL;
+  }
+
+  // Devices without thresholds configured may alarm using whatever TH and TL
+  // they have - ignore those
+  index = otb_ds18b20_find_device(ow->rom);
+  if ((index < 0) ||
+      (otb_ds18b20_device_alarm(otb_ds18b20_addresses + index) == NULL))
+  {
+    goto EXIT_LABEL;
+  }
+
+  addr = otb_ds18b20_addresses + index;
+  MDETAIL("Device %s alarming", addr->friendly);
+  addr->flags |= OTB_DS18B20_DEVICE_READ;
+  otb_ds18b20_publish_event(addr, "alarm");
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return;
+}
+
+// Returns the alarm thresholds configured for this device, or NULL if none
+otb_conf_ds18b20_alarm ICACHE_FLASH_ATTR *otb_ds18b20_device_alarm(otbDs18b20DeviceAddress *addr)
+{
+  otb_conf_ds18b20 *ds18b20;
+  otb_conf_ds18b20_alarm *alarm = NULL;
+
+  ENTRY;
+
+  ds18b20 = otb_ds18b20_device_conf(addr);
+  if (ds18b20 != NULL)
   {
-    // Don't check the CRC byte
-    if (!os_memcmp(otb_ds18b20_addresses[ii].addr,
-                   ds18b20, 
-                   OTB_DS18B20_DEVICE_ADDRESS_LENGTH-1))
+    alarm = otb_conf->ds18b20_alarm + (ds18b20 - otb_conf->ds18b20);
+    if (alarm->enabled != OTB_CONF_DS18B20_ALARM_ENABLED)
     {
-      rc = TRUE;
-      goto EXIT_LABEL;
+      alarm = NULL;
     }
   }
 
-EXIT_LABEL:
+  EXIT;
+
+  return alarm;
+}
+
+// Called whenever the DS18B20 config, or the set of discovered devices,
+// changes - devices' config entries are resolved again when next needed
+void ICACHE_FLASH_ATTR otb_ds18b20_conf_changed(void)
+{
+  ENTRY;
+
+  otb_ds18b20_conf_resolved = FALSE;
 
   EXIT;
 
-  return (rc);
+  return;
 }
 
-// Returns TRUE if more than OTB_DS18B20_MAX_DS18B20S devices
-bool ICACHE_FLASH_ATTR otb_ds18b20_get_devices(void)
+// Finds each device's config entry, so the publish paths don't need to
+// search the config by address string
+void ICACHE_FLASH_ATTR otb_ds18b20_conf_resolve(void)
 {
-  int rc = TRUE;
-  char ds18b20[OTB_DS18B20_DEVICE_ADDRESS_LENGTH];
-  char crc;
-  
-  MDEBUG("Get devices ...");
-  
-  reset_search();
-  while (rc && (otb_ds18b20_count < OTB_DS18B20_MAX_DS18B20S))
+  uint8_t ii;
+  otb_conf_ds18b20 *ds18b20;
+
+  ENTRY;
+
+  for (ii = 0; ii < otb_ds18b20_count; ii++)
   {
-    rc = ds_search(ds18b20);
-    if (rc)
+    ds18b20 = NULL;
+    if (otb_ds18b20_get_sensor_name(otb_ds18b20_addresses[ii].friendly, &ds18b20) != NULL)
     {
-      // Only progress if crc is good
-      crc = crc8(ds18b20, 7);
-      if (crc == ds18b20[7])
-      {
-        // Only actually add this device if we haven't already added it when
-        // previously scanning the bus
-        if (!otb_ds18b20_check_existing_device(ds18b20))
-        {
-          os_memcpy(otb_ds18b20_addresses[otb_ds18b20_count].addr,
-                    ds18b20, 
-                    OTB_DS18B20_DEVICE_ADDRESS_LENGTH);
-          // I want the address format in the same format as debian/raspbian
-          // Which reverses the order of all but the first byte, and drops the CRC8
-          // byte at the end (which we'll check).
-          os_snprintf((char*)otb_ds18b20_addresses[otb_ds18b20_count].friendly,
-                      OTB_DS18B20_MAX_ADDRESS_STRING_LENGTH,
-                      "%02x-%02x%02x%02x%02x%02x%02x",
-                      ds18b20[0],
-                      ds18b20[6],
-                      ds18b20[5],
-                      ds18b20[4],
-                      ds18b20[3],
-                      ds18b20[2],
-                      ds18b20[1]);
-          otb_ds18b20_addresses[otb_ds18b20_count].timer_int = 0;
-          otb_ds18b20_addresses[otb_ds18b20_count].index = otb_ds18b20_count;
-          otb_ds18b20_count++;
-          MDEBUG("Successfully added device %s",
-                otb_ds18b20_addresses[otb_ds18b20_count].friendly);
-        }
-      }
-      else
-      {
-        MWARN("CRC error: %02x-%02x%02x%02x%02x%02x%02x, crc=0x%x",
-             ds18b20[0],
-             ds18b20[6],
-             ds18b20[5],
-             ds18b20[4],
-             ds18b20[3],
-             ds18b20[2],
-             ds18b20[1],
-             crc);
-      }
+      otb_ds18b20_addresses[ii].conf = ds18b20 - otb_conf->ds18b20;
+    }
+    else
+    {
+      otb_ds18b20_addresses[ii].conf = OTB_DS18B20_NO_CONF;
     }
   }
+  otb_ds18b20_conf_resolved = TRUE;
 
-  if (rc)
+  EXIT;
+
+  return;
+}
+
+// Returns the config entry for this device, or NULL if it isn't configured
+otb_conf_ds18b20 ICACHE_FLASH_ATTR *otb_ds18b20_device_conf(otbDs18b20DeviceAddress *addr)
+{
+  otb_conf_ds18b20 *ds18b20 = NULL;
+
+  ENTRY;
+
+  if (!otb_ds18b20_conf_resolved)
   {
-    rc = ds_search(ds18b20);
+    otb_ds18b20_conf_resolve();
   }
-    
-  return(rc);
+  if (addr->conf != OTB_DS18B20_NO_CONF)
+  {
+    ds18b20 = otb_conf->ds18b20 + addr->conf;
+  }
+
+  EXIT;
+
+  return ds18b20;
+}
+
+void ICACHE_FLASH_ATTR otb_ds18b20_publish_event(otbDs18b20DeviceAddress *addr, char *event)
+{
+  ENTRY;
+
+  if (otb_mqtt_client.connState == MQTT_DATA)
+  {
+    otb_mqtt_send_status(OTB_MQTT_SYSTEM_DS18B20, event, addr->friendly, "");
+  }
+
+  EXIT;
+
+  return;
 }
 
 char ALIGN4 otb_ds18b20_callback_error_string[] = "DS18B20: MQTT disconnected timeout";
 void ICACHE_FLASH_ATTR otb_ds18b20_callback(void *arg)
 {
-  int chars;
-  bool rc = FALSE;
-  otbDs18b20DeviceAddress *addr;
-  char *sensor_loc;
-  int tries;
-  char output[32];
-  char output2[32];
-  
   ENTRY;
 
-  addr = (otbDs18b20DeviceAddress *)arg;
-  MDEBUG("   Device: %s", addr->friendly);
-  MDEBUG("timer_int: %d", addr->timer_int);
-  MDEBUG("    index: %d", addr->index);
+  if (otb_ds18b20_count == 0)
+  {
+    // Nothing to sample
+    goto EXIT_LABEL;
+  }
 
-  if (addr->timer_int != OTB_DS18B20_REPORT_INTERVAL)
+  if (otb_mqtt_client.connState == MQTT_DATA)
+  {
+    otb_ds18b20_mqtt_disconnected_counter = 0;
+  }
+  else
   {
-    // This must be the first time we were scheduled - we stagger first schedule.
-    // So now reschedule on the right timer.
-    addr->timer_int = OTB_DS18B20_REPORT_INTERVAL;
-    os_timer_disarm((os_timer_t*)(otb_ds18b20_timer + addr->index));
-    os_timer_setfn((os_timer_t*)(otb_ds18b20_timer + addr->index), (os_timer_func_t *)otb_ds18b20_callback, arg);
-    // Set repeat to 1!
-    os_timer_arm((os_timer_t*)(otb_ds18b20_timer + addr->index), OTB_DS18B20_REPORT_INTERVAL, 1);
-    // Note this won't match the last of N DS18B20s - that will have this interval
-    // already set, and when set that was tested and set to repeat.
+    MWARN("MQTT not connected, so won't send");
+    otb_ds18b20_mqtt_disconnected_counter += 1;
   }
 
-  // Read this sensor - try up to 4 times (in case of invalid CRC/data)
-  for (tries = 0; (tries < 4) && !rc; tries++)
+  if ((otb_ds18b20_mqtt_disconnected_counter * OTB_DS18B20_REPORT_INTERVAL) >=
+                                                    OTB_MQTT_DISCONNECTED_REBOOT_INTERVAL)
   {
-    otb_ds18b20_prepare_to_read();
-    rc = otb_ds18b20_request_temp(addr->addr,
-                                  otb_ds18b20_last_temp_s[addr->index]);
+    MERROR("MQTT disconnected %d ms so resetting", 
+    otb_ds18b20_mqtt_disconnected_counter * OTB_DS18B20_REPORT_INTERVAL);
+    otb_reset(otb_ds18b20_callback_error_string);
   }
-  if (!rc)
+
+  // Kick off a conversion on all devices on each bus, followed by reading
+  // each in turn
+  otb_ds18b20_ow_request(OTB_DS18B20_OW_PENDING_SAMPLE);
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return;
+}
+
+// Runs more frequently than otb_ds18b20_callback - kicks off a conversion on
+// each bus with alarm thresholds configured on any of its devices, followed by
+// an alarm search, and only reads those devices which are found
+void ICACHE_FLASH_ATTR otb_ds18b20_alarm_callback(void *arg)
+{
+  ENTRY;
+
+  if ((otb_ds18b20_count > 0) && (otb_mqtt_client.connState == MQTT_DATA))
   {
-    os_strcpy(otb_ds18b20_last_temp_s[addr->index], OTB_DS18B20_INTERNAL_ERROR_TEMP);
+    otb_ds18b20_ow_request(OTB_DS18B20_OW_PENDING_ALARM);
   }
-    
-  MDETAIL("Device: %s temp: %s", addr->friendly, otb_ds18b20_last_temp_s[addr->index]);
+
+  EXIT;
+
+  return;
+}
+
+// Called by the 1-Wire engine once it has finished reading a device - with
+// the last temp already updated
+void ICACHE_FLASH_ATTR otb_ds18b20_publish_temp(otbDs18b20DeviceAddress *addr, int tries)
+{
+  char *sensor_loc;
+  char output[32];
+  char output2[32];
+  char temp_s[OTB_DS18B20_MAX_TEMP_LEN];
+  otb_conf_ds18b20 *ds18b20;
+  
+  ENTRY;
+
+  otb_ds18b20_temp_to_str(otb_ds18b20_last_temp + addr->index, temp_s);
+  MDETAIL("Device: %s temp: %s", addr->friendly, temp_s);
 
   if (otb_mqtt_client.connState == MQTT_DATA)
   {
     MDEBUG("Log sensor data");
 
-    // Could send (but may choose not to), so reset disconnectedCounter
-    otb_ds18b20_mqtt_disconnected_counter = 0;
-
     // Put friendly name for sensor in as well, if exists.
-    sensor_loc = otb_ds18b20_get_sensor_name(addr->friendly, NULL);
-    if (sensor_loc != NULL)
+    ds18b20 = otb_ds18b20_device_conf(addr);
+    sensor_loc = (ds18b20 != NULL) ? ds18b20->loc : NULL;
+    if ((sensor_loc != NULL) && (sensor_loc[0] != 0))
     {
       MDEBUG("Sensor location: %s", sensor_loc);
       os_snprintf(otb_mqtt_scratch,
@@ -308,7 +589,7 @@ void ICACHE_FLASH_ATTR otb_ds18b20_callback(void *arg)
     if (tries > 1)
     {
       // Record the fact that we had to retry
-      os_snprintf(output, 31, "retries:%d/final:%s", tries-1, otb_ds18b20_last_temp_s[addr->index]);
+      os_snprintf(output, 31, "retries:%d/final:%s", tries-1, temp_s);
       os_snprintf(output2, 31, "%s/%s", OTB_MQTT_STATUS_ERROR, OTB_MQTT_TEMPERATURE);
       otb_mqtt_publish(&otb_mqtt_client,
                        output2,
@@ -321,9 +602,7 @@ void ICACHE_FLASH_ATTR otb_ds18b20_callback(void *arg)
                        0);
     }
 
-    if (strcmp(otb_ds18b20_last_temp_s[addr->index], "-127.00") &&
-        strcmp(otb_ds18b20_last_temp_s[addr->index], OTB_DS18B20_INTERNAL_ERROR_TEMP) &&
-        strcmp(otb_ds18b20_last_temp_s[addr->index], "85.00"))
+    if (otb_ds18b20_last_temp[addr->index].state == OTB_DS18B20_TEMP_VALID)
     {
       // Decided on reporting using a single format to reduce require MQTT buffer
       // size.
@@ -332,7 +611,7 @@ void ICACHE_FLASH_ATTR otb_ds18b20_callback(void *arg)
       otb_mqtt_publish(&otb_mqtt_client,
                        OTB_MQTT_TEMPERATURE,
                        sensor_loc,
-                       otb_ds18b20_last_temp_s[addr->index],
+                       temp_s,
                        "",
                        0,
                        1,
@@ -340,19 +619,6 @@ void ICACHE_FLASH_ATTR otb_ds18b20_callback(void *arg)
                        0);
     }
   }
-  else
-  {
-    MWARN("MQTT not connected, so not sending");
-    otb_ds18b20_mqtt_disconnected_counter += 1;
-  }
-
-  if ((otb_ds18b20_mqtt_disconnected_counter * OTB_DS18B20_REPORT_INTERVAL) >=
-                                                    OTB_MQTT_DISCONNECTED_REBOOT_INTERVAL)
-  {
-    MERROR("MQTT disconnected %d ms so resetting", 
-    otb_ds18b20_mqtt_disconnected_counter * OTB_DS18B20_REPORT_INTERVAL);
-    otb_reset(otb_ds18b20_callback_error_string);
-  }
 
   EXIT;
 
@@ -532,30 +798,22 @@ EXIT_LABEL:
 
 }
 
-bool ICACHE_FLASH_ATTR otb_ds18b20_conf_set(unsigned char *next_cmd, void *arg, unsigned char *prev_cmd)
+// Finds the config slot for a sensor, allocating one if the sensor isn't
+// already configured.  Returns NULL if there are no free slots.
+otb_conf_ds18b20 ICACHE_FLASH_ATTR *otb_ds18b20_conf_get_slot(unsigned char *addr)
 {
-  bool rc = FALSE;
-  unsigned char *addr;
   char *match;
   otb_conf_ds18b20 *ds18b20;
-  char *response = OTB_MQTT_EMPTY;
   int ii, jj;
-  struct otbDs18b20DeviceAddress *ds;
   bool ds_match;
   
   ENTRY;
   
-  // Have already checked the address is valid
-  addr = prev_cmd;
-  
-  // First of all see if there's already a sensor of this address.  If so replace
-  // with the provided name.
+  // First of all see if there's already a sensor of this address.
   match = otb_ds18b20_get_sensor_name(addr, &ds18b20);
   if (match != NULL)
   {
-    MDEBUG("Found sensor, updating");
-    os_strncpy(ds18b20->loc, next_cmd, OTB_CONF_DS18B20_LOCATION_MAX_LEN);
-    rc = TRUE;
+    MDEBUG("Found sensor");
     goto EXIT_LABEL;
   }
   
@@ -564,19 +822,18 @@ bool ICACHE_FLASH_ATTR otb_ds18b20_conf_set(unsigned char *next_cmd, void *arg,
   {
     if (ds18b20->id[0] == 0)
     {
-      MDETAIL("Update empty slot %d %s %s", ii, addr, next_cmd);
+      MDETAIL("Use empty slot %d %s", ii, addr);
       // Have found an empty slot - fill it
+      os_memset(ds18b20, 0, sizeof(*ds18b20));
+      os_memset(otb_conf->ds18b20_alarm + ii, 0, sizeof(otb_conf_ds18b20_alarm));
       os_strncpy(ds18b20->id, addr, OTB_CONF_DS18B20_MAX_ID_LEN);
       ds18b20->id[OTB_CONF_DS18B20_MAX_ID_LEN-1] = 0;
-      os_strncpy(ds18b20->loc, next_cmd, OTB_CONF_DS18B20_LOCATION_MAX_LEN);
       if (otb_conf->ds18b20s != ii)
       {
         MDETAIL("Conf DS18B20s not correct %d", otb_conf->ds18b20s);
       }
       otb_conf->ds18b20s = (ii + 1);
-      rc = TRUE;
       goto EXIT_LABEL;
-      break;
     }
   }
   
@@ -584,350 +841,1098 @@ bool ICACHE_FLASH_ATTR otb_ds18b20_conf_set(unsigned char *next_cmd, void *arg,
   // sensor not currently present then replace that.  Otherwise reject (this only happens
   // if the maximum number of sensors is present and the user tries to configure a
   // different).
-  if (ii == OTB_DS18B20_MAX_DS18B20S)
+  for (ii = 0, ds18b20 = otb_conf->ds18b20;
+       ii < OTB_DS18B20_MAX_DS18B20S;
+       ds18b20++, ii++)
+  {
+    ds_match = FALSE;
+    for (jj = 0; jj < otb_ds18b20_count; jj++)
+    {
+      if (otb_ds18b20_device_conf(otb_ds18b20_addresses + jj) == ds18b20)
+      {
+        ds_match = TRUE;
+        break;
+      }
+    }
+    if (!ds_match)
+    {
+      // Can use this slot
+      MDETAIL("Found slot not being used");
+      os_memset(ds18b20, 0, sizeof(*ds18b20));
+      os_memset(otb_conf->ds18b20_alarm + ii, 0, sizeof(otb_conf_ds18b20_alarm));
+      os_strncpy(ds18b20->id, addr, OTB_CONF_DS18B20_MAX_ID_LEN);
+      ds18b20->id[OTB_CONF_DS18B20_MAX_ID_LEN-1] = 0;
+      goto EXIT_LABEL;
+    }
+  }
+
+  ds18b20 = NULL;
+  
+EXIT_LABEL:
+
+  EXIT;
+  
+  return ds18b20;
+}
+
+// Handles set/config/ds18b20/<addr>/<name>, set/config/ds18b20/<addr>/res/<bits>
+// and set/config/ds18b20/<addr>/alarm/<low>/<high>|off
+bool ICACHE_FLASH_ATTR otb_ds18b20_conf_set(unsigned char *next_cmd, void *arg, unsigned char *prev_cmd)
+{
+  bool rc = FALSE;
+  unsigned char *addr;
+  unsigned char *value;
+  unsigned char *value2;
+  otb_conf_ds18b20 *ds18b20;
+  otb_conf_ds18b20_alarm *alarm;
+  int res = OTB_CONF_DS18B20_RES_DEFAULT;
+  bool set_res = FALSE;
+  bool set_alarm = FALSE;
+  int low = 0;
+  int high = 0;
+  uint8 enabled = OTB_CONF_DS18B20_ALARM_DISABLED;
+  
+  ENTRY;
+  
+  // Have already checked the address is valid
+  addr = prev_cmd;
+
+  if (!os_strcmp(next_cmd, "res"))
+  {
+    set_res = TRUE;
+    value = otb_cmd_get_next_cmd(next_cmd);
+    if (value == NULL)
+    {
+      otb_cmd_rsp_append("no resolution provided");
+      goto EXIT_LABEL;
+    }
+    res = atoi(value);
+    if ((res != OTB_CONF_DS18B20_RES_DEFAULT) &&
+        ((res < OTB_CONF_DS18B20_RES_MIN) || (res > OTB_CONF_DS18B20_RES_MAX)))
+    {
+      otb_cmd_rsp_append("invalid resolution (9-12, 0 for default)");
+      goto EXIT_LABEL;
+    }
+  }
+  else if (!os_strcmp(next_cmd, "alarm"))
+  {
+    set_alarm = TRUE;
+    value = otb_cmd_get_next_cmd(next_cmd);
+    value2 = (value != NULL) ? otb_cmd_get_next_cmd(value) : NULL;
+    if ((value != NULL) && !os_strcmp(value, "off"))
+    {
+      // Disabled
+    }
+    else if ((value != NULL) && (value2 != NULL))
+    {
+      low = atoi(value);
+      high = atoi(value2);
+      if ((low < OTB_CONF_DS18B20_ALARM_MIN) ||
+          (high > OTB_CONF_DS18B20_ALARM_MAX) ||
+          (low >= high))
+      {
+        otb_cmd_rsp_append("invalid alarm thresholds (-55 to 125, low below high)");
+        goto EXIT_LABEL;
+      }
+      enabled = OTB_CONF_DS18B20_ALARM_ENABLED;
+    }
+    else
+    {
+      otb_cmd_rsp_append("no alarm thresholds provided");
+      goto EXIT_LABEL;
+    }
+  }
+  
+  ds18b20 = otb_ds18b20_conf_get_slot(addr);
+  if (ds18b20 == NULL)
+  {
+    otb_cmd_rsp_append("no free slots");
+    goto EXIT_LABEL;
+  }
+
+  if (set_alarm)
+  {
+    // Will be written to the sensor next time it's read
+    MDETAIL("Set sensor %s alarm %d to %d enabled %d", addr, low, high, enabled);
+    alarm = otb_conf->ds18b20_alarm + (ds18b20 - otb_conf->ds18b20);
+    alarm->low = low;
+    alarm->high = high;
+    alarm->enabled = enabled;
+  }
+  else if (set_res)
+  {
+    // Will be written to the sensor next time it's read.  Older configs may
+    // have a 31 char location terminated by res, so truncate it first.
+    MDETAIL("Set sensor %s resolution %d", addr, res);
+    ds18b20->loc[OTB_CONF_DS18B20_LOCATION_MAX_LEN-1] = 0;
+    ds18b20->res = res;
+  }
+  else
+  {
+    MDETAIL("Set sensor %s location %s", addr, next_cmd);
+    os_strncpy(ds18b20->loc, next_cmd, OTB_CONF_DS18B20_LOCATION_MAX_LEN);
+    ds18b20->loc[OTB_CONF_DS18B20_LOCATION_MAX_LEN-1] = 0;
+  }
+  rc = TRUE;
+  
+EXIT_LABEL:
+  
+  // If successful store off new config
+  if (rc)
+  {
+    otb_ds18b20_conf_changed();
+    rc = otb_conf_update(otb_conf);
+    if (!rc)
+    {
+      otb_cmd_rsp_append("failed to store new config");
+    }
+  }
+
+  EXIT;
+  
+  return rc;
+  
+}
+
+bool ICACHE_FLASH_ATTR otb_ds18b20_conf_delete(unsigned char *next_cmd, void *arg, unsigned char *prev_cmd)
+{
+  bool rc = FALSE;
+  int cmd;
+  char *match;
+  char *addr;
+  otb_conf_ds18b20 *ds18b20;
+  
+  ENTRY;
+  
+  cmd = (int)arg;
+
+  if (cmd == OTB_CMD_DS18B20_ALL)
+  {
+    os_memset(otb_conf->ds18b20,
+              0,
+              sizeof(otb_conf_ds18b20) * OTB_DS18B20_MAX_DS18B20S);
+    os_memset(otb_conf->ds18b20_alarm, 0, sizeof(otb_conf->ds18b20_alarm));
+    otb_conf->ds18b20s = 0;
+    rc = TRUE;
+    goto EXIT_LABEL;
+  }
+  else if (cmd == OTB_CMD_DS18B20_ADDR)
+  {
+    // We've tested the address is configured already, so a bit of asserting
+    addr = prev_cmd;
+    match = otb_ds18b20_get_sensor_name(addr, &ds18b20);
+    OTB_ASSERT(match != NULL);
+    os_memset(otb_conf->ds18b20_alarm + (ds18b20 - otb_conf->ds18b20),
+              0,
+              sizeof(otb_conf_ds18b20_alarm));
+    os_memset(ds18b20, 0, sizeof(otb_conf_ds18b20));
+    otb_conf->ds18b20s--;
+    rc = TRUE;
+  }
+  else
   {
-    for (ii = 0, ds18b20 = otb_conf->ds18b20;
-         ii < OTB_DS18B20_MAX_DS18B20S;
-         ds18b20++, ii++)
+    OTB_ASSERT(FALSE);
+  }  
+  
+EXIT_LABEL:
+
+  // If successful store off new config
+  if (rc)
+  {
+    otb_ds18b20_conf_changed();
+    rc = otb_conf_update(otb_conf);
+    if (!rc)
+    {
+      otb_cmd_rsp_append("failed to store new config");
+    }
+  }
+  
+  EXIT;
+  
+  return rc;
+}
+
+void ICACHE_FLASH_ATTR otb_ds18b20_conf_get(char *sensor, char *index)
+{
+  char *match = NULL;
+  int slot_num;
+  char *response = NULL;
+
+  ENTRY;
+  
+  // Check "sensor" isn't really an index
+  if (sensor == NULL)
+  {
+    match = NULL;
+    response = "argument not provided";
+    goto EXIT_LABEL;
+  }
+  
+  if (!os_strncmp(sensor, OTB_MQTT_CMD_GET_INDEX, os_strlen(OTB_MQTT_CMD_GET_INDEX)))
+  {
+    if (index == NULL)
+    {
+      match = NULL;
+      response = "no index provided";
+      goto EXIT_LABEL;
+    }
+    // Get slot number
+    slot_num = atoi(index);
+    MDEBUG("index %d", slot_num);
+    if ((slot_num >= 0) && (slot_num < otb_conf->ds18b20s))
+    {
+      match = otb_conf->ds18b20[slot_num].id;
+    } 
+    else
+    {
+      match = NULL;
+      response = "invalid index";
+    }
+    goto EXIT_LABEL; 
+  }
+  
+  // Not a slot, so sensor may be addr or friendly name - so return the other
+  match = otb_ds18b20_get_sensor_name(sensor, NULL);
+  if (match == NULL)
+  {
+    match = otb_ds18b20_get_addr(sensor, NULL);
+    goto EXIT_LABEL; 
+  }
+
+EXIT_LABEL:
+  
+  if (match != NULL)
+  {
+    otb_mqtt_send_status(OTB_MQTT_SYSTEM_CONFIG,
+                         OTB_MQTT_CMD_GET,
+                         OTB_MQTT_STATUS_OK,
+                         match);
+  }
+  else
+  {
+    if (response == NULL)
     {
-      for (jj = 0, ds = otb_ds18b20_addresses; ii < otb_ds18b20_count; jj++, ds++)
+      response = "sensor not found";
+    }
+    otb_mqtt_send_status(OTB_MQTT_SYSTEM_CONFIG,
+                         OTB_MQTT_CMD_GET,
+                         OTB_MQTT_STATUS_ERROR,
+                         response);
+  }
+  
+  EXIT;
+  
+  return;
+}
+
+bool ICACHE_FLASH_ATTR otb_ds18b20_trigger_device_refresh(unsigned char *next_cmd, void *arg, unsigned char *prev_cmd)
+{
+  bool rc = TRUE;
+  unsigned char scratch[4];
+
+  ENTRY;
+
+  // The search runs asynchronously, so this returns the number of devices
+  // known before the search completes
+  otb_ds18b20_device_callback(NULL);
+  os_snprintf(scratch, 4, "%d", otb_ds18b20_count);
+  scratch[3] = 0;
+  otb_cmd_rsp_append(scratch);
+
+  EXIT;
+
+  return rc;
+};
+
+bool ICACHE_FLASH_ATTR otb_ds18b20_decode_temp(char *addr, uint8_t *data, otb_ds18b20_temp *temp)
+{
+  bool rc = FALSE;
+  uint16_t tdata, sign;
+  int16_t centi;
+  uint16_t sign_bits;
+  uint8_t crc;
+  
+  ENTRY;
+
+  // Scratchpad is 9 bytes long, but 0 and 1 bytes contain LSB and MSB
+  // of current temp
+  crc = crc8(data, 8);
+  if (crc != data[8])
+  {
+    MWARN("DS18B20 response %02x%02x%02x%02x%02x%02x%02x%02x%02x - invalid CRC: 0x%02x", data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7], data[8], crc);
+    goto EXIT_LABEL;
+  }
+  else
+  {
+    MDETAIL("DS18B20 response %02x%02x%02x%02x%02x%02x%02x%02x%02x", data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7], data[8]);
+  }
+
+  tdata = (data[1] << 8) | data[0]; 
+
+  // Below 12 bits resolution the bottom bits are undefined
+  if (addr[0] == DS18B20)
+  {
+    tdata &= ~((1 << (12 - OTB_DS18B20_CONFIG_TO_RES(data[OTB_DS18B20_SCRATCHPAD_CONFIG]))) - 1);
+  }
+
+  // Top X bits are either all 0s or all ones
+  if (addr[0] != DS18S20)
+  {
+    sign_bits = 0xf800;
+  }
+  else
+  {
+    sign_bits = 0xff00;
+  }
+
+  sign = tdata & sign_bits;
+  if (sign && (sign != sign_bits))
+  {
+    // All bits must be set if any are
+    MWARN("Invalid data received 0x%04x", tdata);
+    goto EXIT_LABEL;
+  }
+
+  // Work with the magnitude, so fractions are truncated towards zero
+  if (sign)
+  {
+    tdata = -tdata;
+  }
+
+  if (addr[0] != DS18S20)
+  {
+    // DS18B20 - 1/16ths of a degree
+    centi = (tdata >> 4) * 100 + (tdata & 0x0F) * 100 / 16;
+  }
+  else
+  {
+    // DS18S20 - 1/2s of a degree
+    centi = (tdata >> 1) * 100 + ((tdata & 1) ? 50 : 0);
+  }
+  if (sign)
+  {
+    centi = -centi;
+  }
+
+  if ((centi < OTB_DS18B20_CENTI_MIN) || (centi > OTB_DS18B20_CENTI_MAX))
+  {
+    // Invalid value
+    MWARN("Invalid value decoded: %d from 0x%04x", centi, (data[1]<<8 | data[0]));
+    goto EXIT_LABEL;
+  }
+  
+  temp->centi = centi;
+  if (centi == OTB_DS18B20_CENTI_POWER_ON)
+  {
+    temp->state = OTB_DS18B20_TEMP_POWER_ON;
+  }
+  else
+  {
+    temp->state = OTB_DS18B20_TEMP_VALID;
+  }
+
+  rc = TRUE;
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return(rc);
+}
+
+// Formats a reading for publishing or command responses.  temp_s must be at
+// least OTB_DS18B20_MAX_TEMP_LEN long.
+void ICACHE_FLASH_ATTR otb_ds18b20_temp_to_str(otb_ds18b20_temp *temp, char *temp_s)
+{
+  int16_t centi;
+  char *sign = "";
+
+  ENTRY;
+
+  if ((temp->state != OTB_DS18B20_TEMP_VALID) &&
+      (temp->state != OTB_DS18B20_TEMP_POWER_ON))
+  {
+    os_strcpy(temp_s, OTB_DS18B20_INTERNAL_ERROR_TEMP);
+    goto EXIT_LABEL;
+  }
+
+  centi = temp->centi;
+  if (centi < 0)
+  {
+    sign = "-";
+    centi = -centi;
+  }
+  os_snprintf(temp_s,
+              OTB_DS18B20_MAX_TEMP_LEN,
+              "%s%d.%02d",
+              sign,
+              centi / 100,
+              centi % 100);
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return;
+}
+
+// Queue work for every bus
+void ICACHE_FLASH_ATTR otb_ds18b20_ow_request(uint8_t work)
+{
+  int ii;
+
+  ENTRY;
+
+  for (ii = 0; ii < otb_ds18b20_buses; ii++)
+  {
+    otb_ds18b20_ow_queue(otb_ds18b20_ow + ii, work);
+  }
+
+  EXIT;
+
+  return;
+}
+
+// Queue work for a bus's 1-Wire engine, and start it if it's idle
+void ICACHE_FLASH_ATTR otb_ds18b20_ow_queue(otb_ds18b20_ow_engine *ow, uint8_t work)
+{
+  ENTRY;
+
+  ow->pending |= work;
+  if (ow->state == OTB_DS18B20_OW_STATE_IDLE)
+  {
+    otb_ds18b20_ow_next_job(ow);
+  }
+  else
+  {
+    MDEBUG("1-Wire bus %d busy (state %d) - queued 0x%02x", ow->bus, ow->state, work);
+  }
+
+  EXIT;
+
+  return;
+}
+
+// Returns the index of the first device on this bus at or after from, or
+// otb_ds18b20_count if there isn't one
+uint8_t ICACHE_FLASH_ATTR otb_ds18b20_ow_next_device(otb_ds18b20_ow_engine *ow, uint8_t from)
+{
+  uint8_t ii;
+
+  ENTRY;
+
+  for (ii = from; ii < otb_ds18b20_count; ii++)
+  {
+    if (otb_ds18b20_addresses[ii].bus == ow->bus)
+    {
+      break;
+    }
+  }
+
+  EXIT;
+
+  return ii;
+}
+
+uint8_t ICACHE_FLASH_ATTR otb_ds18b20_ow_bus_count(otb_ds18b20_ow_engine *ow)
+{
+  uint8_t ii;
+  uint8_t count = 0;
+
+  ENTRY;
+
+  for (ii = 0; ii < otb_ds18b20_count; ii++)
+  {
+    if (otb_ds18b20_addresses[ii].bus == ow->bus)
+    {
+      count++;
+    }
+  }
+
+  EXIT;
+
+  return count;
+}
+
+// As otb_ds18b20_ow_next_device, but only returns devices marked to be read
+uint8_t ICACHE_FLASH_ATTR otb_ds18b20_ow_next_read(otb_ds18b20_ow_engine *ow, uint8_t from)
+{
+  uint8_t ii;
+
+  ENTRY;
+
+  for (ii = otb_ds18b20_ow_next_device(ow, from);
+       ii < otb_ds18b20_count;
+       ii = otb_ds18b20_ow_next_device(ow, ii + 1))
+  {
+    if (otb_ds18b20_addresses[ii].flags & OTB_DS18B20_DEVICE_READ)
+    {
+      break;
+    }
+  }
+
+  EXIT;
+
+  return ii;
+}
+
+// Returns TRUE if any device on this bus has alarm thresholds configured
+bool ICACHE_FLASH_ATTR otb_ds18b20_ow_alarms(otb_ds18b20_ow_engine *ow)
+{
+  bool rc = FALSE;
+  uint8_t ii;
+
+  ENTRY;
+
+  for (ii = otb_ds18b20_ow_next_device(ow, 0);
+       ii < otb_ds18b20_count;
+       ii = otb_ds18b20_ow_next_device(ow, ii + 1))
+  {
+    if (otb_ds18b20_device_alarm(otb_ds18b20_addresses + ii) != NULL)
+    {
+      rc = TRUE;
+      break;
+    }
+  }
+
+  EXIT;
+
+  return rc;
+}
+
+// Start the next piece of queued work, or go idle if there isn't any
+void ICACHE_FLASH_ATTR otb_ds18b20_ow_next_job(otb_ds18b20_ow_engine *ow)
+{
+  uint8_t ii;
+
+  ENTRY;
+
+  if (ow->pending & OTB_DS18B20_OW_PENDING_SEARCH)
+  {
+    ow->pending &= ~OTB_DS18B20_OW_PENDING_SEARCH;
+    ow->job = OTB_DS18B20_OW_JOB_SEARCH;
+    otb_ds18b20_ow_start_search(ow);
+  }
+  else if ((ow->pending & OTB_DS18B20_OW_PENDING_SAMPLE) &&
+           (otb_ds18b20_ow_next_device(ow, 0) < otb_ds18b20_count))
+  {
+    // Reads every device, so there's no need for a separate alarm check
+    ow->pending &= ~(OTB_DS18B20_OW_PENDING_SAMPLE | OTB_DS18B20_OW_PENDING_ALARM);
+    ow->job = OTB_DS18B20_OW_JOB_SAMPLE;
+    for (ii = otb_ds18b20_ow_next_device(ow, 0);
+         ii < otb_ds18b20_count;
+         ii = otb_ds18b20_ow_next_device(ow, ii + 1))
+    {
+      otb_ds18b20_addresses[ii].flags |= OTB_DS18B20_DEVICE_READ;
+    }
+    ow->state = OTB_DS18B20_OW_STATE_CONV_RESET;
+    otb_ds18b20_ow_schedule(ow, OTB_DS18B20_OW_STEP_US);
+  }
+  else if ((ow->pending & OTB_DS18B20_OW_PENDING_ALARM) &&
+           otb_ds18b20_ow_alarms(ow))
+  {
+    ow->pending &= ~OTB_DS18B20_OW_PENDING_ALARM;
+    ow->job = OTB_DS18B20_OW_JOB_ALARM;
+    ow->state = OTB_DS18B20_OW_STATE_CONV_RESET;
+    otb_ds18b20_ow_schedule(ow, OTB_DS18B20_OW_STEP_US);
+  }
+  else
+  {
+    ow->pending = 0;
+    ow->job = OTB_DS18B20_OW_JOB_NONE;
+    ow->state = OTB_DS18B20_OW_STATE_IDLE;
+  }
+
+  EXIT;
+
+  return;
+}
+
+// Start searching the bus - either for all devices, or for alarming devices
+// once they've converted, depending on the job
+void ICACHE_FLASH_ATTR otb_ds18b20_ow_start_search(otb_ds18b20_ow_engine *ow)
+{
+  uint8_t ii;
+
+  ENTRY;
+
+  reset_search(ow);
+  ow->added = 0;
+  ow->search_failed = FALSE;
+  if (ow->job == OTB_DS18B20_OW_JOB_SEARCH)
+  {
+    for (ii = otb_ds18b20_ow_next_device(ow, 0);
+         ii < otb_ds18b20_count;
+         ii = otb_ds18b20_ow_next_device(ow, ii + 1))
+    {
+      otb_ds18b20_addresses[ii].flags &= ~OTB_DS18B20_DEVICE_SEEN;
+    }
+  }
+  ow->state = OTB_DS18B20_OW_STATE_SEARCH_RESET;
+  otb_ds18b20_ow_schedule(ow, OTB_DS18B20_OW_STEP_US);
+
+  EXIT;
+
+  return;
+}
+
+void ICACHE_FLASH_ATTR otb_ds18b20_ow_schedule(otb_ds18b20_ow_engine *ow, uint32_t us)
+{
+  ENTRY;
+
+  os_timer_disarm((os_timer_t*)&ow->timer);
+  os_timer_arm_us((os_timer_t*)&ow->timer, us, 0);
+
+  EXIT;
+
+  return;
+}
+
+// Perform a single step of the current job, and schedule the next one
+void ICACHE_FLASH_ATTR otb_ds18b20_ow_step(void *arg)
+{
+  otb_ds18b20_ow_engine *ow;
+  otbDs18b20DeviceAddress *addr;
+  uint32_t next_us = OTB_DS18B20_OW_STEP_US;
+
+  ENTRY;
+
+  ow = (otb_ds18b20_ow_engine *)arg;
+  addr = otb_ds18b20_addresses + ow->device;
+
+  switch (ow->state)
+  {
+    case OTB_DS18B20_OW_STATE_CONV_RESET:
+      reset(ow->gpio);
+      ow->state = OTB_DS18B20_OW_STATE_CONV_SKIP_ROM;
+      next_us = OTB_DS18B20_OW_RESET_RECOVERY_US;
+      break;
+
+    case OTB_DS18B20_OW_STATE_CONV_SKIP_ROM:
+      write(ow->gpio, DS1820_SKIP_ROM, 1);
+      ow->state = OTB_DS18B20_OW_STATE_CONV_CMD;
+      break;
+
+    case OTB_DS18B20_OW_STATE_CONV_CMD:
+      // Leave the bus powered during the conversion, for parasitic devices
+      write(ow->gpio, DS1820_CONVERT_T, 1);
+      ow->state = OTB_DS18B20_OW_STATE_CONV_WAIT;
+      os_timer_disarm((os_timer_t*)&ow->timer);
+      os_timer_arm((os_timer_t*)&ow->timer, otb_ds18b20_ow_conv_time(ow), 0);
+      next_us = 0;
+      break;
+
+    case OTB_DS18B20_OW_STATE_CONV_WAIT:
+      if (ow->job == OTB_DS18B20_OW_JOB_ALARM)
+      {
+        // Find out which devices need reading
+        otb_ds18b20_ow_start_search(ow);
+      }
+      else
+      {
+        otb_ds18b20_ow_read_from(ow, 0);
+      }
+      next_us = 0;
+      break;
+
+    case OTB_DS18B20_OW_STATE_SELECT_RESET:
+      reset(ow->gpio);
+      ow->state = OTB_DS18B20_OW_STATE_SELECT_MATCH;
+      next_us = OTB_DS18B20_OW_RESET_RECOVERY_US;
+      break;
+
+    case OTB_DS18B20_OW_STATE_SELECT_MATCH:
+      write(ow->gpio, DS1820_MATCHROM, 0);
+      ow->byte = 0;
+      ow->state = OTB_DS18B20_OW_STATE_SELECT_ROM;
+      break;
+
+    case OTB_DS18B20_OW_STATE_SELECT_ROM:
+      write(ow->gpio, addr->addr[ow->byte], 0);
+      ow->byte++;
+      if (ow->byte >= OTB_DS18B20_DEVICE_ADDRESS_LENGTH)
+      {
+        ow->state = ow->writing ? OTB_DS18B20_OW_STATE_WRITE_CMD : OTB_DS18B20_OW_STATE_READ_CMD;
+      }
+      break;
+
+    case OTB_DS18B20_OW_STATE_WRITE_CMD:
+      write(ow->gpio, DS1820_WRITE_SCRATCHPAD, 0);
+      ow->byte = 0;
+      ow->state = OTB_DS18B20_OW_STATE_WRITE_DATA;
+      break;
+
+    case OTB_DS18B20_OW_STATE_WRITE_DATA:
+      write(ow->gpio, ow->data[OTB_DS18B20_SCRATCHPAD_TH + ow->byte], 0);
+      ow->byte++;
+      if (ow->byte >= ((addr->addr[0] == DS18B20) ?
+                                   OTB_DS18B20_SCRATCHPAD_WRITE_LEN :
+                                   OTB_DS18S20_SCRATCHPAD_WRITE_LEN))
+      {
+        // Not copied to the device's EEPROM, to save wearing it out - it'll
+        // be rewritten if the device is power cycled
+        if (addr->addr[0] == DS18B20)
+        {
+          addr->res = OTB_DS18B20_CONFIG_TO_RES(ow->data[OTB_DS18B20_SCRATCHPAD_CONFIG]);
+        }
+        MDETAIL("Device %s configured, resolution %d bits", addr->friendly, addr->res);
+        otb_ds18b20_ow_read_from(ow, ow->device + 1);
+        next_us = 0;
+      }
+      break;
+
+    case OTB_DS18B20_OW_STATE_READ_CMD:
+      write(ow->gpio, DS1820_READ_SCRATCHPAD, 0);
+      ow->byte = 0;
+      ow->state = OTB_DS18B20_OW_STATE_READ_DATA;
+      break;
+
+    case OTB_DS18B20_OW_STATE_READ_DATA:
+      ow->data[ow->byte] = read(ow->gpio);
+      ow->byte++;
+      if (ow->byte >= OTB_DS18B20_SCRATCHPAD_LEN)
+      {
+        otb_ds18b20_ow_read_done(ow);
+        next_us = 0;
+      }
+      break;
+
+    case OTB_DS18B20_OW_STATE_SEARCH_RESET:
+      if (ow->last_device_flag || !reset(ow->gpio))
+      {
+        // Either found the last device last time round, or nothing on the bus
+        otb_ds18b20_ow_search_done(ow);
+        next_us = 0;
+        break;
+      }
+      ow->state = OTB_DS18B20_OW_STATE_SEARCH_CMD;
+      next_us = OTB_DS18B20_OW_RESET_RECOVERY_US;
+      break;
+
+    case OTB_DS18B20_OW_STATE_SEARCH_CMD:
+      write(ow->gpio,
+            (ow->job == OTB_DS18B20_OW_JOB_ALARM) ? DS1820_ALARMSEARCH : DS1820_SEARCHROM,
+            0);
+      ow->id_bit_number = 1;
+      ow->last_zero = 0;
+      ow->byte = 0;
+      ow->state = OTB_DS18B20_OW_STATE_SEARCH_ROM;
+      break;
+
+    case OTB_DS18B20_OW_STATE_SEARCH_ROM:
+      if (!search_rom_byte(ow))
+      {
+        // No devices responded
+        reset_search(ow);
+        ow->search_failed = TRUE;
+        otb_ds18b20_ow_search_done(ow);
+        next_us = 0;
+        break;
+      }
+      ow->byte++;
+      if (ow->byte < OTB_DS18B20_DEVICE_ADDRESS_LENGTH)
+      {
+        break;
+      }
+
+      // Have a complete ROM
+      ow->last_discrepancy = ow->last_zero;
+      if (ow->last_discrepancy == 0)
       {
-        ds_match = FALSE;
-        if (!os_strncmp(ds->friendly, ds18b20->id, OTB_DS18B20_MAX_ADDRESS_STRING_LENGTH))
-        {
-          ds_match = TRUE;
-          break;
-        }
+        ow->last_device_flag = TRUE;
       }
-      if (!ds_match)
+      if (!ow->rom[0])
       {
-        // Can use this slot
-        MDETAIL("Found slot not being used");
-        os_strncpy(ds18b20->id, addr, OTB_CONF_DS18B20_MAX_ID_LEN);
-        os_strncpy(ds18b20->loc, next_cmd, OTB_CONF_DS18B20_LOCATION_MAX_LEN);
-        rc = TRUE;
-        goto EXIT_LABEL;
+        reset_search(ow);
+        ow->search_failed = TRUE;
+        otb_ds18b20_ow_search_done(ow);
+        next_us = 0;
         break;
       }
-    }
+      if (ow->job == OTB_DS18B20_OW_JOB_ALARM)
+      {
+        otb_ds18b20_alarm_device(ow);
+      }
+      else if (!otb_ds18b20_add_device(ow->bus, ow->rom))
+      {
+        // Keep going, but this search can't be trusted to have found every
+        // device
+        ow->search_failed = TRUE;
+      }
+      ow->state = OTB_DS18B20_OW_STATE_SEARCH_RESET;
+      break;
+
+    case OTB_DS18B20_OW_STATE_IDLE:
+    default:
+      MWARN("1-Wire bus %d stepped in state %d", ow->bus, ow->state);
+      next_us = 0;
+      break;
   }
-  
-  otb_cmd_rsp_append("no free slots");
-  
-EXIT_LABEL:
-  
-  // If successful store off new config
-  if (rc)
+
+  if (next_us)
   {
-    rc = otb_conf_update(otb_conf);
-    if (!rc)
-    {
-      otb_cmd_rsp_append("failed to store new config");
-    }
+    otb_ds18b20_ow_schedule(ow, next_us);
   }
 
   EXIT;
-  
-  return rc;
-  
+
+  return;
 }
 
-bool ICACHE_FLASH_ATTR otb_ds18b20_conf_delete(unsigned char *next_cmd, void *arg, unsigned char *prev_cmd)
+// Called once a device's scratchpad has been read in full
+void ICACHE_FLASH_ATTR otb_ds18b20_ow_read_done(otb_ds18b20_ow_engine *ow)
 {
-  bool rc = FALSE;
-  int cmd;
-  char *match;
-  char *addr;
-  otb_conf_ds18b20 *ds18b20;
-  
+  bool rc;
+  otbDs18b20DeviceAddress *addr;
+  uint8_t res;
+  otb_conf_ds18b20_alarm *alarm;
+
   ENTRY;
-  
-  cmd = (int)arg;
 
-  if (cmd == OTB_CMD_DS18B20_ALL)
+  addr = otb_ds18b20_addresses + ow->device;
+  ow->tries++;
+  rc = otb_ds18b20_decode_temp(addr->addr,
+                               ow->data,
+                               otb_ds18b20_last_temp + addr->index);
+  if (!rc && (ow->tries < OTB_DS18B20_OW_READ_TRIES))
   {
-    os_memset(otb_conf->ds18b20,
-              0,
-              sizeof(struct otbDs18b20DeviceAddress) * OTB_DS18B20_MAX_DS18B20S);
-    otb_conf->ds18b20s = 0;
-    rc = TRUE;
+    // Read the scratchpad again (in case of invalid CRC/data) - no need to
+    // redo the conversion
+    ow->state = OTB_DS18B20_OW_STATE_SELECT_RESET;
+    otb_ds18b20_ow_schedule(ow, OTB_DS18B20_OW_STEP_US);
     goto EXIT_LABEL;
   }
-  else if (cmd == OTB_CMD_DS18B20_ADDR)
+  if (!rc)
   {
-    // We've tested the address is configured already, so a bit of asserting
-    addr = prev_cmd;
-    match = otb_ds18b20_get_sensor_name(addr, &ds18b20);
-    OTB_ASSERT(match != NULL);
-    os_memset(ds18b20, 0, sizeof(otb_conf_ds18b20));
-    otb_conf->ds18b20s--;
-    rc = TRUE;
+    // May have been unplugged - search the bus once this job is finished
+    otb_ds18b20_last_temp[addr->index].state = OTB_DS18B20_TEMP_ERROR;
+    ow->pending |= OTB_DS18B20_OW_PENDING_SEARCH;
   }
-  else
-  {
-    OTB_ASSERT(FALSE);
-  }  
-  
-EXIT_LABEL:
 
-  // If successful store off new config
+  otb_ds18b20_publish_temp(addr, ow->tries);
+  addr->flags &= ~OTB_DS18B20_DEVICE_READ;
+
   if (rc)
   {
-    rc = otb_conf_update(otb_conf);
-    if (!rc)
+    if (addr->addr[0] == DS18B20)
     {
-      otb_cmd_rsp_append("failed to store new config");
+      // Only DS18B20s have a configurable resolution
+      addr->res = OTB_DS18B20_CONFIG_TO_RES(ow->data[OTB_DS18B20_SCRATCHPAD_CONFIG]);
+      res = otb_ds18b20_configured_res(addr);
+      if ((res != OTB_CONF_DS18B20_RES_DEFAULT) && (res != addr->res))
+      {
+        MDETAIL("Device %s at %d bits, configuring for %d bits", addr->friendly, addr->res, res);
+        ow->data[OTB_DS18B20_SCRATCHPAD_CONFIG] = OTB_DS18B20_RES_TO_CONFIG(res);
+        ow->writing = TRUE;
+      }
     }
-  }
-  
-  EXIT;
-  
-  return rc;
-}
-
-void ICACHE_FLASH_ATTR otb_ds18b20_conf_get(char *sensor, char *index)
-{
-  char *match = NULL;
-  int slot_num;
-  char *response = NULL;
 
-  ENTRY;
-  
-  // Check "sensor" isn't really an index
-  if (sensor == NULL)
-  {
-    match = NULL;
-    response = "argument not provided";
-    goto EXIT_LABEL;
-  }
-  
-  if (!os_strncmp(sensor, OTB_MQTT_CMD_GET_INDEX, os_strlen(OTB_MQTT_CMD_GET_INDEX)))
-  {
-    if (index == NULL)
+    alarm = otb_ds18b20_device_alarm(addr);
+    if ((alarm != NULL) &&
+        (((sint8)ow->data[OTB_DS18B20_SCRATCHPAD_TH] != alarm->high) ||
+         ((sint8)ow->data[OTB_DS18B20_SCRATCHPAD_TL] != alarm->low)))
     {
-      match = NULL;
-      response = "no index provided";
-      goto EXIT_LABEL;
+      MDETAIL("Device %s configuring alarm %d to %d", addr->friendly, alarm->low, alarm->high);
+      ow->data[OTB_DS18B20_SCRATCHPAD_TH] = alarm->high;
+      ow->data[OTB_DS18B20_SCRATCHPAD_TL] = alarm->low;
+      ow->writing = TRUE;
     }
-    // Get slot number
-    slot_num = atoi(index);
-    MDEBUG("index %d", slot_num);
-    if ((slot_num >= 0) && (slot_num < otb_conf->ds18b20s))
-    {
-      match = otb_conf->ds18b20[slot_num].id;
-    } 
-    else
+
+    if (ow->writing)
     {
-      match = NULL;
-      response = "invalid index";
+      // Write the new configuration - fields which aren't changing are written
+      // back as they were read
+      ow->state = OTB_DS18B20_OW_STATE_SELECT_RESET;
+      otb_ds18b20_ow_schedule(ow, OTB_DS18B20_OW_STEP_US);
+      goto EXIT_LABEL;
     }
-    goto EXIT_LABEL; 
-  }
-  
-  // Not a slot, so sensor may be addr or friendly name - so return the other
-  match = otb_ds18b20_get_sensor_name(sensor, NULL);
-  if (match == NULL)
-  {
-    match = otb_ds18b20_get_addr(sensor, NULL);
-    goto EXIT_LABEL; 
   }
 
+  otb_ds18b20_ow_read_from(ow, ow->device + 1);
+
 EXIT_LABEL:
-  
-  if (match != NULL)
+
+  EXIT;
+
+  return;
+}
+
+// Move onto the next device on this bus to be read, starting at index from,
+// if there is one
+void ICACHE_FLASH_ATTR otb_ds18b20_ow_read_from(otb_ds18b20_ow_engine *ow, uint8_t from)
+{
+  ENTRY;
+
+  ow->device = otb_ds18b20_ow_next_read(ow, from);
+  ow->tries = 0;
+  ow->writing = FALSE;
+  if (ow->device < otb_ds18b20_count)
   {
-    otb_mqtt_send_status(OTB_MQTT_SYSTEM_CONFIG,
-                         OTB_MQTT_CMD_GET,
-                         OTB_MQTT_STATUS_OK,
-                         match);
+    ow->state = OTB_DS18B20_OW_STATE_SELECT_RESET;
+    otb_ds18b20_ow_schedule(ow, OTB_DS18B20_OW_STEP_US);
   }
   else
   {
-    if (response == NULL)
-    {
-      response = "sensor not found";
-    }
-    otb_mqtt_send_status(OTB_MQTT_SYSTEM_CONFIG,
-                         OTB_MQTT_CMD_GET,
-                         OTB_MQTT_STATUS_ERROR,
-                         response);
+    otb_ds18b20_ow_next_job(ow);
   }
-  
+
   EXIT;
-  
+
   return;
 }
 
-bool ICACHE_FLASH_ATTR otb_ds18b20_trigger_device_refresh(unsigned char *next_cmd, void *arg, unsigned char *prev_cmd)
+// Returns the resolution configured for this device, or
+// OTB_CONF_DS18B20_RES_DEFAULT if none
+uint8_t ICACHE_FLASH_ATTR otb_ds18b20_configured_res(otbDs18b20DeviceAddress *addr)
 {
-  bool rc = TRUE;
-  unsigned char scratch[4];
+  otb_conf_ds18b20 *ds18b20;
+  uint8_t res = OTB_CONF_DS18B20_RES_DEFAULT;
 
   ENTRY;
 
-  otb_ds18b20_device_callback(NULL);
-  os_snprintf(scratch, 4, "%d", otb_ds18b20_count);
-  scratch[3] = 0;
-  otb_cmd_rsp_append(scratch);
+  ds18b20 = otb_ds18b20_device_conf(addr);
+  if (ds18b20 != NULL)
+  {
+    res = ds18b20->res;
+  }
 
   EXIT;
 
-  return rc;
-};
+  return res;
+}
 
-void ICACHE_FLASH_ATTR otb_ds18b20_prepare_to_read(void)
+// Returns how long to wait for a conversion to complete on this bus, in ms.
+// This is the conversion time of the slowest device.
+uint32_t ICACHE_FLASH_ATTR otb_ds18b20_ow_conv_time(otb_ds18b20_ow_engine *ow)
 {
+  uint8_t ii;
+  uint8_t res = 0;
+  uint32_t time;
+
   ENTRY;
 
-  reset();
-  write( DS1820_SKIP_ROM, 1 );
-  write( DS1820_CONVERT_T, 1 );
-  //os_delay_us( 750*1000 );
-  otb_util_delay_ms(750);
+  for (ii = otb_ds18b20_ow_next_device(ow, 0);
+       ii < otb_ds18b20_count;
+       ii = otb_ds18b20_ow_next_device(ow, ii + 1))
+  {
+    if ((otb_ds18b20_addresses[ii].addr[0] != DS18B20) ||
+        (otb_ds18b20_addresses[ii].res == 0))
+    {
+      // Resolution unknown or fixed, so assume worst case
+      res = OTB_CONF_DS18B20_RES_MAX;
+      break;
+    }
+    if (otb_ds18b20_addresses[ii].res > res)
+    {
+      res = otb_ds18b20_addresses[ii].res;
+    }
+  }
+
+  switch (res)
+  {
+    case 9:
+      time = OTB_DS18B20_OW_CONVERT_9_MS;
+      break;
+
+    case 10:
+      time = OTB_DS18B20_OW_CONVERT_10_MS;
+      break;
+
+    case 11:
+      time = OTB_DS18B20_OW_CONVERT_11_MS;
+      break;
+
+    default:
+      time = OTB_DS18B20_OW_CONVERT_MS;
+      break;
+  }
+
+  MDEBUG("1-Wire bus %d conversion time %d ms", ow->bus, time);
 
   EXIT;
 
-  return;
+  return time;
 }
 
-bool ICACHE_FLASH_ATTR otb_ds18b20_request_temp(char *addr, char *temp_s)
+// Called when a search of the bus has completed
+void ICACHE_FLASH_ATTR otb_ds18b20_ow_search_done(otb_ds18b20_ow_engine *ow)
 {
   int ii;
-  bool rc = FALSE;
-	uint8_t data[12];
-  uint16_t tdata, sign;
-  uint16_t tVal, tFract;
-  char tSign[2];
-  uint16_t sign_bits;
-  uint8_t crc;
-  
+  uint8_t removed = 0;
+
   ENTRY;
 
-  // Read scratchpad from DS18 device we're interested in
-  // This is up to 9 bytes long, but 0 and 1 bytes contain LSB and MSB
-  // of current temp
-  reset();
-  select(addr);
-  write( DS1820_READ_SCRATCHPAD, 0 );
-  for(ii = 0; ii< 9; ii++)
-  {
-    data[ii] = read();
-  }
-  crc = crc8(data, 8);
-  if (crc != data[8])
+  if (ow->job == OTB_DS18B20_OW_JOB_ALARM)
   {
-    MWARN("DS18B20 response %02x%02x%02x%02x%02x%02x%02x%02x%02x - invalid CRC: 0x%02x", data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7], data[8], crc);
+    // Read the devices the alarm search found (if any)
+    otb_ds18b20_ow_read_from(ow, 0);
     goto EXIT_LABEL;
   }
-  else
-  {
-    MDETAIL("DS18B20 response %02x%02x%02x%02x%02x%02x%02x%02x%02x", data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7], data[8]);
-  }
-
-  tdata = (data[1] << 8) | data[0]; 
-
-  // Top X bits are either all 0s or all ones
-  if (addr[0] != DS18S20)
-  {
-    sign_bits = 0xf800;
-  }
-  else
-  {
-    sign_bits = 0xff00;
-  }
 
-  sign = tdata & sign_bits;
-  tSign[0] = 0;
-  if (sign)
+  if (!ow->search_failed)
   {
-    if (sign != sign_bits)
+    // Anything on this bus which wasn't found has been removed.  Go backwards,
+    // as removing a device moves those after it.
+    for (ii = otb_ds18b20_count - 1; ii >= 0; ii--)
     {
-      // All bits must be set if any are
-      MWARN("Invalid data received 0x%04x", tdata);
-      goto EXIT_LABEL;
+      if ((otb_ds18b20_addresses[ii].bus == ow->bus) &&
+          !(otb_ds18b20_addresses[ii].flags & OTB_DS18B20_DEVICE_SEEN))
+      {
+        otb_ds18b20_remove_device(ii);
+        removed++;
+      }
     }
-    tSign[0] = '-';
-    tSign[1] = 0;
-  }
-
-  // Discard sign info
-  tdata &= ~sign_bits;
-  if (sign)
-  {
-    tdata = (tdata ^ (~sign_bits)) + 1;  // Take 2s complement
   }
 
-  if (addr[0] != DS18S20)
+  if (ow->added || removed)
   {
-    // DS18B20
-    tVal = tdata >> 4;
-    tFract = (tdata & 0x0F) * 100 / 16;
-  }
-  else
-  {
-    // DS18S20
-    tVal = tdata >> 1;
-    tFract = (tdata & 1) ? 50 : 0;
+    MDETAIL("DS18B20 bus %d added %u removed %u now %u",
+            ow->bus,
+            ow->added,
+            removed,
+            otb_ds18b20_ow_bus_count(ow));
+    for (ii = 0; ii < otb_ds18b20_count; ii++)
+    {
+      MDETAIL("Index %d Bus %d Address %s", ii, otb_ds18b20_addresses[ii].bus, otb_ds18b20_addresses[ii].friendly);
+    }
   }
 
-  if ((sign && ((tVal > 55) ||
-                ((tVal == 55) &&
-                (tFract > 0)))) ||
-      (!sign && ((tVal > 125) ||
-                 ((tVal == 125) &&
-                  (tFract > 0)))))
+  if (ow->added)
   {
-    // Invalid value
-    MWARN("Invalid value decoded: %s%d.%02d from 0x%04x", tSign, tVal, tFract, (data[1]<<8 | data[0]));
-    goto EXIT_LABEL;
+    // Don't wait for the next report interval to read the new devices
+    ow->pending |= OTB_DS18B20_OW_PENDING_SAMPLE;
   }
-  
-  os_snprintf(temp_s,
-              OTB_DS18B20_MAX_TEMP_LEN,
-              "%s%d.%02d",
-              tSign, 
-              tVal,
-              tFract);
 
-  rc = TRUE;
+  otb_ds18b20_ow_next_job(ow);
 
 EXIT_LABEL:
 
   EXIT;
 
-  return(rc);
+  return;
 }
 
-// global search state
-static unsigned char ROM_NO[8];
-static uint8_t LastDiscrepancy;
-static uint8_t LastFamilyDiscrepancy;
-static uint8_t LastDeviceFlag;
-static int gpioPin;
-
 void ICACHE_FLASH_ATTR otb_ds18b20_init(int gpio)
 {
-	gpioPin = gpio;
-
-	PIN_FUNC_SELECT(pin_mux[gpioPin], pin_func[gpioPin]);
-	//PIN_PULLDWN_DIS(pin_mux[gpioPin]);
-  //CLEAR_PERI_REG_MASK(pin_mux[gpioPin], BIT6);  // PULLDWN_DIS replacement
-	//PIN_PULLUP_DIS(pin_mux[gpioPin]);
+	PIN_FUNC_SELECT(pin_mux[gpio], pin_func[gpio]);
+	//PIN_PULLDWN_DIS(pin_mux[gpio]);
+  //CLEAR_PERI_REG_MASK(pin_mux[gpio], BIT6);  // PULLDWN_DIS replacement
+	//PIN_PULLUP_DIS(pin_mux[gpio]);
   // Enable pullup resistor for this GPIO (should obviate the need for external resistor)
-	//PIN_PULLUP_EN(pin_mux[gpioPin]);  
+	//PIN_PULLUP_EN(pin_mux[gpio]);  
 	  
-	GPIO_DIS_OUTPUT(gpioPin);
+	GPIO_DIS_OUTPUT(gpio);
 
 }
 
-static void reset_search()
+static void reset_search(otb_ds18b20_ow_engine *ow)
 {
 	// reset the search state
-	LastDiscrepancy = 0;
-	LastDeviceFlag = FALSE;
-	LastFamilyDiscrepancy = 0;
+	ow->last_discrepancy = 0;
+	ow->last_device_flag = FALSE;
+	ow->last_family_discrepancy = 0;
 	for(int i = 7; ; i--) {
-		ROM_NO[i] = 0;
+		ow->rom[i] = 0;
 		if ( i == 0) break;
 	}
 }
@@ -938,163 +1943,96 @@ static void reset_search()
 //
 // Returns 1 if a device asserted a presence pulse, 0 otherwise.
 //
-static uint8_t reset(void)
+// The caller must leave the bus alone for OTB_DS18B20_OW_RESET_RECOVERY_US
+// afterwards - this is done by the engine's timer rather than a delay here.
+//
+static uint8_t reset( int pin )
 {
-	//	IO_REG_TYPE mask = bitmask;
-	//	volatile IO_REG_TYPE *reg IO_REG_ASM = baseReg;
 	int r;
 	uint8_t retries = 125;
 
-	// noInterrupts();
-	// DIRECT_MODE_INPUT(reg, mask);
-	GPIO_DIS_OUTPUT( gpioPin );
+	GPIO_DIS_OUTPUT( pin );
 	
-	// interrupts();
 	// wait until the wire is high... just in case
 	do {
 		if (--retries == 0) return 0;
 		os_delay_us(2);
-	} while ( !GPIO_INPUT_GET( gpioPin ));
+	} while ( !GPIO_INPUT_GET( pin ));
 
-	// noInterrupts();
-	GPIO_OUTPUT_SET( gpioPin, 0 );
-	// DIRECT_WRITE_LOW(reg, mask);
-	// DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
-	// interrupts();
+	// Holding the bus low for longer than 480us is harmless, so interrupts can
+	// stay enabled here
+	GPIO_OUTPUT_SET( pin, 0 );
 	os_delay_us(480);
-	// noInterrupts();
-	GPIO_DIS_OUTPUT( gpioPin );
-	// DIRECT_MODE_INPUT(reg, mask);	// allow it to float
+
+	// But the presence pulse must be sampled at the right time
+	ETS_INTR_LOCK();
+	GPIO_DIS_OUTPUT( pin );
 	os_delay_us(70);
-	// r = !DIRECT_READ(reg, mask);
-	r = !GPIO_INPUT_GET( gpioPin );
-	// interrupts();
-	os_delay_us(410);
+	r = !GPIO_INPUT_GET( pin );
+	ETS_INTR_UNLOCK();
 
 	return r;
 }
 
-/* pass array of 8 bytes in */
-static int ds_search( uint8_t *newAddr )
+// Search for the next 8 bits of a device's ROM, as part of a search (the
+// SEARCHROM command must already have been sent).  ROM byte ow->byte is
+// filled in.
+//
+// Returns FALSE if no devices responded.
+static bool search_rom_byte(otb_ds18b20_ow_engine *ow)
 {
-	uint8_t id_bit_number;
-	uint8_t last_zero, rom_byte_number;
 	uint8_t id_bit, cmp_id_bit;
-	int search_result;
-
 	unsigned char rom_byte_mask, search_direction;
 
-	// initialize for search
-	id_bit_number = 1;
-	last_zero = 0;
-	rom_byte_number = 0;
-	rom_byte_mask = 1;
-	search_result = 0;
-
-	// if the last call was not the last one
-	if (!LastDeviceFlag)
+	for (rom_byte_mask = 1; rom_byte_mask; rom_byte_mask <<= 1)
 	{
-		// 1-Wire reset
-		if (!reset())
+		// read a bit and its complement
+		id_bit = read_bit(ow->gpio);
+		cmp_id_bit = read_bit(ow->gpio);
+ 
+		// check for no devices on 1-wire
+		if ((id_bit == 1) && (cmp_id_bit == 1))
 		{
-			// reset the search
-			LastDiscrepancy = 0;
-			LastDeviceFlag = FALSE;
-			LastFamilyDiscrepancy = 0;
-
 			return FALSE;
 		}
 
-		// issue the search command
-		write(DS1820_SEARCHROM, 0);
-
-		// loop to do the search
-		do
+		// all devices coupled have 0 or 1
+		if (id_bit != cmp_id_bit)
+			search_direction = id_bit;  // bit write value for search
+		else
 		{
-			// read a bit and its complement
-			id_bit = read_bit();
-			cmp_id_bit = read_bit();
-	 
-			// check for no devices on 1-wire
-			if ((id_bit == 1) && (cmp_id_bit == 1))
-			{
-				break;
-			}
+			// if this discrepancy if before the Last Discrepancy
+			// on a previous next then pick the same as last time
+			if (ow->id_bit_number < ow->last_discrepancy)
+				search_direction = ((ow->rom[ow->byte] & rom_byte_mask) > 0);
 			else
+				// if equal to last pick 1, if not then pick 0
+				search_direction = (ow->id_bit_number == ow->last_discrepancy);
+
+			// if 0 was picked then record its position in LastZero
+			if (search_direction == 0)
 			{
-				// all devices coupled have 0 or 1
-				if (id_bit != cmp_id_bit)
-					search_direction = id_bit;  // bit write value for search
-				else
-				{
-					// if this discrepancy if before the Last Discrepancy
-					// on a previous next then pick the same as last time
-					if (id_bit_number < LastDiscrepancy)
-						search_direction = ((ROM_NO[rom_byte_number] & rom_byte_mask) > 0);
-					else
-						// if equal to last pick 1, if not then pick 0
-						search_direction = (id_bit_number == LastDiscrepancy);
-
-					// if 0 was picked then record its position in LastZero
-					if (search_direction == 0)
-					{
-						last_zero = id_bit_number;
-
-						// check for Last discrepancy in family
-						if (last_zero < 9)
-							LastFamilyDiscrepancy = last_zero;
-					}
-				}
-
-				// set or clear the bit in the ROM byte rom_byte_number
-				// with mask rom_byte_mask
-				if (search_direction == 1)
-					ROM_NO[rom_byte_number] |= rom_byte_mask;
-				else
-					ROM_NO[rom_byte_number] &= ~rom_byte_mask;
-
-				// serial number search direction write bit
-				write_bit(search_direction);
-
-				// increment the byte counter id_bit_number
-				// and shift the mask rom_byte_mask
-				id_bit_number++;
-				rom_byte_mask <<= 1;
-
-				// if the mask is 0 then go to new SerialNum byte rom_byte_number and reset mask
-				if (rom_byte_mask == 0)
-				{
-					rom_byte_number++;
-					rom_byte_mask = 1;
-				}
+				ow->last_zero = ow->id_bit_number;
+
+				// check for Last discrepancy in family
+				if (ow->last_zero < 9)
+					ow->last_family_discrepancy = ow->last_zero;
 			}
 		}
-		while(rom_byte_number < 8);  // loop until through all ROM bytes 0-7
 
-		// if the search was successful then
-		if (!(id_bit_number < 65))
-		{
-			// search successful so set LastDiscrepancy,LastDeviceFlag,search_result
-			LastDiscrepancy = last_zero;
+		// set or clear the bit in the ROM byte with mask rom_byte_mask
+		if (search_direction == 1)
+			ow->rom[ow->byte] |= rom_byte_mask;
+		else
+			ow->rom[ow->byte] &= ~rom_byte_mask;
 
-			// check for last device
-			if (LastDiscrepancy == 0)
-				LastDeviceFlag = TRUE;
+		// serial number search direction write bit
+		write_bit(ow->gpio, search_direction);
 
-			search_result = TRUE;
-		}
+		ow->id_bit_number++;
 	}
 
-	// if no device found then reset counters so next 'search' will be like a first
-	if (!search_result || !ROM_NO[0])
-	{
-		LastDiscrepancy = 0;
-		LastDeviceFlag = FALSE;
-		LastFamilyDiscrepancy = 0;
-		search_result = FALSE;
-	}
-	for (int i = 0; i < 8; i++) newAddr[i] = ROM_NO[i];
-	return search_result;
+	return TRUE;
 }
 
 //
@@ -1104,100 +2042,69 @@ static int ds_search( uint8_t *newAddr )
 // go tri-state at the end of the write to avoid heating in a short or
 // other mishap.
 //
-static void write( uint8_t v, int power ) {
+static void write( int pin, uint8_t v, int power ) {
 	uint8_t bitMask;
 
 	for (bitMask = 0x01; bitMask; bitMask <<= 1) {
-		write_bit( (bitMask & v)?1:0);
+		write_bit( pin, (bitMask & v)?1:0);
 	}
 	if ( !power) {
-		// noInterrupts();
-		GPIO_DIS_OUTPUT( gpioPin );
-		GPIO_OUTPUT_SET( gpioPin, 0 );
-		// DIRECT_MODE_INPUT(baseReg, bitmask);
-		// DIRECT_WRITE_LOW(baseReg, bitmask);
-		// interrupts();
+		// Let the pull up hold the bus high until the next step - driving it
+		// low here would look like the start of a slot
+		GPIO_DIS_OUTPUT( pin );
 	}
 }
 
 //
-// Write a bit. Port and bit is used to cut lookup time and provide
-// more certain timing.
+// Write a bit.  Interrupts are disabled for the slot itself, but not the
+// recovery time.
 //
-static inline void ICACHE_FLASH_ATTR  write_bit( int v )
+static inline void ICACHE_FLASH_ATTR  write_bit( int pin, int v )
 {
-	// IO_REG_TYPE mask=bitmask;
-	//	volatile IO_REG_TYPE *reg IO_REG_ASM = baseReg;
-
-	GPIO_OUTPUT_SET( gpioPin, 0 );
+	ETS_INTR_LOCK();
+	GPIO_OUTPUT_SET( pin, 0 );
 	if( v ) {
-		// noInterrupts();
-		//	DIRECT_WRITE_LOW(reg, mask);
-		//	DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
 		os_delay_us(10);
-		GPIO_OUTPUT_SET( gpioPin, 1 );
-		// DIRECT_WRITE_HIGH(reg, mask);	// drive output high
-		// interrupts();
+		GPIO_OUTPUT_SET( pin, 1 );
+		ETS_INTR_UNLOCK();
 		os_delay_us(55);
 	} else {
-		// noInterrupts();
-		//	DIRECT_WRITE_LOW(reg, mask);
-		//	DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
 		os_delay_us(65);
-		GPIO_OUTPUT_SET( gpioPin, 1 );
-		//	DIRECT_WRITE_HIGH(reg, mask);	// drive output high
-		//		interrupts();
+		GPIO_OUTPUT_SET( pin, 1 );
+		ETS_INTR_UNLOCK();
 		os_delay_us(5);
 	}
 }
 
 //
-// Read a bit. Port and bit is used to cut lookup time and provide
-// more certain timing.
+// Read a bit.  Interrupts are disabled from the start of the slot until the
+// bit has been sampled.
 //
-static inline int read_bit(void)
+static inline int read_bit( int pin )
 {
-	//IO_REG_TYPE mask=bitmask;
-	//volatile IO_REG_TYPE *reg IO_REG_ASM = baseReg;
 	int r;
   
-	// noInterrupts();
-	GPIO_OUTPUT_SET( gpioPin, 0 );
-	// DIRECT_MODE_OUTPUT(reg, mask);
-	// DIRECT_WRITE_LOW(reg, mask);
+	ETS_INTR_LOCK();
+	GPIO_OUTPUT_SET( pin, 0 );
 	os_delay_us(3);
-	GPIO_DIS_OUTPUT( gpioPin );
-	// DIRECT_MODE_INPUT(reg, mask);	// let pin float, pull up will raise
+	GPIO_DIS_OUTPUT( pin );
 	os_delay_us(10);
-	// r = DIRECT_READ(reg, mask);
-	r = GPIO_INPUT_GET( gpioPin );
-	// interrupts();
+	r = GPIO_INPUT_GET( pin );
+	ETS_INTR_UNLOCK();
 	os_delay_us(53);
 
 	return r;
 }
 
-//
-// Do a ROM select
-//
-static void select(const uint8_t *rom)
-{
-	uint8_t i;
-
-	write(DS1820_MATCHROM, 0);           // Choose ROM
-
-	for (i = 0; i < 8; i++) write(rom[i], 0);
-}
-
 //
 // Read a byte
 //
-static uint8_t read() {
+static uint8_t read( int pin ) {
 	uint8_t bitMask;
 	uint8_t r = 0;
 
 	for (bitMask = 0x01; bitMask; bitMask <<= 1) {
-		if ( read_bit()) r |= bitMask;
+		if ( read_bit( pin )) r |= bitMask;
 	}
 	return r;
 }
@@ -38,6 +38,7 @@ void ICACHE_FLASH_ATTR otb_eeprom_read(void)
   otb_eeprom_main_module *mod;
   otb_eeprom_info *eeprom_info_v;
   uint32_t rpi_rc;
+  bool cached;
 
   ENTRY;
 
@@ -54,12 +55,19 @@ void ICACHE_FLASH_ATTR otb_eeprom_read(void)
 
 #ifndef OTB_RBOOT_BOOTLOADER
 
-  MDETAIL("Attempt to read main eeprom at address 0x%02x", otb_eeprom_main_board_addr);
-  otb_eeprom_read_all(otb_eeprom_main_board_addr, bus);
   os_memset(otb_eeprom_main_module_info_g, 0, sizeof(otb_eeprom_main_module_info) * OTB_EEPROM_MAX_MODULES);
 
+  // Try the flash cache first - this avoids reading the components over I2C
+  // unless an eeprom has changed
+  cached = otb_eeprom_cache_load(bus);
+  if (!cached)
+  {
+    MDETAIL("Attempt to read main eeprom at address 0x%02x", otb_eeprom_main_board_addr);
+    otb_eeprom_read_all(otb_eeprom_main_board_addr, bus);
+  }
+
   // Read the modules.
-  // - If an non-espi device then use the standard format
+  // - If an non-espi device then use the standard format (unless cached)
   // - If an espi device then use the raspberry pi format 
 
   if (otb_eeprom_main_board_g != NULL)
@@ -74,11 +82,14 @@ void ICACHE_FLASH_ATTR otb_eeprom_read(void)
 
       if (otb_eeprom_main_board_module_g[ii] != NULL)
       {
-        MDETAIL("Look for module %d eeprom at address 0x%02x", ii, otb_eeprom_main_board_module_g[ii]->address);
-        
         eeprom_info_v = NULL;
         if (otb_eeprom_main_board_module_g[ii]->socket_type != OTB_EEPROM_MODULE_TYPE_RPI_HAT_ESPI)
         {
+          if (cached)
+          {
+            continue;
+          }
+          MDETAIL("Look for module %d eeprom at address 0x%02x", ii, otb_eeprom_main_board_module_g[ii]->address);
           eeprom_info_v = otb_eeprom_load_main_comp(otb_eeprom_main_board_module_g[ii]->address, bus, eeprom_info_v, OTB_EEPROM_INFO_TYPE_INFO, 1, NULL, 0);
           if (eeprom_info_v != NULL)
           {
@@ -95,7 +106,9 @@ void ICACHE_FLASH_ATTR otb_eeprom_read(void)
         }
         else
         {
-          // Try reading an RPi EEPROM
+          // Try reading an RPi EEPROM - not cached, as reading it also
+          // initializes the hat
+          MDETAIL("Look for module %d eeprom at address 0x%02x", ii, otb_eeprom_main_board_module_g[ii]->address);
           otb_eeprom_rpi_header rpi_hdr;
           rpi_rc = otb_eeprom_load_rpi_eeprom(otb_eeprom_main_board_module_g[ii]->address, bus, eeprom_info_v, OTB_EEPROM_INFO_RPI_TYPE_HEADER, &rpi_hdr);
         }
@@ -104,6 +117,16 @@ void ICACHE_FLASH_ATTR otb_eeprom_read(void)
     }
   }
 
+  if (!cached)
+  {
+    otb_eeprom_cache_save(bus);
+  }
+
+  otb_eeprom_lazy_locate();
+  MDETAIL("Eeprom components using %d bytes of heap, %d bytes not loaded yet",
+          otb_eeprom_heap_used,
+          otb_eeprom_heap_deferred());
+
 #endif // OTB_RBOOT_BOOTLOADER
 
 EXIT_LABEL:
@@ -556,29 +579,29 @@ void ICACHE_FLASH_ATTR otb_eeprom_init_modules()
           if (kk >= 2)
           {
             gpios_munged = (gpios[1] << 8) | gpios[0];
-            timer_param = (void*)gpios_munged;
-            switch (otb_eeprom_main_module_info_g[ii].module->module_type)
+            // Only a temperature board gets its GPIOs passed through -
+            // otb_init_ds18b20 starts 1-Wire buses on any it's given
+            switch (otb_eeprom_image_mezz_init(otb_eeprom_main_module_info_g[ii].module->module_type, gpios_munged, &timer_param))
             {
-              case OTB_EEPROM_MODULE_TYPE_TEMP_V0_2:
+              case OTB_EEPROM_IMAGE_MEZZ_INIT_DS18B20:
                 timer_func = otb_init_ds18b20;
                 break;
 
-              case OTB_EEPROM_MODULE_TYPE_ADC_V0_1:
+              case OTB_EEPROM_IMAGE_MEZZ_INIT_ADS:
                 timer_func = otb_init_ads;
                 break;
 
-              case OTB_EEPROM_MODULE_TYPE_RELAY_V0_2:
+              case OTB_EEPROM_IMAGE_MEZZ_INIT_RELAY:
                 timer_func = otb_relay_init_mezz;
                 break;
 
-              case OTB_EEPROM_MODULE_TYPE_MBUS_V0_1:
+              case OTB_EEPROM_IMAGE_MEZZ_INIT_MBUS:
                 timer_func = otb_serial_init_mbus_mezz;
-                timer_param = (void*)otb_eeprom_main_module_info_g[ii].module->module_type;
                 break;
 
-              case OTB_EEPROM_MODULE_TYPE_LL_V0_1:
-              case OTB_EEPROM_MODULE_TYPE_NIXIE_V0_2:
+              case OTB_EEPROM_IMAGE_MEZZ_INIT_NONE:
               default:
+                timer_func = otb_init_ds18b20;
                 MDETAIL("No initialisation for module type: 0x%08x", otb_eeprom_main_module_info_g[ii].module->module_type);
                 break;
             }
@@ -651,11 +674,11 @@ void ICACHE_FLASH_ATTR otb_eeprom_read_all(uint8_t addr,
                                            brzo_i2c_info *i2c_info)
 {
 #ifndef OTB_RBOOT_BOOTLOADER // Not within the bootloader
+  // Types in otb_eeprom_lazy_comps are read when first needed
   uint32_t types[] = {OTB_EEPROM_INFO_TYPE_INFO,
                       OTB_EEPROM_INFO_TYPE_MAIN_BOARD,
-                      OTB_EEPROM_INFO_TYPE_MAIN_BOARD_MODULE,
-                      OTB_EEPROM_INFO_TYPE_GPIO_PINS};
-  uint32_t types_num = 4;
+                      OTB_EEPROM_INFO_TYPE_MAIN_BOARD_MODULE};
+  uint32_t types_num = 3;
 #else // OTB_RBOOT_BOOTLOADER // Within the bootloader
   uint32_t types[] = {OTB_EEPROM_INFO_TYPE_INFO,
                       OTB_EEPROM_INFO_TYPE_GPIO_PINS,
@@ -821,7 +844,6 @@ void *ICACHE_FLASH_ATTR otb_eeprom_load_main_comp(uint8_t addr,
   uint32_t fn_rc;
   otb_eeprom_hdr *hdr;
   int ii;
-  unsigned char serial[OTB_EEPROM_HW_SERIAL_LEN+2];
 
   ENTRY;
 
@@ -877,6 +899,10 @@ void *ICACHE_FLASH_ATTR otb_eeprom_load_main_comp(uint8_t addr,
     OTB_ASSERT(hdr->length <= OTB_EEPROM_MAX_MAIN_COMP_LENGTH);
 #ifndef OTB_RBOOT_BOOTLOADER    
     local_buf = os_malloc(hdr->length);
+    if (local_buf != NULL)
+    {
+      otb_eeprom_heap_used += hdr->length;
+    }
 #else // OTB_RBOOT_BOOTLOADER
     OTB_ASSERT((type == OTB_EEPROM_INFO_TYPE_INFO) ||
                (type == OTB_EEPROM_INFO_TYPE_GPIO_PINS) ||
@@ -895,12 +921,30 @@ void *ICACHE_FLASH_ATTR otb_eeprom_load_main_comp(uint8_t addr,
   OTB_ASSERT(local_buf != NULL);
   os_memcpy(local_buf, temp_buf, hdr->length);
 
-  hdr = (otb_eeprom_hdr *)local_buf;
+  otb_eeprom_process_main_comp(type, local_buf);
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return (local_buf);
+  
+}
+
+//
+// Logs a main comp, and acts on anything in it needed straight away
+//
+void ICACHE_FLASH_ATTR otb_eeprom_process_main_comp(uint32_t type, void *comp)
+{
+  unsigned char serial[OTB_EEPROM_HW_SERIAL_LEN+2];
+
+  ENTRY;
+
   switch (type)
   {
     case OTB_EEPROM_INFO_TYPE_INFO:
       ;
-      otb_eeprom_info *eeprom_info = (otb_eeprom_info *)local_buf;
+      otb_eeprom_info *eeprom_info = (otb_eeprom_info *)comp;
       MDETAIL("  eeprom_size:     0x%08x", eeprom_info->eeprom_size);
       MDETAIL("  comp_num:        %d", eeprom_info->comp_num);
       MDETAIL("  write_date:      0x%08x", eeprom_info->write_date);
@@ -908,7 +952,7 @@ void *ICACHE_FLASH_ATTR otb_eeprom_load_main_comp(uint8_t addr,
 
     case OTB_EEPROM_INFO_TYPE_MAIN_BOARD:
       ;
-      otb_eeprom_main_board *main_board = (otb_eeprom_main_board *)local_buf;
+      otb_eeprom_main_board *main_board = (otb_eeprom_main_board *)comp;
       // Guard against non NULL terminated serial!
       os_memcpy(serial, main_board->common.serial, OTB_EEPROM_HW_SERIAL_LEN+1);
       serial[OTB_EEPROM_HW_SERIAL_LEN+1] = 0;
@@ -945,7 +989,7 @@ void *ICACHE_FLASH_ATTR otb_eeprom_load_main_comp(uint8_t addr,
 
     case OTB_EEPROM_INFO_TYPE_MAIN_BOARD_MODULE:
       ;
-      otb_eeprom_main_board_module *module = (otb_eeprom_main_board_module *)local_buf;
+      otb_eeprom_main_board_module *module = (otb_eeprom_main_board_module *)comp;
       MDETAIL("  num:             %d", module->num);
       MDETAIL("  socket_type:     %d", module->socket_type);
       MDETAIL("  num_headers:     %d", module->num_headers);
@@ -958,13 +1002,13 @@ void *ICACHE_FLASH_ATTR otb_eeprom_load_main_comp(uint8_t addr,
 
     case OTB_EEPROM_INFO_TYPE_SDK_INIT_DATA:
       ;
-      otb_eeprom_main_board_sdk_init_data *sdk_init_data = (otb_eeprom_main_board_sdk_init_data *)local_buf;
+      otb_eeprom_main_board_sdk_init_data *sdk_init_data = (otb_eeprom_main_board_sdk_init_data *)comp;
       MDETAIL("  data_len:        %d bytes", sdk_init_data->data_len);
       break;
 
     case OTB_EEPROM_INFO_TYPE_GPIO_PINS:
       ;
-      otb_eeprom_main_board_gpio_pins *gpio_pins = (otb_eeprom_main_board_gpio_pins *)local_buf;
+      otb_eeprom_main_board_gpio_pins *gpio_pins = (otb_eeprom_main_board_gpio_pins *)comp;
       MDETAIL("  num_pins:        %d", gpio_pins->num_pins);
 #ifdef OTB_DEBUG      
       otb_eeprom_output_pin_info(gpio_pins->num_pins, gpio_pins->pin_info);
@@ -973,7 +1017,7 @@ void *ICACHE_FLASH_ATTR otb_eeprom_load_main_comp(uint8_t addr,
 
     case OTB_EEPROM_INFO_TYPE_MAIN_MODULE:
       ;
-      otb_eeprom_main_module *mod = (otb_eeprom_main_module *)local_buf;
+      otb_eeprom_main_module *mod = (otb_eeprom_main_module *)comp;
       // Guard against non NULL terminated serial!
       os_memcpy(serial, mod->common.serial, OTB_EEPROM_HW_SERIAL_LEN+1);
       serial[OTB_EEPROM_HW_SERIAL_LEN+1] = 0;
@@ -990,13 +1034,11 @@ void *ICACHE_FLASH_ATTR otb_eeprom_load_main_comp(uint8_t addr,
       break;
   }
 
-EXIT_LABEL:
-
   EXIT;
 
-  return (local_buf);
-  
+  return;
 }
+
 //
 // otb_eeprom_find_main_comp
 //
@@ -1077,11 +1119,8 @@ bool ICACHE_FLASH_ATTR otb_eeprom_process_hdr(otb_eeprom_hdr *hdr,
                                               bool checksum)
 {
   bool fn_rc = TRUE;
-  uint32_t magic;
-  uint32_t version_min;
-  uint32_t version_max;
-  uint32_t struct_size_min;
-  uint32_t struct_size_max;
+  uint32_t hdr_rc;
+  otb_eeprom_main_comp_type *type_info;
   unsigned char *struct_type;
 
   ENTRY;
@@ -1090,83 +1129,70 @@ bool ICACHE_FLASH_ATTR otb_eeprom_process_hdr(otb_eeprom_hdr *hdr,
   OTB_ASSERT(type < OTB_EEPROM_INFO_TYPE_NUM);
   OTB_ASSERT(buf_len >= sizeof(otb_eeprom_main_comp_types[type].struct_size_min));
 
-  struct_type = otb_eeprom_main_comp_types[type].name;
-  magic = otb_eeprom_main_comp_types[type].magic;
-  version_min = otb_eeprom_main_comp_types[type].version_min;
-  version_max = otb_eeprom_main_comp_types[type].version_max;
-  struct_size_min = otb_eeprom_main_comp_types[type].struct_size_min;
-  struct_size_max = otb_eeprom_main_comp_types[type].struct_size_max;
+  type_info = otb_eeprom_main_comp_types + type;
+  struct_type = type_info->name;
 
   if (!checksum)
   {
-    if (hdr->magic != magic)
+    // Can keep going after any of these, other than the buffer being too
+    // small - in which case we can't check the checksum as we don't have all
+    // the data
+    hdr_rc = otb_eeprom_image_hdr_check((uint8_t *)hdr, type, type_info, buf_len);
+    if (hdr_rc != OTB_EEPROM_ERR_OK)
     {
-      // Can keep going
-      MWARN("Bad magic number %s 0x%08x vs 0x%08x", struct_type, hdr->magic, magic);
       fn_rc = FALSE;
-      *rc |= OTB_EEPROM_ERR_MAGIC;
+      *rc |= hdr_rc;
     }
 
-    if (hdr->type != type)
+    if (hdr_rc & OTB_EEPROM_ERR_MAGIC)
+    {
+      MWARN("Bad magic number %s 0x%08x vs 0x%08x", struct_type, hdr->magic, type_info->magic);
+    }
+
+    if (hdr_rc & OTB_EEPROM_ERR_TYPE)
     {
-      // Can keep going
       MWARN("Bad type %s %d vs %d", struct_type, hdr->type, type);
-      fn_rc = FALSE;
-      *rc |= OTB_EEPROM_ERR_TYPE;
     }
 
-    if ((hdr->version < version_min) ||
-        (hdr->version > version_max))
+    if (hdr_rc & OTB_EEPROM_ERR_VERSION)
     {
-      // Can keep going
       MWARN("Bad version %s %d vs %d/%d",
           struct_type,
           hdr->version,
-          version_min,
-          version_max);
-      fn_rc = FALSE;
-      *rc |= OTB_EEPROM_ERR_VERSION;
+          type_info->version_min,
+          type_info->version_max);
     }
 
-    // Should also test not smaller than size of smallest version
-    if ((hdr->struct_size < struct_size_min) || (hdr->struct_size > struct_size_max))
+    if (hdr_rc & OTB_EEPROM_ERR_STRUCT_SIZE)
     {
-      // Can keep going
       MWARN("Bad struct_size %s %d vs %d/%d",
           struct_type,
           hdr->struct_size,
-          struct_size_min,
-          struct_size_max);
-      fn_rc = FALSE;
-      *rc |= OTB_EEPROM_ERR_MAGIC;
+          type_info->struct_size_min,
+          type_info->struct_size_max);
     }
 
-    if (hdr->length > buf_len)
+    if (hdr_rc & OTB_EEPROM_ERR_LENGTH)
+    {
+      MWARN("Bad length %s %d", struct_type, hdr->length);
+    }
+
+    if (hdr_rc & OTB_EEPROM_ERR_BUF_LEN_COMP)
     {
-      // We can't check the checksum as we don't have all the data
       MWARN("Buffer not large enough %d vs %d", buf_len, hdr->length);
-      fn_rc = FALSE;
-      *rc |= OTB_EEPROM_ERR_BUF_LEN_COMP;
-      goto EXIT_LABEL;
     }
   }
   else
   {
-    fn_rc = otb_eeprom_check_checksum((char*)hdr,
-                                      hdr->length,
-                                      (char*)&(hdr->checksum) - (char*)hdr,
-                                      sizeof(hdr->checksum));
+    fn_rc = otb_eeprom_image_checksum_ok((uint8_t *)hdr);
     if (!fn_rc)
     {
       // Can keep going
       MWARN("Bad checksum %s 0x%08x", struct_type, hdr->checksum);
-      fn_rc = FALSE;
       *rc |= OTB_EEPROM_ERR_CHECKSUM;
     }                 
   }
 
-EXIT_LABEL:                     
-
   EXIT;
 
   return fn_rc;
@@ -1327,11 +1353,8 @@ EXIT_LABEL:
   return rc;
 }
 
-char ICACHE_FLASH_ATTR otb_eeprom_check_checksum(char *data, int size, int checksum_loc, int checksum_size)
+uint32 ICACHE_FLASH_ATTR otb_eeprom_calc_checksum(char *data, int size, int checksum_loc, int checksum_size)
 {
-  char rc = 0;
-  int ii;
-  uint32 *checksum;
   uint32 calc_check;
   
   ENTRY;
@@ -1342,20 +1365,27 @@ char ICACHE_FLASH_ATTR otb_eeprom_check_checksum(char *data, int size, int check
   
   OTB_ASSERT(checksum_size == sizeof(uint32));
   
+  calc_check = otb_eeprom_image_checksum((uint8_t *)data, size, checksum_loc);
+  
+  MDEBUG("Calculated checksum: 0x%08x", calc_check);
+
+  EXIT;
+  
+  return calc_check;
+}
+
+char ICACHE_FLASH_ATTR otb_eeprom_check_checksum(char *data, int size, int checksum_loc, int checksum_size)
+{
+  char rc = 0;
+  uint32 *checksum;
+  uint32 calc_check;
+  
+  ENTRY;
+
   checksum = (uint32*)(data + checksum_loc);
   MDEBUG("Stored checksum: 0x%08x", *checksum);
   
-  calc_check = OTB_EEPROM_CHECKSUM_INITIAL;
-  for (ii = 0; ii < size; ii++)
-  {
-    if ((ii < checksum_loc) || (ii >= (checksum_loc + checksum_size)))
-    {
-      MDEBUG("Checksum byte: 0x%02x, %d", *(data+ii), (ii%4));
-      calc_check += (*(data+ii) << ((ii%4) * 8));
-    }
-  }  
-  
-  MDEBUG("Calculated checksum: 0x%08x", calc_check);
+  calc_check = otb_eeprom_calc_checksum(data, size, checksum_loc, checksum_size);
 
   rc = (*checksum == calc_check);
   
@@ -1415,3 +1445,533 @@ EXIT_LABEL:
 
 }
 #endif // OTB_RBOOT_BOOTLOADER
+
+#ifndef OTB_RBOOT_BOOTLOADER
+
+// Records are padded so each component starts 4 byte aligned - they're used
+// in place
+#define OTB_EEPROM_CACHE_PAD(LEN)  (((LEN) + 3) & ~3)
+
+//
+// Reads just an eeprom's otb_eeprom_info header, to see what's on it.  Leaves
+// the key zeroed (but for addr) if it can't be read.
+//
+bool ICACHE_FLASH_ATTR otb_eeprom_cache_key_read(uint8_t addr,
+                                                 brzo_i2c_info *i2c_info,
+                                                 otb_eeprom_cache_key *key)
+{
+  bool rc;
+  otb_eeprom_info eeprom_info;
+
+  ENTRY;
+
+  rc = otb_i2c_24xx128_read_data(addr,
+                                 0,
+                                 sizeof(eeprom_info),
+                                 (uint8_t *)&eeprom_info,
+                                 i2c_info);
+  if (rc && (eeprom_info.hdr.magic != OTB_EEPROM_INFO_MAGIC))
+  {
+    MDETAIL("No otb_eeprom_info at 0x%02x", addr);
+    rc = FALSE;
+  }
+  otb_eeprom_cache_key_set(addr, rc ? &eeprom_info : NULL, key);
+
+  EXIT;
+
+  return rc;
+}
+
+void ICACHE_FLASH_ATTR otb_eeprom_cache_key_set(uint8_t addr,
+                                                otb_eeprom_info *eeprom_info,
+                                                otb_eeprom_cache_key *key)
+{
+  ENTRY;
+
+  os_memset(key, 0, sizeof(*key));
+  key->addr = addr;
+  if (eeprom_info != NULL)
+  {
+    key->checksum = eeprom_info->hdr.checksum;
+    key->length = eeprom_info->hdr.length;
+    key->write_date = eeprom_info->write_date;
+  }
+
+  EXIT;
+
+  return;
+}
+
+// Forget anything loaded from a cache which turned out to be bad
+void ICACHE_FLASH_ATTR otb_eeprom_cache_clear(void)
+{
+  int ii;
+
+  ENTRY;
+
+  otb_eeprom_info_g = NULL;
+  otb_eeprom_main_board_g = NULL;
+  for (ii = 0; ii < OTB_EEPROM_MAX_MODULES; ii++)
+  {
+    otb_eeprom_main_board_module_g[ii] = NULL;
+  }
+  os_memset(otb_eeprom_main_module_info_g, 0, sizeof(otb_eeprom_main_module_info) * OTB_EEPROM_MAX_MODULES);
+
+  EXIT;
+
+  return;
+}
+
+//
+// otb_eeprom_cache_load
+//
+// If the eeproms still hold what the flash cache was built from, points the
+// globals at the cached components (which are left in a single allocated
+// buffer) and returns TRUE.  Otherwise the eeproms need reading.
+//
+bool ICACHE_FLASH_ATTR otb_eeprom_cache_load(brzo_i2c_info *i2c_info)
+{
+  bool rc = FALSE;
+  otb_eeprom_cache_hdr hdr;
+  otb_eeprom_cache_hdr *cache = NULL;
+  otb_eeprom_cache_key key;
+  otb_eeprom_cache_rec *rec;
+  otb_eeprom_hdr *comp;
+  uint32_t pos;
+  int ii;
+
+  ENTRY;
+
+  rc = otb_util_flash_read(OTB_BOOT_EEPROM_CACHE_LOCATION,
+                           (uint32 *)&hdr,
+                           sizeof(hdr));
+  if (!rc ||
+      (hdr.magic != OTB_EEPROM_CACHE_MAGIC) ||
+      (hdr.version != OTB_EEPROM_CACHE_VERSION) ||
+      (hdr.length < sizeof(hdr)) ||
+      (hdr.length > OTB_BOOT_EEPROM_CACHE_LEN) ||
+      (hdr.length % 4) ||
+      (hdr.key_num < 1) ||
+      (hdr.key_num > OTB_EEPROM_CACHE_MAX_KEYS))
+  {
+    MDETAIL("No eeprom cache");
+    rc = FALSE;
+    goto EXIT_LABEL;
+  }
+
+  // Check the eeproms haven't changed - including that any which couldn't be
+  // read before still can't
+  for (ii = 0; ii < hdr.key_num; ii++)
+  {
+    otb_eeprom_cache_key_read(hdr.key[ii].addr, i2c_info, &key);
+    if (os_memcmp(&key, hdr.key + ii, sizeof(key)))
+    {
+      MDETAIL("Eeprom at 0x%02x has changed", key.addr);
+      rc = FALSE;
+      goto EXIT_LABEL;
+    }
+  }
+
+  cache = (otb_eeprom_cache_hdr *)os_malloc(hdr.length);
+  if (cache == NULL)
+  {
+    MWARN("Failed to allocate memory for eeprom cache %d", hdr.length);
+    rc = FALSE;
+    goto EXIT_LABEL;
+  }
+  rc = otb_util_flash_read(OTB_BOOT_EEPROM_CACHE_LOCATION,
+                           (uint32 *)cache,
+                           hdr.length);
+  if (!rc ||
+      os_memcmp(cache, &hdr, sizeof(hdr)) ||
+      !otb_eeprom_check_checksum((char *)cache,
+                                 cache->length,
+                                 (char *)&(cache->checksum) - (char *)cache,
+                                 sizeof(cache->checksum)))
+  {
+    MWARN("Bad eeprom cache");
+    rc = FALSE;
+    goto EXIT_LABEL;
+  }
+
+  // Point the globals at the cached components
+  pos = sizeof(*cache);
+  for (ii = 0; ii < cache->rec_num; ii++)
+  {
+    rec = (otb_eeprom_cache_rec *)((uint8_t *)cache + pos);
+    comp = (otb_eeprom_hdr *)rec->comp;
+    if (((pos + sizeof(*rec) + sizeof(*comp)) > cache->length) ||
+        (rec->type >= OTB_EEPROM_INFO_TYPE_NUM) ||
+        (comp->type != rec->type) ||
+        (comp->length < sizeof(*comp)) ||
+        ((pos + sizeof(*rec) + comp->length) > cache->length))
+    {
+      MWARN("Bad eeprom cache record %d", ii);
+      rc = FALSE;
+      goto EXIT_LABEL;
+    }
+
+    MDEBUG("Cached %s", otb_eeprom_main_comp_types[rec->type].name);
+    if (rec->slot == OTB_EEPROM_CACHE_SLOT_MAIN)
+    {
+      if ((otb_eeprom_main_comp_types[rec->type].global == NULL) ||
+          (rec->num >= otb_eeprom_main_comp_types[rec->type].quantity))
+      {
+        MWARN("Bad eeprom cache record %d", ii);
+        rc = FALSE;
+        goto EXIT_LABEL;
+      }
+      *(otb_eeprom_main_comp_types[rec->type].global + rec->num) = comp;
+    }
+    else if ((rec->slot < OTB_EEPROM_MAX_MODULES) &&
+             (rec->type == OTB_EEPROM_INFO_TYPE_INFO))
+    {
+      otb_eeprom_main_module_info_g[rec->slot].eeprom_info = (otb_eeprom_info *)comp;
+    }
+    else if ((rec->slot < OTB_EEPROM_MAX_MODULES) &&
+             (rec->type == OTB_EEPROM_INFO_TYPE_MAIN_MODULE))
+    {
+      otb_eeprom_main_module_info_g[rec->slot].module = (otb_eeprom_main_module *)comp;
+      otb_eeprom_main_module_info_g[rec->slot].main_board_mod = otb_eeprom_main_board_module_g[rec->slot];
+    }
+    else
+    {
+      MWARN("Bad eeprom cache record %d", ii);
+      rc = FALSE;
+      goto EXIT_LABEL;
+    }
+    otb_eeprom_process_main_comp(rec->type, comp);
+
+    pos += sizeof(*rec) + OTB_EEPROM_CACHE_PAD(comp->length);
+  }
+
+  if ((otb_eeprom_info_g == NULL) || (otb_eeprom_main_board_g == NULL))
+  {
+    MWARN("Eeprom cache incomplete");
+    rc = FALSE;
+    goto EXIT_LABEL;
+  }
+
+  MDETAIL("Loaded %d components from eeprom cache", cache->rec_num);
+  otb_eeprom_heap_used += cache->length;
+  rc = TRUE;
+
+EXIT_LABEL:
+
+  if (!rc)
+  {
+    otb_eeprom_cache_clear();
+    if (cache != NULL)
+    {
+      os_free(cache);
+    }
+  }
+
+  EXIT;
+
+  return rc;
+}
+
+//
+// Appends a record to the cache at buf (if not NULL), returning its length
+//
+uint32_t ICACHE_FLASH_ATTR otb_eeprom_cache_add(uint8_t *buf,
+                                                uint32_t type,
+                                                uint8_t slot,
+                                                uint8_t num,
+                                                void *comp)
+{
+  otb_eeprom_cache_rec *rec;
+  uint32_t len;
+
+  ENTRY;
+
+  len = ((otb_eeprom_hdr *)comp)->length;
+  if (buf != NULL)
+  {
+    rec = (otb_eeprom_cache_rec *)buf;
+    rec->type = type;
+    rec->slot = slot;
+    rec->num = num;
+    os_memcpy(rec->comp, comp, len);
+  }
+  len = sizeof(*rec) + OTB_EEPROM_CACHE_PAD(len);
+
+  EXIT;
+
+  return len;
+}
+
+//
+// otb_eeprom_cache_save
+//
+// Writes what's just been read from the eeproms to the flash cache.  Only
+// called when the cache was missing or out of date.
+//
+void ICACHE_FLASH_ATTR otb_eeprom_cache_save(brzo_i2c_info *i2c_info)
+{
+  otb_eeprom_cache_hdr *cache = NULL;
+  otb_eeprom_cache_hdr old;
+  otb_eeprom_main_module_info *mod_info;
+  uint8_t *buf;
+  uint32_t pos;
+  int pass;
+  int ii, jj;
+  bool rc;
+
+  ENTRY;
+
+  if ((otb_eeprom_info_g == NULL) || (otb_eeprom_main_board_g == NULL))
+  {
+    MDETAIL("Nothing to cache");
+    goto EXIT_LABEL;
+  }
+
+  // First pass sizes the cache, the second fills it in
+  for (pass = 0; pass < 2; pass++)
+  {
+    buf = (cache != NULL) ? (uint8_t *)cache : NULL;
+    pos = sizeof(otb_eeprom_cache_hdr);
+    ii = 0;
+    pos += otb_eeprom_cache_add(buf ? buf + pos : NULL, OTB_EEPROM_INFO_TYPE_INFO, OTB_EEPROM_CACHE_SLOT_MAIN, 0, otb_eeprom_info_g);
+    ii++;
+    pos += otb_eeprom_cache_add(buf ? buf + pos : NULL, OTB_EEPROM_INFO_TYPE_MAIN_BOARD, OTB_EEPROM_CACHE_SLOT_MAIN, 0, otb_eeprom_main_board_g);
+    ii++;
+    for (jj = 0; jj < OTB_EEPROM_MAX_MODULES; jj++)
+    {
+      if (otb_eeprom_main_board_module_g[jj] != NULL)
+      {
+        pos += otb_eeprom_cache_add(buf ? buf + pos : NULL, OTB_EEPROM_INFO_TYPE_MAIN_BOARD_MODULE, OTB_EEPROM_CACHE_SLOT_MAIN, jj, otb_eeprom_main_board_module_g[jj]);
+        ii++;
+      }
+      mod_info = otb_eeprom_main_module_info_g + jj;
+      if ((mod_info->eeprom_info != NULL) && (mod_info->module != NULL))
+      {
+        pos += otb_eeprom_cache_add(buf ? buf + pos : NULL, OTB_EEPROM_INFO_TYPE_INFO, jj, 0, mod_info->eeprom_info);
+        pos += otb_eeprom_cache_add(buf ? buf + pos : NULL, OTB_EEPROM_INFO_TYPE_MAIN_MODULE, jj, 0, mod_info->module);
+        ii += 2;
+      }
+    }
+
+    if (cache == NULL)
+    {
+      if (pos > OTB_BOOT_EEPROM_CACHE_LEN)
+      {
+        MWARN("Eeprom contents too large to cache %d", pos);
+        goto EXIT_LABEL;
+      }
+      cache = (otb_eeprom_cache_hdr *)os_zalloc(pos);
+      if (cache == NULL)
+      {
+        MWARN("Failed to allocate memory for eeprom cache %d", pos);
+        goto EXIT_LABEL;
+      }
+    }
+  }
+
+  cache->magic = OTB_EEPROM_CACHE_MAGIC;
+  cache->version = OTB_EEPROM_CACHE_VERSION;
+  cache->length = pos;
+  cache->rec_num = ii;
+
+  // Key on the main board eeprom, and every (non RPi Hat) module's eeprom
+  // whether it could be read or not - so one being plugged in is spotted.
+  // Modules' keys are read afresh, exactly as the next boot will.
+  otb_eeprom_cache_key_set(otb_eeprom_main_board_addr, otb_eeprom_info_g, cache->key);
+  cache->key_num = 1;
+  for (ii = 0; ii < OTB_EEPROM_MAX_MODULES; ii++)
+  {
+    if ((otb_eeprom_main_board_module_g[ii] != NULL) &&
+        (otb_eeprom_main_board_module_g[ii]->socket_type != OTB_EEPROM_MODULE_TYPE_RPI_HAT_ESPI))
+    {
+      otb_eeprom_cache_key_read(otb_eeprom_main_board_module_g[ii]->address,
+                                i2c_info,
+                                cache->key + cache->key_num);
+      cache->key_num++;
+    }
+  }
+
+  cache->checksum = otb_eeprom_calc_checksum((char *)cache,
+                                             cache->length,
+                                             (char *)&(cache->checksum) - (char *)cache,
+                                             sizeof(cache->checksum));
+
+  // Don't wear the flash rewriting an identical cache
+  rc = otb_util_flash_read(OTB_BOOT_EEPROM_CACHE_LOCATION,
+                           (uint32 *)&old,
+                           sizeof(old));
+  if (rc && !os_memcmp(&old, cache, sizeof(old)))
+  {
+    MDETAIL("Eeprom cache unchanged");
+    goto EXIT_LABEL;
+  }
+
+  spi_flash_erase_sector(OTB_BOOT_EEPROM_CACHE_LOCATION / 0x1000);
+  rc = otb_util_flash_write(OTB_BOOT_EEPROM_CACHE_LOCATION, (uint32 *)cache, cache->length);
+  if (!rc)
+  {
+    MWARN("Failed to write eeprom cache");
+    goto EXIT_LABEL;
+  }
+
+  MDETAIL("Cached %d components from %d eeprom(s)", cache->rec_num, cache->key_num);
+
+EXIT_LABEL:
+
+  if (cache != NULL)
+  {
+    os_free(cache);
+  }
+
+  EXIT;
+
+  return;
+}
+
+//
+// otb_eeprom_lazy_locate
+//
+// Finds whether, and where, the lazily loaded components are on the main board
+// eeprom - without reading them.
+//
+void ICACHE_FLASH_ATTR otb_eeprom_lazy_locate(void)
+{
+  otb_eeprom_lazy_comp *lazy;
+  bool found;
+  int ii;
+
+  ENTRY;
+
+  for (ii = 0; ii < OTB_EEPROM_LAZY_COMPS; ii++)
+  {
+    lazy = otb_eeprom_lazy_comps + ii;
+    lazy->state = OTB_EEPROM_LAZY_STATE_ABSENT;
+    lazy->loc = 0;
+    lazy->length = 0;
+    if (otb_eeprom_info_g == NULL)
+    {
+      continue;
+    }
+    found = otb_eeprom_find_main_comp(otb_eeprom_info_g,
+                                      lazy->type,
+                                      0,
+                                      &lazy->loc,
+                                      &lazy->length);
+    if (found)
+    {
+      MDETAIL("Located %s at 0x%x length %d",
+              otb_eeprom_main_comp_types[lazy->type].name,
+              lazy->loc,
+              lazy->length);
+      lazy->state = OTB_EEPROM_LAZY_STATE_LOCATED;
+    }
+  }
+
+  EXIT;
+
+  return;
+}
+
+//
+// otb_eeprom_get_main_comp
+//
+// Returns a main board component - reading and validating it first if it's a
+// lazily loaded one that hasn't been asked for before.  NULL if the eeprom
+// doesn't have it, or it couldn't be read (which isn't retried).
+//
+void *ICACHE_FLASH_ATTR otb_eeprom_get_main_comp(uint32_t type)
+{
+  void **global;
+  otb_eeprom_lazy_comp *lazy = NULL;
+  int ii;
+
+  ENTRY;
+
+  OTB_ASSERT(type < OTB_EEPROM_INFO_TYPE_NUM);
+  global = otb_eeprom_main_comp_types[type].global;
+  OTB_ASSERT(global != NULL);
+
+  if (*global != NULL)
+  {
+    goto EXIT_LABEL;
+  }
+
+  for (ii = 0; ii < OTB_EEPROM_LAZY_COMPS; ii++)
+  {
+    if (otb_eeprom_lazy_comps[ii].type == type)
+    {
+      lazy = otb_eeprom_lazy_comps + ii;
+      break;
+    }
+  }
+  if ((lazy == NULL) || (lazy->state != OTB_EEPROM_LAZY_STATE_LOCATED))
+  {
+    goto EXIT_LABEL;
+  }
+
+  MDETAIL("Read %s on first use", otb_eeprom_main_comp_types[type].name);
+  *global = otb_eeprom_load_main_comp(otb_eeprom_main_board_addr,
+                                      &otb_i2c_bus_internal,
+                                      otb_eeprom_info_g,
+                                      type,
+                                      0,
+                                      NULL,
+                                      0);
+  if (*global != NULL)
+  {
+    lazy->state = OTB_EEPROM_LAZY_STATE_LOADED;
+  }
+  else
+  {
+    MWARN("Failed to read %s", otb_eeprom_main_comp_types[type].name);
+    lazy->state = OTB_EEPROM_LAZY_STATE_FAILED;
+  }
+  MDETAIL("Eeprom components using %d bytes of heap, %d bytes not loaded yet",
+          otb_eeprom_heap_used,
+          otb_eeprom_heap_deferred());
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return *global;
+}
+
+// Heap saved so far by not reading the lazily loaded components
+uint32_t ICACHE_FLASH_ATTR otb_eeprom_heap_deferred(void)
+{
+  uint32_t deferred = 0;
+  int ii;
+
+  ENTRY;
+
+  for (ii = 0; ii < OTB_EEPROM_LAZY_COMPS; ii++)
+  {
+    if (otb_eeprom_lazy_comps[ii].state == OTB_EEPROM_LAZY_STATE_LOCATED)
+    {
+      deferred += otb_eeprom_lazy_comps[ii].length;
+    }
+  }
+
+  EXIT;
+
+  return deferred;
+}
+
+bool ICACHE_FLASH_ATTR otb_eeprom_heap_get(unsigned char *next_cmd, void *arg, unsigned char *prev_cmd)
+{
+  bool rc = FALSE;
+
+  ENTRY;
+
+  otb_cmd_rsp_append("used:%u deferred:%u",
+                     (unsigned int)otb_eeprom_heap_used,
+                     (unsigned int)otb_eeprom_heap_deferred());
+  rc = TRUE;
+
+  EXIT;
+
+  return rc;
+}
+
+#endif // OTB_RBOOT_BOOTLOADER
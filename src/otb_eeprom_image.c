@@ -0,0 +1,353 @@
+/*
+ * OTB-IOT - Out of The Box Internet Of Things
+ *
+ * Copyright (C) 2020 Piers Finlayson
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Eeprom image encoding and decoding - see otb_eeprom_image.h.  Built into the
+// firmware, the bootloader and hwinfo, so there's no logging (or ENTRY/EXIT)
+// here - callers log the errors returned.
+
+#ifdef OTB_HWINFO
+#include "otb_hwinfo_types.h"
+#include "otb_eeprom.h"
+#include "otb_eeprom_image.h"
+#else // OTB_HWINFO
+#include "otb.h"
+#endif // OTB_HWINFO
+
+#if defined(OTB_RBOOT_BOOTLOADER) || defined(OTB_HWINFO)
+#undef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+uint32_t ICACHE_FLASH_ATTR otb_eeprom_image_get32(const uint8_t *data)
+{
+  return ((uint32_t)data[0]) |
+         ((uint32_t)data[1] << 8) |
+         ((uint32_t)data[2] << 16) |
+         ((uint32_t)data[3] << 24);
+}
+
+void ICACHE_FLASH_ATTR otb_eeprom_image_put32(uint8_t *data, uint32_t val)
+{
+  data[0] = val & 0xff;
+  data[1] = (val >> 8) & 0xff;
+  data[2] = (val >> 16) & 0xff;
+  data[3] = (val >> 24) & 0xff;
+
+  return;
+}
+
+//
+// Each byte is added in, shifted by 8 times its offset mod 4, skipping the 4
+// byte checksum itself.  Bytes are unsigned - as the ESP8266 treats char.
+//
+uint32_t ICACHE_FLASH_ATTR otb_eeprom_image_checksum(const uint8_t *data,
+                                                     uint32_t len,
+                                                     uint32_t checksum_loc)
+{
+  uint32_t checksum = OTB_EEPROM_CHECKSUM_INITIAL;
+  uint32_t ii;
+
+  for (ii = 0; ii < len; ii++)
+  {
+    if ((ii < checksum_loc) || (ii >= (checksum_loc + 4)))
+    {
+      checksum += (uint32_t)data[ii] << ((ii % 4) * 8);
+    }
+  }
+
+  // uint32_t may be wider than 32 bits on a host (as in the esput tests)
+  return checksum & 0xffffffff;
+}
+
+//
+// Fills in a component's header, other than the checksum - which must be done
+// (with otb_eeprom_image_seal) once the rest of the component is.
+//
+void ICACHE_FLASH_ATTR otb_eeprom_image_hdr_set(uint8_t *comp,
+                                                uint32_t type,
+                                                const otb_eeprom_main_comp_type *type_info,
+                                                uint32_t length)
+{
+  otb_eeprom_image_put32(comp + OTB_EEPROM_IMAGE_HDR_MAGIC, type_info->magic);
+  otb_eeprom_image_put32(comp + OTB_EEPROM_IMAGE_HDR_TYPE, type);
+  otb_eeprom_image_put32(comp + OTB_EEPROM_IMAGE_HDR_STRUCT_SIZE, type_info->struct_size_max);
+  otb_eeprom_image_put32(comp + OTB_EEPROM_IMAGE_HDR_VERSION, type_info->version_max);
+  otb_eeprom_image_put32(comp + OTB_EEPROM_IMAGE_HDR_LENGTH, length);
+
+  return;
+}
+
+// Stores the checksum of the component, whose length is taken from its header
+void ICACHE_FLASH_ATTR otb_eeprom_image_seal(uint8_t *comp)
+{
+  uint32_t checksum;
+
+  checksum = otb_eeprom_image_checksum(comp,
+                                       otb_eeprom_image_get32(comp + OTB_EEPROM_IMAGE_HDR_LENGTH),
+                                       OTB_EEPROM_IMAGE_HDR_CHECKSUM);
+  otb_eeprom_image_put32(comp + OTB_EEPROM_IMAGE_HDR_CHECKSUM, checksum);
+
+  return;
+}
+
+// The caller must have checked the header's length is within the buffer
+bool ICACHE_FLASH_ATTR otb_eeprom_image_checksum_ok(const uint8_t *comp)
+{
+  uint32_t checksum;
+
+  checksum = otb_eeprom_image_checksum(comp,
+                                       otb_eeprom_image_get32(comp + OTB_EEPROM_IMAGE_HDR_LENGTH),
+                                       OTB_EEPROM_IMAGE_HDR_CHECKSUM);
+
+  return (checksum == otb_eeprom_image_get32(comp + OTB_EEPROM_IMAGE_HDR_CHECKSUM));
+}
+
+//
+// Checks a component's header (but not its checksum) is what's expected for
+// the type, and that the component fits within buf_len.  comp must have at
+// least OTB_EEPROM_IMAGE_HDR_LEN bytes.
+//
+uint32_t ICACHE_FLASH_ATTR otb_eeprom_image_hdr_check(const uint8_t *comp,
+                                                      uint32_t type,
+                                                      const otb_eeprom_main_comp_type *type_info,
+                                                      uint32_t buf_len)
+{
+  uint32_t rc = OTB_EEPROM_ERR_OK;
+  uint32_t version;
+  uint32_t struct_size;
+  uint32_t length;
+
+  if (otb_eeprom_image_get32(comp + OTB_EEPROM_IMAGE_HDR_MAGIC) != type_info->magic)
+  {
+    rc |= OTB_EEPROM_ERR_MAGIC;
+  }
+
+  if (otb_eeprom_image_get32(comp + OTB_EEPROM_IMAGE_HDR_TYPE) != type)
+  {
+    rc |= OTB_EEPROM_ERR_TYPE;
+  }
+
+  version = otb_eeprom_image_get32(comp + OTB_EEPROM_IMAGE_HDR_VERSION);
+  if ((version < type_info->version_min) || (version > type_info->version_max))
+  {
+    rc |= OTB_EEPROM_ERR_VERSION;
+  }
+
+  struct_size = otb_eeprom_image_get32(comp + OTB_EEPROM_IMAGE_HDR_STRUCT_SIZE);
+  if ((struct_size < type_info->struct_size_min) ||
+      (struct_size > type_info->struct_size_max))
+  {
+    rc |= OTB_EEPROM_ERR_STRUCT_SIZE;
+  }
+
+  // The component can be longer than the struct (e.g. pin info follows it) but
+  // not shorter
+  length = otb_eeprom_image_get32(comp + OTB_EEPROM_IMAGE_HDR_LENGTH);
+  if ((length < OTB_EEPROM_IMAGE_HDR_LEN) || (length < struct_size))
+  {
+    rc |= OTB_EEPROM_ERR_LENGTH;
+  }
+  if (length > buf_len)
+  {
+    rc |= OTB_EEPROM_ERR_BUF_LEN_COMP;
+  }
+
+  return rc;
+}
+
+//
+// Checks a whole image: the otb_eeprom_info at the start, and then each
+// component it lists - which must lie within the image, have a valid header
+// matching the listed type and length, and a valid checksum.  Stops at the
+// first bad component.
+//
+uint32_t ICACHE_FLASH_ATTR otb_eeprom_image_verify(const uint8_t *image,
+                                                   uint32_t len,
+                                                   const otb_eeprom_main_comp_type *types,
+                                                   uint32_t types_num)
+{
+  uint32_t rc = OTB_EEPROM_ERR_OK;
+  uint32_t comp_num;
+  uint32_t info_len;
+  const uint8_t *entry;
+  uint32_t type;
+  uint32_t loc;
+  uint32_t length;
+  uint32_t ii;
+
+  if ((types_num <= OTB_EEPROM_INFO_TYPE_INFO) ||
+      (len < OTB_EEPROM_IMAGE_INFO_COMP))
+  {
+    rc = OTB_EEPROM_ERR_LENGTH;
+    goto EXIT_LABEL;
+  }
+
+  rc = otb_eeprom_image_hdr_check(image,
+                                  OTB_EEPROM_INFO_TYPE_INFO,
+                                  types + OTB_EEPROM_INFO_TYPE_INFO,
+                                  len);
+  if (rc != OTB_EEPROM_ERR_OK)
+  {
+    goto EXIT_LABEL;
+  }
+
+  // The component list must fit within otb_eeprom_info's length
+  comp_num = otb_eeprom_image_get32(image + OTB_EEPROM_IMAGE_INFO_COMP_NUM);
+  info_len = otb_eeprom_image_get32(image + OTB_EEPROM_IMAGE_HDR_LENGTH);
+  if ((comp_num > OTB_EEPROM_INFO_MAX_COMP) ||
+      (info_len < (OTB_EEPROM_IMAGE_INFO_COMP + (comp_num * OTB_EEPROM_IMAGE_INFO_COMP_LEN))))
+  {
+    rc = OTB_EEPROM_ERR_LENGTH;
+    goto EXIT_LABEL;
+  }
+
+  if (!otb_eeprom_image_checksum_ok(image))
+  {
+    rc = OTB_EEPROM_ERR_CHECKSUM;
+    goto EXIT_LABEL;
+  }
+
+  for (ii = 0; ii < comp_num; ii++)
+  {
+    entry = image + OTB_EEPROM_IMAGE_INFO_COMP + (ii * OTB_EEPROM_IMAGE_INFO_COMP_LEN);
+    type = otb_eeprom_image_get32(entry + OTB_EEPROM_IMAGE_COMP_TYPE);
+    loc = otb_eeprom_image_get32(entry + OTB_EEPROM_IMAGE_COMP_LOCATION);
+    length = otb_eeprom_image_get32(entry + OTB_EEPROM_IMAGE_COMP_LENGTH);
+
+    if ((type >= types_num) || (type == OTB_EEPROM_INFO_TYPE_INFO))
+    {
+      rc = OTB_EEPROM_ERR_TYPE;
+      goto EXIT_LABEL;
+    }
+
+    // Written to avoid overflow
+    if ((loc > len) ||
+        (length > (len - loc)) ||
+        (length < OTB_EEPROM_IMAGE_HDR_LEN))
+    {
+      rc = OTB_EEPROM_ERR_LENGTH;
+      goto EXIT_LABEL;
+    }
+
+    rc = otb_eeprom_image_hdr_check(image + loc, type, types + type, length);
+    if ((rc == OTB_EEPROM_ERR_OK) &&
+        (otb_eeprom_image_get32(image + loc + OTB_EEPROM_IMAGE_HDR_LENGTH) != length))
+    {
+      rc = OTB_EEPROM_ERR_LENGTH;
+    }
+    if (rc != OTB_EEPROM_ERR_OK)
+    {
+      goto EXIT_LABEL;
+    }
+
+    if (!otb_eeprom_image_checksum_ok(image + loc))
+    {
+      rc = OTB_EEPROM_ERR_CHECKSUM;
+      goto EXIT_LABEL;
+    }
+  }
+
+EXIT_LABEL:
+
+  return rc;
+}
+
+//
+// Finds the num'th (from 0) component of type in an image which has passed
+// otb_eeprom_image_verify
+//
+bool ICACHE_FLASH_ATTR otb_eeprom_image_find(const uint8_t *image,
+                                             uint32_t type,
+                                             uint32_t num,
+                                             uint32_t *loc,
+                                             uint32_t *length)
+{
+  bool found = FALSE;
+  uint32_t comp_num;
+  const uint8_t *entry;
+  uint32_t ii;
+
+  comp_num = otb_eeprom_image_get32(image + OTB_EEPROM_IMAGE_INFO_COMP_NUM);
+  for (ii = 0; ii < comp_num; ii++)
+  {
+    entry = image + OTB_EEPROM_IMAGE_INFO_COMP + (ii * OTB_EEPROM_IMAGE_INFO_COMP_LEN);
+    if (otb_eeprom_image_get32(entry + OTB_EEPROM_IMAGE_COMP_TYPE) != type)
+    {
+      continue;
+    }
+    if (num > 0)
+    {
+      num--;
+      continue;
+    }
+    *loc = otb_eeprom_image_get32(entry + OTB_EEPROM_IMAGE_COMP_LOCATION);
+    *length = otb_eeprom_image_get32(entry + OTB_EEPROM_IMAGE_COMP_LENGTH);
+    found = TRUE;
+    break;
+  }
+
+  return found;
+}
+
+#if !defined(OTB_RBOOT_BOOTLOADER) && !defined(OTB_HWINFO)
+//
+// Works out how to initialise a mezzanine module of module_type, whose first
+// two GPIOs are packed into gpios (second << 8 | first).  Returns one of
+// OTB_EEPROM_IMAGE_MEZZ_INIT_..., and sets *param to what to pass to the init
+// function.  Only a temperature board gets its GPIOs - for anything else NONE
+// means just the default 1-Wire bus is started, so *param is NULL.
+//
+uint32_t ICACHE_FLASH_ATTR otb_eeprom_image_mezz_init(uint32_t module_type,
+                                                      uint32_t gpios,
+                                                      void **param)
+{
+  uint32_t init;
+
+  *param = NULL;
+  switch (module_type)
+  {
+    case OTB_EEPROM_MODULE_TYPE_TEMP_V0_2:
+      init = OTB_EEPROM_IMAGE_MEZZ_INIT_DS18B20;
+      *param = (void *)(long)gpios;
+      break;
+
+    case OTB_EEPROM_MODULE_TYPE_ADC_V0_1:
+      init = OTB_EEPROM_IMAGE_MEZZ_INIT_ADS;
+      break;
+
+    case OTB_EEPROM_MODULE_TYPE_RELAY_V0_2:
+      init = OTB_EEPROM_IMAGE_MEZZ_INIT_RELAY;
+      break;
+
+    case OTB_EEPROM_MODULE_TYPE_MBUS_V0_1:
+      init = OTB_EEPROM_IMAGE_MEZZ_INIT_MBUS;
+      *param = (void *)(long)module_type;
+      break;
+
+    case OTB_EEPROM_MODULE_TYPE_LL_V0_1:
+    case OTB_EEPROM_MODULE_TYPE_NIXIE_V0_2:
+    default:
+      init = OTB_EEPROM_IMAGE_MEZZ_INIT_NONE;
+      break;
+  }
+
+  return init;
+}
+
+#endif // !OTB_RBOOT_BOOTLOADER && !OTB_HWINFO
@@ -50,13 +50,16 @@ EXIT_LABEL:
 const otb_eeprom_pin_info ICACHE_FLASH_ATTR *otb_gpio_get_pin_info(uint32_t pin_num)
 {
   const otb_eeprom_pin_info *pin_info = NULL;
+  otb_eeprom_main_board_gpio_pins *gpio_pins;
 
   MDEBUG("otb_gpio_get_pin_info entry")
 
-  if (otb_eeprom_main_board_gpio_pins_g != NULL)
+  // Read from the eeprom the first time it's needed
+  gpio_pins = otb_eeprom_get_main_comp(OTB_EEPROM_INFO_TYPE_GPIO_PINS);
+  if (gpio_pins != NULL)
   {
-    MDEBUG("Search in eeprom: %d %p", otb_eeprom_main_board_gpio_pins_g->num_pins, otb_eeprom_main_board_gpio_pins_g->pin_info);
-    pin_info = otb_gpio_get_pin_info_det(pin_num, otb_eeprom_main_board_gpio_pins_g->num_pins, otb_eeprom_main_board_gpio_pins_g->pin_info);
+    MDEBUG("Search in eeprom: %d %p", gpio_pins->num_pins, gpio_pins->pin_info);
+    pin_info = otb_gpio_get_pin_info_det(pin_num, gpio_pins->num_pins, gpio_pins->pin_info);
   }
 
   if (pin_info == NULL)
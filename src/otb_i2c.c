@@ -72,6 +72,7 @@ void ICACHE_FLASH_ATTR otb_i2c_initialize_bus(brzo_i2c_info *info,
   
   OTB_ASSERT(info != NULL);
 
+  otb_i2c_shadow_reset_bus(info);
   os_memset(info, 0, sizeof(*info));
 
   info->sda_pin = sda_pin;
@@ -102,16 +103,33 @@ void ICACHE_FLASH_ATTR otb_i2c_ads_disable_all_timers(void)
   
   ENTRY;
   
-  os_timer_disarm((os_timer_t*)&otb_ads_timer);
+  // End any capture first, as it may have taken over an ADS's ALERT/RDY pin
+  if (otb_i2c_ads_capture_buf.ads != NULL)
+  {
+    otb_i2c_ads_capture_finish(&otb_i2c_ads_capture_buf);
+  }
+
+  os_timer_disarm((os_timer_t*)&(otb_i2c_ads_bus_sampler.timer));
+  otb_i2c_ads_bus_sampler.num_active = 0;
   for (ii = 0; ii < OTB_CONF_ADS_MAX_ADSS; ii++)
   {
+    os_timer_disarm((os_timer_t*)&(otb_ads_timer[ii]));
+    samples = otb_i2c_ads_samples_array[ii];
     if (samples != NULL)
     {
       os_timer_disarm((os_timer_t*)&(samples->timer));
+
+      // Only unregister ALERT/RDY if this ADS's sample period registered it
+      if ((samples->ads != NULL) &&
+          samples->ads->rdy &&
+          (otb_intr_reg_info[samples->ads->rdy].arg == samples))
+      {
+        otb_intr_unreg(samples->ads->rdy);
+      }
+      samples->rdy_pending = FALSE;
     }
   }
   
-  
   EXIT;
 }
 
@@ -133,7 +151,8 @@ void ICACHE_FLASH_ATTR otb_ads_build_msb_lsb_conf(otb_conf_ads *ads, uint8 *msb,
   // Bit 3         0 = Comparator active low
   // Bit 2         0 = Non latching comparator
   // Bits 1:0     11 = Disable comparator
-  *lsb = (ads->rate << 5) | (0b00000) | (0b0000) | (0b000) | (0b11);
+  //              00 = Assert after one conversion (ALERT/RDY as conversion ready)
+  *lsb = (ads->rate << 5) | (0b00000) | (0b0000) | (0b000) | (ads->rdy ? 0b00 : 0b11);
   
   MDEBUG("msb 0x%02x lsb 0x%02x", *msb, *lsb);
 
@@ -147,12 +166,35 @@ bool ICACHE_FLASH_ATTR otb_ads_configure(otb_conf_ads *ads)
   bool rc;
   uint8 msb;
   uint8 lsb;
+  uint8_t lo[2] = {0x00, 0x00};
+  uint8_t hi[2] = {0x80, 0x00};
 
   ENTRY;
   
+  if (ads->rdy)
+  {
+    // ALERT/RDY signals conversion ready if the MSB of the hi threshold is 1
+    // and of the lo threshold is 0
+    rc = otb_i2c_write_reg_seq(ads->addr, OTB_I2C_ADS_REG_LO, 2, lo) &&
+         otb_i2c_write_reg_seq(ads->addr, OTB_I2C_ADS_REG_HI, 2, hi);
+    if (!rc)
+    {
+      MERROR("Failed to set ADS 0x%02x thresholds", ads->addr);
+      goto EXIT_LABEL;
+    }
+  }
+
   otb_ads_build_msb_lsb_conf(ads, &msb, &lsb);
   rc = otb_i2c_ads_set_cont_mode(ads->addr, msb, lsb);
 
+  if (rc)
+  {
+    // Leave the pointer on the conversion register, ready to read samples
+    rc = otb_i2c_ads_set_read_mode(ads->addr, OTB_I2C_ADS_REG_CONV);
+  }
+
+EXIT_LABEL:
+
   EXIT;
   
   return rc;
@@ -163,17 +205,68 @@ void ICACHE_FLASH_ATTR otb_i2c_ads_init_samples(otb_conf_ads *ads, otb_i2c_ads_s
 
   ENTRY;
   
-  OTB_ASSERT(sizeof(otb_i2c_ads_rms_samples) == sizeof(otb_i2c_ads_nonrms_samples));
-
-  // Structure of nonrms samples is the same
   os_memset(samples, 0, sizeof(otb_i2c_ads_samples));
   samples->ads = ads;
+  otb_i2c_ads_accum_init(&(samples->accum));
+  otb_i2c_ads_harmonics_init(samples);
   
   EXIT;
 
   return;
 }
 
+// (Re)starts harmonic analysis, if configured, for the current sample rate.
+// Called again if the bus sampler's tick changes, as the coefficients are only
+// right for one rate - the analysis then covers the samples from then on.
+void ICACHE_FLASH_ATTR otb_i2c_ads_harmonics_init(otb_i2c_ads_samples *samples)
+{
+  otb_conf_ads_cal *cal;
+
+  ENTRY;
+
+  cal = otb_conf->ads_cal + samples->ads->index;
+  if (cal->harmonics)
+  {
+    otb_power_goertzel_init(&(samples->goertzel),
+                            cal->harmonics,
+                            cal->mains_hz ? cal->mains_hz : OTB_CONF_ADS_CAL_MAINS_HZ_DEFAULT,
+                            otb_i2c_ads_sample_mhz(samples->ads));
+  }
+
+  EXIT;
+
+  return;
+}
+
+// Rate at which samples are taken during a sample period, in mHz.  When
+// polling it's the bus sampler's current rate, otherwise the ADS's own.
+uint32_t ICACHE_FLASH_ATTR otb_i2c_ads_sample_mhz(otb_conf_ads *ads)
+{
+  uint32_t mhz;
+  uint32_t tick_us;
+  static const uint16_t sps[8] = {8, 16, 32, 64, 128, 250, 475, 860};
+
+  ENTRY;
+
+  if (ads->rdy)
+  {
+    mhz = sps[ads->rate & 0b111] * 1000;
+  }
+  else
+  {
+    tick_us = otb_i2c_ads_bus_sampler.tick_us;
+    if (tick_us < OTB_I2C_ADS_SAMPLER_MIN_US)
+    {
+      tick_us = OTB_I2C_ADS_SAMPLER_MIN_US;
+    }
+    mhz = 1000000000 / tick_us;
+  }
+
+  EXIT;
+
+  return mhz;
+}
+
 void ICACHE_FLASH_ATTR otb_i2c_ads_on_timer(void *arg)
 {
   otb_i2c_ads_samples *samples;
@@ -182,25 +275,124 @@ void ICACHE_FLASH_ATTR otb_i2c_ads_on_timer(void *arg)
   
   OTB_ASSERT(arg != NULL);
   samples = (otb_i2c_ads_samples *)arg;
+  if (otb_i2c_ads_capturing(samples->ads))
+  {
+    MDETAIL("ADS 0x%02x capturing - skip sample period", samples->ads->addr);
+    goto EXIT_LABEL;
+  }
   otb_i2c_ads_start_sample(samples);
+
+EXIT_LABEL:
   
   EXIT;
   
   return;
 }
 
-void ICACHE_FLASH_ATTR otb_i2c_ads_sample_timer(void *arg)
+// Adds an ADS to the bus sampler for the rest of its sample period, starting
+// the sampler if it isn't already running
+void ICACHE_FLASH_ATTR otb_i2c_ads_sampler_add(otb_i2c_ads_samples *samples)
+{
+  otb_i2c_ads_sampler *sampler;
+  int ii;
+
+  ENTRY;
+
+  sampler = &otb_i2c_ads_bus_sampler;
+  for (ii = 0; ii < sampler->num_active; ii++)
+  {
+    if (sampler->active[ii] == samples)
+    {
+      MWARN("ADS 0x%02x already being sampled", samples->ads->addr);
+      goto EXIT_LABEL;
+    }
+  }
+  OTB_ASSERT(sampler->num_active < OTB_CONF_ADS_MAX_ADSS);
+  sampler->active[sampler->num_active] = samples;
+  sampler->num_active++;
+
+  if (sampler->num_active == 1)
+  {
+    sampler->tick_us = OTB_I2C_ADS_SAMPLER_MIN_US;
+    os_timer_disarm((os_timer_t*)&(sampler->timer));
+    os_timer_setfn((os_timer_t*)&(sampler->timer), (os_timer_func_t *)otb_i2c_ads_sampler_timer, sampler);
+    os_timer_arm_us((os_timer_t*)&(sampler->timer), sampler->tick_us, 1);
+  }
+
+  // The tick may differ from when the samples were initialised
+  otb_i2c_ads_harmonics_init(samples);
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return;
+}
+
+// Reads one sample from each active ADS.  An ADS drops out when its sample
+// period is finished (or fails), and the sampler stops when none are left.
+void ICACHE_FLASH_ATTR otb_i2c_ads_sampler_timer(void *arg)
 {
+  otb_i2c_ads_sampler *sampler;
   otb_i2c_ads_samples *samples;
-  
+  uint32_t start;
+  uint32_t taken;
+  int ii;
+  int jj;
+  bool rc;
+
   ENTRY;
-  
+
   OTB_ASSERT(arg != NULL);
-  samples = (otb_i2c_ads_samples *)arg;
-  otb_i2c_ads_get_sample(samples);
-  
+  sampler = (otb_i2c_ads_sampler *)arg;
+  start = system_get_time();
+
+  for (ii = 0, jj = 0; ii < sampler->num_active; ii++)
+  {
+    samples = sampler->active[ii];
+    if (otb_i2c_ads_capturing(samples->ads))
+    {
+      MDETAIL("ADS 0x%02x capturing - abandon sample period", samples->ads->addr);
+      otb_i2c_ads_init_samples(samples->ads, samples);
+      continue;
+    }
+
+    // Handles errors, and finishing the sample period
+    rc = otb_i2c_ads_get_sample(samples);
+    if (rc && (samples->next_sample != 0))
+    {
+      // Keep, preserving order
+      sampler->active[jj] = samples;
+      jj++;
+    }
+  }
+  sampler->num_active = jj;
+
+  if (sampler->num_active == 0)
+  {
+    os_timer_disarm((os_timer_t*)&(sampler->timer));
+    goto EXIT_LABEL;
+  }
+
+  // If the bus can't keep up with the ADSs, slow down rather than queuing up
+  // timer callbacks
+  taken = system_get_time() - start;
+  if ((taken + OTB_I2C_ADS_SAMPLER_MARGIN_US) > sampler->tick_us)
+  {
+    sampler->tick_us = taken + OTB_I2C_ADS_SAMPLER_MARGIN_US;
+    MDETAIL("ADS sampler tick now %dus", sampler->tick_us);
+    os_timer_disarm((os_timer_t*)&(sampler->timer));
+    os_timer_arm_us((os_timer_t*)&(sampler->timer), sampler->tick_us, 1);
+    for (ii = 0; ii < sampler->num_active; ii++)
+    {
+      otb_i2c_ads_harmonics_init(sampler->active[ii]);
+    }
+  }
+
+EXIT_LABEL:
+
   EXIT;
-  
+
   return;
 }
 
@@ -211,271 +403,1035 @@ void ICACHE_FLASH_ATTR otb_i2c_ads_start_sample(otb_i2c_ads_samples *samples)
   ENTRY;
   
   os_timer_disarm((os_timer_t*)&(samples->timer));
-  os_timer_setfn((os_timer_t*)&(samples->timer), (os_timer_func_t *)otb_i2c_ads_sample_timer, samples);
 
   // Record start time
   samples->time = system_get_time();
+
+  if (samples->ads->rdy)
+  {
+    // Read each sample when the ADS says it's ready.  The timer is only used
+    // to defer the read out of the interrupt handler, or to give up if
+    // ALERT/RDY stops firing.
+    samples->rdy_pending = FALSE;
+    os_timer_setfn((os_timer_t*)&(samples->timer), (os_timer_func_t *)otb_i2c_ads_rdy_timer, samples);
+    os_timer_arm((os_timer_t*)&(samples->timer), OTB_I2C_ADS_RDY_TIMEOUT, 0);
+    if (!otb_intr_register_edge(otb_i2c_ads_rdy_interrupt,
+                                samples,
+                                samples->ads->rdy,
+                                OTB_INTR_EDGE_NEG))
+    {
+      MERROR("Failed to register ALERT/RDY for ADS 0x%02x", samples->ads->addr);
+      os_timer_disarm((os_timer_t*)&(samples->timer));
+    }
+    goto EXIT_LABEL;
+  }
   
-  // Get a sample (handles errors and if finished)
+  // Get a sample (handles errors and if finished), then leave the rest to the
+  // bus sampler, interleaved with any other ADSs being sampled
   rc = otb_i2c_ads_get_sample(samples);
 
-  if (rc)
+  if (rc && (samples->next_sample != 0))
   {  
-    // Run the timer at 860Hz (in fact just less) and repeat
-    // We start it here so we don't go for less than 1/860Hz between reads
-    os_timer_arm_us((os_timer_t*)&(samples->timer), (1000000/860)+1, 1);  
+    otb_i2c_ads_sampler_add(samples);
   }
 
+EXIT_LABEL:
+
   EXIT;
   
   return;
 }
 
-bool ICACHE_FLASH_ATTR otb_i2c_ads_read_rms_sample(otb_i2c_ads_samples *samples)
+// Called in interrupt context when ALERT/RDY goes low - schedule the read
+void ICACHE_FLASH_ATTR otb_i2c_ads_rdy_interrupt(void *arg)
+{
+  otb_i2c_ads_samples *samples;
+
+  ENTRY;
+
+  OTB_ASSERT(arg != NULL);
+  samples = (otb_i2c_ads_samples *)arg;
+  if (samples->rdy_pending)
+  {
+    // Previous conversion hasn't been read yet, and now it's been overwritten
+    samples->missed++;
+  }
+  else
+  {
+    samples->rdy_pending = TRUE;
+    os_timer_disarm((os_timer_t*)&(samples->timer));
+    os_timer_arm((os_timer_t*)&(samples->timer), 0, 0);
+  }
+
+  EXIT;
+
+  return;
+}
+
+void ICACHE_FLASH_ATTR otb_i2c_ads_rdy_timer(void *arg)
+{
+  otb_i2c_ads_samples *samples;
+  bool rc;
+
+  ENTRY;
+
+  OTB_ASSERT(arg != NULL);
+  samples = (otb_i2c_ads_samples *)arg;
+
+  if (otb_i2c_ads_capturing(samples->ads))
+  {
+    // A capture has taken over ALERT/RDY, so leave the interrupt alone
+    MDETAIL("ADS 0x%02x capturing - abandon sample period", samples->ads->addr);
+    otb_i2c_ads_init_samples(samples->ads, samples);
+    goto EXIT_LABEL;
+  }
+
+  if (!samples->rdy_pending)
+  {
+    MERROR("Timed out waiting for ALERT/RDY from ADS 0x%02x", samples->ads->addr);
+    otb_intr_unreg(samples->ads->rdy);
+    otb_i2c_ads_init_samples(samples->ads, samples);
+    goto EXIT_LABEL;
+  }
+
+  // Clear before reading, so a conversion completing during the read counts
+  // as the next sample rather than a missed one
+  samples->rdy_pending = FALSE;
+  rc = otb_i2c_ads_get_sample(samples);
+  if (rc && (samples->next_sample != 0))
+  {
+    // Still going - rearm the timeout, unless the next sample is already
+    // ready and the timer has been scheduled to read it
+    ETS_INTR_LOCK();
+    if (!samples->rdy_pending)
+    {
+      os_timer_arm((os_timer_t*)&(samples->timer), OTB_I2C_ADS_RDY_TIMEOUT, 0);
+    }
+    ETS_INTR_UNLOCK();
+  }
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return;
+}
+
+void ICACHE_FLASH_ATTR otb_i2c_ads_accum_init(otb_i2c_ads_accum *accum)
+{
+
+  ENTRY;
+
+  os_memset(accum, 0, sizeof(*accum));
+  accum->min = 0x7fff;
+  accum->max = -0x8000;
+
+  EXIT;
+
+  return;
+}
+
+void ICACHE_FLASH_ATTR otb_i2c_ads_accum_add(otb_i2c_ads_accum *accum, int16_t sample)
+{
+
+  ENTRY;
+
+  accum->sum += sample;
+  accum->sum_sq += (int32_t)sample * sample;
+  accum->count++;
+  if (sample < accum->min)
+  {
+    accum->min = sample;
+  }
+  if (sample > accum->max)
+  {
+    accum->max = sample;
+  }
+  accum->last = sample;
+
+  EXIT;
+
+  return;
+}
+
+int16_t ICACHE_FLASH_ATTR otb_i2c_ads_accum_mean(otb_i2c_ads_accum *accum)
+{
+  int16_t val = 0;
+
+  ENTRY;
+
+  if (accum->count > 0)
+  {
+    val = (int16_t)(accum->sum / (long long)accum->count);
+  }
+
+  EXIT;
+
+  return val;
+}
+
+// RMS with the mean (any DC offset) removed - sqrt(mean of squares - mean^2)
+uint16_t ICACHE_FLASH_ATTR otb_i2c_ads_accum_ac_rms(otb_i2c_ads_accum *accum)
+{
+  unsigned long long mean_sq;
+  long long mean;
+  uint32_t working;
+  uint16_t val = 0;
+
+  ENTRY;
+
+  if (accum->count > 0)
+  {
+    mean_sq = accum->sum_sq / accum->count;
+    mean = accum->sum / (long long)accum->count;
+    if ((unsigned long long)(mean * mean) < mean_sq)
+    {
+      // As for otb_i2c_ads_accum_rms this fits in 32 bits
+      working = mean_sq - (unsigned long long)(mean * mean);
+      working = isqrt(working);
+      OTB_ASSERT(working <= 0x8000);
+      val = (uint16_t)working;
+    }
+  }
+
+  EXIT;
+
+  return val;
+}
+
+uint16_t ICACHE_FLASH_ATTR otb_i2c_ads_accum_rms(otb_i2c_ads_accum *accum)
+{
+  uint32_t working;
+  uint16_t val = 0;
+
+  ENTRY;
+
+  if (accum->count > 0)
+  {
+    // Mean of squares of int16_ts always fits in 32 bits (max 0x40000000)
+    working = accum->sum_sq / accum->count;
+    working = isqrt(working);
+    OTB_ASSERT(working <= 0x8000);
+    val = (uint16_t)working;
+  }
+
+  EXIT;
+
+  return val;
+}
+
+bool ICACHE_FLASH_ATTR otb_i2c_ads_read_sample(otb_i2c_ads_samples *samples)
 {
   bool rc;
-  otb_i2c_ads_rms_samples *rms_samples;
+  int16_t sample;
   
   ENTRY;
   
-  rms_samples = (otb_i2c_ads_rms_samples *)samples;
-  rc = otb_i2c_ads_read(samples->ads->addr, &(rms_samples->samples[samples->next_sample]));
+  rc = otb_i2c_ads_read(samples->ads->addr, &sample);
+  if (!rc)
+  {
+    goto EXIT_LABEL;
+  }
+
+  if ((samples->accum.count > 0) && !samples->ads->rdy)
+  {
+    // Only useful when polling - when driven by ALERT/RDY missed samples are
+    // counted explicitly
+    // Also note will get lots of dupes for non AC current
+    if (sample == samples->accum.last)
+    {
+      samples->dupes++;
+    }
+  }
+
+  otb_i2c_ads_accum_add(&(samples->accum), sample);
+  if (samples->goertzel.num > 0)
+  {
+    otb_power_goertzel_add(&(samples->goertzel), sample);
+  }
   
+EXIT_LABEL:
+
   EXIT;
 
-  return rc;
-}
+  return rc;
+}
+
+bool ICACHE_FLASH_ATTR otb_i2c_ads_get_sample(otb_i2c_ads_samples *samples)
+{
+  bool rc = FALSE;
+  
+  ENTRY;
+
+  // Get a sample
+  rc = otb_i2c_ads_read_sample(samples);
+  if (!rc)
+  { 
+    goto EXIT_LABEL;
+  }
+
+  samples->next_sample++;
+
+EXIT_LABEL:
+
+  if (rc)
+  {
+    // See if finished
+    if ((samples->next_sample == 0) || (samples->next_sample >= samples->ads->samples))
+    {
+      os_timer_disarm((os_timer_t*)&(samples->timer));
+      if (samples->ads->rdy)
+      {
+        otb_intr_unreg(samples->ads->rdy);
+      }
+      samples->time = system_get_time() - samples->time;
+      otb_i2c_ads_finish_sample(samples);
+      // Reinitialise samples!    
+      otb_i2c_ads_init_samples(samples->ads, samples);
+    }
+  }
+  else
+  {
+    // Failed, give up this time around - will sent MQTT message if connected
+    MERROR("Failed to collect samples from ADS %d 0x%02x", samples->ads->index, samples->ads->addr);
+    os_timer_disarm((os_timer_t*)&(samples->timer));
+    if (samples->ads->rdy)
+    {
+      otb_intr_unreg(samples->ads->rdy);
+    }
+    // Reinitialise samples!    
+    otb_i2c_ads_init_samples(samples->ads, samples);
+  }
+
+  EXIT;
+
+  return rc;
+}
+
+void ICACHE_FLASH_ATTR otb_i2c_ads_finish_sample(otb_i2c_ads_samples *samples)  
+{
+#define OTB_I2C_ADS_ON_TIMER_MSG_LEN 64
+  char message[OTB_I2C_ADS_ON_TIMER_MSG_LEN];
+  char message_mains[OTB_I2C_ADS_ON_TIMER_MSG_LEN];
+  int chars=0;
+  int chars_mains=0;
+  int val;
+  otb_conf_ads *ads;
+  otb_power_cal *cal;
+  otb_power_reading reading;
+  uint32_t mains_hz;
+
+  ENTRY;
+  
+  ads = samples->ads;
+  if (!otb_i2c_ads_conf_indexed)
+  {
+    otb_i2c_ads_conf_index();
+  }
+  cal = &(otb_i2c_ads_meters[(int)ads->index].cal);
+  // Different messages if RMS or not (in latter case may be negative)
+  if (ads->rms)
+  {
+    val = otb_i2c_ads_accum_rms(&(samples->accum));
+    chars = os_snprintf(message, OTB_I2C_ADS_ON_TIMER_MSG_LEN, "0x%04x", val);
+  }
+  else
+  {
+    val = otb_i2c_ads_accum_mean(&(samples->accum));
+    chars = os_snprintf(message,
+                        OTB_I2C_ADS_ON_TIMER_MSG_LEN,
+                        "%s0x%04x",
+                        (val<0)?"-":"",
+                        (val<0)?-val:val);
+  }
+
+  // Calculate the voltage across, and current through, the sensor circuit,
+  // and the current through the transformer and power drawn, using this ADS's
+  // CT calibration
+  OTB_ASSERT(ads->gain < OTB_I2C_ADC_GAIN_VALUES);
+  // RMS can (just) exceed the largest positive reading
+  otb_power_convert(cal, (val > 0x7fff) ? 0x7fff : val, ads->gain, &reading);
+
+  chars += os_snprintf(message+chars, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars, ":");
+  chars += otb_power_milli_to_str(message+chars, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars, reading.sens_ua, 3);
+  chars += os_snprintf(message+chars, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars, "mA:");
+  chars += otb_power_milli_to_str(message+chars, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars, reading.uv, 2);
+  chars += os_snprintf(message+chars, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars, "mV");
+  chars += os_snprintf(message+chars, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars, ":%dus", samples->time); 
+  chars += os_snprintf(message+chars, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars, ":%d", samples->dupes); 
+  chars += os_snprintf(message+chars, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars, ":%d", samples->missed); 
+  
+  // Calculate voltage of mains supply
+  // No op at the moment XXX
+  
+  // Build up power output
+  chars_mains += os_snprintf(message_mains+chars_mains, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars_mains, "%dW:", reading.w);
+  chars_mains += otb_power_milli_to_str(message_mains+chars_mains, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars_mains, reading.primary_ma, 3);
+  chars_mains += os_snprintf(message_mains+chars_mains, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars_mains, "A:%d.%02dV", cal->mains_v, 0);
+
+  // ADS ADC measurements (reading, time taken, mV)
+  otb_mqtt_publish(&otb_mqtt_client,
+                   OTB_MQTT_ADC,
+                   ads->loc,
+                   message,
+                   "",
+                   0,
+                   0,
+                   NULL,
+                   0);
+
+  // If cumulative energy is being published that's all that's needed, so
+  // only publish power every period if it isn't
+  if (otb_conf->ads_cal[(int)ads->index].energy == OTB_CONF_ADS_CAL_ENERGY_OFF)
+  {
+    otb_mqtt_publish(&otb_mqtt_client,
+                     OTB_MQTT_POWER,
+                     ads->loc,
+                     message_mains,
+                     "",
+                     0,
+                     0,
+                     NULL,
+                     0);
+  }
+
+  // If the bus sampler's tick changed late in the period there may be too few
+  // samples since for the analysis to separate the harmonics
+  if (samples->goertzel.num > 0)
+  {
+    mains_hz = otb_conf->ads_cal[(int)ads->index].mains_hz;
+    mains_hz = mains_hz ? mains_hz : OTB_CONF_ADS_CAL_MAINS_HZ_DEFAULT;
+    if (((unsigned long long)samples->goertzel.count * mains_hz * 1000) >=
+        ((unsigned long long)OTB_I2C_ADS_HARMONICS_MIN_CYCLES * otb_i2c_ads_sample_mhz(ads)))
+    {
+      otb_i2c_ads_harmonics_publish(samples,
+                                    otb_i2c_ads_accum_ac_rms(&(samples->accum)),
+                                    cal);
+    }
+    else
+    {
+      MDETAIL("ADS 0x%02x too few samples for harmonics", ads->addr);
+    }
+  }
+
+  otb_i2c_ads_energy_update(samples, reading.w);
+
+  EXIT;
+  
+  return;
+}
+
+// Publishes the RMS current in each analysed harmonic, and if the fundamental
+// was analysed and this is an RMS reading, an approximate power factor.  This
+// is the distortion power factor - ratio of the fundamental to total RMS
+// current - as there's no voltage waveform to measure displacement against.
+// val is the AC RMS, so a DC offset doesn't count towards the total.
+void ICACHE_FLASH_ATTR otb_i2c_ads_harmonics_publish(otb_i2c_ads_samples *samples,
+                                                     int val,
+                                                     otb_power_cal *cal)
+{
+  char message[OTB_MQTT_MAX_MSG_LENGTH];
+  int chars = 0;
+  uint8_t ii;
+  uint32_t rms_q8;
+  uint32_t pf;
+  otb_power_goertzel *g;
+
+  ENTRY;
+
+  g = &(samples->goertzel);
+  message[0] = 0;
+  for (ii = 0; ii < g->num; ii++)
+  {
+    rms_q8 = otb_power_goertzel_rms(g, ii);
+    if ((g->harmonic[ii] == 1) && samples->ads->rms && (val > 0))
+    {
+      pf = ((unsigned long long)rms_q8 * 1000) / ((uint32_t)val << 8);
+      pf = (pf > 1000) ? 1000 : pf;
+      chars += os_snprintf(message+chars, OTB_MQTT_MAX_MSG_LENGTH-chars, "pf=");
+      chars += otb_power_milli_to_str(message+chars, OTB_MQTT_MAX_MSG_LENGTH-chars, pf, 3);
+      chars += os_snprintf(message+chars, OTB_MQTT_MAX_MSG_LENGTH-chars, ":");
+    }
+    chars += os_snprintf(message+chars, OTB_MQTT_MAX_MSG_LENGTH-chars, "h%d=", g->harmonic[ii]);
+    chars += otb_power_milli_to_str(message+chars,
+                                    OTB_MQTT_MAX_MSG_LENGTH-chars,
+                                    otb_power_counts_to_ma(cal, rms_q8, samples->ads->gain),
+                                    3);
+    chars += os_snprintf(message+chars,
+                         OTB_MQTT_MAX_MSG_LENGTH-chars,
+                         (ii < g->num - 1) ? "A:" : "A");
+  }
+
+  otb_mqtt_publish(&otb_mqtt_client,
+                   OTB_MQTT_HARMONICS,
+                   samples->ads->loc,
+                   message,
+                   "",
+                   0,
+                   0,
+                   NULL,
+                   0);
+
+  EXIT;
+
+  return;
+}
+
+// Integrates power over the time since the last sample period finished, and
+// publishes and checkpoints the totals when due.  The power measured in a
+// period is assumed to have been drawn since the previous one.
+void ICACHE_FLASH_ATTR otb_i2c_ads_energy_update(otb_i2c_ads_samples *samples, int32_t w)
+{
+  otb_conf_ads *ads;
+  otb_i2c_ads_meter *meter;
+  uint32_t now;
+  uint32_t ms;
+  uint32_t max_ms;
+  uint16_t energy;
+
+  ENTRY;
+
+  ads = samples->ads;
+  meter = otb_i2c_ads_meters + ads->index;
+  if (!otb_i2c_ads_checkpoint_loaded)
+  {
+    otb_i2c_ads_checkpoint_load();
+  }
+
+  // system_get_time() wraps every ~71 minutes, but unsigned arithmetic copes
+  // with that as long as periods are shorter.  If a period is much longer than
+  // configured (e.g. sampling has been stopped) don't assume the power was
+  // drawn the whole time.
+  now = system_get_time();
+  if (meter->last_finish != 0)
+  {
+    ms = (now - meter->last_finish) / 1000;
+    max_ms = ads->period * 2000;
+    if (ms > max_ms)
+    {
+      MDETAIL("ADS 0x%02x period %dms too long, using %dms", ads->addr, ms, max_ms);
+      ms = max_ms;
+    }
+    otb_power_energy_add(&(meter->energy), w, ms);
+    meter->since_publish += ms;
+    otb_i2c_ads_since_checkpoint += ms;
+  }
+  meter->last_finish = now ? now : 1;
+
+  energy = otb_conf->ads_cal[(int)ads->index].energy;
+  if ((energy != OTB_CONF_ADS_CAL_ENERGY_OFF) &&
+      (meter->since_publish >= (energy * 60000)))
+  {
+    otb_i2c_ads_energy_publish(ads, meter);
+    meter->since_publish = 0;
+  }
+
+  if (otb_i2c_ads_since_checkpoint >= OTB_POWER_CHECKPOINT_INTERVAL)
+  {
+    otb_i2c_ads_checkpoint_save();
+    otb_i2c_ads_since_checkpoint = 0;
+  }
+
+  EXIT;
+
+  return;
+}
+
+void ICACHE_FLASH_ATTR otb_i2c_ads_energy_publish(otb_conf_ads *ads, otb_i2c_ads_meter *meter)
+{
+  char message[OTB_I2C_ADS_ON_TIMER_MSG_LEN];
+
+  ENTRY;
+
+  // Whole Wh, plus the remainder to 3dp (W.ms / 3600 is mWh)
+  os_snprintf(message,
+              OTB_I2C_ADS_ON_TIMER_MSG_LEN,
+              "%u.%03uWh",
+              (unsigned int)meter->energy.wh,
+              (unsigned int)(meter->energy.wms / 3600));
+  otb_mqtt_publish(&otb_mqtt_client,
+                   OTB_MQTT_ENERGY,
+                   ads->loc,
+                   message,
+                   "",
+                   0,
+                   0,
+                   NULL,
+                   0);
+
+  EXIT;
+
+  return;
+}
+
+// Finds the latest valid checkpoint in flash and restores the energy totals
+// from it
+void ICACHE_FLASH_ATTR otb_i2c_ads_checkpoint_load(void)
+{
+  otb_power_checkpoint cp;
+  otb_power_checkpoint latest;
+  bool found = FALSE;
+  uint16_t ii;
+  uint16_t latest_ii = 0;
+  bool rc;
+
+  ENTRY;
+
+  for (ii = 0; ii < OTB_I2C_ADS_CHECKPOINTS; ii++)
+  {
+    rc = otb_util_flash_read(OTB_BOOT_ENERGY_LOCATION + (ii * sizeof(cp)),
+                             (uint32 *)&cp,
+                             sizeof(cp));
+    if (rc &&
+        otb_power_checkpoint_valid(&cp) &&
+        (!found || ((int32_t)(cp.seq - latest.seq) > 0)))
+    {
+      os_memcpy(&latest, &cp, sizeof(latest));
+      latest_ii = ii;
+      found = TRUE;
+    }
+  }
+
+  if (found)
+  {
+    MDETAIL("Loaded energy checkpoint %d from record %d", latest.seq, latest_ii);
+    for (ii = 0; ii < OTB_CONF_ADS_MAX_ADSS; ii++)
+    {
+      otb_i2c_ads_meters[ii].energy.wh = latest.wh[ii];
+      otb_i2c_ads_meters[ii].energy.wms = 0;
+      otb_i2c_ads_checkpoint_wh[ii] = latest.wh[ii];
+    }
+    otb_i2c_ads_checkpoint_seq = latest.seq;
+    otb_i2c_ads_checkpoint_next = (latest_ii + 1) % OTB_I2C_ADS_CHECKPOINTS;
+  }
+  else
+  {
+    MDETAIL("No energy checkpoint");
+    otb_i2c_ads_checkpoint_seq = 0;
+    otb_i2c_ads_checkpoint_next = 0;
+  }
+  otb_i2c_ads_checkpoint_loaded = TRUE;
+
+  EXIT;
+
+  return;
+}
+
+// Appends a checkpoint record, if any total has changed since the last one.
+// Loses at most OTB_POWER_CHECKPOINT_INTERVAL of energy on a reboot.
+void ICACHE_FLASH_ATTR otb_i2c_ads_checkpoint_save(void)
+{
+  otb_power_checkpoint cp;
+  uint32_t location;
+  int ii;
+  bool changed = FALSE;
+  bool rc;
+
+  ENTRY;
+
+  os_memset(&cp, 0, sizeof(cp));
+  for (ii = 0; ii < OTB_CONF_ADS_MAX_ADSS; ii++)
+  {
+    cp.wh[ii] = otb_i2c_ads_meters[ii].energy.wh;
+    if (cp.wh[ii] != otb_i2c_ads_checkpoint_wh[ii])
+    {
+      changed = TRUE;
+    }
+  }
+  if (!changed)
+  {
+    goto EXIT_LABEL;
+  }
+
+  cp.magic = OTB_POWER_CHECKPOINT_MAGIC;
+  cp.seq = otb_i2c_ads_checkpoint_seq + 1;
+  cp.checksum = otb_power_checkpoint_sum(&cp);
+
+  // Erase a sector only when first writing to it
+  location = OTB_BOOT_ENERGY_LOCATION + (otb_i2c_ads_checkpoint_next * sizeof(cp));
+  if ((otb_i2c_ads_checkpoint_next % OTB_I2C_ADS_CHECKPOINTS_PER_SECTOR) == 0)
+  {
+    spi_flash_erase_sector(location / 0x1000);
+  }
+  rc = otb_util_flash_write(location, (uint32 *)&cp, sizeof(cp));
+  if (!rc)
+  {
+    MWARN("Failed to write energy checkpoint");
+    goto EXIT_LABEL;
+  }
+
+  MDEBUG("Wrote energy checkpoint %d to record %d", cp.seq, otb_i2c_ads_checkpoint_next);
+  os_memcpy(otb_i2c_ads_checkpoint_wh, cp.wh, sizeof(otb_i2c_ads_checkpoint_wh));
+  otb_i2c_ads_checkpoint_seq = cp.seq;
+  otb_i2c_ads_checkpoint_next = (otb_i2c_ads_checkpoint_next + 1) % OTB_I2C_ADS_CHECKPOINTS;
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return;
+}
+
+// Whether a capture is reading from this ADS, in which case its regular
+// sample periods are skipped
+bool ICACHE_FLASH_ATTR otb_i2c_ads_capturing(otb_conf_ads *ads)
+{
+  bool rc;
+
+  ENTRY;
+
+  rc = (otb_i2c_ads_capture_buf.state == OTB_I2C_ADS_CAPTURE_STATE_READING) &&
+       (otb_i2c_ads_capture_buf.ads == ads);
+
+  EXIT;
+
+  return rc;
+}
+
+bool ICACHE_FLASH_ATTR otb_i2c_ads_capture_cmd(unsigned char *next_cmd,
+                                               void *arg,
+                                               unsigned char *prev_cmd)
+{
+  bool rc = FALSE;
+  otb_i2c_ads_capture *capture;
+  otb_conf_ads *ads;
+  int count;
+
+  ENTRY;
+
+  capture = &otb_i2c_ads_capture_buf;
+  if (capture->state != OTB_I2C_ADS_CAPTURE_STATE_IDLE)
+  {
+    otb_cmd_rsp_append("capture already in progress");
+    goto EXIT_LABEL;
+  }
+
+  // We've tested the address is configured already
+  rc = otb_i2c_ads_conf_get_addr(otb_i2c_ads_last_addr, &ads);
+  OTB_ASSERT(rc);
+
+  if ((next_cmd == NULL) ||
+      !otb_i2c_mqtt_get_num(next_cmd, &count) ||
+      (count < 1) ||
+      (count > OTB_I2C_ADS_CAPTURE_MAX_SAMPLES))
+  {
+    otb_cmd_rsp_append("invalid number of samples");
+    rc = FALSE;
+    goto EXIT_LABEL;
+  }
+
+  capture->ads = ads;
+  os_memcpy(&(capture->conf), ads, sizeof(capture->conf));
+  capture->conf.rate = OTB_I2C_ADS_CAPTURE_RATE;
+  capture->conf.cont = 0;
+  capture->count = count;
+  capture->next = 0;
+  capture->missed = 0;
+  capture->start = 0;
+  rc = otb_i2c_ads_capture_start(capture);
+  if (!rc)
+  {
+    otb_cmd_rsp_append("failed to start capture");
+  }
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return rc;
+}
+
+bool ICACHE_FLASH_ATTR otb_i2c_ads_capture_start(otb_i2c_ads_capture *capture)
+{
+  bool rc;
+
+  otb_i2c_ads_samples *samples;
+
+  ENTRY;
+
+  if (capture->conf.rdy &&
+      (otb_intr_reg_info[capture->conf.rdy].fn == otb_i2c_ads_rdy_interrupt))
+  {
+    // A sample period holds ALERT/RDY.  If it's this ADS's, take the pin over
+    // and abandon the period, otherwise it belongs to another ADS - refuse.
+    samples = (otb_i2c_ads_samples *)otb_intr_reg_info[capture->conf.rdy].arg;
+    if (samples->ads != capture->ads)
+    {
+      MERROR("ALERT/RDY for ADS 0x%02x in use by ADS 0x%02x", capture->conf.addr, samples->ads->addr);
+      rc = FALSE;
+      capture->ads = NULL;
+      goto EXIT_LABEL;
+    }
+    MDETAIL("ADS 0x%02x capturing - abandon sample period", samples->ads->addr);
+    os_timer_disarm((os_timer_t*)&(samples->timer));
+    otb_intr_unreg(capture->conf.rdy);
+    otb_i2c_ads_init_samples(samples->ads, samples);
+  }
+
+  capture->state = OTB_I2C_ADS_CAPTURE_STATE_READING;
+  rc = otb_ads_configure(&(capture->conf));
+  if (!rc)
+  {
+    MERROR("Failed to configure ADS 0x%02x for capture", capture->conf.addr);
+    otb_i2c_ads_capture_finish(capture);
+    goto EXIT_LABEL;
+  }
+
+  os_timer_disarm((os_timer_t*)&(capture->timer));
+  os_timer_setfn((os_timer_t*)&(capture->timer), (os_timer_func_t *)otb_i2c_ads_capture_timer, capture);
+
+  if (capture->conf.rdy)
+  {
+    // As for otb_i2c_ads_start_sample - read when ALERT/RDY fires
+    capture->rdy_pending = FALSE;
+    os_timer_arm((os_timer_t*)&(capture->timer), OTB_I2C_ADS_RDY_TIMEOUT, 0);
+    rc = otb_intr_register_edge(otb_i2c_ads_capture_interrupt,
+                                capture,
+                                capture->conf.rdy,
+                                OTB_INTR_EDGE_NEG);
+    if (!rc)
+    {
+      MERROR("Failed to register ALERT/RDY for ADS 0x%02x", capture->conf.addr);
+      otb_i2c_ads_capture_finish(capture);
+      goto EXIT_LABEL;
+    }
+  }
+  else
+  {
+    // Poll at (just under) 860Hz
+    os_timer_arm_us((os_timer_t*)&(capture->timer), (1000000/860)+1, 1);
+  }
+
+  MDETAIL("Capturing %d samples from ADS 0x%02x", capture->count, capture->conf.addr);
+
+EXIT_LABEL:
 
-bool ICACHE_FLASH_ATTR otb_i2c_ads_read_nonrms_sample(otb_i2c_ads_samples *samples)
-{
-  bool rc;
-  otb_i2c_ads_nonrms_samples *nonrms_samples;
-  
-  ENTRY;
-  
-  nonrms_samples = (otb_i2c_ads_nonrms_samples *)samples;
-  rc = otb_i2c_ads_read(samples->ads->addr, &(nonrms_samples->samples[samples->next_sample]));
-  
   EXIT;
 
   return rc;
 }
 
-uint16_t ICACHE_FLASH_ATTR otb_i2c_ads_finish_rms_samples(otb_i2c_ads_samples *samples)
+// Called in interrupt context when ALERT/RDY goes low - schedule the read
+void ICACHE_FLASH_ATTR otb_i2c_ads_capture_interrupt(void *arg)
 {
-  otb_i2c_ads_rms_samples *rms_samples;
-  uint16_t val;
-  unsigned long long sum;
-  int ii;
-  uint32_t working;
+  otb_i2c_ads_capture *capture;
 
   ENTRY;
 
-  rms_samples = (otb_i2c_ads_rms_samples *)samples;
-  sum = 0;
-  for (ii = 0; ii < samples->ads->samples; ii++)
+  OTB_ASSERT(arg != NULL);
+  capture = (otb_i2c_ads_capture *)arg;
+  if (capture->rdy_pending)
   {
-    sum += (rms_samples->samples[ii] * rms_samples->samples[ii]);
+    capture->missed++;
+  }
+  else
+  {
+    capture->rdy_pending = TRUE;
+    os_timer_disarm((os_timer_t*)&(capture->timer));
+    os_timer_arm((os_timer_t*)&(capture->timer), 0, 0);
   }
-  
-  working = sum/(samples->ads->samples);
-  working = isqrt(working);
-  OTB_ASSERT(working < 0xffff);
-  val = (uint16_t)working;
 
   EXIT;
-  
-  return val;
+
+  return;
 }
 
-int16_t ICACHE_FLASH_ATTR otb_i2c_ads_finish_nonrms_samples(otb_i2c_ads_samples *samples)
+void ICACHE_FLASH_ATTR otb_i2c_ads_capture_timer(void *arg)
 {
-  otb_i2c_ads_nonrms_samples *nonrms_samples;
-  int16_t val;
-  int sum;
-  int ii;
-  int working;
+  otb_i2c_ads_capture *capture;
 
   ENTRY;
 
-  nonrms_samples = (otb_i2c_ads_nonrms_samples *)samples;
-  sum = 0;
-  for (ii = 0; ii < samples->ads->samples; ii++)
+  OTB_ASSERT(arg != NULL);
+  capture = (otb_i2c_ads_capture *)arg;
+
+  if (capture->state == OTB_I2C_ADS_CAPTURE_STATE_SENDING)
   {
-    sum += nonrms_samples->samples[ii];
+    otb_i2c_ads_capture_send(capture);
+  }
+  else if (!capture->conf.rdy)
+  {
+    otb_i2c_ads_capture_read(capture);
+  }
+  else if (!capture->rdy_pending)
+  {
+    MERROR("Timed out waiting for ALERT/RDY from ADS 0x%02x", capture->conf.addr);
+    otb_i2c_ads_capture_finish(capture);
+  }
+  else
+  {
+    capture->rdy_pending = FALSE;
+    otb_i2c_ads_capture_read(capture);
+    if (capture->state == OTB_I2C_ADS_CAPTURE_STATE_READING)
+    {
+      ETS_INTR_LOCK();
+      if (!capture->rdy_pending)
+      {
+        os_timer_arm((os_timer_t*)&(capture->timer), OTB_I2C_ADS_RDY_TIMEOUT, 0);
+      }
+      ETS_INTR_UNLOCK();
+    }
   }
-  
-  working = sum/(samples->ads->samples);
-  val = (int16_t)working;
 
   EXIT;
-  
-  return val;
+
+  return;
 }
 
-bool ICACHE_FLASH_ATTR otb_i2c_ads_get_sample(otb_i2c_ads_samples *samples)
+void ICACHE_FLASH_ATTR otb_i2c_ads_capture_read(otb_i2c_ads_capture *capture)
 {
-  bool rc = FALSE;
-  int time_now;
-  otb_i2c_ads_rms_samples rms_samples;
-  otb_i2c_ads_nonrms_samples nonrms_samples;
-  
+  bool rc;
+  uint32_t now;
+
   ENTRY;
 
-  // Get a sample
-  if (samples->ads->rms)
-  {
-    rc = otb_i2c_ads_read_rms_sample(samples);
-  }
-  else
-  {
-    rc = otb_i2c_ads_read_nonrms_sample(samples);
-  }
-  
+  rc = otb_i2c_ads_read(capture->conf.addr, capture->val + capture->next);
   if (!rc)
-  { 
+  {
+    MERROR("Failed to read capture sample from ADS 0x%02x", capture->conf.addr);
+    otb_i2c_ads_capture_finish(capture);
     goto EXIT_LABEL;
   }
-  
-  if (samples->next_sample > 0)
+  now = system_get_time();
+  if (capture->next == 0)
   {
-    // This is a bit hacky - should really do rms and nonrms separately or assert
-    // somewhere that offset of samples in samples is same for rms and nonrms (it is).
-    // Also note will get lots of dupes for non AC current
-    if (((otb_i2c_ads_rms_samples*)samples)->samples[samples->next_sample-1] == ((otb_i2c_ads_rms_samples*)samples)->samples[samples->next_sample])
-    {
-      samples->dupes++;
-    }
+    capture->start = now;
   }
+  capture->us[capture->next] = now - capture->start;
+  capture->next++;
 
-  samples->next_sample++;
-
-EXIT_LABEL:
-
-  if (rc)
+  if (capture->next >= capture->count)
   {
-    // See if finished
-    if ((samples->next_sample == 0) || (samples->next_sample >= samples->ads->samples))
+    // Done reading - put the ADS back as it was, and start sending
+    os_timer_disarm((os_timer_t*)&(capture->timer));
+    if (capture->conf.rdy)
     {
-      os_timer_disarm((os_timer_t*)&(samples->timer));
-      samples->time = system_get_time() - samples->time;
-      otb_i2c_ads_finish_sample(samples);
-      // Reinitialise samples!    
-      otb_i2c_ads_init_samples(samples->ads, samples);
+      otb_intr_unreg(capture->conf.rdy);
     }
+    if (!otb_ads_configure(capture->ads))
+    {
+      MERROR("Failed to restore ADS 0x%02x config after capture", capture->conf.addr);
+    }
+    MDETAIL("Captured %d samples in %dus, %d missed",
+            capture->count,
+            capture->us[capture->count-1],
+            capture->missed);
+    capture->state = OTB_I2C_ADS_CAPTURE_STATE_SENDING;
+    capture->next = 0;
+    os_timer_setfn((os_timer_t*)&(capture->timer), (os_timer_func_t *)otb_i2c_ads_capture_timer, capture);
+    os_timer_arm((os_timer_t*)&(capture->timer), OTB_I2C_ADS_CAPTURE_CHUNK_MS, 1);
   }
-  else
-  {
-    // Failed, give up this time around - will sent MQTT message if connected
-    MERROR("Failed to collect samples from ADS %d 0x%02x", samples->ads->index, samples->ads->addr);
-    os_timer_disarm((os_timer_t*)&(samples->timer));
-    // Reinitialise samples!    
-    otb_i2c_ads_init_samples(samples->ads, samples);
-  }
+
+EXIT_LABEL:
 
   EXIT;
 
-  return rc;
+  return;
 }
 
-void ICACHE_FLASH_ATTR otb_i2c_ads_finish_sample(otb_i2c_ads_samples *samples)  
+// Publishes the next chunk.  If MQTT's queue is full the chunk is retried next
+// time around.
+void ICACHE_FLASH_ATTR otb_i2c_ads_capture_send(otb_i2c_ads_capture *capture)
 {
-#define OTB_I2C_ADS_ON_TIMER_MSG_LEN 64
-  char message[OTB_I2C_ADS_ON_TIMER_MSG_LEN];
-  char message_mains[OTB_I2C_ADS_ON_TIMER_MSG_LEN];
-  int chars=0;
-  int chars_mains=0;
-  double voltage;
-  int voltage_int;
-  int voltage_hundreth;
-  double current;
-  int current_int;
-  int current_thou;
-  double current_sens;
-  int current_sens_int;
-  int current_sens_thou;
-  int power;
-  int val;
-  otb_conf_ads *ads;
-#define OTB_I2C_ADS_ON_TIMER_RESISTOR_VALUE 22.14 // measured with isotech dmm
-#define OTB_I2C_ADS_ON_TIMER_TRANSFORMER_TURNS 2000
-#define OTB_I2C_ADS_ON_TIMER_MAINS_VOLTAGE 245 // measured with isotech dmm, but will vary
+  uint8_t buf[OTB_I2C_ADS_CAPTURE_CHUNK_LEN];
+  uint8_t *ptr;
+  uint16_t chunks;
+  uint16_t first;
+  uint16_t num;
+  uint16_t ii;
+  int16_t val;
 
   ENTRY;
-  
-  ads = samples->ads;
-  // Different messages if RMS or not (in latter case may be negative)
-  if (ads->rms)
+
+  if (!otb_mqtt_connected)
   {
-    val = otb_i2c_ads_finish_rms_samples(samples);
-    chars = os_snprintf(message, OTB_I2C_ADS_ON_TIMER_MSG_LEN, "0x%04x", val);
+    MWARN("MQTT not connected - abandoning capture");
+    otb_i2c_ads_capture_finish(capture);
+    goto EXIT_LABEL;
   }
-  else
-  {
-    val = otb_i2c_ads_finish_nonrms_samples(samples);
-    chars = os_snprintf(message,
-                        OTB_I2C_ADS_ON_TIMER_MSG_LEN,
-                        "%s0x%04x",
-                        (val<0)?"-":"",
-                        (val<0)?-val:val);
+
+  chunks = (capture->count + OTB_I2C_ADS_CAPTURE_CHUNK_SAMPLES - 1) /
+           OTB_I2C_ADS_CAPTURE_CHUNK_SAMPLES;
+  first = capture->next * OTB_I2C_ADS_CAPTURE_CHUNK_SAMPLES;
+  num = capture->count - first;
+  if (num > OTB_I2C_ADS_CAPTURE_CHUNK_SAMPLES)
+  {
+    num = OTB_I2C_ADS_CAPTURE_CHUNK_SAMPLES;
+  }
+
+  ptr = buf;
+  *ptr++ = OTB_I2C_ADS_CAPTURE_VERSION;
+  *ptr++ = capture->conf.gain;
+  *ptr++ = capture->conf.mux;
+  *ptr++ = capture->conf.rate;
+  *ptr++ = capture->next & 0xff;
+  *ptr++ = capture->next >> 8;
+  *ptr++ = chunks & 0xff;
+  *ptr++ = chunks >> 8;
+  *ptr++ = capture->count & 0xff;
+  *ptr++ = capture->count >> 8;
+  *ptr++ = capture->missed & 0xff;
+  *ptr++ = capture->missed >> 8;
+  *ptr++ = num & 0xff;
+  *ptr++ = num >> 8;
+  for (ii = first; ii < first + num; ii++)
+  {
+    *ptr++ = capture->us[ii] & 0xff;
+    *ptr++ = (capture->us[ii] >> 8) & 0xff;
+    *ptr++ = (capture->us[ii] >> 16) & 0xff;
+    *ptr++ = (capture->us[ii] >> 24) & 0xff;
+    val = capture->val[ii];
+    *ptr++ = val & 0xff;
+    *ptr++ = (val >> 8) & 0xff;
+  }
+
+  if (otb_mqtt_publish_bin(&otb_mqtt_client,
+                           OTB_MQTT_CAPTURE,
+                           capture->ads->loc,
+                           buf,
+                           ptr - buf,
+                           0,
+                           0))
+  {
+    capture->next++;
+    if (capture->next >= chunks)
+    {
+      otb_i2c_ads_capture_finish(capture);
+    }
   }
 
-  // Calculate the voltage
-  OTB_ASSERT(ads->gain < OTB_I2C_ADC_GAIN_VALUES);
-  voltage = otb_i2c_ads_gain_to_v[ads->gain] * val * 1000/ 0x8000; // 0x8000 as in differential (+ & -ve mode)
-  voltage_int = voltage/1;
-  voltage_hundreth = (int)(voltage*100)%100;
-  
-  // Calculate the current through sensor circuit
-  current_sens = voltage / OTB_I2C_ADS_ON_TIMER_RESISTOR_VALUE;
-  current_sens_int = current_sens/1;
-  current_sens_thou = (int)(current_sens*1000)%1000;
+EXIT_LABEL:
 
-  chars += os_snprintf(message+chars, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars, ":%d.%03dmA", current_sens_int, current_sens_thou);
-  chars += os_snprintf(message+chars, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars, ":%d.%02dmV", voltage_int, voltage_hundreth); 
-  chars += os_snprintf(message+chars, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars, ":%dus", samples->time); 
-  chars += os_snprintf(message+chars, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars, ":%d", samples->dupes); 
-  
-  // Calculate voltage of mains supply
-  // No op at the moment XXX
-  
-  // Calculate the current flowing through the transformer
-  // Note hack - this should be configured
-  current = voltage * OTB_I2C_ADS_ON_TIMER_TRANSFORMER_TURNS / OTB_I2C_ADS_ON_TIMER_RESISTOR_VALUE / 1000; // 1000 as mV
-  current_int = current/1;
-  current_thou = (int)(current*1000)%1000;
-  
-  // Calculate power P = IV
-  // Hack - should detect voltage
-  power = OTB_I2C_ADS_ON_TIMER_MAINS_VOLTAGE * current;
+  EXIT;
 
-  // Build up power output
-  chars_mains += os_snprintf(message_mains+chars_mains, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars_mains, "%dW", power);
-  chars_mains += os_snprintf(message_mains+chars_mains, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars_mains, ":%d.%03dA", current_int, current_thou);
-  chars_mains += os_snprintf(message_mains+chars_mains, OTB_I2C_ADS_ON_TIMER_MSG_LEN-chars_mains, ":%d.%02dV", OTB_I2C_ADS_ON_TIMER_MAINS_VOLTAGE, 0);
+  return;
+}
 
-  // ADS ADC measurements (reading, time taken, mV)
-  otb_mqtt_publish(&otb_mqtt_client,
-                   OTB_MQTT_ADC,
-                   ads->loc,
-                   message,
-                   "",
-                   0,
-                   0,
-                   NULL,
-                   0);
-  otb_mqtt_publish(&otb_mqtt_client,
-                   OTB_MQTT_POWER,
-                   ads->loc,
-                   message_mains,
-                   "",
-                   0,
-                   0,
-                   NULL,
-                   0);
+void ICACHE_FLASH_ATTR otb_i2c_ads_capture_finish(otb_i2c_ads_capture *capture)
+{
+
+  ENTRY;
+
+  os_timer_disarm((os_timer_t*)&(capture->timer));
+  if (capture->state == OTB_I2C_ADS_CAPTURE_STATE_READING)
+  {
+    // Abandoned while reading.  Only unregister ALERT/RDY if the capture got
+    // as far as registering it.
+    if (capture->conf.rdy &&
+        (otb_intr_reg_info[capture->conf.rdy].arg == capture))
+    {
+      otb_intr_unreg(capture->conf.rdy);
+    }
+    if (!otb_ads_configure(capture->ads))
+    {
+      MERROR("Failed to restore ADS 0x%02x config after capture", capture->conf.addr);
+    }
+  }
+  capture->state = OTB_I2C_ADS_CAPTURE_STATE_IDLE;
+  capture->ads = NULL;
 
   EXIT;
-  
+
   return;
 }
 
@@ -487,6 +1443,7 @@ bool ICACHE_FLASH_ATTR otb_i2c_init()
 
   //i2c_master_gpio_init();
   otb_brzo_i2c_setup(0);
+  otb_i2c_shadow_reset_bus(NULL);
   otb_i2c_initialized = TRUE;
   rc = TRUE;
 
@@ -1116,9 +2073,8 @@ bool ICACHE_FLASH_ATTR otb_i2c_ads_range(uint8 addr, int num, int16_t *result, i
 {
   bool rc = FALSE;
   int ii;
-  int16_t samples[1024];
-  int sum;
-  int working;
+  int16_t sample;
+  otb_i2c_ads_accum accum;
   uint32 start_time;
   uint32 end_time;
   
@@ -1126,22 +2082,24 @@ bool ICACHE_FLASH_ATTR otb_i2c_ads_range(uint8 addr, int num, int16_t *result, i
   
   MDEBUG("Get range %d", num);
   
-  if (num > 1024)
+  if ((num < 1) || (num > OTB_I2C_ADS_MAX_RANGE_SAMPLES))
   {
-    MWARN("Too many samples requested - max is 1024");
+    MWARN("Invalid number of samples requested - max is %d", OTB_I2C_ADS_MAX_RANGE_SAMPLES);
     goto EXIT_LABEL;
   }
   
+  otb_i2c_ads_accum_init(&accum);
   start_time = system_get_time();
   
   for (ii = 0; ii < num; ii++)
   {
-    rc = otb_i2c_ads_read(addr, &(samples[ii]));
+    rc = otb_i2c_ads_read(addr, &sample);
     if (!rc)
     {
       MWARN("Failed to read sample num %d", ii+1);
       goto EXIT_LABEL;
     }
+    otb_i2c_ads_accum_add(&accum, sample);
     // Worked out experimentally base don 860SPS.
     os_delay_us(398);
   }
@@ -1150,17 +2108,8 @@ bool ICACHE_FLASH_ATTR otb_i2c_ads_range(uint8 addr, int num, int16_t *result, i
   
   *time_taken = end_time - start_time;
   
-  sum = 0;
-  for (ii = 0; ii < num; ii++)
-  {
-    sum += samples[ii];
-  }
-  
-  working = sum/num;
-  *result = (int16_t)working;
-  MDETAIL("Result %d working %d", *result, working);
-  // Check we haven't lost any data!
-  OTB_ASSERT(*result == working);
+  *result = otb_i2c_ads_accum_mean(&accum);
+  MDETAIL("Result %d min %d max %d", *result, accum.min, accum.max);
   rc = TRUE;
 
 EXIT_LABEL:
@@ -1175,10 +2124,8 @@ bool ICACHE_FLASH_ATTR otb_i2c_ads_rms_range(uint8 addr, int num, uint16_t *resu
 {
   bool rc = FALSE;
   int ii;
-  uint32_t samples[1024];
   int16_t sample;
-  unsigned long long sum;
-  uint32_t working;
+  otb_i2c_ads_accum accum;
   uint32 start_time;
   uint32 end_time;
   
@@ -1186,12 +2133,13 @@ bool ICACHE_FLASH_ATTR otb_i2c_ads_rms_range(uint8 addr, int num, uint16_t *resu
   
   MDEBUG("Get range %d", num);
   
-  if (num > 1024)
+  if ((num < 1) || (num > OTB_I2C_ADS_MAX_RANGE_SAMPLES))
   {
-    MWARN("Too many samples requested - max is 1024");
+    MWARN("Invalid number of samples requested - max is %d", OTB_I2C_ADS_MAX_RANGE_SAMPLES);
     goto EXIT_LABEL;
   }
   
+  otb_i2c_ads_accum_init(&accum);
   start_time = system_get_time();
   
   for (ii = 0; ii < num; ii++)
@@ -1202,7 +2150,7 @@ bool ICACHE_FLASH_ATTR otb_i2c_ads_rms_range(uint8 addr, int num, uint16_t *resu
       MWARN("Failed to read sample num %d", ii+1);
       goto EXIT_LABEL;
     }
-    samples[ii] = sample * sample;
+    otb_i2c_ads_accum_add(&accum, sample);
     // Worked out experimentally base don 860SPS.
     os_delay_us(398);
   }
@@ -1211,16 +2159,7 @@ bool ICACHE_FLASH_ATTR otb_i2c_ads_rms_range(uint8 addr, int num, uint16_t *resu
   
   *time_taken = end_time - start_time;
   
-  sum = 0;
-  for (ii = 0; ii < num; ii++)
-  {
-    sum += samples[ii];
-  }
-  
-  working = sum/num;
-  working = isqrt(working);
-  OTB_ASSERT(working < 0xffff);
-  *result = (uint16_t)working;
+  *result = otb_i2c_ads_accum_rms(&accum);
   rc = TRUE;
 
 EXIT_LABEL:
@@ -1230,23 +2169,105 @@ EXIT_LABEL:
   return rc;
 }
 
-bool ICACHE_FLASH_ATTR otb_i2c_ads_conf_get_addr(uint8_t addr, otb_conf_ads **ads)
+void ICACHE_FLASH_ATTR otb_i2c_ads_conf_changed(void)
+{
+  ENTRY;
+
+  otb_i2c_ads_conf_indexed = FALSE;
+
+  EXIT;
+
+  return;
+}
+
+void ICACHE_FLASH_ATTR otb_i2c_ads_conf_index(void)
 {
-  bool rc = FALSE;
   int ii;
+  uint8_t addr;
 
   ENTRY;
-  
+
+  for (ii = 0; ii < OTB_I2C_ADS_ADDRS; ii++)
+  {
+    otb_i2c_ads_conf_slot[ii] = -1;
+  }
   for (ii = 0; ii < OTB_CONF_ADS_MAX_ADSS; ii++)
   {
-    if (otb_conf->ads[ii].addr == addr)
+    addr = otb_conf->ads[ii].addr;
+    if ((addr >= OTB_I2C_ADS_ADDR_MIN) &&
+        (addr <= OTB_I2C_ADS_ADDR_MAX) &&
+        (otb_i2c_ads_conf_slot[addr - OTB_I2C_ADS_ADDR_MIN] < 0))
     {
-      *ads = &(otb_conf->ads[ii]);
-      rc = TRUE;
-      break;
+      otb_i2c_ads_conf_slot[addr - OTB_I2C_ADS_ADDR_MIN] = ii;
     }
+
+    // Calibration has been checked by otb_conf_verify and when set, so this
+    // can't fail
+    otb_i2c_ads_cal_init(otb_conf->ads_cal + ii, &(otb_i2c_ads_meters[ii].cal));
+  }
+  otb_i2c_ads_conf_indexed = TRUE;
+
+  EXIT;
+
+  return;
+}
+
+// Builds the fixed point calibration for an ADS's CT, using the defaults for
+// anything not configured.  cal may be NULL just to check the config is usable.
+bool ICACHE_FLASH_ATTR otb_i2c_ads_cal_init(otb_conf_ads_cal *conf_cal, otb_power_cal *cal)
+{
+  bool rc;
+  otb_power_cal local_cal;
+
+  ENTRY;
+
+  if (cal == NULL)
+  {
+    cal = &local_cal;
+  }
+
+  rc = otb_power_cal_init(cal,
+                          conf_cal->burden_mohm ?
+                            conf_cal->burden_mohm :
+                            OTB_CONF_ADS_CAL_BURDEN_DEFAULT,
+                          conf_cal->turns ?
+                            conf_cal->turns :
+                            OTB_CONF_ADS_CAL_TURNS_DEFAULT,
+                          conf_cal->mains_v ?
+                            conf_cal->mains_v :
+                            OTB_CONF_ADS_CAL_MAINS_V_DEFAULT);
+
+  EXIT;
+
+  return rc;
+}
+
+bool ICACHE_FLASH_ATTR otb_i2c_ads_conf_get_addr(uint8_t addr, otb_conf_ads **ads)
+{
+  bool rc = FALSE;
+  int8_t slot;
+
+  ENTRY;
+  
+  if ((addr < OTB_I2C_ADS_ADDR_MIN) || (addr > OTB_I2C_ADS_ADDR_MAX))
+  {
+    goto EXIT_LABEL;
+  }
+
+  if (!otb_i2c_ads_conf_indexed)
+  {
+    otb_i2c_ads_conf_index();
+  }
+
+  slot = otb_i2c_ads_conf_slot[addr - OTB_I2C_ADS_ADDR_MIN];
+  if (slot >= 0)
+  {
+    *ads = &(otb_conf->ads[slot]);
+    rc = TRUE;
   }
   
+EXIT_LABEL:
+
   EXIT;
   
   return rc;
@@ -1351,6 +2372,7 @@ bool ICACHE_FLASH_ATTR otb_i2c_ads_configured_addr(unsigned char *to_match)
   }
   
   rc = TRUE;
+  otb_i2c_ads_last_addr = addr_b;
   
 EXIT_LABEL:
   
@@ -1379,6 +2401,8 @@ bool ICACHE_FLASH_ATTR otb_i2c_ads_conf_set(unsigned char *next_cmd, void *arg,
   uint16_t *ads_val_i;
   uint8_t type;
   int offset;
+  char *reserved_text;
+  otb_conf_ads_cal cal;
     
   ENTRY;
 
@@ -1436,13 +2460,91 @@ bool ICACHE_FLASH_ATTR otb_i2c_ads_conf_set(unsigned char *next_cmd, void *arg,
     case OTB_CMD_ADS_ADD:
       ads->addr = addr_b;
       otb_conf->adss++;
+      otb_i2c_ads_conf_changed();
+      rc = TRUE;
+      break;
+
+    case OTB_CMD_ADS_LOC:
+      os_strncpy(ads->loc, value, OTB_CONF_ADS_LOCATION_MAX_LEN);
+      ads->loc[OTB_CONF_ADS_LOCATION_MAX_LEN-1] = 0;
       rc = TRUE;
       break;
 
-    case OTB_CMD_ADS_LOC:
-      os_strncpy(ads->loc, value, OTB_CONF_ADS_LOCATION_MAX_LEN);
-      ads->loc[OTB_CONF_ADS_LOCATION_MAX_LEN-1] = 0;
-      rc = TRUE;
+    case OTB_CMD_ADS_RDY:
+      rc = otb_i2c_mqtt_get_num(value, &val_i);
+      if (!rc ||
+          (val_i > otb_i2c_ads_conf[cmd].max) ||
+          ((val_i != OTB_CONF_ADS_RDY_NONE) &&
+           otb_gpio_is_reserved(val_i, &reserved_text)))
+      {
+        MDETAIL("rc: %d rdy: %d", rc, val_i);
+        otb_cmd_rsp_append("invalid pin");
+        rc = FALSE;
+        goto EXIT_LABEL;
+      }
+      if (!OTB_CONF_ADS_RDY_CONT_OK(val_i, ads->cont))
+      {
+        otb_cmd_rsp_append("rdy requires continuous mode");
+        rc = FALSE;
+        goto EXIT_LABEL;
+      }
+      ads->rdy = val_i;
+      break;
+
+    case OTB_CMD_ADS_BURDEN:
+    case OTB_CMD_ADS_TURNS:
+    case OTB_CMD_ADS_MAINS:
+    case OTB_CMD_ADS_ENERGY:
+    case OTB_CMD_ADS_HARMONICS:
+    case OTB_CMD_ADS_HZ:
+      type = otb_i2c_ads_conf[cmd].type;
+      offset = otb_i2c_ads_conf[cmd].offset;
+      min = otb_i2c_ads_conf[cmd].min;
+      max = otb_i2c_ads_conf[cmd].max;
+      if (cmd == OTB_CMD_ADS_HARMONICS)
+      {
+        // A bitfield, so given in binary like the ADS's other bitfields
+        rc = otb_i2c_ads_get_binary_val(value, &val_b);
+        val_i = val_b;
+      }
+      else
+      {
+        rc = otb_i2c_mqtt_get_num(value, &val_i);
+      }
+      if (!rc ||
+          (val_i < min) ||
+          (val_i > max) ||
+          ((cmd == OTB_CMD_ADS_HZ) && (val_i != 0) && (val_i != 50) && (val_i != 60)))
+      {
+        MDETAIL("rc: %d min: %d max: %d val: %d", rc, min, max, val_i);
+        otb_cmd_rsp_append("invalid value");
+        rc = FALSE;
+        goto EXIT_LABEL;
+      }
+
+      // Check the resulting calibration is usable before storing it
+      os_memcpy(&cal, otb_conf->ads_cal + ads->index, sizeof(cal));
+      if (type == OTB_I2C_ADS_CONF_VAL_TYPE_CAL_UINT32)
+      {
+        *((uint32_t *)(((unsigned char *)&cal) + offset)) = val_i;
+      }
+      else if (type == OTB_I2C_ADS_CONF_VAL_TYPE_CAL_UINT16)
+      {
+        *((uint16_t *)(((unsigned char *)&cal) + offset)) = val_i;
+      }
+      else
+      {
+        OTB_ASSERT(type == OTB_I2C_ADS_CONF_VAL_TYPE_CAL_BYTE);
+        *(((unsigned char *)&cal) + offset) = val_i;
+      }
+      if (!otb_i2c_ads_cal_init(&cal, NULL))
+      {
+        otb_cmd_rsp_append("invalid calibration");
+        rc = FALSE;
+        goto EXIT_LABEL;
+      }
+      os_memcpy(otb_conf->ads_cal + ads->index, &cal, sizeof(cal));
+      otb_i2c_ads_conf_changed();
       break;
 
     case OTB_CMD_ADS_MUX:
@@ -1479,6 +2581,13 @@ bool ICACHE_FLASH_ATTR otb_i2c_ads_conf_set(unsigned char *next_cmd, void *arg,
         rc = FALSE;
         goto EXIT_LABEL;
       }
+
+      if ((cmd == OTB_CMD_ADS_CONT) && !OTB_CONF_ADS_RDY_CONT_OK(ads->rdy, val))
+      {
+        otb_cmd_rsp_append("rdy requires continuous mode");
+        rc = FALSE;
+        goto EXIT_LABEL;
+      }
       
       if (type == OTB_I2C_ADS_CONF_VAL_TYPE_BYTE)
       {
@@ -1532,7 +2641,13 @@ bool ICACHE_FLASH_ATTR otb_i2c_ads_conf_delete(unsigned char *next_cmd,
 
   if (cmd == OTB_CMD_ADS_ALL)
   {
+    if (otb_i2c_ads_capture_buf.ads != NULL)
+    {
+      otb_i2c_ads_capture_finish(&otb_i2c_ads_capture_buf);
+    }
     otb_conf_ads_init(otb_conf);
+    os_memset(otb_i2c_ads_meters, 0, sizeof(otb_i2c_ads_meters));
+    otb_i2c_ads_conf_changed();
     rc = TRUE;
     goto EXIT_LABEL;
   }
@@ -1544,8 +2659,15 @@ bool ICACHE_FLASH_ATTR otb_i2c_ads_conf_delete(unsigned char *next_cmd,
     OTB_ASSERT(rc);
     rc = otb_i2c_ads_conf_get_addr(addr_b, &ads);
     OTB_ASSERT(rc);
+    if (otb_i2c_ads_capture_buf.ads == ads)
+    {
+      otb_i2c_ads_capture_finish(&otb_i2c_ads_capture_buf);
+    }
+    os_memset(otb_conf->ads_cal + ads->index, 0, sizeof(otb_conf_ads_cal));
+    os_memset(&(otb_i2c_ads_meters[(int)ads->index].energy), 0, sizeof(otb_power_energy));
     otb_conf_ads_init_one(ads, ads->index);
     otb_conf->adss--;
+    otb_i2c_ads_conf_changed();
     rc = TRUE;
   }
   else
@@ -1669,6 +2791,34 @@ void ICACHE_FLASH_ATTR otb_i2c_ads_conf_get(char *addr, char *field, char *field
     case OTB_MQTT_I2C_ADS_FIELD_LOC_:
       os_snprintf(otb_i2c_mqtt_error, OTB_I2C_MQTT_ERROR_LEN, "%s", ads->loc);
       break;
+
+    case OTB_MQTT_I2C_ADS_FIELD_RDY_:
+      os_snprintf(otb_i2c_mqtt_error, OTB_I2C_MQTT_ERROR_LEN, "%d", ads->rdy);
+      break;
+
+    case OTB_MQTT_I2C_ADS_FIELD_BURDEN_:
+      os_snprintf(otb_i2c_mqtt_error, OTB_I2C_MQTT_ERROR_LEN, "%d", otb_conf->ads_cal[(int)ads->index].burden_mohm);
+      break;
+
+    case OTB_MQTT_I2C_ADS_FIELD_TURNS_:
+      os_snprintf(otb_i2c_mqtt_error, OTB_I2C_MQTT_ERROR_LEN, "%d", otb_conf->ads_cal[(int)ads->index].turns);
+      break;
+
+    case OTB_MQTT_I2C_ADS_FIELD_MAINS_:
+      os_snprintf(otb_i2c_mqtt_error, OTB_I2C_MQTT_ERROR_LEN, "%d", otb_conf->ads_cal[(int)ads->index].mains_v);
+      break;
+
+    case OTB_MQTT_I2C_ADS_FIELD_ENERGY_:
+      os_snprintf(otb_i2c_mqtt_error, OTB_I2C_MQTT_ERROR_LEN, "%d", otb_conf->ads_cal[(int)ads->index].energy);
+      break;
+
+    case OTB_MQTT_I2C_ADS_FIELD_HARMONICS_:
+      os_snprintf(otb_i2c_mqtt_error, OTB_I2C_MQTT_ERROR_LEN, "0x%02x", otb_conf->ads_cal[(int)ads->index].harmonics);
+      break;
+
+    case OTB_MQTT_I2C_ADS_FIELD_HZ_:
+      os_snprintf(otb_i2c_mqtt_error, OTB_I2C_MQTT_ERROR_LEN, "%d", otb_conf->ads_cal[(int)ads->index].mains_hz);
+      break;
     
     default:
       rc = FALSE;
@@ -1705,268 +2855,4 @@ EXIT_LABEL:
   return;
 }
 
-bool ICACHE_FLASH_ATTR otb_i2c_write_one_reg(uint8_t addr, uint8_t reg, uint8_t val)
-{
-  bool rc;
-
-  ENTRY;
-  
-  rc = otb_i2c_write_reg_seq(addr, reg, 1, &val);
-  
-  EXIT;
-  
-  return rc;
-}
-
-// Device must be in write sequential mode!
-bool ICACHE_RAM_ATTR otb_i2c_write_reg_seq(uint8_t addr, uint8_t reg, uint8_t count, uint8_t *val)
-{
-  uint8_t brzo_rc;
-  bool rc = FALSE;
-  int ii;
-
-  ENTRY;
-
-  brzo_i2c_start_transaction(addr, 100);
-  brzo_i2c_write(&reg, 1, FALSE);
-  brzo_i2c_write(val, count, FALSE);
-  brzo_rc = brzo_i2c_end_transaction();
-  if (!brzo_rc)
-  {
-    rc = TRUE;
-  }
-  
-  EXIT;
-
-  return rc;
-}
-
-bool ICACHE_FLASH_ATTR otb_i2c_read_one_reg(uint8_t addr, uint8_t reg, uint8_t *val)
-{
-  bool rc;
-
-  ENTRY;
-  
-  rc = otb_i2c_read_reg_seq(addr, reg, 1, val);
-  
-  EXIT;
-  
-  return rc;
-}
-
-// Note the device must be in sequential read mode for this to work!
-bool ICACHE_RAM_ATTR otb_i2c_read_reg_seq(uint8_t addr, uint8_t reg, uint8_t count, uint8_t *val)
-{
-  uint8_t brzo_rc;
-  bool rc = FALSE;
-  int ii;
-  
-  ENTRY;
-  
-  brzo_i2c_start_transaction(addr, 100);
-  brzo_i2c_write(&reg, 1, FALSE);
-  brzo_i2c_read(val, count, FALSE);
-  brzo_rc = brzo_i2c_end_transaction();
-  if (!brzo_rc)
-  {
-    rc = TRUE;
-  }
-  
-  EXIT;
-  
-  return rc;
-}
-
-bool ICACHE_RAM_ATTR otb_i2c_write_seq_vals(uint8_t addr, uint8_t count, uint8_t *val)
-{
-  uint8_t brzo_rc;
-  bool rc = FALSE;
-  
-  ENTRY;
-  
-  brzo_i2c_start_transaction(addr, 100);
-  brzo_i2c_write(val, count, FALSE);
-  brzo_rc = brzo_i2c_end_transaction();
-  if (!brzo_rc)
-  {
-    rc = TRUE;
-  }
-  
-  EXIT;
-  
-  return rc;
-}
-
-bool ICACHE_RAM_ATTR otb_i2c_write_one_val(uint8_t addr, uint8_t val)
-{
-  uint8_t brzo_rc;
-  bool rc = FALSE;
-  
-  ENTRY;
-  
-  brzo_i2c_start_transaction(addr, 100);
-  brzo_i2c_write(&val, 1, FALSE);
-  brzo_rc = brzo_i2c_end_transaction();
-  if (!brzo_rc)
-  {
-    rc = TRUE;
-  }
-  
-  EXIT;
-  
-  return rc;
-}
-
-bool ICACHE_RAM_ATTR otb_i2c_read_one_val(uint8_t addr, uint8_t *val)
-{
-  uint8_t brzo_rc;
-  bool rc = FALSE;
-  
-  ENTRY;
-
-  brzo_i2c_start_transaction(addr, 100);
-  brzo_i2c_read(val, 1, FALSE);
-  brzo_rc = brzo_i2c_end_transaction();
-  if (!brzo_rc)
-  {
-    rc = TRUE;
-  }
-
-  EXIT;
-  
-  return rc;
-}
-
-bool ICACHE_FLASH_ATTR otb_i2c_write_one_reg_info(uint8_t addr, uint8_t reg, uint8_t val, brzo_i2c_info *info)
-{
-  bool rc;
-
-  ENTRY;
-  
-  rc = otb_i2c_write_reg_seq_info(addr, reg, 1, &val, info);
-  
-  EXIT;
-  
-  return rc;
-}
-
-// Device must be in write sequential mode!
-bool ICACHE_RAM_ATTR otb_i2c_write_reg_seq_info(uint8_t addr, uint8_t reg, uint8_t count, uint8_t *val, brzo_i2c_info *info)
-{
-  uint8_t brzo_rc;
-  bool rc = FALSE;
-  int ii;
-
-  ENTRY;
-
-  brzo_i2c_start_transaction_info(addr, 100, info);
-  brzo_i2c_write_info(&reg, 1, TRUE, info);
-  brzo_i2c_write_info(val, count, FALSE, info);
-  brzo_rc = brzo_i2c_end_transaction_info(info);
-  if (!brzo_rc)
-  {
-    rc = TRUE;
-  }
-  
-  EXIT;
-
-  return rc;
-}
-
-bool ICACHE_FLASH_ATTR otb_i2c_read_one_reg_info(uint8_t addr, uint8_t reg, uint8_t *val, brzo_i2c_info *info)
-{
-  bool rc;
-
-  ENTRY;
-  
-  rc = otb_i2c_read_reg_seq_info(addr, reg, 1, val, info);
-  
-  EXIT;
-  
-  return rc;
-}
-
-// Note the device must be in sequential read mode for this to work!
-bool ICACHE_RAM_ATTR otb_i2c_read_reg_seq_info(uint8_t addr, uint8_t reg, uint8_t count, uint8_t *val, brzo_i2c_info *info)
-{
-  uint8_t brzo_rc;
-  bool rc = FALSE;
-  int ii;
-  
-  ENTRY;
-  
-  brzo_i2c_start_transaction_info(addr, 100, info);
-  brzo_i2c_write_info(&reg, 1, FALSE, info);
-  brzo_i2c_read_info(val, count, FALSE, info);
-  brzo_rc = brzo_i2c_end_transaction_info(info);
-  if (!brzo_rc)
-  {
-    rc = TRUE;
-  }
-  
-  EXIT;
-  
-  return rc;
-}
-
-bool ICACHE_RAM_ATTR otb_i2c_write_seq_vals_info(uint8_t addr, uint8_t count, uint8_t *val, brzo_i2c_info *info)
-{
-  uint8_t brzo_rc;
-  bool rc = FALSE;
-  
-  ENTRY;
-  
-  brzo_i2c_start_transaction_info(addr, 100, info);
-  brzo_i2c_write_info(val, count, FALSE, info);
-  brzo_rc = brzo_i2c_end_transaction_info(info);
-  if (!brzo_rc)
-  {
-    rc = TRUE;
-  }
-  
-  EXIT;
-  
-  return rc;
-}
-
-bool ICACHE_RAM_ATTR otb_i2c_write_one_val_info(uint8_t addr, uint8_t val, brzo_i2c_info *info)
-{
-  uint8_t brzo_rc;
-  bool rc = FALSE;
-  
-  ENTRY;
-  
-  brzo_i2c_start_transaction_info(addr, 100, info);
-  brzo_i2c_write_info(&val, 1, FALSE, info);
-  brzo_rc = brzo_i2c_end_transaction_info(info);
-  if (!brzo_rc)
-  {
-    rc = TRUE;
-  }
-  
-  EXIT;
-  
-  return rc;
-}
-
-bool ICACHE_RAM_ATTR otb_i2c_read_one_val_info(uint8_t addr, uint8_t *val, brzo_i2c_info *info)
-{
-  uint8_t brzo_rc;
-  bool rc = FALSE;
-  
-  ENTRY;
-
-  brzo_i2c_start_transaction_info(addr, 100, info);
-  brzo_i2c_read_info(val, 1, FALSE, info);
-  brzo_rc = brzo_i2c_end_transaction_info(info);
-  if (!brzo_rc)
-  {
-    rc = TRUE;
-  }
-
-  EXIT;
-  
-  return rc;
-}
-
 #endif // OTB_RBOOT_BOOTLOADER
@@ -59,7 +59,7 @@ void ICACHE_FLASH_ATTR otb_i2c_24xxyy_test_timerfunc(void)
     // On
     MDETAIL("Time to write");
     buf[0] = otb_i2c_24xxyy_next_byte;
-    rc = otb_i2c_24xxyy_write_bytes(otb_i2c_24xxyy_test_addr, word_addr, buf, 1, &otb_i2c_bus_internal);
+    rc = otb_i2c_24xxyy_write_bytes(otb_i2c_24xxyy_test_addr, word_addr, buf, 1, OTB_I2C_24XX00_PAGE_SIZE, &otb_i2c_bus_internal);
     if (!rc)
     {
       MWARN("Failed to communicate with 24XXYY");
@@ -113,49 +113,43 @@ EXIT_LABEL:
 
 #endif // OTB_RBOOT_BOOTLOADER
 
-bool ICACHE_FLASH_ATTR otb_i2c_24xxyy_read_bytes(uint8_t addr, uint8_t word_addr, uint8_t *bytes, uint8_t num_bytes, brzo_i2c_info *info)
+// Sets the device's address pointer to word_addr (word_addr_len bytes, MSB
+// first), then streams num_bytes sequentially from there.  The device
+// increments its own address pointer, so after the first chunk the rest are
+// current address reads - no need to send the address again.
+bool ICACHE_FLASH_ATTR otb_i2c_24xxyy_read_seq(uint8_t addr, uint8_t *word_addr, uint8_t word_addr_len, uint8_t *buf, uint16_t num_bytes, brzo_i2c_info *info)
 {
   bool rc = FALSE;
   uint8_t brzo_rc;
-  int ii;
-  uint8_t reg;
-  
+  uint16_t read;
+  uint16_t chunk;
+
   ENTRY;
 
-  // Need to write underlying functions to do sequential reads
-  for (ii = 0; ii < num_bytes; ii++)
+  for (read = 0; read < num_bytes; read += chunk)
   {
-    // First of all write the address 
-    brzo_i2c_start_transaction_info(addr, 100, info);
-    reg = word_addr+ii;
-    brzo_i2c_write_info(&reg, 1, FALSE, info);
-    brzo_rc = brzo_i2c_end_transaction_info(info);
-    if (!brzo_rc)
+    chunk = num_bytes - read;
+    if (chunk > OTB_I2C_24XXYY_READ_CHUNK)
     {
-      rc = TRUE;
+      chunk = OTB_I2C_24XXYY_READ_CHUNK;
     }
-    if (!rc)
-    {
-      MDETAIL("Failed to write addr: 0x%02x", word_addr + ii);
-      goto EXIT_LABEL;
-    }
-  
+
     brzo_i2c_start_transaction_info(addr, 100, info);
-    brzo_i2c_read_info(bytes+ii, 1, FALSE, info);
-    brzo_rc = brzo_i2c_end_transaction_info(info);
-    if (!brzo_rc)
+    if (read == 0)
     {
-      rc = TRUE;
+      brzo_i2c_write_info(word_addr, word_addr_len, FALSE, info);
     }
-    if (!rc)
+    brzo_i2c_read_info(buf+read, chunk, FALSE, info);
+    brzo_rc = brzo_i2c_end_transaction_info(info);
+    if (brzo_rc)
     {
-      MDETAIL("Failed to read addr: 0x%02x", word_addr + ii);
+      MDEBUG("Failed to read %d bytes at offset %d: %d", chunk, read, brzo_rc);
       goto EXIT_LABEL;
     }
   }
 
   rc = TRUE;
-  
+
 EXIT_LABEL:
 
   EXIT;
@@ -163,63 +157,107 @@ EXIT_LABEL:
   return rc;
 }
 
-bool ICACHE_FLASH_ATTR otb_i2c_24xxyy_write_bytes(uint8_t addr, uint8_t word_addr, uint8_t *bytes, uint8_t num_bytes, brzo_i2c_info *info)
+bool ICACHE_FLASH_ATTR otb_i2c_24xxyy_read_bytes(uint8_t addr, uint8_t word_addr, uint8_t *bytes, uint8_t num_bytes, brzo_i2c_info *info)
+{
+  bool rc;
+
+  ENTRY;
+
+  rc = otb_i2c_24xxyy_read_seq(addr, &word_addr, 1, bytes, num_bytes, info);
+  if (!rc)
+  {
+    MDETAIL("Failed to read from addr: 0x%02x", word_addr);
+  }
+
+  EXIT;
+
+  return rc;
+}
+
+// Writes num_bytes from word_addr, a page per write cycle.  Writes are split
+// at page boundaries (page_size must be a power of 2), as the device wraps
+// within a page rather than moving on to the next.  After each page the device
+// is ack polled until its write cycle completes, and the page read back to
+// check it.
+bool ICACHE_FLASH_ATTR otb_i2c_24xxyy_write_seq(uint8_t addr, uint16_t word_addr, uint8_t word_addr_len, uint8_t page_size, uint8_t *buf, uint16_t num_bytes, brzo_i2c_info *info)
 {
   bool rc = FALSE;
-  int ii;
-  int jj;
   uint8_t brzo_rc;
-  uint8_t buf[2];
-  uint8_t reg;
-  
+  uint8_t data[2+OTB_I2C_24XXYY_MAX_PAGE_SIZE];
+  uint8_t check[OTB_I2C_24XXYY_MAX_PAGE_SIZE];
+  uint16_t written;
+  uint16_t page_addr;
+  uint8_t chunk;
+  int polls;
+
   ENTRY;
 
-  // Need to write underlying functions to do sequential reads
-  for (ii = 0; ii < num_bytes; ii++)
+  OTB_ASSERT((page_size > 0) && (page_size <= OTB_I2C_24XXYY_MAX_PAGE_SIZE));
+  OTB_ASSERT(!(page_size & (page_size - 1)));
+  OTB_ASSERT((word_addr_len == 1) || (word_addr_len == 2));
+
+  for (written = 0; written < num_bytes; written += chunk)
   {
-    buf[0] = word_addr;
-    buf[1] = bytes[ii];
-    brzo_i2c_start_transaction_info(addr, 100, info);
-    brzo_i2c_write_info(buf, 2, FALSE, info);
-    brzo_rc = brzo_i2c_end_transaction_info(info);
-    if (!brzo_rc)
+    page_addr = word_addr + written;
+    chunk = page_size - (page_addr & (page_size - 1));
+    if (chunk > (num_bytes - written))
     {
-      rc = TRUE;
+      chunk = num_bytes - written;
     }
-    if (!rc)
+
+    if (word_addr_len == 2)
     {
-      MDETAIL("Failed to write addr: 0x%02x", word_addr + ii);
+      data[0] = page_addr >> 8;
+      data[1] = page_addr & 0xff;
+    }
+    else
+    {
+      data[0] = page_addr & 0xff;
+    }
+    os_memcpy(data+word_addr_len, buf+written, chunk);
+    brzo_i2c_start_transaction_info(addr, 100, info);
+    brzo_i2c_write_info(data, word_addr_len+chunk, FALSE, info);
+    brzo_rc = brzo_i2c_end_transaction_info(info);
+    if (brzo_rc)
+    {
+      MDETAIL("Failed to write %d bytes to addr: 0x%04x", chunk, page_addr);
       goto EXIT_LABEL;
     }
-    
-    // Now do ack polling to check write succeeded
-    rc = FALSE;
-    jj = 0;
-    while (!rc & jj < 100)
+
+    // The device doesn't ack its address until the write cycle is done.  Poll
+    // by writing the address of the page, ready for the read back.
+    for (polls = 1; polls <= OTB_I2C_24XXYY_WRITE_POLLS; polls++)
     {
+      os_delay_us(OTB_I2C_24XXYY_WRITE_POLL_US);
       brzo_i2c_start_transaction_info(addr, 100, info);
-      reg = word_addr+ii;
-      brzo_i2c_write_info(&reg, 1, FALSE, info);
+      brzo_i2c_write_info(data, word_addr_len, FALSE, info);
       brzo_rc = brzo_i2c_end_transaction_info(info);
       if (!brzo_rc)
       {
-        rc = TRUE;
+        break;
       }
-      jj++;
     }
-    if (!rc)
+    if (brzo_rc)
     {
-      MDETAIL("Device failed to perform write");
-      break;
+      MDETAIL("Device failed to perform write to addr: 0x%04x", page_addr);
+      goto EXIT_LABEL;
     }
-    else
+    MDEBUG("Wrote %d bytes to 0x%04x, polls: %d", chunk, page_addr, polls);
+
+    if (!otb_i2c_24xxyy_read_seq(addr, data, word_addr_len, check, chunk, info))
     {
-      MDETAIL("Polls: %d", jj+1);
+      MDETAIL("Failed to read back addr: 0x%04x", page_addr);
+      goto EXIT_LABEL;
+    }
+    if (os_memcmp(check, buf+written, chunk))
+    {
+      MDETAIL("Verify failed for %d bytes at addr: 0x%04x", chunk, page_addr);
+      goto EXIT_LABEL;
     }
   }
-  
+
   rc = TRUE;
-  
+
 EXIT_LABEL:
 
   EXIT;
@@ -227,6 +265,22 @@ EXIT_LABEL:
   return rc;
 }
 
+bool ICACHE_FLASH_ATTR otb_i2c_24xxyy_write_bytes(uint8_t addr, uint8_t word_addr, uint8_t *bytes, uint8_t num_bytes, uint8_t page_size, brzo_i2c_info *info)
+{
+  bool rc;
+
+  ENTRY;
+
+  // Don't let the write wrap around the end of the 8-bit address space
+  OTB_ASSERT((word_addr + num_bytes) <= 0x100);
+
+  rc = otb_i2c_24xxyy_write_seq(addr, word_addr, 1, page_size, bytes, num_bytes, info);
+
+  EXIT;
+
+  return rc;
+}
+
 #ifdef OTB_RBOOT_BOOTLOADER
 bool otb_i2c_24xxyy_init(uint8_t addr, brzo_i2c_info *info)
 #else
@@ -262,7 +316,6 @@ EXIT_LABEL:
 bool ICACHE_FLASH_ATTR otb_i2c_24xx128_read_data(uint8_t addr, uint16_t start_addr, uint16_t bytes, uint8_t *buf, brzo_i2c_info *info)
 {
   bool rc = FALSE;
-  uint8_t brzo_rc;
   uint8_t start_addr_b[2];
 
   // Reading is achieved as follows:
@@ -276,29 +329,39 @@ bool ICACHE_FLASH_ATTR otb_i2c_24xx128_read_data(uint8_t addr, uint16_t start_ad
 
   start_addr_b[0] = start_addr >> 8;
   start_addr_b[1] = start_addr & 0xff;
-  brzo_i2c_start_transaction_info(addr, 100, info);
-  brzo_i2c_write_info(start_addr_b, 2, FALSE, info);
-  brzo_rc = brzo_i2c_end_transaction_info(info);
-  if (brzo_rc)
+  rc = otb_i2c_24xxyy_read_seq(addr, start_addr_b, 2, buf, bytes, info);
+  if (!rc)
   {
-    MDEBUG("write of address to read from failed: %d", brzo_rc);
-    goto EXIT_LABEL;
+    MDEBUG("read of %d bytes from 0x%04x failed", bytes, start_addr);
   }
   
-  brzo_i2c_start_transaction_info(addr, 100, info);
-  brzo_i2c_read_info(buf, bytes, FALSE, info);
-  brzo_rc = brzo_i2c_end_transaction_info(info);
-  if (brzo_rc)
+  EXIT;
+  
+  return rc;
+}
+
+bool ICACHE_FLASH_ATTR otb_i2c_24xx128_write_data(uint8_t addr, uint16_t start_addr, uint16_t bytes, uint8_t *buf, brzo_i2c_info *info)
+{
+  bool rc;
+
+  ENTRY;
+
+  // 16 KB (128kbit) eeprom
+  OTB_ASSERT((start_addr + bytes) <= (128*1024/8));
+
+  rc = otb_i2c_24xxyy_write_seq(addr,
+                                start_addr,
+                                2,
+                                OTB_I2C_24XX128_PAGE_SIZE,
+                                buf,
+                                bytes,
+                                info);
+  if (!rc)
   {
-    MDEBUG("read failed: %d", brzo_rc);
-    goto EXIT_LABEL;
+    MDEBUG("write of %d bytes to 0x%04x failed", bytes, start_addr);
   }
-  
-  rc = TRUE;
-  
-EXIT_LABEL:
-  
+
   EXIT;
-  
+
   return rc;
 }
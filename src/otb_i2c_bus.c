@@ -0,0 +1,874 @@
+/*
+ * OTB-IOT - Out of The Box Internet Of Things
+ *
+ * Copyright (C) 2020 Piers Finlayson
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. 
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define OTB_I2C_BUS_C
+#include "otb.h"
+#include "brzo_i2c.h"
+
+MLOG("I2C");
+
+bool ICACHE_FLASH_ATTR otb_i2c_write_one_reg(uint8_t addr, uint8_t reg, uint8_t val)
+{
+  bool rc;
+
+  ENTRY;
+  
+  rc = otb_i2c_write_reg_seq(addr, reg, 1, &val);
+  
+  EXIT;
+  
+  return rc;
+}
+
+// Device must be in write sequential mode!
+bool ICACHE_RAM_ATTR otb_i2c_write_reg_seq(uint8_t addr, uint8_t reg, uint8_t count, uint8_t *val)
+{
+  uint8_t brzo_rc;
+  uint32_t start;
+  uint8_t buf[256];
+  bool rc = FALSE;
+  int ii;
+
+  ENTRY;
+
+  // brzo sends the address with each write, so the register and values must
+  // go in one
+  buf[0] = reg;
+  os_memcpy(buf + 1, val, count);
+  start = system_get_time();
+  brzo_i2c_start_transaction(addr, 100);
+  brzo_i2c_write(buf, count + 1, FALSE);
+  brzo_rc = brzo_i2c_end_transaction();
+  otb_i2c_stats_record(NULL, addr, start, count + 1, brzo_rc);
+  if (!brzo_rc)
+  {
+    rc = TRUE;
+  }
+  
+  EXIT;
+
+  return rc;
+}
+
+bool ICACHE_FLASH_ATTR otb_i2c_read_one_reg(uint8_t addr, uint8_t reg, uint8_t *val)
+{
+  bool rc;
+
+  ENTRY;
+  
+  rc = otb_i2c_read_reg_seq(addr, reg, 1, val);
+  
+  EXIT;
+  
+  return rc;
+}
+
+// Note the device must be in sequential read mode for this to work!
+bool ICACHE_RAM_ATTR otb_i2c_read_reg_seq(uint8_t addr, uint8_t reg, uint8_t count, uint8_t *val)
+{
+  uint8_t brzo_rc;
+  uint32_t start;
+  bool rc = FALSE;
+  int ii;
+  
+  ENTRY;
+  
+  start = system_get_time();
+  brzo_i2c_start_transaction(addr, 100);
+  brzo_i2c_write(&reg, 1, FALSE);
+  brzo_i2c_read(val, count, FALSE);
+  brzo_rc = brzo_i2c_end_transaction();
+  otb_i2c_stats_record(NULL, addr, start, 1 + count, brzo_rc);
+  if (!brzo_rc)
+  {
+    rc = TRUE;
+  }
+  
+  EXIT;
+  
+  return rc;
+}
+
+bool ICACHE_RAM_ATTR otb_i2c_write_seq_vals(uint8_t addr, uint8_t count, uint8_t *val)
+{
+  uint8_t brzo_rc;
+  uint32_t start;
+  bool rc = FALSE;
+  
+  ENTRY;
+  
+  start = system_get_time();
+  brzo_i2c_start_transaction(addr, 100);
+  brzo_i2c_write(val, count, FALSE);
+  brzo_rc = brzo_i2c_end_transaction();
+  otb_i2c_stats_record(NULL, addr, start, count, brzo_rc);
+  if (!brzo_rc)
+  {
+    rc = TRUE;
+  }
+  
+  EXIT;
+  
+  return rc;
+}
+
+bool ICACHE_RAM_ATTR otb_i2c_write_one_val(uint8_t addr, uint8_t val)
+{
+  uint8_t brzo_rc;
+  uint32_t start;
+  bool rc = FALSE;
+  
+  ENTRY;
+  
+  start = system_get_time();
+  brzo_i2c_start_transaction(addr, 100);
+  brzo_i2c_write(&val, 1, FALSE);
+  brzo_rc = brzo_i2c_end_transaction();
+  otb_i2c_stats_record(NULL, addr, start, 1, brzo_rc);
+  if (!brzo_rc)
+  {
+    rc = TRUE;
+  }
+  
+  EXIT;
+  
+  return rc;
+}
+
+bool ICACHE_RAM_ATTR otb_i2c_read_one_val(uint8_t addr, uint8_t *val)
+{
+  uint8_t brzo_rc;
+  uint32_t start;
+  bool rc = FALSE;
+  
+  ENTRY;
+
+  start = system_get_time();
+  brzo_i2c_start_transaction(addr, 100);
+  brzo_i2c_read(val, 1, FALSE);
+  brzo_rc = brzo_i2c_end_transaction();
+  otb_i2c_stats_record(NULL, addr, start, 1, brzo_rc);
+  if (!brzo_rc)
+  {
+    rc = TRUE;
+  }
+
+  EXIT;
+  
+  return rc;
+}
+
+bool ICACHE_FLASH_ATTR otb_i2c_write_one_reg_info(uint8_t addr, uint8_t reg, uint8_t val, brzo_i2c_info *info)
+{
+  bool rc;
+
+  ENTRY;
+  
+  rc = otb_i2c_write_reg_seq_info(addr, reg, 1, &val, info);
+  
+  EXIT;
+  
+  return rc;
+}
+
+// Device must be in write sequential mode!
+bool ICACHE_RAM_ATTR otb_i2c_write_reg_seq_info(uint8_t addr, uint8_t reg, uint8_t count, uint8_t *val, brzo_i2c_info *info)
+{
+  uint8_t brzo_rc;
+  uint32_t start;
+  uint8_t buf[256];
+  bool rc = FALSE;
+  int ii;
+
+  ENTRY;
+
+  // brzo sends the address with each write, so the register and values must
+  // go in one
+  buf[0] = reg;
+  os_memcpy(buf + 1, val, count);
+  start = system_get_time();
+  brzo_i2c_start_transaction_info(addr, 100, info);
+  brzo_i2c_write_info(buf, count + 1, FALSE, info);
+  brzo_rc = brzo_i2c_end_transaction_info(info);
+  otb_i2c_stats_record(info, addr, start, count + 1, brzo_rc);
+  if (!brzo_rc)
+  {
+    rc = TRUE;
+  }
+  
+  EXIT;
+
+  return rc;
+}
+
+bool ICACHE_FLASH_ATTR otb_i2c_read_one_reg_info(uint8_t addr, uint8_t reg, uint8_t *val, brzo_i2c_info *info)
+{
+  bool rc;
+
+  ENTRY;
+  
+  rc = otb_i2c_read_reg_seq_info(addr, reg, 1, val, info);
+  
+  EXIT;
+  
+  return rc;
+}
+
+// Note the device must be in sequential read mode for this to work!
+bool ICACHE_RAM_ATTR otb_i2c_read_reg_seq_info(uint8_t addr, uint8_t reg, uint8_t count, uint8_t *val, brzo_i2c_info *info)
+{
+  uint8_t brzo_rc;
+  uint32_t start;
+  bool rc = FALSE;
+  int ii;
+  
+  ENTRY;
+  
+  start = system_get_time();
+  brzo_i2c_start_transaction_info(addr, 100, info);
+  brzo_i2c_write_info(&reg, 1, FALSE, info);
+  brzo_i2c_read_info(val, count, FALSE, info);
+  brzo_rc = brzo_i2c_end_transaction_info(info);
+  otb_i2c_stats_record(info, addr, start, 1 + count, brzo_rc);
+  if (!brzo_rc)
+  {
+    rc = TRUE;
+  }
+  
+  EXIT;
+  
+  return rc;
+}
+
+bool ICACHE_RAM_ATTR otb_i2c_write_seq_vals_info(uint8_t addr, uint8_t count, uint8_t *val, brzo_i2c_info *info)
+{
+  uint8_t brzo_rc;
+  uint32_t start;
+  bool rc = FALSE;
+  
+  ENTRY;
+  
+  start = system_get_time();
+  brzo_i2c_start_transaction_info(addr, 100, info);
+  brzo_i2c_write_info(val, count, FALSE, info);
+  brzo_rc = brzo_i2c_end_transaction_info(info);
+  otb_i2c_stats_record(info, addr, start, count, brzo_rc);
+  if (!brzo_rc)
+  {
+    rc = TRUE;
+  }
+  
+  EXIT;
+  
+  return rc;
+}
+
+bool ICACHE_RAM_ATTR otb_i2c_write_one_val_info(uint8_t addr, uint8_t val, brzo_i2c_info *info)
+{
+  uint8_t brzo_rc;
+  uint32_t start;
+  bool rc = FALSE;
+  
+  ENTRY;
+  
+  start = system_get_time();
+  brzo_i2c_start_transaction_info(addr, 100, info);
+  brzo_i2c_write_info(&val, 1, FALSE, info);
+  brzo_rc = brzo_i2c_end_transaction_info(info);
+  otb_i2c_stats_record(info, addr, start, 1, brzo_rc);
+  if (!brzo_rc)
+  {
+    rc = TRUE;
+  }
+  
+  EXIT;
+  
+  return rc;
+}
+
+bool ICACHE_RAM_ATTR otb_i2c_read_one_val_info(uint8_t addr, uint8_t *val, brzo_i2c_info *info)
+{
+  uint8_t brzo_rc;
+  uint32_t start;
+  bool rc = FALSE;
+  
+  ENTRY;
+
+  start = system_get_time();
+  brzo_i2c_start_transaction_info(addr, 100, info);
+  brzo_i2c_read_info(val, 1, FALSE, info);
+  brzo_rc = brzo_i2c_end_transaction_info(info);
+  otb_i2c_stats_record(info, addr, start, 1, brzo_rc);
+  if (!brzo_rc)
+  {
+    rc = TRUE;
+  }
+
+  EXIT;
+  
+  return rc;
+}
+
+// Runs a transaction synchronously, returning the brzo result
+uint8_t ICACHE_FLASH_ATTR otb_i2c_txn_exec(otb_i2c_txn *txn)
+{
+  uint8_t brzo_rc;
+  uint32_t start;
+
+  ENTRY;
+
+  start = system_get_time();
+  if (txn->info != NULL)
+  {
+    brzo_i2c_start_transaction_info(txn->addr, 100, txn->info);
+    if (txn->wr_len > 0)
+    {
+      brzo_i2c_write_info(txn->wr, txn->wr_len, FALSE, txn->info);
+    }
+    if (txn->rd_len > 0)
+    {
+      brzo_i2c_read_info(txn->rd, txn->rd_len, FALSE, txn->info);
+    }
+    brzo_rc = brzo_i2c_end_transaction_info(txn->info);
+  }
+  else
+  {
+    brzo_i2c_start_transaction(txn->addr, 100);
+    if (txn->wr_len > 0)
+    {
+      brzo_i2c_write(txn->wr, txn->wr_len, FALSE);
+    }
+    if (txn->rd_len > 0)
+    {
+      brzo_i2c_read(txn->rd, txn->rd_len, FALSE);
+    }
+    brzo_rc = brzo_i2c_end_transaction();
+  }
+  otb_i2c_stats_record(txn->info, txn->addr, start, txn->wr_len + txn->rd_len, brzo_rc);
+
+  EXIT;
+
+  return brzo_rc;
+}
+
+otb_i2c_queue ICACHE_FLASH_ATTR *otb_i2c_queue_get(brzo_i2c_info *info)
+{
+  otb_i2c_queue *queue = NULL;
+  int ii;
+
+  ENTRY;
+
+  for (ii = 0; ii < OTB_I2C_QUEUE_MAX_BUSES; ii++)
+  {
+    if (otb_i2c_queues[ii].in_use && (otb_i2c_queues[ii].info == info))
+    {
+      queue = otb_i2c_queues + ii;
+      goto EXIT_LABEL;
+    }
+  }
+  for (ii = 0; ii < OTB_I2C_QUEUE_MAX_BUSES; ii++)
+  {
+    if (!otb_i2c_queues[ii].in_use)
+    {
+      queue = otb_i2c_queues + ii;
+      os_memset(queue, 0, sizeof(*queue));
+      queue->info = info;
+      queue->in_use = TRUE;
+      os_timer_disarm(&(queue->timer));
+      os_timer_setfn(&(queue->timer), (os_timer_func_t *)otb_i2c_queue_timer, queue);
+      goto EXIT_LABEL;
+    }
+  }
+  MWARN("No I2C queue available");
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return queue;
+}
+
+// Queues txns - a batch of one or more transactions chained via next, all on
+// the same bus.  Must be called from task context, not an interrupt.
+bool ICACHE_FLASH_ATTR otb_i2c_txn_submit(otb_i2c_txn *txns)
+{
+  bool rc = FALSE;
+  otb_i2c_queue *queue;
+  otb_i2c_txn *txn;
+
+  ENTRY;
+
+  OTB_ASSERT(txns != NULL);
+  queue = otb_i2c_queue_get(txns->info);
+  if (queue == NULL)
+  {
+    goto EXIT_LABEL;
+  }
+
+  for (txn = txns; txn != NULL; txn = txn->next)
+  {
+    OTB_ASSERT(txn->info == txns->info);
+    OTB_ASSERT(!txn->queued);
+    txn->queued = TRUE;
+    txn->batch_end = (txn->next == NULL);
+    txn->brzo_rc = 0;
+    if (queue->tail != NULL)
+    {
+      queue->tail->next = txn;
+    }
+    else
+    {
+      queue->head = txn;
+    }
+    queue->tail = txn;
+  }
+
+  if (!queue->scheduled)
+  {
+    queue->scheduled = TRUE;
+    os_timer_arm(&(queue->timer), 0, 0);
+  }
+  rc = TRUE;
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return rc;
+}
+
+void ICACHE_FLASH_ATTR otb_i2c_queue_timer(void *arg)
+{
+  otb_i2c_queue *queue = arg;
+  otb_i2c_txn *txn;
+  uint32_t start;
+
+  ENTRY;
+
+  queue->scheduled = FALSE;
+  start = system_get_time();
+
+  // Always run at least one transaction, so the queue makes progress however
+  // long each takes
+  while ((queue->head != NULL) &&
+         (!queue->scheduled) &&
+         ((system_get_time() - start) < OTB_I2C_QUEUE_SLICE_US))
+  {
+    txn = queue->head;
+    queue->head = txn->next;
+    if (queue->head == NULL)
+    {
+      queue->tail = NULL;
+    }
+    txn->next = NULL;
+
+    if (queue->skipping)
+    {
+      txn->brzo_rc = OTB_I2C_TXN_SKIPPED;
+    }
+    else
+    {
+      txn->brzo_rc = otb_i2c_txn_exec(txn);
+      if (txn->brzo_rc)
+      {
+        MDEBUG("I2C transaction to 0x%02x failed: %d", txn->addr, txn->brzo_rc);
+        if (txn->flags & OTB_I2C_TXN_FLAG_STOP_ON_ERROR)
+        {
+          queue->skipping = TRUE;
+        }
+      }
+    }
+    if (txn->batch_end)
+    {
+      queue->skipping = FALSE;
+    }
+
+    // The callback may submit more transactions (arming the timer if the
+    // queue was empty), so must come last
+    txn->queued = FALSE;
+    if (txn->cb != NULL)
+    {
+      txn->cb(txn);
+    }
+  }
+
+  if ((queue->head != NULL) && !queue->scheduled)
+  {
+    // Yield to the SDK and carry on where we left off
+    queue->scheduled = TRUE;
+    os_timer_arm(&(queue->timer), 0, 0);
+  }
+
+  EXIT;
+
+  return;
+}
+
+// Returns the device's counters, adding it if there's room, else NULL
+otb_i2c_stats ICACHE_FLASH_ATTR *otb_i2c_stats_get(brzo_i2c_info *info, uint8_t addr)
+{
+  otb_i2c_stats *stats = NULL;
+  otb_i2c_stats *entry;
+  int ii;
+
+  ENTRY;
+
+  // Most often the same device as last time
+  entry = otb_i2c_stats_table + otb_i2c_stats_last;
+  if (entry->in_use && (entry->info == info) && (entry->addr == addr))
+  {
+    stats = entry;
+    goto EXIT_LABEL;
+  }
+
+  // Entries are only freed by a reset, so the first unused one is the end
+  for (ii = 0; ii < OTB_I2C_STATS_MAX; ii++)
+  {
+    entry = otb_i2c_stats_table + ii;
+    if (!entry->in_use)
+    {
+      os_memset(entry, 0, sizeof(*entry));
+      entry->info = info;
+      entry->addr = addr;
+      entry->in_use = TRUE;
+      stats = entry;
+      break;
+    }
+    if ((entry->info == info) && (entry->addr == addr))
+    {
+      stats = entry;
+      break;
+    }
+  }
+  if (stats != NULL)
+  {
+    otb_i2c_stats_last = ii;
+  }
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return stats;
+}
+
+// Counts a transaction which began at start (system_get_time)
+void ICACHE_FLASH_ATTR otb_i2c_stats_record(brzo_i2c_info *info,
+                                            uint8_t addr,
+                                            uint32_t start,
+                                            uint16_t bytes,
+                                            uint8_t brzo_rc)
+{
+  otb_i2c_stats *stats;
+  uint32_t us;
+
+  ENTRY;
+
+  us = system_get_time() - start;
+  stats = otb_i2c_stats_get(info, addr);
+  if (stats != NULL)
+  {
+    stats->transactions++;
+    if (!brzo_rc)
+    {
+      stats->bytes += bytes;
+    }
+    else
+    {
+      stats->errors++;
+      if (brzo_rc & (OTB_I2C_BRZO_RC_WRITE_NAK | OTB_I2C_BRZO_RC_READ_NAK))
+      {
+        stats->naks++;
+      }
+      if (brzo_rc & OTB_I2C_BRZO_RC_CLOCK_STRETCH)
+      {
+        stats->stretch_timeouts++;
+      }
+    }
+    stats->busy_us += us;
+    if (stats->busy_us >= 1000)
+    {
+      stats->busy_ms += stats->busy_us / 1000;
+      stats->busy_us %= 1000;
+    }
+  }
+
+  EXIT;
+
+  return;
+}
+
+void ICACHE_FLASH_ATTR otb_i2c_stats_reset(void)
+{
+  ENTRY;
+
+  os_memset(otb_i2c_stats_table, 0, sizeof(otb_i2c_stats_table));
+  otb_i2c_stats_last = 0;
+
+  EXIT;
+
+  return;
+}
+
+// Totals the counters for every device on a bus
+void ICACHE_FLASH_ATTR otb_i2c_stats_sum(brzo_i2c_info *info, otb_i2c_stats *total)
+{
+  otb_i2c_stats *entry;
+  int ii;
+
+  ENTRY;
+
+  os_memset(total, 0, sizeof(*total));
+  total->info = info;
+  for (ii = 0; ii < OTB_I2C_STATS_MAX; ii++)
+  {
+    entry = otb_i2c_stats_table + ii;
+    if (entry->in_use && (entry->info == info))
+    {
+      total->in_use = TRUE;
+      total->transactions += entry->transactions;
+      total->bytes += entry->bytes;
+      total->errors += entry->errors;
+      total->naks += entry->naks;
+      total->stretch_timeouts += entry->stretch_timeouts;
+      total->busy_ms += entry->busy_ms;
+      total->busy_us += entry->busy_us;
+    }
+  }
+  total->busy_ms += total->busy_us / 1000;
+  total->busy_us %= 1000;
+
+  EXIT;
+
+  return;
+}
+
+// Adds one set of counters to the command response - the bus, and if
+// show_addr the device.  Returns FALSE if there's no room.
+static bool ICACHE_FLASH_ATTR otb_i2c_stats_rsp(otb_i2c_stats *stats, bool show_addr)
+{
+  bool rc = FALSE;
+  char bus[16];
+  char addr[8];
+  char buf[OTB_I2C_STATS_RSP_LEN];
+  int len;
+
+  ENTRY;
+
+  if (stats->info == NULL)
+  {
+    os_strcpy(bus, "default");
+  }
+  else
+  {
+    os_snprintf(bus, sizeof(bus), "sda%d_scl%d", stats->info->sda_pin, stats->info->scl_pin);
+  }
+  addr[0] = 0;
+  if (show_addr)
+  {
+    os_snprintf(addr, sizeof(addr), " 0x%02x", stats->addr);
+  }
+  len = os_snprintf(buf,
+                    sizeof(buf),
+                    "%s%s txns:%u bytes:%u errs:%u naks:%u stretch:%u busy_ms:%u",
+                    bus,
+                    addr,
+                    (unsigned int)stats->transactions,
+                    (unsigned int)stats->bytes,
+                    (unsigned int)stats->errors,
+                    (unsigned int)stats->naks,
+                    (unsigned int)stats->stretch_timeouts,
+                    (unsigned int)stats->busy_ms);
+
+  // Allow for the delimiter and NULL terminator
+  if ((len < 0) ||
+      ((uint32_t)len >= sizeof(buf)) ||
+      ((otb_cmd_rsp_next + len + 2) > OTB_CMD_RSP_MAX_LEN))
+  {
+    MDETAIL("No room for I2C stats");
+    goto EXIT_LABEL;
+  }
+  otb_cmd_rsp_append("%s", buf);
+  rc = TRUE;
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return rc;
+}
+
+// get/i2c/stats - totals for each bus
+// get/i2c/stats/<addr> - the device at addr, on each bus it's been seen on
+// trigger/i2c/stats/reset
+bool ICACHE_FLASH_ATTR otb_i2c_stats_cmd(unsigned char *next_cmd,
+                                         void *arg,
+                                         unsigned char *prev_cmd)
+{
+  bool rc = FALSE;
+  int cmd;
+  uint8_t addr;
+  otb_i2c_stats *entry;
+  otb_i2c_stats total;
+  int ii;
+  int jj;
+
+  ENTRY;
+
+  cmd = (int)(long)arg;
+  OTB_ASSERT((cmd == OTB_CMD_I2C_STATS_GET) || (cmd == OTB_CMD_I2C_STATS_RESET));
+
+  if (cmd == OTB_CMD_I2C_STATS_RESET)
+  {
+    otb_i2c_stats_reset();
+    rc = TRUE;
+    goto EXIT_LABEL;
+  }
+
+  if ((next_cmd != NULL) && (next_cmd[0] != 0))
+  {
+    if (!otb_i2c_mqtt_get_addr((char *)next_cmd, &addr))
+    {
+      otb_cmd_rsp_append("invalid address");
+      goto EXIT_LABEL;
+    }
+    for (ii = 0; ii < OTB_I2C_STATS_MAX; ii++)
+    {
+      entry = otb_i2c_stats_table + ii;
+      if (entry->in_use && (entry->addr == addr))
+      {
+        if (!otb_i2c_stats_rsp(entry, TRUE))
+        {
+          break;
+        }
+        rc = TRUE;
+      }
+    }
+    if (!rc)
+    {
+      otb_cmd_rsp_append("no stats for address");
+    }
+    goto EXIT_LABEL;
+  }
+
+  // Total each bus the first time it's found in the table
+  for (ii = 0; ii < OTB_I2C_STATS_MAX; ii++)
+  {
+    entry = otb_i2c_stats_table + ii;
+    if (!entry->in_use)
+    {
+      break;
+    }
+    for (jj = 0; jj < ii; jj++)
+    {
+      if (otb_i2c_stats_table[jj].info == entry->info)
+      {
+        break;
+      }
+    }
+    if (jj == ii)
+    {
+      otb_i2c_stats_sum(entry->info, &total);
+      if (!otb_i2c_stats_rsp(&total, FALSE))
+      {
+        break;
+      }
+    }
+  }
+  rc = TRUE;
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return rc;
+}
+
+// Returns the device's shadow registers, adding it (with no registers
+// valid) if there's room, else NULL - in which case the driver just doesn't
+// get to skip anything
+otb_i2c_shadow ICACHE_FLASH_ATTR *otb_i2c_shadow_get(brzo_i2c_info *info, uint8_t addr)
+{
+  otb_i2c_shadow *shadow = NULL;
+  otb_i2c_shadow *entry;
+  int ii;
+
+  ENTRY;
+
+  for (ii = 0; ii < OTB_I2C_SHADOW_MAX; ii++)
+  {
+    entry = otb_i2c_shadows + ii;
+    if (!entry->in_use)
+    {
+      os_memset(entry, 0, sizeof(*entry));
+      entry->info = info;
+      entry->addr = addr;
+      entry->in_use = TRUE;
+      shadow = entry;
+      break;
+    }
+    if ((entry->info == info) && (entry->addr == addr))
+    {
+      shadow = entry;
+      break;
+    }
+  }
+  if (shadow == NULL)
+  {
+    MDETAIL("No room to shadow 0x%02x", addr);
+  }
+
+  EXIT;
+
+  return shadow;
+}
+
+// Forgets every device's shadow registers - so the next write to each goes
+// out regardless
+void ICACHE_FLASH_ATTR otb_i2c_shadow_reset(void)
+{
+  ENTRY;
+
+  os_memset(otb_i2c_shadows, 0, sizeof(otb_i2c_shadows));
+
+  EXIT;
+
+  return;
+}
+
+// Forgets the shadow registers of every device on a bus, when the bus is
+// (re)initialized - as its devices may have been reset or replaced
+void ICACHE_FLASH_ATTR otb_i2c_shadow_reset_bus(brzo_i2c_info *info)
+{
+  int ii;
+
+  ENTRY;
+
+  for (ii = 0; ii < OTB_I2C_SHADOW_MAX; ii++)
+  {
+    if (otb_i2c_shadows[ii].in_use && (otb_i2c_shadows[ii].info == info))
+    {
+      otb_i2c_shadows[ii].valid = 0;
+    }
+  }
+
+  EXIT;
+
+  return;
+}
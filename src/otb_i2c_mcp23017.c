@@ -44,10 +44,19 @@ bool ICACHE_FLASH_ATTR otb_i2c_mcp23017_init(uint8_t addr, brzo_i2c_info *info)
 {
   bool rc = FALSE;
   uint8_t conf;
+  uint8_t vals[2];
+  otb_i2c_shadow *shadow;
 
   ENTRY;
 
-  // Set the mode
+  // Whatever state the device was in is forgotten until written below
+  shadow = otb_i2c_shadow_get(info, addr);
+  if (shadow != NULL)
+  {
+    shadow->valid = 0;
+  }
+
+  // Set the mode - BANK = 0, SEQOP = 0, so registers can be written in pairs
   conf = 0;
   rc = otb_i2c_write_one_reg_info(addr, OTB_I2C_MCP23017_REG_IOCON1, conf, info);
   if (!rc)
@@ -57,33 +66,27 @@ bool ICACHE_FLASH_ATTR otb_i2c_mcp23017_init(uint8_t addr, brzo_i2c_info *info)
   }
 
   // Set direction of all ports to output  
-  rc = otb_i2c_write_one_reg_info(addr, OTB_I2C_MCP23017_REG_IODIRA, 0, info);
+  vals[0] = 0;
+  vals[1] = 0;
+  rc = otb_i2c_write_reg_seq_info(addr, OTB_I2C_MCP23017_REG_IODIRA, 2, vals, info);
   if (!rc)
   {
     MWARN("Failed to write a reg");
     goto EXIT_LABEL;
   }
 
-  rc = otb_i2c_write_one_reg_info(addr, OTB_I2C_MCP23017_REG_GPIOA, 0, info);
+  rc = otb_i2c_write_reg_seq_info(addr, OTB_I2C_MCP23017_REG_GPIOA, 2, vals, info);
   if (!rc)
   {
     MWARN("Failed to write a reg");
     goto EXIT_LABEL;
   }
 
-  // Set direction of all ports to output  
-  rc = otb_i2c_write_one_reg_info(addr, OTB_I2C_MCP23017_REG_IODIRB, 0, info);
-  if (!rc)
+  if (shadow != NULL)
   {
-    MWARN("Failed to write a reg");
-    goto EXIT_LABEL;
-  }
-
-  rc = otb_i2c_write_one_reg_info(addr, OTB_I2C_MCP23017_REG_GPIOB, 0, info);
-  if (!rc)
-  {
-    MWARN("Failed to write a reg");
-    goto EXIT_LABEL;
+    shadow->reg[OTB_I2C_MCP23017_SHADOW_OLATA] = 0;
+    shadow->reg[OTB_I2C_MCP23017_SHADOW_OLATB] = 0;
+    shadow->valid = (1 << OTB_I2C_MCP23017_SHADOW_OLATA) | (1 << OTB_I2C_MCP23017_SHADOW_OLATB);
   }
 
   rc = TRUE;
@@ -95,26 +98,75 @@ EXIT_LABEL:
   return rc;
 }
 
-// GPA and GPB format: 0b76543210
+// GPA and GPB format: 0b76543210.  Only ports whose output latch isn't
+// already known to hold the value are written - so nothing is written if
+// neither has changed.
 bool ICACHE_FLASH_ATTR otb_i2c_mcp23017_write_gpios(uint8_t gpa, uint8_t gpb, uint8_t addr, brzo_i2c_info *info)
 {
   bool rc = FALSE;
+  otb_i2c_shadow *shadow;
+  uint8_t vals[2];
+  bool write_a = TRUE;
+  bool write_b = TRUE;
 
   ENTRY;
 
   MDEBUG("Write 0x%02x 0x%02x", gpa, gpb);
 
-  rc = otb_i2c_write_one_reg_info(addr, OTB_I2C_MCP23017_REG_GPIOA, gpa, info);
-  if (!rc)
+  vals[0] = gpa;
+  vals[1] = gpb;
+  shadow = otb_i2c_shadow_get(info, addr);
+  if (shadow != NULL)
+  {
+    write_a = !(shadow->valid & (1 << OTB_I2C_MCP23017_SHADOW_OLATA)) ||
+              (shadow->reg[OTB_I2C_MCP23017_SHADOW_OLATA] != gpa);
+    write_b = !(shadow->valid & (1 << OTB_I2C_MCP23017_SHADOW_OLATB)) ||
+              (shadow->reg[OTB_I2C_MCP23017_SHADOW_OLATB] != gpb);
+  }
+
+  if (write_a && write_b)
+  {
+    rc = otb_i2c_write_reg_seq_info(addr, OTB_I2C_MCP23017_REG_GPIOA, 2, vals, info);
+  }
+  else if (write_a)
+  {
+    rc = otb_i2c_write_one_reg_info(addr, OTB_I2C_MCP23017_REG_GPIOA, gpa, info);
+  }
+  else if (write_b)
   {
-    MWARN("Failed to write GPA value");
+    rc = otb_i2c_write_one_reg_info(addr, OTB_I2C_MCP23017_REG_GPIOB, gpb, info);
+  }
+  else
+  {
+    MDEBUG("Unchanged");
+    rc = TRUE;
     goto EXIT_LABEL;
   }
 
-  rc = otb_i2c_write_one_reg_info(addr, OTB_I2C_MCP23017_REG_GPIOB, gpb, info);
+  if (shadow != NULL)
+  {
+    if (rc)
+    {
+      shadow->reg[OTB_I2C_MCP23017_SHADOW_OLATA] = gpa;
+      shadow->reg[OTB_I2C_MCP23017_SHADOW_OLATB] = gpb;
+      shadow->valid |= (1 << OTB_I2C_MCP23017_SHADOW_OLATA) | (1 << OTB_I2C_MCP23017_SHADOW_OLATB);
+    }
+    else
+    {
+      // Don't know whether the write got through
+      if (write_a)
+      {
+        shadow->valid &= ~(1 << OTB_I2C_MCP23017_SHADOW_OLATA);
+      }
+      if (write_b)
+      {
+        shadow->valid &= ~(1 << OTB_I2C_MCP23017_SHADOW_OLATB);
+      }
+    }
+  }
   if (!rc)
   {
-    MWARN("Failed to write GPB value");
+    MWARN("Failed to write GPIO values");
     goto EXIT_LABEL;
   }
 
@@ -125,29 +177,67 @@ EXIT_LABEL:
   return rc;
 }
 
-// GPA and GPB format: 0b76543210
-bool ICACHE_FLASH_ATTR otb_i2c_mcp23017_read_gpios(uint8_t *gpa, uint8_t *gpb, uint8_t addr, brzo_i2c_info *info)
+// Sets a single output - pin 0-7 is GPA0-7, 8-15 GPB0-7.  One write, of just
+// that pin's port, unless the port's output latch isn't known, in which
+// case it's read first.
+bool ICACHE_FLASH_ATTR otb_i2c_mcp23017_write_gpio(uint8_t pin, bool value, uint8_t addr, brzo_i2c_info *info)
 {
   bool rc = FALSE;
+  otb_i2c_shadow *shadow;
+  uint8_t port;
+  uint8_t olat;
+  uint8_t new_olat;
 
   ENTRY;
 
-  rc = otb_i2c_read_reg_seq_info(addr, OTB_I2C_MCP23017_REG_GPIOA, 1, gpa, info);
-  if (!rc)
+  OTB_ASSERT(pin < OTB_I2C_MCP23017_REG_IO_NUM);
+  port = pin / 8;
+
+  shadow = otb_i2c_shadow_get(info, addr);
+  if ((shadow != NULL) &&
+      (shadow->valid & (1 << (OTB_I2C_MCP23017_SHADOW_OLATA + port))))
   {
-    MWARN("Failed to read GPA value");
+    olat = shadow->reg[OTB_I2C_MCP23017_SHADOW_OLATA + port];
+  }
+  else
+  {
+    rc = otb_i2c_read_one_reg_info(addr, OTB_I2C_MCP23017_REG_OLATA + port, &olat, info);
+    if (!rc)
+    {
+      MWARN("Failed to read output latch");
+      goto EXIT_LABEL;
+    }
+  }
+
+  new_olat = value ? (olat | (1 << (pin % 8))) : (olat & ~(1 << (pin % 8)));
+  if ((shadow != NULL) &&
+      (shadow->valid & (1 << (OTB_I2C_MCP23017_SHADOW_OLATA + port))) &&
+      (new_olat == olat))
+  {
+    MDEBUG("Pin %d unchanged", pin);
+    rc = TRUE;
     goto EXIT_LABEL;
   }
 
-  rc = otb_i2c_read_reg_seq_info(addr, OTB_I2C_MCP23017_REG_GPIOB, 1, gpb, info);
+  rc = otb_i2c_write_one_reg_info(addr, OTB_I2C_MCP23017_REG_GPIOA + port, new_olat, info);
+  if (shadow != NULL)
+  {
+    if (rc)
+    {
+      shadow->reg[OTB_I2C_MCP23017_SHADOW_OLATA + port] = new_olat;
+      shadow->valid |= (1 << (OTB_I2C_MCP23017_SHADOW_OLATA + port));
+    }
+    else
+    {
+      shadow->valid &= ~(1 << (OTB_I2C_MCP23017_SHADOW_OLATA + port));
+    }
+  }
   if (!rc)
   {
-    MWARN("Failed to read GPB value");
+    MWARN("Failed to write pin %d", pin);
     goto EXIT_LABEL;
   }
 
-  MDEBUG("Read  0x%02x 0x%02x", *gpa, *gpb);
-
 EXIT_LABEL:
 
   EXIT;
@@ -155,7 +245,29 @@ EXIT_LABEL:
   return rc;
 }
 
+// GPA and GPB format: 0b76543210
+bool ICACHE_FLASH_ATTR otb_i2c_mcp23017_read_gpios(uint8_t *gpa, uint8_t *gpb, uint8_t addr, brzo_i2c_info *info)
+{
+  bool rc = FALSE;
+  uint8_t vals[2];
+
+  ENTRY;
+
+  // GPIOB follows GPIOA, so both in one
+  rc = otb_i2c_read_reg_seq_info(addr, OTB_I2C_MCP23017_REG_GPIOA, 2, vals, info);
+  if (!rc)
+  {
+    MWARN("Failed to read GPIO values");
+    goto EXIT_LABEL;
+  }
+  *gpa = vals[0];
+  *gpb = vals[1];
 
+  MDEBUG("Read  0x%02x 0x%02x", *gpa, *gpb);
 
+EXIT_LABEL:
 
+  EXIT;
 
+  return rc;
+}
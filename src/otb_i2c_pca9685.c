@@ -127,8 +127,8 @@ bool ICACHE_FLASH_ATTR otb_i2c_pca_gpio_cmd(unsigned char *next_cmd,
         otb_gpio_set(otb_i2c_pca9685_sda, 1, FALSE);
         otb_gpio_set(otb_i2c_pca9685_scl, 1, FALSE);
         otb_i2c_initialize_bus(&otb_i2c_pca9685_brzo_i2c_info, otb_i2c_pca9685_sda, otb_i2c_pca9685_scl);
-        os_memset(otb_i2c_pca9685_desired_state, 0, sizeof(uint8_t));
-        os_memset(otb_i2c_pca9685_current_state, 0, sizeof(uint8_t));
+        os_memset(otb_i2c_pca9685_desired_state, 0, sizeof(otb_i2c_pca9685_desired_state));
+        os_memset(otb_i2c_pca9685_current_state, OTB_I2C_PCA9685_STATE_UNKNOWN, sizeof(otb_i2c_pca9685_current_state));
 
         // Initialize the PCA9685
         rc = otb_i2c_pca9685_init2();
@@ -275,47 +275,45 @@ EXIT_LABEL:
 bool ICACHE_FLASH_ATTR otb_i2c_pca9685_set2()
 {
   bool rc = FALSE;
-  uint8_t bytes[5];
-  uint8_t brzo_rc;
+  otb_i2c_pca9685_frame *frame = &otb_i2c_pca9685_gpio_frame;
+  uint16_t staged;
   int ii;
   uint8_t desired_state;
 
   ENTRY;
 
-  bytes[1] = 0b0;
-  bytes[3] = 0b0;
+  // Stage the pins which need changing, then write them together
+  otb_i2c_pca9685_frame_clear(frame);
   for (ii = 0; ii < OTB_I2C_PCA9685_NUM_PINS; ii++)
   {
     desired_state = otb_i2c_pca9685_desired_state[ii] ? 1 : 0;
-    bytes[0] = OTB_I2C_PCA9685_REG_IO0_ON_L + (ii * 4);
-    bytes[2] = 0b0;
-    bytes[4] = 0b0;
-    if (desired_state)
+    if (otb_i2c_pca9685_current_state[ii] == desired_state)
     {
-      bytes[2]= 0b00010000;
+      // Already set - nothing to write
+      continue;
     }
-    else
+    otb_i2c_pca9685_frame_set_state(frame, ii, desired_state);
+  }
+
+  staged = frame->staged;
+  rc = otb_i2c_pca9685_frame_write(frame, otb_i2c_pca9685_addr, &otb_i2c_pca9685_brzo_i2c_info);
+  for (ii = 0; ii < OTB_I2C_PCA9685_NUM_PINS; ii++)
+  {
+    if (!(staged & (1 << ii)))
     {
-      bytes[4]= 0b00010000;
+      continue;
     }
-    brzo_i2c_start_transaction_info(otb_i2c_pca9685_addr, 100, &otb_i2c_pca9685_brzo_i2c_info);
-    brzo_i2c_write_info(bytes, 5, FALSE, &otb_i2c_pca9685_brzo_i2c_info);
-    brzo_rc = brzo_i2c_end_transaction_info(&otb_i2c_pca9685_brzo_i2c_info);
-    if (brzo_rc)
+    if (frame->staged & (1 << ii))
     {
-      MDETAIL("Failed to set pin: %d, rc: %d", ii, brzo_rc);
-      rc = FALSE;
-      goto EXIT_LABEL;
+      // Failed - so may or may not have been written
+      otb_i2c_pca9685_current_state[ii] = OTB_I2C_PCA9685_STATE_UNKNOWN;
+    }
+    else
+    {
+      otb_i2c_pca9685_current_state[ii] = otb_i2c_pca9685_desired_state[ii] ? 1 : 0;
     }
-    otb_i2c_pca9685_current_state[ii] = desired_state;
-    bytes[2] = 0b0;
-    bytes[4] = 0b0;
   }
 
-  rc = TRUE;
-
-EXIT_LABEL:
-
   EXIT;
 
   return rc;
@@ -389,54 +387,23 @@ bool ICACHE_FLASH_ATTR otb_i2c_pca9685_led_conf(uint8_t addr, uint8_t led, uint1
 {
   bool rc = FALSE;
   uint8_t byte[4];
-  int ii;
   uint8_t reg;
   
   ENTRY;
 
-  // on and off are only 13-bit values
-  OTB_ASSERT(!(on & 0b1110000000000000));
-  OTB_ASSERT(!(off & 0b1110000000000000));
-  
-  // Can't be fully off _and_ on at the same time!
-  OTB_ASSERT(!((on & OTB_I2C_PCA9685_IO_FULL_ON) && (off & OTB_I2C_PCA9685_IO_FULL_OFF)));
+  otb_i2c_pca9685_check_led(led, on, off);
   
-  // Can't be fully on and have other on values - or fully off and other off values
-  OTB_ASSERT(!((on & OTB_I2C_PCA9685_IO_FULL_ON) && (on & 0b111111111111))); 
-  OTB_ASSERT(!((off & OTB_I2C_PCA9685_IO_FULL_ON) && (off & 0b111111111111))); 
-  
-  // Can't be fully on and have off values, or vice versa
-  OTB_ASSERT(!((on & OTB_I2C_PCA9685_IO_FULL_ON) && (off & 0b111111111111))); 
-  OTB_ASSERT(!((off & OTB_I2C_PCA9685_IO_FULL_ON) && (on & 0b111111111111))); 
-  
-#if 0  
   byte[0] = on & 0xff;
   byte[1] = on >> 8;
   byte[2] = off & 0xff;
   byte[3] = off >> 8;
 
-  OTB_ASSERT((led >= 0) && (led < OTB_I2C_PCA9685_REG_IO_NUM)); 
-  //reg = OTB_I2C_PCA9685_REG_IO0_ON_L + (led * 4);
-  reg = 0xfa;
+  // Just this LED's registers - not ALL_LED
+  reg = OTB_I2C_PCA9685_REG_IO0_ON_L + (led * OTB_I2C_PCA9685_REG_IO_LEN);
   rc = otb_i2c_write_reg_seq(addr, reg, 4, byte);
   if (!rc)
   {
-    goto EXIT_LABEL;
-  }
-#endif
-  unsigned char bytes[5];
-  bytes[0] = 0xfa;
-  bytes[1] = on & 0xff;
-  bytes[2] = on >> 8;
-  bytes[3] = off & 0xff;
-  bytes[4] = off >> 8;
-  brzo_i2c_start_transaction(addr, 100);
-  brzo_i2c_write(bytes, 5, FALSE);
-  rc = brzo_i2c_end_transaction(); 
-  if (rc)
-  {
-    MDETAIL("Failed %d", rc);
-    rc = FALSE;
+    MDETAIL("Failed to set LED %d", led);
     goto EXIT_LABEL;
   }
 
@@ -0,0 +1,203 @@
+/*
+ * OTB-IOT - Out of The Box Internet Of Things
+ *
+ * Copyright (C) 2020 Piers Finlayson
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// PCA9685 frames - kept apart from otb_i2c_pca9685.c (which is tied to the
+// command and config code) so they can be tested on the host.
+
+#include "otb.h"
+
+MLOG("PCA9685");
+
+void ICACHE_FLASH_ATTR otb_i2c_pca9685_check_led(uint8_t led, uint16_t on, uint16_t off)
+{
+  ENTRY;
+
+  OTB_ASSERT(led < OTB_I2C_PCA9685_NUM_PINS);
+
+  // on and off are only 13-bit values
+  OTB_ASSERT(!(on & 0b1110000000000000));
+  OTB_ASSERT(!(off & 0b1110000000000000));
+
+  // Can't be fully off _and_ on at the same time!
+  OTB_ASSERT(!((on & OTB_I2C_PCA9685_IO_FULL_ON) && (off & OTB_I2C_PCA9685_IO_FULL_OFF)));
+
+  // Can't be fully on and have other on values - or fully off and other off values
+  OTB_ASSERT(!((on & OTB_I2C_PCA9685_IO_FULL_ON) && (on & 0b111111111111)));
+  OTB_ASSERT(!((off & OTB_I2C_PCA9685_IO_FULL_ON) && (off & 0b111111111111)));
+
+  // Can't be fully on and have off values, or vice versa
+  OTB_ASSERT(!((on & OTB_I2C_PCA9685_IO_FULL_ON) && (off & 0b111111111111)));
+  OTB_ASSERT(!((off & OTB_I2C_PCA9685_IO_FULL_ON) && (on & 0b111111111111)));
+
+  EXIT;
+
+  return;
+}
+
+void ICACHE_FLASH_ATTR otb_i2c_pca9685_frame_clear(otb_i2c_pca9685_frame *frame)
+{
+  ENTRY;
+
+  os_memset(frame, 0, sizeof(*frame));
+
+  EXIT;
+
+  return;
+}
+
+void ICACHE_FLASH_ATTR otb_i2c_pca9685_frame_set(otb_i2c_pca9685_frame *frame, uint8_t led, uint16_t on, uint16_t off)
+{
+  ENTRY;
+
+  otb_i2c_pca9685_check_led(led, on, off);
+
+  frame->led[led][OTB_I2C_PCA9685_REG_IO_ON_L] = on & 0xff;
+  frame->led[led][OTB_I2C_PCA9685_REG_IO_ON_H] = on >> 8;
+  frame->led[led][OTB_I2C_PCA9685_REG_IO_OFF_L] = off & 0xff;
+  frame->led[led][OTB_I2C_PCA9685_REG_IO_OFF_H] = off >> 8;
+  frame->staged |= (1 << led);
+
+  EXIT;
+
+  return;
+}
+
+// Fully on or fully off
+void ICACHE_FLASH_ATTR otb_i2c_pca9685_frame_set_state(otb_i2c_pca9685_frame *frame, uint8_t led, bool on)
+{
+  ENTRY;
+
+  if (on)
+  {
+    otb_i2c_pca9685_frame_set(frame, led, OTB_I2C_PCA9685_IO_FULL_ON, 0);
+  }
+  else
+  {
+    otb_i2c_pca9685_frame_set(frame, led, 0, OTB_I2C_PCA9685_IO_FULL_OFF);
+  }
+
+  EXIT;
+
+  return;
+}
+
+// Fills in frame->txn, chained via next, to write the staged channels -
+// returning how many there are (also in frame->txns).  The caller can then
+// set flags and callbacks and submit them, or use otb_i2c_pca9685_frame_write
+// to run them now.  Staged bits are left for the caller to clear.
+uint8_t ICACHE_FLASH_ATTR otb_i2c_pca9685_frame_build(otb_i2c_pca9685_frame *frame, uint8_t addr, brzo_i2c_info *info)
+{
+  otb_i2c_txn *txn = NULL;
+  uint8_t *wr;
+  uint8_t first;
+  uint8_t num;
+  int ii;
+
+  ENTRY;
+
+  frame->txns = 0;
+  wr = frame->wr;
+  for (ii = 0; ii < OTB_I2C_PCA9685_NUM_PINS; ii++)
+  {
+    if (!(frame->staged & (1 << ii)))
+    {
+      continue;
+    }
+
+    // Find the end of this run
+    first = ii;
+    for (num = 1; (ii + 1) < OTB_I2C_PCA9685_NUM_PINS; ii++, num++)
+    {
+      if (!(frame->staged & (1 << (ii + 1))))
+      {
+        break;
+      }
+    }
+    OTB_ASSERT(frame->txns < OTB_I2C_PCA9685_FRAME_MAX_RUNS);
+
+    if (txn != NULL)
+    {
+      txn->next = frame->txn + frame->txns;
+    }
+    txn = frame->txn + frame->txns;
+    os_memset(txn, 0, sizeof(*txn));
+    txn->info = info;
+    txn->addr = addr;
+    txn->wr = wr;
+    txn->wr_len = 1 + (num * OTB_I2C_PCA9685_REG_IO_LEN);
+    wr[0] = OTB_I2C_PCA9685_REG_IO0_ON_L + (first * OTB_I2C_PCA9685_REG_IO_LEN);
+    os_memcpy(wr + 1, frame->led[first], num * OTB_I2C_PCA9685_REG_IO_LEN);
+    wr += txn->wr_len;
+    frame->txns++;
+  }
+  OTB_ASSERT(wr <= (frame->wr + OTB_I2C_PCA9685_FRAME_WR_LEN));
+
+  MDEBUG("%d channels in %d transaction(s)", (int)((wr - frame->wr) / OTB_I2C_PCA9685_REG_IO_LEN), frame->txns);
+
+  EXIT;
+
+  return frame->txns;
+}
+
+// Which channels one of a frame's transactions writes
+void ICACHE_FLASH_ATTR otb_i2c_pca9685_frame_txn_leds(otb_i2c_txn *txn, uint8_t *first, uint8_t *num)
+{
+  ENTRY;
+
+  *first = (txn->wr[0] - OTB_I2C_PCA9685_REG_IO0_ON_L) / OTB_I2C_PCA9685_REG_IO_LEN;
+  *num = (txn->wr_len - 1) / OTB_I2C_PCA9685_REG_IO_LEN;
+
+  EXIT;
+
+  return;
+}
+
+// Writes the staged channels now, stopping at the first failure.  Channels
+// which were written are unstaged - so on failure frame->staged shows which
+// weren't.
+bool ICACHE_FLASH_ATTR otb_i2c_pca9685_frame_write(otb_i2c_pca9685_frame *frame, uint8_t addr, brzo_i2c_info *info)
+{
+  bool rc = TRUE;
+  uint8_t brzo_rc;
+  uint8_t first;
+  uint8_t num;
+  int ii;
+
+  ENTRY;
+
+  otb_i2c_pca9685_frame_build(frame, addr, info);
+  for (ii = 0; ii < frame->txns; ii++)
+  {
+    otb_i2c_pca9685_frame_txn_leds(frame->txn + ii, &first, &num);
+    brzo_rc = otb_i2c_txn_exec(frame->txn + ii);
+    if (brzo_rc)
+    {
+      MDETAIL("Failed to write channels %d-%d, rc: %d", first, first + num - 1, brzo_rc);
+      rc = FALSE;
+      goto EXIT_LABEL;
+    }
+    frame->staged &= ~(((1 << num) - 1) << first);
+  }
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return rc;
+}
@@ -91,34 +91,41 @@ bool ICACHE_FLASH_ATTR otb_i2c_pcf8574_led_conf(uint8_t addr, uint8_t led, bool
   bool rc = FALSE;
   uint8_t io;
   uint8_t gpio_val;
-  int ii;
-  uint8_t reg;
+  otb_i2c_shadow *shadow;
   
   ENTRY;
 
-  // Figure out which bit within this register this led is on
-  io = 1 << (led|8);
+  OTB_ASSERT(led < OTB_I2C_PCF8574_REG_IO_NUM);
 
-#if 0
-  rc = otb_i2c_read_one_val(addr, &gpio_val);
-  if (!rc)
+  // Figure out which bit this led is on
+  io = 1 << led;
+
+  shadow = otb_i2c_shadow_get(NULL, addr);
+  if ((shadow != NULL) && (shadow->valid & (1 << OTB_I2C_PCF8574_SHADOW_LATCH)))
   {
-    goto EXIT_LABEL;
+    gpio_val = shadow->reg[OTB_I2C_PCF8574_SHADOW_LATCH];
+  }
+  else
+  {
+    // Reading returns the pin states, not the latch - so any pin being held
+    // low externally will read (and be written back) as 0
+    rc = otb_i2c_read_one_val(addr, &gpio_val);
+    if (!rc)
+    {
+      goto EXIT_LABEL;
+    }
   }
-#endif  
   
   if (on)
   {
-    //gpio_val |= io;
-    gpio_val = 0xff;
+    gpio_val |= io;
   }
   else
   {
-    //gpio_val &= ~io;
-    gpio_val = 0;
+    gpio_val &= ~io;
   }
   
-  rc = otb_i2c_write_one_val(addr, gpio_val);
+  rc = otb_i2c_pcf8574_write(addr, gpio_val);
   if (!rc)
   {
     goto EXIT_LABEL;
@@ -133,15 +140,61 @@ EXIT_LABEL:
   return rc;
 }
 
+// Writes all 8 pins, unless they're known to be set that way already
+bool ICACHE_FLASH_ATTR otb_i2c_pcf8574_write(uint8_t addr, uint8_t val)
+{
+  bool rc = FALSE;
+  otb_i2c_shadow *shadow;
+  
+  ENTRY;
+
+  shadow = otb_i2c_shadow_get(NULL, addr);
+  if ((shadow != NULL) &&
+      (shadow->valid & (1 << OTB_I2C_PCF8574_SHADOW_LATCH)) &&
+      (shadow->reg[OTB_I2C_PCF8574_SHADOW_LATCH] == val))
+  {
+    MDEBUG("Unchanged 0x%02x", val);
+    rc = TRUE;
+    goto EXIT_LABEL;
+  }
+
+  rc = otb_i2c_write_one_val(addr, val);
+  if (shadow != NULL)
+  {
+    if (rc)
+    {
+      shadow->reg[OTB_I2C_PCF8574_SHADOW_LATCH] = val;
+      shadow->valid |= (1 << OTB_I2C_PCF8574_SHADOW_LATCH);
+    }
+    else
+    {
+      shadow->valid &= ~(1 << OTB_I2C_PCF8574_SHADOW_LATCH);
+    }
+  }
+  
+EXIT_LABEL:
+
+  EXIT;
+
+  return rc;
+}
+
 bool ICACHE_FLASH_ATTR otb_i2c_pcf8574_init(uint8_t addr)
 {
   bool rc = FALSE;
-  uint8_t conf;
+  otb_i2c_shadow *shadow;
 
   ENTRY;
 
+  // Forget the old state, so the write below always happens
+  shadow = otb_i2c_shadow_get(NULL, addr);
+  if (shadow != NULL)
+  {
+    shadow->valid = 0;
+  }
+
   // Set all outputs to 0
-  rc = otb_i2c_write_one_val(addr, 0);
+  rc = otb_i2c_pcf8574_write(addr, 0);
   if (!rc)
   {
     goto EXIT_LABEL;
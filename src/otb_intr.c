@@ -32,6 +32,7 @@ void ICACHE_FLASH_ATTR otb_intr_init(void)
   {
     otb_intr_reg_info[ii].fn = NULL;
     otb_intr_reg_info[ii].arg = NULL;
+    otb_intr_reg_info[ii].edge = OTB_INTR_EDGE_ANY;
   }
 
   EXIT;
@@ -61,7 +62,7 @@ void ICACHE_FLASH_ATTR otb_intr_set()
   {
     if (otb_intr_reg_info[ii].fn != NULL)
     {
-      gpio_pin_intr_state_set(GPIO_ID_PIN(ii), 3);  // ANYEDGE
+      gpio_pin_intr_state_set(GPIO_ID_PIN(ii), otb_intr_reg_info[ii].edge);
       otb_intr_clear(1<<ii);
       have_intr = TRUE;
     }
@@ -81,16 +82,31 @@ void ICACHE_FLASH_ATTR otb_intr_set()
 }
 
 bool ICACHE_FLASH_ATTR otb_intr_register(otb_intr_handler_fn *fn, void *arg, uint8_t pin)
+{
+  bool rc;
+
+  ENTRY;
+
+  rc = otb_intr_register_edge(fn, arg, pin, OTB_INTR_EDGE_ANY);
+
+  EXIT;
+
+  return rc;
+}
+
+bool ICACHE_FLASH_ATTR otb_intr_register_edge(otb_intr_handler_fn *fn, void *arg, uint8_t pin, uint8_t edge)
 {
   bool rc = FALSE;
 
   ENTRY;
 
   OTB_ASSERT(pin < OTB_GPIO_ESP_GPIO_PINS);
+  OTB_ASSERT((edge >= OTB_INTR_EDGE_POS) && (edge <= OTB_INTR_EDGE_ANY));
   if (otb_intr_reg_info[pin].fn == NULL)
   {
     otb_intr_reg_info[pin].fn = fn;
     otb_intr_reg_info[pin].arg = arg;
+    otb_intr_reg_info[pin].edge = edge;
     ETS_INTR_LOCK();
     otb_intr_set();
     ETS_INTR_UNLOCK();
@@ -115,9 +131,11 @@ void ICACHE_FLASH_ATTR otb_intr_unreg(uint8_t pin)
   OTB_ASSERT(pin < OTB_GPIO_ESP_GPIO_PINS);
   otb_intr_reg_info[pin].fn = NULL;
   otb_intr_reg_info[pin].arg = NULL;
+  otb_intr_reg_info[pin].edge = OTB_INTR_EDGE_ANY;
   ETS_INTR_LOCK();
   otb_intr_set();
-  gpio_pin_intr_state_set(GPIO_ID_PIN(pin), 0);  //   ETS_INTR_UNLOCK();
+  gpio_pin_intr_state_set(GPIO_ID_PIN(pin), 0);
+  ETS_INTR_UNLOCK();
   MDETAIL("Unregistered interrupt handler for pin %d", pin)
 
   EXIT;
@@ -32,14 +32,11 @@ void ICACHE_FLASH_ATTR otb_mqtt_publish(MQTT_Client *mqtt_client,
                                         char *buf,
                                         uint16_t buf_len)
 {
-  char *loc1, *loc2, *loc3, *loc1_, *loc2_, *loc3_;
   int chars;
   int ii;
 
   ENTRY;
 
-  otb_mqtt_handle_loc(&loc1, &loc1_, &loc2, &loc2_, &loc3, &loc3_);
-  
   if (extra_message[0] == 0)
   {
     chars = os_snprintf(otb_mqtt_msg_s, OTB_MQTT_MAX_MSG_LENGTH, "%s", message);
@@ -58,6 +55,69 @@ void ICACHE_FLASH_ATTR otb_mqtt_publish(MQTT_Client *mqtt_client,
     otb_mqtt_msg_s[ii] = tolower(otb_mqtt_msg_s[ii]);
   }
 
+  otb_mqtt_build_topic(subtopic, extra_subtopic);
+  
+  // We don't "INFO" this as can be retrieved from MQTT broker
+  MDEBUG("Publish: %s %s qos: %d retain: %d",
+       otb_mqtt_topic_s,
+       otb_mqtt_msg_s,
+       qos,
+       retain);
+  if (buf != NULL)
+  {
+    os_strncpy(buf, otb_mqtt_msg_s, buf_len);
+    buf[buf_len - 1] = 0;
+  }
+  if (otb_mqtt_connected)
+  {
+    MQTT_Publish(mqtt_client, otb_mqtt_topic_s, otb_mqtt_msg_s, chars, qos, retain);
+  }
+
+  EXIT;
+
+  return;
+}
+
+// Publishes data as is, rather than as a (lowercased) string.  Returns FALSE if
+// not connected, or the MQTT queue is full, so the caller can try again later.
+bool ICACHE_FLASH_ATTR otb_mqtt_publish_bin(MQTT_Client *mqtt_client,
+                                            char *subtopic,
+                                            char *extra_subtopic,
+                                            uint8_t *data,
+                                            uint16_t len,
+                                            uint8_t qos,
+                                            bool retain)
+{
+  bool rc = FALSE;
+
+  ENTRY;
+
+  otb_mqtt_build_topic(subtopic, extra_subtopic);
+
+  MDEBUG("Publish: %s %d bytes qos: %d retain: %d",
+       otb_mqtt_topic_s,
+       len,
+       qos,
+       retain);
+  if (otb_mqtt_connected)
+  {
+    rc = MQTT_Publish(mqtt_client, otb_mqtt_topic_s, (char *)data, len, qos, retain);
+  }
+
+  EXIT;
+
+  return rc;
+}
+
+// Builds the topic to publish to into otb_mqtt_topic_s
+void ICACHE_FLASH_ATTR otb_mqtt_build_topic(char *subtopic, char *extra_subtopic)
+{
+  char *loc1, *loc2, *loc3, *loc1_, *loc2_, *loc3_;
+
+  ENTRY;
+
+  otb_mqtt_handle_loc(&loc1, &loc1_, &loc2, &loc2_, &loc3, &loc3_);
+
   if (extra_subtopic[0] == 0)
   {
     os_snprintf(otb_mqtt_topic_s,
@@ -89,22 +149,6 @@ void ICACHE_FLASH_ATTR otb_mqtt_publish(MQTT_Client *mqtt_client,
                 subtopic,
                 extra_subtopic);
   }
-  
-  // We don't "INFO" this as can be retrieved from MQTT broker
-  MDEBUG("Publish: %s %s qos: %d retain: %d",
-       otb_mqtt_topic_s,
-       otb_mqtt_msg_s,
-       qos,
-       retain);
-  if (buf != NULL)
-  {
-    os_strncpy(buf, otb_mqtt_msg_s, buf_len);
-    buf[buf_len - 1] = 0;
-  }
-  if (otb_mqtt_connected)
-  {
-    MQTT_Publish(mqtt_client, otb_mqtt_topic_s, otb_mqtt_msg_s, chars, qos, retain);
-  }
 
   EXIT;
 
@@ -0,0 +1,420 @@
+/*
+ * OTB-IOT - Out of The Box Internet Of Things
+ *
+ * Copyright (C) 2020 Piers Finlayson
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define OTB_POWER_C
+#include "otb.h"
+
+MLOG("POWER");
+
+// Works out the fixed point multipliers for a CT.  Only done when the
+// calibration changes, so the (64-bit) divides here are off the sample path.
+bool ICACHE_FLASH_ATTR otb_power_cal_init(otb_power_cal *cal,
+                                          uint32_t burden_mohm,
+                                          uint16_t turns,
+                                          uint16_t mains_v)
+{
+  bool rc = FALSE;
+  unsigned long long sens_ua;
+  unsigned long long primary_ma;
+  unsigned long long w;
+
+  ENTRY;
+
+  os_memset(cal, 0, sizeof(*cal));
+
+  if (burden_mohm == 0)
+  {
+    MWARN("Invalid burden resistor value");
+    goto EXIT_LABEL;
+  }
+
+  // uV / mOhm = mA, so scale by 1000 to get uA
+  sens_ua = (1000ULL << OTB_POWER_CAL_Q) / burden_mohm;
+  primary_ma = ((unsigned long long)turns << OTB_POWER_CAL_Q) / burden_mohm;
+  w = (((unsigned long long)turns * mains_v) << OTB_POWER_CAL_Q) / burden_mohm / 1000;
+  if ((sens_ua > 0xffffffff) || (primary_ma > 0xffffffff) || (w > 0xffffffff))
+  {
+    MWARN("Calibration out of range: burden %dmOhm turns %d mains %dV",
+          burden_mohm,
+          turns,
+          mains_v);
+    goto EXIT_LABEL;
+  }
+
+  cal->sens_ua = sens_ua;
+  cal->primary_ma = primary_ma;
+  cal->w = w;
+  cal->mains_v = mains_v;
+  rc = TRUE;
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return rc;
+}
+
+int32_t ICACHE_FLASH_ATTR otb_power_ads_to_uv(int16_t val, uint8_t gain)
+{
+  uint32_t mag;
+  int32_t uv;
+
+  ENTRY;
+
+  OTB_ASSERT(gain < OTB_POWER_ADS_GAIN_VALUES);
+
+  // Work on the magnitude so we truncate towards zero whatever the sign.
+  // At most 0x8000 * 48000, so fits in 32 bits.
+  mag = (val < 0) ? -(int32_t)val : val;
+  uv = (mag * otb_power_ads_lsb_uv[gain]) >> OTB_POWER_ADS_LSB_Q;
+  uv = (val < 0) ? -uv : uv;
+
+  EXIT;
+
+  return uv;
+}
+
+void ICACHE_FLASH_ATTR otb_power_convert(otb_power_cal *cal,
+                                         int16_t val,
+                                         uint8_t gain,
+                                         otb_power_reading *reading)
+{
+  unsigned long long uv_q;
+  int shift;
+  bool neg;
+
+  ENTRY;
+
+  OTB_ASSERT(gain < OTB_POWER_ADS_GAIN_VALUES);
+
+  neg = (val < 0);
+  uv_q = (neg ? -(int32_t)val : val);
+  uv_q *= otb_power_ads_lsb_uv[gain];
+  shift = OTB_POWER_ADS_LSB_Q + OTB_POWER_CAL_Q;
+
+  // Each value is calculated from the unrounded voltage, so errors don't
+  // compound
+  reading->uv = uv_q >> OTB_POWER_ADS_LSB_Q;
+  reading->sens_ua = (uv_q * cal->sens_ua) >> shift;
+  reading->primary_ma = (uv_q * cal->primary_ma) >> shift;
+  reading->w = (uv_q * cal->w) >> shift;
+
+  if (neg)
+  {
+    reading->uv = -reading->uv;
+    reading->sens_ua = -reading->sens_ua;
+    reading->primary_ma = -reading->primary_ma;
+    reading->w = -reading->w;
+  }
+
+  EXIT;
+
+  return;
+}
+
+// Writes milli/1000 with dp (1-3) decimal places, truncated
+int ICACHE_FLASH_ATTR otb_power_milli_to_str(char *buf, int len, int32_t milli, uint8_t dp)
+{
+  int chars;
+  uint32_t mag;
+  uint32_t frac;
+  char *fmt;
+
+  ENTRY;
+
+  OTB_ASSERT((dp >= 1) && (dp <= 3));
+
+  // os_snprintf doesn't support variable width, so pick the format
+  mag = (milli < 0) ? -milli : milli;
+  frac = mag % 1000;
+  if (dp == 1)
+  {
+    frac /= 100;
+    fmt = "%s%u.%01u";
+  }
+  else if (dp == 2)
+  {
+    frac /= 10;
+    fmt = "%s%u.%02u";
+  }
+  else
+  {
+    fmt = "%s%u.%03u";
+  }
+  chars = os_snprintf(buf,
+                      len,
+                      fmt,
+                      (milli < 0) ? "-" : "",
+                      (unsigned int)(mag / 1000),
+                      (unsigned int)frac);
+
+  EXIT;
+
+  return chars;
+}
+
+// Adds w drawn for ms to the total.  Negative power (a reversed CT, or noise
+// around zero) isn't metered.
+void ICACHE_FLASH_ATTR otb_power_energy_add(otb_power_energy *energy,
+                                            int32_t w,
+                                            uint32_t ms)
+{
+  unsigned long long wms;
+
+  ENTRY;
+
+  if (w > 0)
+  {
+    wms = (unsigned long long)w * ms + energy->wms;
+    energy->wh += wms / OTB_POWER_WMS_PER_WH;
+    energy->wms = wms % OTB_POWER_WMS_PER_WH;
+  }
+
+  EXIT;
+
+  return;
+}
+
+// Sum of all other fields, inverted so an erased (all 0xff) or zeroed record
+// doesn't look valid
+uint32_t ICACHE_FLASH_ATTR otb_power_checkpoint_sum(otb_power_checkpoint *cp)
+{
+  uint32_t sum;
+  int ii;
+
+  ENTRY;
+
+  sum = cp->magic + cp->seq;
+  for (ii = 0; ii < OTB_CONF_ADS_MAX_ADSS; ii++)
+  {
+    sum += cp->wh[ii];
+  }
+  sum = ~sum;
+
+  EXIT;
+
+  return sum;
+}
+
+bool ICACHE_FLASH_ATTR otb_power_checkpoint_valid(otb_power_checkpoint *cp)
+{
+  bool rc;
+
+  ENTRY;
+
+  rc = (cp->magic == OTB_POWER_CHECKPOINT_MAGIC) &&
+       (cp->checksum == otb_power_checkpoint_sum(cp));
+
+  EXIT;
+
+  return rc;
+}
+
+// cos of phase (a full turn is 0x10000), Q14
+int32_t ICACHE_FLASH_ATTR otb_power_cos(uint16_t phase)
+{
+  uint16_t quarter;
+  uint16_t pos;
+  uint16_t step;
+  uint16_t frac;
+  int32_t val;
+
+  ENTRY;
+
+  // Fold into the first quarter turn, and fix up the sign afterwards
+  quarter = phase >> 14;
+  pos = phase & 0x3fff;
+  if (quarter & 1)
+  {
+    pos = 0x4000 - pos;
+  }
+
+  // 64 steps of 0x100 each, linearly interpolated
+  step = pos >> 8;
+  frac = pos & 0xff;
+  val = otb_power_cos_table[step];
+  if (step < OTB_POWER_COS_STEPS)
+  {
+    val -= ((val - otb_power_cos_table[step+1]) * frac) >> 8;
+  }
+
+  if ((quarter == 1) || (quarter == 2))
+  {
+    val = -val;
+  }
+
+  EXIT;
+
+  return val;
+}
+
+unsigned long long ICACHE_FLASH_ATTR otb_power_isqrt(unsigned long long x)
+{
+  unsigned long long res = 0;
+  unsigned long long bit = 1ULL << 62;
+
+  ENTRY;
+
+  while (bit > x)
+  {
+    bit >>= 2;
+  }
+  while (bit != 0)
+  {
+    if (x >= res + bit)
+    {
+      x -= res + bit;
+      res = (res >> 1) + bit;
+    }
+    else
+    {
+      res >>= 1;
+    }
+    bit >>= 2;
+  }
+
+  EXIT;
+
+  return res;
+}
+
+// As otb_power_convert's primary_ma, but for a fractional (Q8) number of ADS
+// counts - so small harmonics don't lose all precision
+int32_t ICACHE_FLASH_ATTR otb_power_counts_to_ma(otb_power_cal *cal,
+                                                 uint32_t counts_q8,
+                                                 uint8_t gain)
+{
+  unsigned long long uv_q;
+  int32_t ma;
+
+  ENTRY;
+
+  OTB_ASSERT(gain < OTB_POWER_ADS_GAIN_VALUES);
+
+  // Keep uv_q in the same range as otb_power_convert, so the multiply can't
+  // overflow
+  uv_q = ((unsigned long long)counts_q8 * otb_power_ads_lsb_uv[gain]) >> 8;
+  ma = (uv_q * cal->primary_ma) >> (OTB_POWER_ADS_LSB_Q + OTB_POWER_CAL_Q);
+
+  EXIT;
+
+  return ma;
+}
+
+// Sets up analysis of the harmonics in the bitmask (bit 0 is the fundamental),
+// for samples taken at sample_mhz (sample rate in mHz).  Harmonics at or above
+// the Nyquist frequency are ignored.
+void ICACHE_FLASH_ATTR otb_power_goertzel_init(otb_power_goertzel *g,
+                                               uint8_t harmonics,
+                                               uint16_t fundamental_hz,
+                                               uint32_t sample_mhz)
+{
+  uint8_t ii;
+  unsigned long long freq_mhz;
+  uint16_t phase;
+
+  ENTRY;
+
+  os_memset(g, 0, sizeof(*g));
+  for (ii = 0; ii < OTB_POWER_HARMONICS_MAX; ii++)
+  {
+    if (!(harmonics & (1 << ii)))
+    {
+      continue;
+    }
+    freq_mhz = (unsigned long long)(ii + 1) * fundamental_hz * 1000;
+    if ((freq_mhz * 2) >= sample_mhz)
+    {
+      MDEBUG("Harmonic %d above Nyquist - ignoring", ii + 1);
+      continue;
+    }
+    phase = ((freq_mhz << 16) + (sample_mhz / 2)) / sample_mhz;
+    g->coeff[g->num] = 2 * otb_power_cos(phase);
+    g->harmonic[g->num] = ii + 1;
+    g->num++;
+  }
+
+  EXIT;
+
+  return;
+}
+
+void ICACHE_FLASH_ATTR otb_power_goertzel_add(otb_power_goertzel *g, int16_t sample)
+{
+  uint8_t ii;
+  int32_t s0;
+
+  ENTRY;
+
+  if (g->count < OTB_POWER_GOERTZEL_MAX_SAMPLES)
+  {
+    for (ii = 0; ii < g->num; ii++)
+    {
+      s0 = sample +
+           (int32_t)(((long long)g->coeff[ii] * g->s1[ii]) >> OTB_POWER_GOERTZEL_Q) -
+           g->s2[ii];
+      g->s2[ii] = g->s1[ii];
+      g->s1[ii] = s0;
+    }
+    g->count++;
+  }
+
+  EXIT;
+
+  return;
+}
+
+// RMS of the indexed harmonic, in ADS counts, Q8
+uint32_t ICACHE_FLASH_ATTR otb_power_goertzel_rms(otb_power_goertzel *g, uint8_t index)
+{
+  long long power;
+  unsigned long long mag;
+  uint32_t rms = 0;
+  int32_t s1;
+  int32_t s2;
+
+  ENTRY;
+
+  OTB_ASSERT(index < g->num);
+  if (g->count == 0)
+  {
+    goto EXIT_LABEL;
+  }
+
+  s1 = g->s1[index];
+  s2 = g->s2[index];
+  power = (long long)s1 * s1 +
+          (long long)s2 * s2 -
+          (((long long)g->coeff[index] * s1) >> OTB_POWER_GOERTZEL_Q) * s2;
+  if (power < 0)
+  {
+    // Rounding
+    power = 0;
+  }
+
+  // Peak amplitude is 2|X|/N, so RMS is sqrt(2)|X|/N
+  mag = otb_power_isqrt(2 * (unsigned long long)power);
+  rms = (mag << 8) / g->count;
+
+EXIT_LABEL:
+
+  EXIT;
+
+  return rms;
+}
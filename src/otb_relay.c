@@ -307,7 +307,7 @@ bool ICACHE_FLASH_ATTR otb_relay_trigger(unsigned char *next_cmd,
         // Phew - now have a relay module (relay), relay itself (ivalue), and desired
         // binary state (bvalue)
         // Note otb-relay has pins 1 to 8 reversed - hence 9-ivalue!
-        rc = otb_relay_trigger_relay(relay_status, (uint8_t)ivalue, bvalue);
+        rc = otb_relay_trigger_relay(relay_status, (uint8_t)ivalue, bvalue, TRUE);
         if (!rc)
         {
           rc = FALSE;
@@ -333,7 +333,12 @@ EXIT_LABEL:
   return rc;
 }
 
-bool ICACHE_FLASH_ATTR otb_relay_trigger_relay(otb_relay *relay_status, uint8_t num, uint8_t state)
+// Sets a relay on an otb-relay module.  Unless force is set, the write is
+// skipped if the relay is known to be in that state already.  Explicit
+// commands force the write, as the module may have been power cycled since
+// the state was last written.  If the module is being connected to, the write
+// is deferred until that's done, and always made.
+bool ICACHE_FLASH_ATTR otb_relay_trigger_relay(otb_relay *relay_status, uint8_t num, uint8_t state, bool force)
 {
   bool rc;
   otb_conf_relay *relay;
@@ -350,6 +355,24 @@ bool ICACHE_FLASH_ATTR otb_relay_trigger_relay(otb_relay *relay_status, uint8_t
 
   MDETAIL("Trigger otb-relay PCA9685 address 0x%2x num: %d to status: %d", i2c_addr, num, state);
 
+  if (otb_relay_init_txns.relay == relay_status)
+  {
+    MDETAIL("Relay module %d connecting - defer relay %d", relay_status->index, num);
+    otb_relay_init_txns.pending |= (1 << (num-1));
+    otb_relay_init_txns.pending_state[num-1] = state ? 1 : 0;
+    rc = TRUE;
+    goto EXIT_LABEL;
+  }
+
+  if (!force &&
+      (relay_status->known_written & (1 << (num-1))) &&
+      (relay_status->known_state[num-1] == (state ? 1 : 0)))
+  {
+    MDEBUG("Relay %d already in state %d", num, state);
+    rc = TRUE;
+    goto EXIT_LABEL;
+  }
+
   bytes[0] = OTB_I2C_PCA9685_REG_IO0_ON_L + (((9-num)-1) * 4);
   bytes[1] = 0b0;
   bytes[2] = state ? 0b00010000 : 0;
@@ -361,12 +384,15 @@ bool ICACHE_FLASH_ATTR otb_relay_trigger_relay(otb_relay *relay_status, uint8_t
   if (brzo_rc)
   {
     MDETAIL("Failed to put otb-relay PCA9685 address 0x%2x num: %d to status: %d, rc: %d", i2c_addr, num, state, brzo_rc);
+    // The module may have lost power, so don't trust any of its relays
+    relay_status->known_written = 0;
     rc = FALSE;
     goto EXIT_LABEL;
   }
   
   rc = TRUE;
   relay_status->known_state[num-1] = state ? 1 : 0;
+  relay_status->known_written |= (1 << (num-1));
   
 EXIT_LABEL:
 
@@ -624,6 +650,7 @@ void ICACHE_FLASH_ATTR otb_relay_init(void)
     otb_relay_status[ii].index = -1;
     otb_relay_status[ii].connected = FALSE;
     os_memset(otb_relay_status[ii].known_state, -1, 16);
+    otb_relay_status[ii].known_written = 0;
   }
 
   // Now set up internal relay module state based on config
@@ -678,12 +705,12 @@ void ICACHE_FLASH_ATTR otb_relay_init(void)
 
 void ICACHE_FLASH_ATTR otb_relay_on_timer(void *arg)
 {
-  bool rc = FALSE;
-  uint8_t brzo_rc;
-  uint8_t bytes[5];
+  uint32_t timeout = 60000;
   uint8_t i2c_addr;
   int ii;
   uint8_t desired_state;
+  otb_relay_init_batch *batch = &otb_relay_init_txns;
+  otb_i2c_txn *txn;
   
   otb_relay *relay;
   otb_conf_relay *relay_conf;
@@ -701,6 +728,15 @@ void ICACHE_FLASH_ATTR otb_relay_on_timer(void *arg)
   
   os_timer_disarm((os_timer_t*)&(relay->timer));
 
+  if (batch->relay != NULL)
+  {
+    MDEBUG("Relay module %d connecting - retry module %d",
+           batch->relay->index,
+           relay->index);
+    timeout = OTB_RELAY_INIT_RETRY;
+    goto EXIT_LABEL;
+  }
+
   MDEBUG("Connect to and set up relay module %d", relay->index);
   
   switch(relay_conf->type)
@@ -708,40 +744,22 @@ void ICACHE_FLASH_ATTR otb_relay_on_timer(void *arg)
     case OTB_CONF_RELAY_TYPE_OTB_0_4:
       // Figure out I2C address
       i2c_addr = OTB_I2C_PCA9685_BASE_ADDR + relay_conf->addr;
+      os_memset(batch, 0, sizeof(*batch));
     
       // Set the mode
-      bytes[0] = 0x00; // MODE1 register
-      bytes[1] = 0b00100001; // reset = 1, AI = 1, sleep = 0, allcall = 1
-      brzo_i2c_start_transaction(i2c_addr, 100);
-      brzo_i2c_write(bytes, 2, FALSE);
-      brzo_rc = brzo_i2c_end_transaction();
-      if (brzo_rc)
-      {
-        MDETAIL("Failed to set otb-relay PCA9685 mode: %d", rc);
-        rc = FALSE;
-        goto EXIT_LABEL;
-      }
+      batch->mode_bytes[0] = 0x00; // MODE1 register
+      batch->mode_bytes[1] = 0b00100001; // reset = 1, AI = 1, sleep = 0, allcall = 1
+      txn = &batch->mode_txn;
+      txn->info = NULL;
+      txn->addr = i2c_addr;
+      txn->wr = batch->mode_bytes;
+      txn->wr_len = 2;
 
       // Now set status LED to on
-      bytes[0] = OTB_I2C_PCA9685_REG_IO0_ON_L + (OTB_RELAY_STATUS_LED_OTB_0_4 * 4);
-      bytes[1] = 0b0;
-      bytes[2] = 0b00010000;
-      bytes[3] = 0b0;
-      bytes[4] = 0b0;
-      brzo_i2c_start_transaction(i2c_addr, 100);
-      brzo_i2c_write(bytes, 5, FALSE);
-      brzo_rc = brzo_i2c_end_transaction();
-      if (brzo_rc)
-      {
-        MDETAIL("Failed to turn on otb-relay PCA9685 status led: %d", rc);
-        rc = FALSE;
-        goto EXIT_LABEL;
-      }
+      otb_i2c_pca9685_frame_set_state(&batch->frame, OTB_RELAY_STATUS_LED_OTB_0_4, TRUE);
 
       // Now set pins to desired state
-      bytes[1] = 0b0;
-      bytes[3] = 0b0;
-      for (ii = 0; ii < 8; ii++)
+      for (ii = 0; ii < OTB_RELAY_INIT_RELAYS; ii++)
       {
         // Use known state rather than power on state if known
         if (relay->known_state[ii] >= 0)
@@ -753,34 +771,25 @@ void ICACHE_FLASH_ATTR otb_relay_on_timer(void *arg)
           desired_state = relay_conf->relay_pwr_on[1] & (1 << ii);
         }
         desired_state = desired_state ? 1 : 0;
-        bytes[0] = OTB_I2C_PCA9685_REG_IO0_ON_L + ((7-ii) * 4);
-        bytes[2] = 0b0;
-        bytes[4] = 0b0;
-        if (desired_state)
-        {
-          bytes[2]= 0b00010000;
-        }
-        else
-        {
-          bytes[4]= 0b00010000;
-        }
-        brzo_i2c_start_transaction(i2c_addr, 100);
-        brzo_i2c_write(bytes, 5, FALSE);
-        brzo_rc = brzo_i2c_end_transaction();
-        if (brzo_rc)
-        {
-          MDETAIL("Failed to init pin: %d, rc: %d", ii, rc);
-          rc = FALSE;
-          goto EXIT_LABEL;
-        }
-        relay->known_state[ii] = desired_state;
-        bytes[2] = 0b0;
-        bytes[4] = 0b0;
+        batch->desired_state[ii] = desired_state;
+        otb_i2c_pca9685_frame_set_state(&batch->frame, 7-ii, desired_state);
+      }
+
+      // Chain the frame's transactions after the mode
+      otb_i2c_pca9685_frame_build(&batch->frame, i2c_addr, NULL);
+      txn->next = batch->frame.txn;
+      for (txn = &batch->mode_txn; txn != NULL; txn = txn->next)
+      {
+        txn->flags = OTB_I2C_TXN_FLAG_STOP_ON_ERROR;
+        txn->cb = otb_relay_init_txn_done;
+        txn->arg = relay;
+      }
+
+      batch->relay = relay;
+      if (!otb_i2c_txn_submit(&batch->mode_txn))
+      {
+        batch->relay = NULL;
       }
-      
-      relay->connected = TRUE;
-      rc = TRUE;
-      goto EXIT_LABEL;
       break;
   
     default:
@@ -795,9 +804,93 @@ EXIT_LABEL:
   os_timer_setfn((os_timer_t*)&(relay->timer),
                  (os_timer_func_t *)otb_relay_on_timer,
                  relay);
-  os_timer_arm((os_timer_t*)&(relay->timer), 60000, 1);
+  os_timer_arm((os_timer_t*)&(relay->timer), timeout, 1);
 
   EXIT;
   
   return;
 }
+
+void ICACHE_FLASH_ATTR otb_relay_init_txn_done(otb_i2c_txn *txn)
+{
+  otb_relay_init_batch *batch = &otb_relay_init_txns;
+  otb_relay *relay;
+  uint8_t first = 0;
+  uint8_t num = 0;
+  uint8_t pending;
+  int ii;
+
+  ENTRY;
+
+  relay = (otb_relay *)txn->arg;
+  OTB_ASSERT(relay == batch->relay);
+  if (txn != &batch->mode_txn)
+  {
+    OTB_ASSERT((txn >= batch->frame.txn) && (txn < (batch->frame.txn + batch->frame.txns)));
+    otb_i2c_pca9685_frame_txn_leds(txn, &first, &num);
+  }
+
+  if (txn->brzo_rc)
+  {
+    // The module may have lost power, or failed - either way don't trust any
+    // of its relays' states until they're next written
+    relay->known_written = 0;
+  }
+
+  if (txn->brzo_rc == OTB_I2C_TXN_SKIPPED)
+  {
+    // Already logged the failure
+  }
+  else if (txn->brzo_rc)
+  {
+    if (txn == &batch->mode_txn)
+    {
+      MDETAIL("Failed to set otb-relay PCA9685 mode: %d", txn->brzo_rc);
+    }
+    else
+    {
+      MDETAIL("Failed to init pins: %d-%d, rc: %d", first, first + num - 1, txn->brzo_rc);
+    }
+  }
+
+  // Relay ii is on pin 7-ii
+  for (ii = 0; ii < OTB_RELAY_INIT_RELAYS; ii++)
+  {
+    if (((7-ii) < first) || ((7-ii) >= (first + num)) ||
+        (batch->pending & (1 << ii)))
+    {
+      // Not in this transaction, or triggered since - so about to be written
+      continue;
+    }
+    if (!txn->brzo_rc)
+    {
+      relay->known_state[ii] = batch->desired_state[ii];
+      relay->known_written |= (1 << ii);
+    }
+  }
+
+  if (txn->batch_end)
+  {
+    if (!txn->brzo_rc)
+    {
+      relay->connected = TRUE;
+      MDEBUG("Connected to relay module %d", relay->index);
+    }
+    batch->relay = NULL;
+
+    // Now write any relays triggered while connecting
+    pending = batch->pending;
+    batch->pending = 0;
+    for (ii = 0; ii < OTB_RELAY_INIT_RELAYS; ii++)
+    {
+      if (pending & (1 << ii))
+      {
+        otb_relay_trigger_relay(relay, ii+1, batch->pending_state[ii], TRUE);
+      }
+    }
+  }
+
+  EXIT;
+
+  return;
+}
@@ -1631,10 +1631,22 @@ void ICACHE_FLASH_ATTR otb_init_mqtt(void *arg)
 
 void ICACHE_FLASH_ATTR otb_init_ds18b20(void *arg)
 {
+  uint32 gpios_munged;
+
   ENTRY;
 
   DETAIL("OTB: Set up One Wire bus");
   otb_ds18b20_initialize(OTB_DS18B20_DEFAULT_GPIO);
+
+  if (arg != NULL)
+  {
+    // Temperature mezzanine board - run a separate bus on each of its GPIOs
+    gpios_munged = (uint32)arg;
+    DETAIL("OTB: Set up One Wire buses for mezzanine board");
+    otb_ds18b20_initialize(gpios_munged & 0xff);
+    otb_ds18b20_initialize((gpios_munged >> 8) & 0xff);
+  }
+
   otb_util_booted();
 
   EXIT;
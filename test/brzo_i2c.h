@@ -0,0 +1 @@
+// brzo_i2c is replaced by the simulated bus in esput_i2c.h
@@ -2,6 +2,111 @@
 
 bool esput_debug = FALSE;
 
+//
+// Simulated clock and timers
+//
+
+unsigned long long esput_now;
+unsigned long long esput_intr_lock_max;
+static unsigned long long esput_intr_lock_start;
+static bool esput_intr_locked;
+static os_timer_t *esput_timers;
+
+void esput_os_timer_disarm(os_timer_t *timer)
+{
+  timer->armed = FALSE;
+}
+
+void esput_os_timer_setfn(os_timer_t *timer, os_timer_func_t *fn, void *arg)
+{
+  os_timer_t *t;
+
+  timer->fn = fn;
+  timer->arg = arg;
+  timer->armed = FALSE;
+  for (t = esput_timers; t != NULL; t = t->next)
+  {
+    if (t == timer)
+    {
+      return;
+    }
+  }
+  timer->next = esput_timers;
+  esput_timers = timer;
+}
+
+void esput_os_timer_arm_us(os_timer_t *timer, unsigned long long us, bool repeat)
+{
+  timer->expire = esput_now + us;
+  timer->period = repeat ? us : 0;
+  timer->armed = TRUE;
+}
+
+void esput_os_delay_us(unsigned long long us)
+{
+  esput_now += us;
+}
+
+uint32_t esput_system_get_time(void)
+{
+  return (uint32_t)esput_now;
+}
+
+void esput_ets_intr_lock(void)
+{
+  assert(!esput_intr_locked);
+  esput_intr_locked = TRUE;
+  esput_intr_lock_start = esput_now;
+}
+
+void esput_ets_intr_unlock(void)
+{
+  assert(esput_intr_locked);
+  esput_intr_locked = FALSE;
+  if ((esput_now - esput_intr_lock_start) > esput_intr_lock_max)
+  {
+    esput_intr_lock_max = esput_now - esput_intr_lock_start;
+  }
+}
+
+void esput_timer_run(unsigned long long us)
+{
+  unsigned long long end = esput_now + us;
+  os_timer_t *t;
+  os_timer_t *next;
+
+  while (1)
+  {
+    next = NULL;
+    for (t = esput_timers; t != NULL; t = t->next)
+    {
+      if (t->armed && ((next == NULL) || (t->expire < next->expire)))
+      {
+        next = t;
+      }
+    }
+    if ((next == NULL) || (next->expire > end))
+    {
+      break;
+    }
+    if (next->expire > esput_now)
+    {
+      esput_now = next->expire;
+    }
+    if (next->period)
+    {
+      next->expire += next->period;
+    }
+    else
+    {
+      next->armed = FALSE;
+    }
+    next->fn(next->arg);
+  }
+
+  esput_now = end;
+}
+
 int main(int argc, char *argv[])
 {
   bool rc;
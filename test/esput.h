@@ -2,6 +2,7 @@
 #define OTB_DEBUG 1
 #define ICACHE_FLASH_ATTR
 #define ICACHE_RODATA_ATTR
+#define ICACHE_RAM_ATTR
 #define ALIGN4
 
 typedef unsigned char bool;
@@ -23,8 +24,7 @@ typedef unsigned long uint32_t;
 
 #define OTB_MIN(A, B) (A < B) ? A : B
 
-extern char *mlog;
-#define MLOG(X) char *mlog = X
+#define MLOG(X) static char *mlog = X
 
 extern bool esput_debug;
 
@@ -155,6 +155,45 @@ typedef void MQTT_Client;
         os_snprintf(STR, OTB_IP_MAX_IPV4_ADDR_LEN, "%d.%d.%d.%d", IP[0], IP[1], IP[2], IP[3]); \
         STR[OTB_IP_MAX_IPV4_ADDR_LEN-1] = 0
 
+//
+// SDK replacements - timers are run against a simulated clock, which also
+// advances when os_delay_us is called
+//
+typedef void os_timer_func_t(void *timer_arg);
+
+typedef struct esput_os_timer
+{
+  os_timer_func_t *fn;
+  void *arg;
+  unsigned long long expire;
+  unsigned long long period;
+  bool armed;
+  struct esput_os_timer *next;
+} os_timer_t;
+
+#define os_timer_disarm(T) esput_os_timer_disarm(T)
+#define os_timer_setfn(T, F, A) esput_os_timer_setfn(T, F, A)
+#define os_timer_arm(T, MS, R) esput_os_timer_arm_us(T, (unsigned long long)(MS) * 1000, R)
+#define os_timer_arm_us(T, US, R) esput_os_timer_arm_us(T, US, R)
+#define os_delay_us(US) esput_os_delay_us(US)
+#define system_get_time() esput_system_get_time()
+#define ETS_INTR_LOCK() esput_ets_intr_lock()
+#define ETS_INTR_UNLOCK() esput_ets_intr_unlock()
+
+extern void esput_os_timer_disarm(os_timer_t *timer);
+extern void esput_os_timer_setfn(os_timer_t *timer, os_timer_func_t *fn, void *arg);
+extern void esput_os_timer_arm_us(os_timer_t *timer, unsigned long long us, bool repeat);
+extern void esput_os_delay_us(unsigned long long us);
+extern uint32_t esput_system_get_time(void);
+extern void esput_ets_intr_lock(void);
+extern void esput_ets_intr_unlock(void);
+
+// Runs timers until the simulated clock has advanced by us
+extern void esput_timer_run(unsigned long long us);
+
+extern unsigned long long esput_now;
+extern unsigned long long esput_intr_lock_max;
+
 #define ESPUT_ASSERT(X) if (!(X)) { printf("%s: %s failed\n", test_name, #X); return(FALSE); }
 
 typedef bool esput_test_fn(char *test_name);
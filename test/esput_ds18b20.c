@@ -0,0 +1,526 @@
+#include "otb.h"
+
+otb_conf_struct *otb_conf;
+esput_mqtt_client otb_mqtt_client;
+char otb_mqtt_scratch[OTB_MQTT_MAX_MSG_LENGTH];
+
+int pin_mux[ESPUT_OW_MAX_PINS];
+int pin_func[ESPUT_OW_MAX_PINS];
+
+int esput_temp_publishes;
+int esput_error_publishes;
+char esput_last_temp_loc[OTB_MQTT_MAX_MSG_LENGTH];
+char esput_last_temp[OTB_MQTT_MAX_MSG_LENGTH];
+unsigned long long esput_last_temp_time;
+int esput_status_sends;
+char esput_last_status[OTB_MQTT_MAX_MSG_LENGTH];
+
+//
+// Simulated 1-Wire bus.  Slots are decoded from the length of time the master
+// holds the line low, and devices respond by pulling the line low for a period
+// after the master's falling edge.
+//
+
+#define ESPUT_OW_STATE_IDLE       0
+#define ESPUT_OW_STATE_ROM_CMD    1
+#define ESPUT_OW_STATE_MATCH_ROM  2
+#define ESPUT_OW_STATE_SEARCH     3
+#define ESPUT_OW_STATE_FUNC_CMD   4
+#define ESPUT_OW_STATE_READ       5
+#define ESPUT_OW_STATE_WRITE      6
+
+#define ESPUT_OW_RESET_MIN_US     480
+#define ESPUT_OW_WRITE_1_MAX_US   15
+#define ESPUT_OW_PRESENCE_WAIT_US 15
+#define ESPUT_OW_PRESENCE_US      120
+#define ESPUT_OW_READ_0_US        30
+
+esput_ow_bus esput_ow_buses[ESPUT_OW_MAX_PINS];
+
+uint8 esput_ow_crc8(uint8 *data, int len)
+{
+  uint8 crc = 0;
+  int ii, jj;
+
+  for (ii = 0; ii < len; ii++)
+  {
+    crc ^= data[ii];
+    for (jj = 0; jj < 8; jj++)
+    {
+      crc = (crc & 1) ? ((crc >> 1) ^ 0x8c) : (crc >> 1);
+    }
+  }
+
+  return crc;
+}
+
+void esput_ow_add_device(int pin, esput_ow_device *dev)
+{
+  esput_ow_bus *bus = esput_ow_buses + pin;
+
+  assert(bus->num_devices < ESPUT_OW_MAX_DEVICES);
+  dev->rom[7] = esput_ow_crc8(dev->rom, 7);
+  if (dev->config == 0)
+  {
+    // Power on default - 12 bits
+    dev->config = 0x7f;
+  }
+  // Power on temperature is 85C
+  dev->reg = 85 * 16;
+  dev->conv_done = 0;
+  dev->selected = FALSE;
+  bus->devices[bus->num_devices] = dev;
+  bus->num_devices++;
+}
+
+static int esput_ow_rom_bit(esput_ow_device *dev, int bit)
+{
+  return (dev->rom[bit / 8] >> (bit % 8)) & 1;
+}
+
+static unsigned long long esput_ow_conv_time(esput_ow_device *dev)
+{
+  if (dev->rom[0] != DS18B20)
+  {
+    return 750000;
+  }
+  return 93750 << ((dev->config >> 5) & 3);
+}
+
+static void esput_ow_latch(esput_ow_device *dev);
+
+static bool esput_ow_in_alarm(esput_ow_device *dev)
+{
+  int temp;
+
+  esput_ow_latch(dev);
+  temp = dev->reg / 16;
+
+  if (dev->rom[0] == DS18S20)
+  {
+    temp = dev->reg / 2;
+  }
+  return ((temp > dev->th) || (temp <= dev->tl));
+}
+
+static void esput_ow_latch(esput_ow_device *dev)
+{
+  int raw;
+
+  if ((dev->conv_done != 0) && (esput_now >= dev->conv_done))
+  {
+    raw = dev->conv_temp;
+    if (dev->rom[0] == DS18S20)
+    {
+      // Half degree resolution
+      raw = raw / 8;
+    }
+    else
+    {
+      // Lower bits undefined at lower resolutions - simulate as 0
+      raw &= ~((1 << (3 - ((dev->config >> 5) & 3))) - 1);
+    }
+    dev->reg = raw;
+    dev->conv_done = 0;
+  }
+}
+
+static void esput_ow_scratchpad(esput_ow_device *dev, uint8 *data)
+{
+  esput_ow_latch(dev);
+  data[0] = dev->reg & 0xff;
+  data[1] = (dev->reg >> 8) & 0xff;
+  data[2] = dev->th;
+  data[3] = dev->tl;
+  data[4] = (dev->rom[0] == DS18B20) ? dev->config : 0xff;
+  data[5] = 0xff;
+  data[6] = 0x0c;
+  data[7] = 0x10;
+  data[8] = esput_ow_crc8(data, 8);
+  if (dev->crc_errors > 0)
+  {
+    data[0] ^= 0x01;
+    dev->crc_errors--;
+  }
+}
+
+// Value devices put on the bus for the next read slot (wired-AND)
+static int esput_ow_tx_bit(esput_ow_bus *bus)
+{
+  int ii;
+  int bit = 1;
+  esput_ow_device *dev;
+
+  switch (bus->state)
+  {
+    case ESPUT_OW_STATE_SEARCH:
+      if (bus->search_phase < 2)
+      {
+        for (ii = 0; ii < bus->num_devices; ii++)
+        {
+          dev = bus->devices[ii];
+          if (dev->present && dev->selected)
+          {
+            bit &= esput_ow_rom_bit(dev, bus->bits) ^ bus->search_phase;
+          }
+        }
+      }
+      break;
+
+    case ESPUT_OW_STATE_READ:
+      if (bus->bits < 72)
+      {
+        bit = (bus->tx[bus->bits / 8] >> (bus->bits % 8)) & 1;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  return bit;
+}
+
+static void esput_ow_func_cmd(esput_ow_bus *bus, uint8 cmd)
+{
+  int ii, jj;
+  uint8 data[9];
+  esput_ow_device *dev;
+
+  bus->state = ESPUT_OW_STATE_IDLE;
+  bus->bits = 0;
+  switch (cmd)
+  {
+    case DS1820_CONVERT_T:
+      bus->converts++;
+      bus->last_convert = esput_now;
+      bus->first_read_after_convert = 0;
+      for (ii = 0; ii < bus->num_devices; ii++)
+      {
+        dev = bus->devices[ii];
+        if (dev->present && dev->selected)
+        {
+          dev->conv_temp = dev->temp;
+          dev->conv_done = esput_now + esput_ow_conv_time(dev);
+        }
+      }
+      break;
+
+    case DS1820_READ_SCRATCHPAD:
+      if (bus->first_read_after_convert == 0)
+      {
+        bus->first_read_after_convert = esput_now;
+      }
+      memset(bus->tx, 0xff, 9);
+      for (ii = 0; ii < bus->num_devices; ii++)
+      {
+        dev = bus->devices[ii];
+        if (dev->present && dev->selected)
+        {
+          esput_ow_scratchpad(dev, data);
+          for (jj = 0; jj < 9; jj++)
+          {
+            bus->tx[jj] &= data[jj];
+          }
+        }
+      }
+      bus->state = ESPUT_OW_STATE_READ;
+      break;
+
+    case DS1820_WRITE_SCRATCHPAD:
+      bus->state = ESPUT_OW_STATE_WRITE;
+      break;
+
+    default:
+      break;
+  }
+}
+
+static void esput_ow_rx_bit(esput_ow_bus *bus, int bit)
+{
+  int ii;
+  esput_ow_device *dev;
+
+  switch (bus->state)
+  {
+    case ESPUT_OW_STATE_ROM_CMD:
+      bus->rx |= bit << bus->bits;
+      bus->bits++;
+      if (bus->bits < 8)
+      {
+        break;
+      }
+      bus->bits = 0;
+      for (ii = 0; ii < bus->num_devices; ii++)
+      {
+        dev = bus->devices[ii];
+        dev->selected = dev->present;
+        if ((bus->rx == DS1820_ALARMSEARCH) && !esput_ow_in_alarm(dev))
+        {
+          dev->selected = FALSE;
+        }
+      }
+      switch (bus->rx)
+      {
+        case DS1820_SKIP_ROM:
+          bus->state = ESPUT_OW_STATE_FUNC_CMD;
+          break;
+
+        case DS1820_MATCHROM:
+          bus->state = ESPUT_OW_STATE_MATCH_ROM;
+          break;
+
+        case DS1820_SEARCHROM:
+        case DS1820_ALARMSEARCH:
+          bus->state = ESPUT_OW_STATE_SEARCH;
+          bus->search_phase = 0;
+          break;
+
+        default:
+          bus->state = ESPUT_OW_STATE_IDLE;
+          break;
+      }
+      bus->rx = 0;
+      break;
+
+    case ESPUT_OW_STATE_MATCH_ROM:
+    case ESPUT_OW_STATE_SEARCH:
+      for (ii = 0; ii < bus->num_devices; ii++)
+      {
+        dev = bus->devices[ii];
+        if (esput_ow_rom_bit(dev, bus->bits) != bit)
+        {
+          dev->selected = FALSE;
+        }
+      }
+      bus->search_phase = 0;
+      bus->bits++;
+      if (bus->bits >= 64)
+      {
+        bus->bits = 0;
+        bus->state = ESPUT_OW_STATE_FUNC_CMD;
+      }
+      break;
+
+    case ESPUT_OW_STATE_FUNC_CMD:
+      bus->rx |= bit << bus->bits;
+      bus->bits++;
+      if (bus->bits >= 8)
+      {
+        esput_ow_func_cmd(bus, bus->rx);
+        bus->rx = 0;
+      }
+      break;
+
+    case ESPUT_OW_STATE_WRITE:
+      bus->rx |= bit << (bus->bits % 8);
+      bus->bits++;
+      if ((bus->bits % 8) == 0)
+      {
+        for (ii = 0; ii < bus->num_devices; ii++)
+        {
+          dev = bus->devices[ii];
+          if (dev->present && dev->selected)
+          {
+            switch (bus->bits / 8)
+            {
+              case 1:
+                dev->th = bus->rx;
+                break;
+
+              case 2:
+                dev->tl = bus->rx;
+                break;
+
+              case 3:
+                dev->config = (bus->rx & 0x60) | 0x1f;
+                break;
+            }
+          }
+        }
+        bus->rx = 0;
+        if (bus->bits >= 24)
+        {
+          bus->state = ESPUT_OW_STATE_IDLE;
+        }
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+static void esput_ow_reset(esput_ow_bus *bus)
+{
+  int ii;
+  bool present = FALSE;
+
+  bus->resets++;
+  bus->state = ESPUT_OW_STATE_ROM_CMD;
+  bus->bits = 0;
+  bus->rx = 0;
+  for (ii = 0; ii < bus->num_devices; ii++)
+  {
+    bus->devices[ii]->selected = FALSE;
+    present |= bus->devices[ii]->present;
+  }
+  if (present)
+  {
+    bus->dev_low_start = esput_now + ESPUT_OW_PRESENCE_WAIT_US;
+    bus->dev_low_end = bus->dev_low_start + ESPUT_OW_PRESENCE_US;
+  }
+}
+
+static void esput_ow_fall(esput_ow_bus *bus)
+{
+  bus->master_low = TRUE;
+  bus->fall_time = esput_now;
+  if (!esput_ow_tx_bit(bus))
+  {
+    bus->dev_low_start = esput_now;
+    bus->dev_low_end = esput_now + ESPUT_OW_READ_0_US;
+  }
+}
+
+static void esput_ow_rise(esput_ow_bus *bus)
+{
+  unsigned long long low = esput_now - bus->fall_time;
+
+  bus->master_low = FALSE;
+  if (low >= ESPUT_OW_RESET_MIN_US)
+  {
+    esput_ow_reset(bus);
+  }
+  else if ((bus->state == ESPUT_OW_STATE_READ) ||
+           ((bus->state == ESPUT_OW_STATE_SEARCH) && (bus->search_phase < 2)))
+  {
+    // Master was reading
+    if (bus->state == ESPUT_OW_STATE_READ)
+    {
+      bus->bits++;
+    }
+    else
+    {
+      bus->search_phase++;
+    }
+  }
+  else
+  {
+    esput_ow_rx_bit(bus, (low < ESPUT_OW_WRITE_1_MAX_US) ? 1 : 0);
+  }
+}
+
+void esput_ow_output_set(int pin, int val)
+{
+  esput_ow_bus *bus = esput_ow_buses + pin;
+
+  assert(pin < ESPUT_OW_MAX_PINS);
+  if (!val && !bus->master_low)
+  {
+    esput_ow_fall(bus);
+  }
+  else if (val && bus->master_low)
+  {
+    esput_ow_rise(bus);
+  }
+  bus->master_driving = TRUE;
+}
+
+void esput_ow_dis_output(int pin)
+{
+  esput_ow_bus *bus = esput_ow_buses + pin;
+
+  assert(pin < ESPUT_OW_MAX_PINS);
+  if (bus->master_low)
+  {
+    esput_ow_rise(bus);
+  }
+  bus->master_driving = FALSE;
+}
+
+int esput_ow_input_get(int pin)
+{
+  esput_ow_bus *bus = esput_ow_buses + pin;
+
+  assert(pin < ESPUT_OW_MAX_PINS);
+  if (bus->master_driving)
+  {
+    return bus->master_low ? 0 : 1;
+  }
+  if ((esput_now >= bus->dev_low_start) && (esput_now < bus->dev_low_end))
+  {
+    return 0;
+  }
+  return 1;
+}
+
+//
+// otb replacements
+//
+
+void esput_otb_mqtt_publish(MQTT_Client *mqtt_client,
+                            char *subtopic,
+                            char *extra_subtopic,
+                            char *message,
+                            char *extra_message,
+                            uint8_t qos,
+                            bool retain,
+                            char *buf,
+                            uint16_t buf_len)
+{
+  if (!strcmp(subtopic, OTB_MQTT_TEMPERATURE))
+  {
+    esput_temp_publishes++;
+    snprintf(esput_last_temp_loc, OTB_MQTT_MAX_MSG_LENGTH, "%s", extra_subtopic);
+    snprintf(esput_last_temp, OTB_MQTT_MAX_MSG_LENGTH, "%s", message);
+    esput_last_temp_time = esput_now;
+  }
+  else
+  {
+    esput_error_publishes++;
+  }
+  return;
+}
+
+void esput_otb_mqtt_send_status(char *val1, char *val2, char *val3, char *val4)
+{
+  esput_status_sends++;
+  snprintf(esput_last_status, OTB_MQTT_MAX_MSG_LENGTH, "%s:%s:%s", val1, val2, val3);
+  return;
+}
+
+bool esput_otb_mqtt_match(char *msg, char *cmd)
+{
+  return !strcmp(msg, cmd);
+}
+
+int esput_otb_mqtt_get_cmd_len(char *cmd)
+{
+  return strlen(cmd);
+}
+
+void esput_otb_cmd_rsp_append(char *rsp)
+{
+  return;
+}
+
+unsigned char *esput_otb_cmd_get_next_cmd(unsigned char *cmd)
+{
+  return NULL;
+}
+
+bool esput_otb_conf_update(otb_conf_struct *conf)
+{
+  return TRUE;
+}
+
+bool esput_otb_gpio_is_valid(uint8_t pin)
+{
+  return (pin < ESPUT_OW_MAX_PINS);
+}
+
+void esput_otb_reset(char *text)
+{
+  return;
+}
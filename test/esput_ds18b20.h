@@ -0,0 +1,138 @@
+//
+// GPIO replacements - which drive the simulated 1-Wire buses
+//
+#define PIN_FUNC_SELECT(MUX, FUNC)
+#define GPIO_OUTPUT_SET(PIN, V) esput_ow_output_set(PIN, V)
+#define GPIO_DIS_OUTPUT(PIN) esput_ow_dis_output(PIN)
+#define GPIO_INPUT_GET(PIN) esput_ow_input_get(PIN)
+
+extern int pin_mux[];
+extern int pin_func[];
+
+extern void esput_ow_output_set(int pin, int val);
+extern void esput_ow_dis_output(int pin);
+extern int esput_ow_input_get(int pin);
+
+//
+// Simulated 1-Wire bus
+//
+#define ESPUT_OW_MAX_PINS     17
+#define ESPUT_OW_MAX_DEVICES  16
+
+typedef struct esput_ow_device
+{
+  // ROM ID - CRC byte is filled in when the device is added
+  uint8 rom[8];
+
+  // Current temperature, in 1/16ths of a degree C
+  int temp;
+
+  // Alarm thresholds and config register (DS18B20 only)
+  sint8 th;
+  sint8 tl;
+  uint8 config;
+
+  // Set to FALSE to simulate the device dropping off the bus
+  bool present;
+
+  // Number of subsequent scratchpad reads to corrupt
+  int crc_errors;
+
+  // Internal state
+  bool selected;
+  int reg;
+  unsigned long long conv_done;
+  int conv_temp;
+} esput_ow_device;
+
+typedef struct esput_ow_bus
+{
+  int num_devices;
+  esput_ow_device *devices[ESPUT_OW_MAX_DEVICES];
+
+  // Line state
+  bool master_driving;
+  bool master_low;
+  unsigned long long fall_time;
+  unsigned long long dev_low_start;
+  unsigned long long dev_low_end;
+
+  // Protocol state
+  int state;
+  uint8 rx;
+  int bits;
+  int search_phase;
+  uint8 tx[9];
+
+  // Statistics
+  int resets;
+  int converts;
+  unsigned long long last_convert;
+  unsigned long long first_read_after_convert;
+} esput_ow_bus;
+
+extern esput_ow_bus esput_ow_buses[ESPUT_OW_MAX_PINS];
+
+extern void esput_ow_add_device(int pin, esput_ow_device *dev);
+extern uint8 esput_ow_crc8(uint8 *data, int len);
+
+//
+// otb replacements
+//
+typedef struct esput_mqtt_client
+{
+  int connState;
+} esput_mqtt_client;
+#define MQTT_DATA 1
+
+extern esput_mqtt_client otb_mqtt_client;
+extern char otb_mqtt_scratch[];
+extern otb_conf_struct *otb_conf;
+
+#define OTB_MQTT_EMPTY             ""
+#define OTB_MQTT_STATUS_ERROR      "error"
+#define OTB_MQTT_STATUS_OK         "ok"
+#define OTB_MQTT_SYSTEM_CONFIG     "config"
+#define OTB_MQTT_SYSTEM_DS18B20    "ds18b20"
+#define OTB_MQTT_CMD_GET           "get"
+#define OTB_MQTT_CMD_GET_INDEX     "index"
+#define OTB_CMD_DS18B20_ALL   0
+#define OTB_CMD_DS18B20_ADDR  1
+
+void esput_otb_mqtt_publish(MQTT_Client *mqtt_client,
+                            char *subtopic,
+                            char *extra_subtopic,
+                            char *message,
+                            char *extra_message,
+                            uint8_t qos,
+                            bool retain,
+                            char *buf,
+                            uint16_t buf_len);
+void esput_otb_mqtt_send_status(char *val1, char *val2, char *val3, char *val4);
+bool esput_otb_mqtt_match(char *msg, char *cmd);
+int esput_otb_mqtt_get_cmd_len(char *cmd);
+void esput_otb_cmd_rsp_append(char *rsp);
+unsigned char *esput_otb_cmd_get_next_cmd(unsigned char *cmd);
+bool esput_otb_conf_update(otb_conf_struct *conf);
+bool esput_otb_gpio_is_valid(uint8_t pin);
+void esput_otb_reset(char *text);
+#define otb_mqtt_publish(...) esput_otb_mqtt_publish(__VA_ARGS__)
+#define otb_mqtt_send_status(...) esput_otb_mqtt_send_status(__VA_ARGS__)
+#define otb_mqtt_match(...) esput_otb_mqtt_match(__VA_ARGS__)
+#define otb_mqtt_get_cmd_len(...) esput_otb_mqtt_get_cmd_len(__VA_ARGS__)
+#define otb_cmd_rsp_append(...) esput_otb_cmd_rsp_append(__VA_ARGS__)
+#define otb_cmd_get_next_cmd(...) esput_otb_cmd_get_next_cmd(__VA_ARGS__)
+#define otb_conf_update(...) esput_otb_conf_update(__VA_ARGS__)
+#define otb_gpio_is_valid(...) esput_otb_gpio_is_valid(__VA_ARGS__)
+#define otb_reset(...) esput_otb_reset(__VA_ARGS__)
+
+// Records the last temperature published
+extern int esput_temp_publishes;
+extern int esput_error_publishes;
+extern char esput_last_temp_loc[];
+extern char esput_last_temp[];
+extern unsigned long long esput_last_temp_time;
+
+// Records the last status sent
+extern int esput_status_sends;
+extern char esput_last_status[];
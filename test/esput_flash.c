@@ -0,0 +1,126 @@
+#include "otb.h"
+
+//
+// Simulated NOR flash
+//
+
+esput_flash esput_flash_chip;
+
+// Everything erased, and statistics reset
+void esput_flash_init(uint32_t base)
+{
+  memset(&esput_flash_chip, 0, sizeof(esput_flash_chip));
+  memset(esput_flash_chip.mem, 0xff, sizeof(esput_flash_chip.mem));
+  esput_flash_chip.base = base;
+  esput_flash_chip.cut_after = -1;
+}
+
+void esput_flash_power_on(void)
+{
+  esput_flash_chip.off = FALSE;
+  esput_flash_chip.cut_after = -1;
+}
+
+int esput_flash_erases(void)
+{
+  int erases = 0;
+  int ii;
+
+  for (ii = 0; ii < ESPUT_FLASH_SECTORS; ii++)
+  {
+    erases += esput_flash_chip.erases[ii];
+  }
+
+  return erases;
+}
+
+// Uses up one byte's worth of power before a cut, returning FALSE if the
+// power has gone
+static bool esput_flash_power(void)
+{
+  if (esput_flash_chip.cut_after == 0)
+  {
+    esput_flash_chip.off = TRUE;
+  }
+  if (esput_flash_chip.off)
+  {
+    return FALSE;
+  }
+  if (esput_flash_chip.cut_after > 0)
+  {
+    esput_flash_chip.cut_after--;
+  }
+
+  return TRUE;
+}
+
+static uint8_t *esput_flash_mem(uint32 addr, uint32 size)
+{
+  assert(addr >= esput_flash_chip.base);
+  assert((addr + size) <= (esput_flash_chip.base + sizeof(esput_flash_chip.mem)));
+  assert((addr % 4) == 0);
+  assert((size % 4) == 0);
+
+  return esput_flash_chip.mem + (addr - esput_flash_chip.base);
+}
+
+SpiFlashOpResult spi_flash_erase_sector(uint16 sec)
+{
+  uint8_t *mem;
+  int half;
+
+  mem = esput_flash_mem(sec * ESPUT_FLASH_SECTOR_LEN, ESPUT_FLASH_SECTOR_LEN);
+  for (half = 0; half < 2; half++)
+  {
+    if (!esput_flash_power())
+    {
+      return SPI_FLASH_RESULT_ERR;
+    }
+    memset(mem + (half * (ESPUT_FLASH_SECTOR_LEN / 2)), 0xff, ESPUT_FLASH_SECTOR_LEN / 2);
+  }
+  esput_flash_chip.erases[(mem - esput_flash_chip.mem) / ESPUT_FLASH_SECTOR_LEN]++;
+
+  return SPI_FLASH_RESULT_OK;
+}
+
+SpiFlashOpResult spi_flash_write(uint32 des_addr, uint32 *src_addr, uint32 size)
+{
+  uint8_t *mem;
+  uint8_t *src = (uint8_t *)src_addr;
+  uint32 ii;
+
+  mem = esput_flash_mem(des_addr, size);
+  assert(((unsigned long)src_addr % 4) == 0);
+  esput_flash_chip.writes++;
+  for (ii = 0; ii < size; ii++)
+  {
+    if (!esput_flash_power())
+    {
+      return SPI_FLASH_RESULT_ERR;
+    }
+    if (mem[ii] != 0xff)
+    {
+      esput_flash_chip.overwrites++;
+    }
+    mem[ii] &= src[ii];
+    esput_flash_chip.bytes_written++;
+  }
+
+  return SPI_FLASH_RESULT_OK;
+}
+
+SpiFlashOpResult spi_flash_read(uint32 src_addr, uint32 *des_addr, uint32 size)
+{
+  uint8_t *mem;
+
+  mem = esput_flash_mem(src_addr, size);
+  assert(((unsigned long)des_addr % 4) == 0);
+  if (esput_flash_chip.off)
+  {
+    return SPI_FLASH_RESULT_ERR;
+  }
+  esput_flash_chip.reads++;
+  memcpy(des_addr, mem, size);
+
+  return SPI_FLASH_RESULT_OK;
+}
@@ -0,0 +1,49 @@
+//
+// Simulated NOR flash, replacing the SDK's spi_flash_ functions, covering
+// ESPUT_FLASH_SECTORS sectors from esput_flash_chip.base.  Erasing sets a
+// sector to 0xff, and writing can only clear bits.  Addresses, buffers and
+// lengths must be 4 byte aligned, as on the ESP8266.
+//
+// Power cuts are simulated with cut_after - the number of bytes which can be
+// written before the power goes (an erase counts as two, one for each half of
+// the sector).  A write stops part way through, an erase leaves the sector
+// half erased, and everything fails until esput_flash_power_on is called.
+//
+#define ESPUT_FLASH_SECTOR_LEN  0x1000
+#define ESPUT_FLASH_SECTORS     8
+
+typedef enum
+{
+  SPI_FLASH_RESULT_OK,
+  SPI_FLASH_RESULT_ERR,
+  SPI_FLASH_RESULT_TIMEOUT
+} SpiFlashOpResult;
+
+typedef struct esput_flash
+{
+  uint32_t base;
+  uint8_t mem[ESPUT_FLASH_SECTORS * ESPUT_FLASH_SECTOR_LEN];
+
+  // Bytes which can be written before the power is cut, -1 for no cut
+  int cut_after;
+  bool off;
+
+  // Statistics
+  int erases[ESPUT_FLASH_SECTORS];
+  int writes;
+  int bytes_written;
+  int reads;
+
+  // Bytes written which hadn't been erased
+  int overwrites;
+} esput_flash;
+
+extern esput_flash esput_flash_chip;
+
+extern void esput_flash_init(uint32_t base);
+extern void esput_flash_power_on(void);
+extern int esput_flash_erases(void);
+
+SpiFlashOpResult spi_flash_erase_sector(uint16 sec);
+SpiFlashOpResult spi_flash_write(uint32 des_addr, uint32 *src_addr, uint32 size);
+SpiFlashOpResult spi_flash_read(uint32 src_addr, uint32 *des_addr, uint32 size);
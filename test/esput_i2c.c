@@ -0,0 +1,752 @@
+#include "otb.h"
+
+brzo_i2c_info otb_i2c_bus_internal;
+
+//
+// Simulated I2C bus
+//
+
+esput_i2c_bus esput_i2c_default_bus;
+brzo_i2c_info esput_i2c_default_info = {0, 0, 0, &esput_i2c_default_bus};
+
+void esput_i2c_add_device(esput_i2c_bus *bus, esput_i2c_device *dev)
+{
+  assert(bus->num_devices < ESPUT_I2C_MAX_DEVICES);
+  bus->devices[bus->num_devices] = dev;
+  bus->num_devices++;
+}
+
+void esput_i2c_reset_stats(esput_i2c_bus *bus)
+{
+  bus->transactions = 0;
+  bus->writes = 0;
+  bus->reads = 0;
+  bus->bytes_written = 0;
+  bus->bytes_read = 0;
+  bus->naks = 0;
+  bus->stretch_timeouts = 0;
+  bus->busy_us = 0;
+  bus->last_txn_us = 0;
+}
+
+static unsigned long long esput_i2c_byte_us(esput_i2c_bus *bus)
+{
+  return 9000 / bus->khz;
+}
+
+// Starts a message of len data bytes - sends the address, and returns the
+// device which acked it, or NULL (having latched an error)
+static esput_i2c_device *esput_i2c_message(esput_i2c_bus *bus, uint32_t len)
+{
+  esput_i2c_device *dev = NULL;
+  int ii;
+
+  assert(bus->in_transaction);
+  if (bus->error)
+  {
+    return NULL;
+  }
+
+  esput_now += esput_i2c_byte_us(bus);
+  for (ii = 0; ii < bus->num_devices; ii++)
+  {
+    if ((bus->devices[ii]->addr == bus->addr) &&
+        bus->devices[ii]->present &&
+        (bus->devices[ii]->busy_until <= esput_now))
+    {
+      dev = bus->devices[ii];
+      break;
+    }
+  }
+  if ((dev != NULL) && (dev->nak_addr > 0))
+  {
+    dev->nak_addr--;
+    dev = NULL;
+  }
+  if (dev == NULL)
+  {
+    bus->error = ESPUT_I2C_ERR_NAK;
+    bus->naks++;
+    return NULL;
+  }
+
+  if (dev->stretch_us > bus->stretch_timeout_us)
+  {
+    bus->error = ESPUT_I2C_ERR_CLOCK_STRETCH;
+    bus->stretch_timeouts++;
+    esput_now += bus->stretch_timeout_us;
+    return NULL;
+  }
+  esput_now += dev->stretch_us * (1 + len);
+  dev->messages++;
+
+  return dev;
+}
+
+void brzo_i2c_start_transaction_info(uint8_t slave_address, uint16_t SCL_frequency_KHz, brzo_i2c_info *info)
+{
+  esput_i2c_bus *bus = info->bus;
+
+  assert(!bus->in_transaction);
+  assert(SCL_frequency_KHz > 0);
+  bus->in_transaction = TRUE;
+  bus->addr = slave_address;
+  bus->error = bus->stuck ? ESPUT_I2C_ERR_BUS_BUSY : 0;
+  bus->khz = SCL_frequency_KHz;
+  bus->stretch_timeout_us = info->clock_stretch_time_out_usec;
+  bus->start = esput_now;
+  bus->transactions++;
+}
+
+void brzo_i2c_write_info(uint8_t *data, uint32_t no_of_bytes, bool repeated_start, brzo_i2c_info *info)
+{
+  esput_i2c_bus *bus = info->bus;
+  esput_i2c_device *dev;
+
+  bus->writes++;
+  dev = esput_i2c_message(bus, no_of_bytes);
+  if (dev == NULL)
+  {
+    return;
+  }
+  if ((dev->nak_data > 0) && (no_of_bytes > 0))
+  {
+    dev->nak_data--;
+    bus->error = ESPUT_I2C_ERR_NAK;
+    bus->naks++;
+    esput_now += esput_i2c_byte_us(bus);
+    return;
+  }
+  // The device acts on the data once it has all been clocked in
+  esput_now += no_of_bytes * esput_i2c_byte_us(bus);
+  bus->bytes_written += no_of_bytes;
+  dev->write(dev, data, no_of_bytes);
+}
+
+void brzo_i2c_read_info(uint8_t *data, uint32_t nr_of_bytes, bool repeated_start, brzo_i2c_info *info)
+{
+  esput_i2c_bus *bus = info->bus;
+  esput_i2c_device *dev;
+
+  bus->reads++;
+  dev = esput_i2c_message(bus, nr_of_bytes);
+  if (dev == NULL)
+  {
+    return;
+  }
+  dev->read(dev, data, nr_of_bytes);
+  bus->bytes_read += nr_of_bytes;
+  esput_now += nr_of_bytes * esput_i2c_byte_us(bus);
+}
+
+uint8_t brzo_i2c_end_transaction_info(brzo_i2c_info *info)
+{
+  esput_i2c_bus *bus = info->bus;
+
+  assert(bus->in_transaction);
+  bus->in_transaction = FALSE;
+  bus->last_txn_us = esput_now - bus->start;
+  bus->busy_us += bus->last_txn_us;
+
+  return bus->error;
+}
+
+void brzo_i2c_start_transaction(uint8_t slave_address, uint16_t SCL_frequency_KHz)
+{
+  brzo_i2c_start_transaction_info(slave_address, SCL_frequency_KHz, &esput_i2c_default_info);
+}
+
+void brzo_i2c_write(uint8_t *data, uint32_t no_of_bytes, bool repeated_start)
+{
+  brzo_i2c_write_info(data, no_of_bytes, repeated_start, &esput_i2c_default_info);
+}
+
+void brzo_i2c_read(uint8_t *data, uint32_t nr_of_bytes, bool repeated_start)
+{
+  brzo_i2c_read_info(data, nr_of_bytes, repeated_start, &esput_i2c_default_info);
+}
+
+uint8_t brzo_i2c_end_transaction(void)
+{
+  return brzo_i2c_end_transaction_info(&esput_i2c_default_info);
+}
+
+//
+// Simulated 24XXYY EEPROM
+//
+
+static void esput_i2c_eeprom_write(esput_i2c_device *dev, uint8_t *data, uint32_t len)
+{
+  esput_i2c_eeprom *eeprom = (esput_i2c_eeprom *)dev;
+  uint32_t page;
+  uint32_t ii;
+
+  // A partial word address is ignored
+  if (len < eeprom->word_addr_len)
+  {
+    return;
+  }
+  eeprom->ptr = 0;
+  for (ii = 0; ii < eeprom->word_addr_len; ii++)
+  {
+    eeprom->ptr = (eeprom->ptr << 8) | data[ii];
+  }
+  eeprom->ptr %= eeprom->size;
+  if (len == eeprom->word_addr_len)
+  {
+    return;
+  }
+
+  page = eeprom->ptr & ~(eeprom->page_size - 1);
+  for (; ii < len; ii++)
+  {
+    eeprom->mem[eeprom->ptr] = data[ii];
+    if (eeprom->corrupt_after > 0)
+    {
+      eeprom->corrupt_after--;
+    }
+    else if (eeprom->corrupt > 0)
+    {
+      eeprom->mem[eeprom->ptr] ^= 0x01;
+      eeprom->corrupt--;
+    }
+    eeprom->ptr = page | ((eeprom->ptr + 1) & (eeprom->page_size - 1));
+  }
+  eeprom->write_cycles++;
+  dev->busy_until = esput_now + eeprom->write_cycle_us;
+}
+
+static void esput_i2c_eeprom_read(esput_i2c_device *dev, uint8_t *data, uint32_t len)
+{
+  esput_i2c_eeprom *eeprom = (esput_i2c_eeprom *)dev;
+  uint32_t ii;
+
+  for (ii = 0; ii < len; ii++)
+  {
+    data[ii] = eeprom->mem[eeprom->ptr];
+    eeprom->ptr = (eeprom->ptr + 1) % eeprom->size;
+  }
+}
+
+void esput_i2c_eeprom_init(esput_i2c_eeprom *eeprom,
+                           uint8_t addr,
+                           uint8_t word_addr_len,
+                           uint8_t *mem,
+                           uint32_t size,
+                           uint32_t page_size)
+{
+  memset(eeprom, 0, sizeof(*eeprom));
+  eeprom->dev.addr = addr;
+  eeprom->dev.present = TRUE;
+  eeprom->dev.write = esput_i2c_eeprom_write;
+  eeprom->dev.read = esput_i2c_eeprom_read;
+  eeprom->word_addr_len = word_addr_len;
+  eeprom->mem = mem;
+  eeprom->size = size;
+  eeprom->page_size = page_size;
+  eeprom->write_cycle_us = ESPUT_I2C_EEPROM_WRITE_CYCLE_US;
+}
+
+//
+// Simulated PCA9685
+//
+
+#define ESPUT_I2C_PCA9685_MODE1_AI   0x20
+#define ESPUT_I2C_PCA9685_LED0       0x06
+#define ESPUT_I2C_PCA9685_LED_LAST   0x45
+#define ESPUT_I2C_PCA9685_ALL_LED    0xFA
+
+static void esput_i2c_pca9685_next(esput_i2c_pca9685 *pca)
+{
+  if (pca->regs[0] & ESPUT_I2C_PCA9685_MODE1_AI)
+  {
+    pca->ptr = (pca->ptr == ESPUT_I2C_PCA9685_LED_LAST) ? 0 : pca->ptr + 1;
+  }
+}
+
+static void esput_i2c_pca9685_write(esput_i2c_device *dev, uint8_t *data, uint32_t len)
+{
+  esput_i2c_pca9685 *pca = (esput_i2c_pca9685 *)dev;
+  uint32_t ii;
+  int led;
+
+  if (len == 0)
+  {
+    return;
+  }
+  pca->ptr = data[0];
+  for (ii = 1; ii < len; ii++)
+  {
+    pca->regs[pca->ptr] = data[ii];
+    pca->reg_writes++;
+    if ((pca->ptr >= ESPUT_I2C_PCA9685_ALL_LED) && (pca->ptr < ESPUT_I2C_PCA9685_ALL_LED + 4))
+    {
+      for (led = 0; led < 16; led++)
+      {
+        pca->regs[ESPUT_I2C_PCA9685_LED0 + (led * 4) + (pca->ptr - ESPUT_I2C_PCA9685_ALL_LED)] = data[ii];
+      }
+    }
+    esput_i2c_pca9685_next(pca);
+  }
+}
+
+static void esput_i2c_pca9685_read(esput_i2c_device *dev, uint8_t *data, uint32_t len)
+{
+  esput_i2c_pca9685 *pca = (esput_i2c_pca9685 *)dev;
+  uint32_t ii;
+
+  for (ii = 0; ii < len; ii++)
+  {
+    data[ii] = pca->regs[pca->ptr];
+    esput_i2c_pca9685_next(pca);
+  }
+}
+
+void esput_i2c_pca9685_init(esput_i2c_pca9685 *pca, uint8_t addr)
+{
+  int led;
+
+  memset(pca, 0, sizeof(*pca));
+  pca->dev.addr = addr;
+  pca->dev.present = TRUE;
+  pca->dev.write = esput_i2c_pca9685_write;
+  pca->dev.read = esput_i2c_pca9685_read;
+
+  // Power on state - asleep, all LEDs fully off
+  pca->regs[0x00] = 0x11;
+  pca->regs[0x01] = 0x04;
+  pca->regs[0xFE] = 0x1E;
+  for (led = 0; led < 16; led++)
+  {
+    pca->regs[ESPUT_I2C_PCA9685_LED0 + (led * 4) + 3] = 0x10;
+  }
+  pca->regs[ESPUT_I2C_PCA9685_ALL_LED + 3] = 0x10;
+}
+
+void esput_i2c_pca9685_led(esput_i2c_pca9685 *pca, int led, uint16_t *on, uint16_t *off)
+{
+  uint8_t *reg;
+
+  assert((led >= 0) && (led < 16));
+  reg = pca->regs + ESPUT_I2C_PCA9685_LED0 + (led * 4);
+  *on = reg[0] | (reg[1] << 8);
+  *off = reg[2] | (reg[3] << 8);
+}
+
+//
+// Simulated MCP23017
+//
+
+#define ESPUT_I2C_MCP23017_IODIRA  0x00
+#define ESPUT_I2C_MCP23017_IPOLA   0x02
+#define ESPUT_I2C_MCP23017_IOCON   0x0A
+#define ESPUT_I2C_MCP23017_GPIOA   0x12
+#define ESPUT_I2C_MCP23017_OLATA   0x14
+#define ESPUT_I2C_MCP23017_SEQOP   0x20
+
+static void esput_i2c_mcp23017_next(esput_i2c_mcp23017 *mcp)
+{
+  if (!(mcp->regs[ESPUT_I2C_MCP23017_IOCON] & ESPUT_I2C_MCP23017_SEQOP))
+  {
+    mcp->ptr = (mcp->ptr + 1) % ESPUT_I2C_MCP23017_REGS;
+  }
+}
+
+static void esput_i2c_mcp23017_write(esput_i2c_device *dev, uint8_t *data, uint32_t len)
+{
+  esput_i2c_mcp23017 *mcp = (esput_i2c_mcp23017 *)dev;
+  uint32_t ii;
+  uint8_t reg;
+
+  if (len == 0)
+  {
+    return;
+  }
+  assert(data[0] < ESPUT_I2C_MCP23017_REGS);
+  mcp->ptr = data[0];
+  for (ii = 1; ii < len; ii++)
+  {
+    reg = mcp->ptr;
+    if ((reg & ~1) == ESPUT_I2C_MCP23017_GPIOA)
+    {
+      // Writes to GPIO go to the output latch
+      reg = ESPUT_I2C_MCP23017_OLATA + (reg & 1);
+    }
+    if ((reg & ~1) == ESPUT_I2C_MCP23017_IOCON)
+    {
+      // IOCON is mirrored
+      mcp->regs[reg ^ 1] = data[ii];
+    }
+    mcp->regs[reg] = data[ii];
+    mcp->reg_writes++;
+    esput_i2c_mcp23017_next(mcp);
+  }
+}
+
+static void esput_i2c_mcp23017_read(esput_i2c_device *dev, uint8_t *data, uint32_t len)
+{
+  esput_i2c_mcp23017 *mcp = (esput_i2c_mcp23017 *)dev;
+  uint32_t ii;
+  int port;
+  uint8_t iodir;
+
+  for (ii = 0; ii < len; ii++)
+  {
+    if ((mcp->ptr & ~1) == ESPUT_I2C_MCP23017_GPIOA)
+    {
+      port = mcp->ptr & 1;
+      iodir = mcp->regs[ESPUT_I2C_MCP23017_IODIRA + port];
+      data[ii] = ((mcp->input[port] ^ mcp->regs[ESPUT_I2C_MCP23017_IPOLA + port]) & iodir) |
+                 (mcp->regs[ESPUT_I2C_MCP23017_OLATA + port] & ~iodir);
+    }
+    else
+    {
+      data[ii] = mcp->regs[mcp->ptr];
+    }
+    mcp->reg_reads++;
+    esput_i2c_mcp23017_next(mcp);
+  }
+}
+
+void esput_i2c_mcp23017_init(esput_i2c_mcp23017 *mcp, uint8_t addr)
+{
+  memset(mcp, 0, sizeof(*mcp));
+  mcp->dev.addr = addr;
+  mcp->dev.present = TRUE;
+  mcp->dev.write = esput_i2c_mcp23017_write;
+  mcp->dev.read = esput_i2c_mcp23017_read;
+
+  // Power on state - all pins inputs
+  mcp->regs[ESPUT_I2C_MCP23017_IODIRA] = 0xff;
+  mcp->regs[ESPUT_I2C_MCP23017_IODIRA + 1] = 0xff;
+}
+
+uint8_t esput_i2c_mcp23017_outputs(esput_i2c_mcp23017 *mcp, int port)
+{
+  assert((port == 0) || (port == 1));
+  return mcp->regs[ESPUT_I2C_MCP23017_OLATA + port] &
+         ~mcp->regs[ESPUT_I2C_MCP23017_IODIRA + port];
+}
+
+//
+// Simulated PCF8574
+//
+
+static void esput_i2c_pcf8574_write(esput_i2c_device *dev, uint8_t *data, uint32_t len)
+{
+  esput_i2c_pcf8574 *pcf = (esput_i2c_pcf8574 *)dev;
+
+  if (len > 0)
+  {
+    pcf->latch = data[len-1];
+  }
+}
+
+static void esput_i2c_pcf8574_read(esput_i2c_device *dev, uint8_t *data, uint32_t len)
+{
+  esput_i2c_pcf8574 *pcf = (esput_i2c_pcf8574 *)dev;
+  uint32_t ii;
+
+  for (ii = 0; ii < len; ii++)
+  {
+    data[ii] = pcf->latch & pcf->input;
+  }
+}
+
+void esput_i2c_pcf8574_init(esput_i2c_pcf8574 *pcf, uint8_t addr)
+{
+  memset(pcf, 0, sizeof(*pcf));
+  pcf->dev.addr = addr;
+  pcf->dev.present = TRUE;
+  pcf->dev.write = esput_i2c_pcf8574_write;
+  pcf->dev.read = esput_i2c_pcf8574_read;
+  pcf->latch = 0xff;
+  pcf->input = 0xff;
+}
+
+//
+// Simulated ADS1115
+//
+
+static const unsigned long long esput_i2c_ads_sps[8] = {8, 16, 32, 64, 128, 250, 475, 860};
+
+unsigned long long esput_i2c_ads_conv_us(esput_i2c_ads *ads)
+{
+  return 1000000 / esput_i2c_ads_sps[(ads->regs[ESPUT_I2C_ADS_REG_CONF] >> 5) & 0x7];
+}
+
+static bool esput_i2c_ads_continuous(esput_i2c_ads *ads)
+{
+  return !(ads->regs[ESPUT_I2C_ADS_REG_CONF] & ESPUT_I2C_ADS_CONF_MODE);
+}
+
+// Completes any conversion due by now
+static void esput_i2c_ads_update(esput_i2c_ads *ads)
+{
+  uint8_t mux;
+
+  if ((ads->conv_done == 0) || (esput_now < ads->conv_done))
+  {
+    return;
+  }
+  mux = (ads->regs[ESPUT_I2C_ADS_REG_CONF] >> 12) & 0x7;
+  ads->regs[ESPUT_I2C_ADS_REG_CONV] = (ads->sample != NULL) ? ads->sample(ads, mux) : ads->val[mux];
+  ads->conversions++;
+  if (esput_i2c_ads_continuous(ads))
+  {
+    while (ads->conv_done <= esput_now)
+    {
+      ads->conv_done += esput_i2c_ads_conv_us(ads);
+    }
+  }
+  else
+  {
+    ads->conv_done = 0;
+  }
+}
+
+static void esput_i2c_ads_write(esput_i2c_device *dev, uint8_t *data, uint32_t len)
+{
+  esput_i2c_ads *ads = (esput_i2c_ads *)dev;
+  uint16_t val;
+
+  if (len == 0)
+  {
+    return;
+  }
+  ads->ptr = data[0] & 0x3;
+  if ((len < 3) || (ads->ptr == ESPUT_I2C_ADS_REG_CONV))
+  {
+    return;
+  }
+  val = (data[1] << 8) | data[2];
+  if (ads->ptr == ESPUT_I2C_ADS_REG_CONF)
+  {
+    ads->regs[ESPUT_I2C_ADS_REG_CONF] = val & ~ESPUT_I2C_ADS_CONF_OS;
+    if (esput_i2c_ads_continuous(ads) || (val & ESPUT_I2C_ADS_CONF_OS))
+    {
+      ads->conv_done = esput_now + esput_i2c_ads_conv_us(ads);
+    }
+    else
+    {
+      ads->conv_done = 0;
+    }
+  }
+  else
+  {
+    ads->regs[ads->ptr] = val;
+  }
+}
+
+static void esput_i2c_ads_read(esput_i2c_device *dev, uint8_t *data, uint32_t len)
+{
+  esput_i2c_ads *ads = (esput_i2c_ads *)dev;
+  uint16_t val;
+  uint32_t ii;
+
+  esput_i2c_ads_update(ads);
+  val = ads->regs[ads->ptr];
+  if ((ads->ptr == ESPUT_I2C_ADS_REG_CONF) &&
+      !esput_i2c_ads_continuous(ads) &&
+      (ads->conv_done == 0))
+  {
+    val |= ESPUT_I2C_ADS_CONF_OS;
+  }
+  for (ii = 0; ii < len; ii++)
+  {
+    data[ii] = (ii & 1) ? (val & 0xff) : (val >> 8);
+  }
+}
+
+void esput_i2c_ads_init(esput_i2c_ads *ads, uint8_t addr)
+{
+  memset(ads, 0, sizeof(*ads));
+  ads->dev.addr = addr;
+  ads->dev.present = TRUE;
+  ads->dev.write = esput_i2c_ads_write;
+  ads->dev.read = esput_i2c_ads_read;
+
+  // Power on state - OS bit is added on read
+  ads->regs[ESPUT_I2C_ADS_REG_CONF] = 0x0583;
+  ads->regs[ESPUT_I2C_ADS_REG_LO] = 0x8000;
+  ads->regs[ESPUT_I2C_ADS_REG_HI] = 0x7fff;
+}
+
+//
+// Simulated SC16IS7xx
+//
+
+#define ESPUT_I2C_SC16IS_LCR_DLAB  0x80
+#define ESPUT_I2C_SC16IS_LSR_DR    0x01
+#define ESPUT_I2C_SC16IS_LSR_THRE  0x20
+#define ESPUT_I2C_SC16IS_LSR_TEMT  0x40
+
+static void esput_i2c_sc16is_write(esput_i2c_device *dev, uint8_t *data, uint32_t len)
+{
+  esput_i2c_sc16is *uart = (esput_i2c_sc16is *)dev;
+  esput_i2c_sc16is_channel *ch;
+  uint32_t ii;
+
+  if (len == 0)
+  {
+    return;
+  }
+  uart->reg = (data[0] >> 3) & 0xf;
+  uart->chan = (data[0] >> 1) & 0x3;
+  assert(uart->chan < ESPUT_I2C_SC16IS_CHANNELS);
+  ch = uart->channel + uart->chan;
+  for (ii = 1; ii < len; ii++)
+  {
+    if ((uart->reg == ESPUT_I2C_SC16IS_REG_RHR) &&
+        !(ch->regs[ESPUT_I2C_SC16IS_REG_LCR] & ESPUT_I2C_SC16IS_LCR_DLAB))
+    {
+      // THR - transmitted immediately
+      assert(ch->tx_count < ESPUT_I2C_SC16IS_TX_LOG);
+      ch->tx[ch->tx_count] = data[ii];
+      ch->tx_count++;
+    }
+    else if (uart->reg == ESPUT_I2C_SC16IS_REG_IODIR)
+    {
+      uart->iodir = data[ii];
+    }
+    else if (uart->reg == ESPUT_I2C_SC16IS_REG_IOSTATE)
+    {
+      uart->iostate = data[ii];
+    }
+    else
+    {
+      ch->regs[uart->reg] = data[ii];
+    }
+  }
+}
+
+static void esput_i2c_sc16is_read(esput_i2c_device *dev, uint8_t *data, uint32_t len)
+{
+  esput_i2c_sc16is *uart = (esput_i2c_sc16is *)dev;
+  esput_i2c_sc16is_channel *ch;
+  uint32_t ii;
+
+  ch = uart->channel + uart->chan;
+  for (ii = 0; ii < len; ii++)
+  {
+    switch (uart->reg)
+    {
+      case ESPUT_I2C_SC16IS_REG_RHR:
+        if (ch->regs[ESPUT_I2C_SC16IS_REG_LCR] & ESPUT_I2C_SC16IS_LCR_DLAB)
+        {
+          data[ii] = ch->regs[uart->reg];
+        }
+        else if (ch->rx_count > 0)
+        {
+          data[ii] = ch->rx[0];
+          ch->rx_count--;
+          memmove(ch->rx, ch->rx + 1, ch->rx_count);
+        }
+        else
+        {
+          data[ii] = 0;
+        }
+        break;
+
+      case ESPUT_I2C_SC16IS_REG_LSR:
+        data[ii] = ESPUT_I2C_SC16IS_LSR_THRE | ESPUT_I2C_SC16IS_LSR_TEMT;
+        if (ch->rx_count > 0)
+        {
+          data[ii] |= ESPUT_I2C_SC16IS_LSR_DR;
+        }
+        break;
+
+      case ESPUT_I2C_SC16IS_REG_TXLVL:
+        data[ii] = ESPUT_I2C_SC16IS_FIFO;
+        break;
+
+      case ESPUT_I2C_SC16IS_REG_RXLVL:
+        data[ii] = ch->rx_count;
+        break;
+
+      case ESPUT_I2C_SC16IS_REG_IODIR:
+        data[ii] = uart->iodir;
+        break;
+
+      case ESPUT_I2C_SC16IS_REG_IOSTATE:
+        data[ii] = uart->iostate;
+        break;
+
+      default:
+        data[ii] = ch->regs[uart->reg];
+        break;
+    }
+  }
+}
+
+void esput_i2c_sc16is_init(esput_i2c_sc16is *uart, uint8_t addr)
+{
+  memset(uart, 0, sizeof(*uart));
+  uart->dev.addr = addr;
+  uart->dev.present = TRUE;
+  uart->dev.write = esput_i2c_sc16is_write;
+  uart->dev.read = esput_i2c_sc16is_read;
+}
+
+void esput_i2c_sc16is_rx(esput_i2c_sc16is *uart, int chan, uint8_t *data, int len)
+{
+  esput_i2c_sc16is_channel *ch;
+
+  assert(chan < ESPUT_I2C_SC16IS_CHANNELS);
+  ch = uart->channel + chan;
+  assert((ch->rx_count + len) <= ESPUT_I2C_SC16IS_FIFO);
+  memcpy(ch->rx + ch->rx_count, data, len);
+  ch->rx_count += len;
+}
+
+//
+// otb replacements
+//
+
+void esput_otb_util_timer_set(os_timer_t *timer,
+                              os_timer_func_t *timerfunc,
+                              void *arg,
+                              uint32_t timeout,
+                              bool repeat)
+{
+  os_timer_disarm(timer);
+  os_timer_setfn(timer, timerfunc, arg);
+  os_timer_arm(timer, timeout, repeat);
+}
+
+uint16_t otb_cmd_rsp_next;
+unsigned char otb_cmd_rsp[OTB_CMD_RSP_MAX_LEN];
+
+// As otb_cmd_rsp_append, but asserts rather than overflowing
+void esput_otb_cmd_rsp_append(char *format, ...)
+{
+  va_list args;
+  int written;
+
+  if (otb_cmd_rsp_next > 0)
+  {
+    otb_cmd_rsp[otb_cmd_rsp_next] = '/';
+    otb_cmd_rsp_next++;
+  }
+  va_start(args, format);
+  written = vsnprintf((char *)otb_cmd_rsp + otb_cmd_rsp_next,
+                      OTB_CMD_RSP_MAX_LEN - otb_cmd_rsp_next,
+                      format,
+                      args);
+  va_end(args);
+  otb_cmd_rsp_next += written;
+  assert(otb_cmd_rsp_next < OTB_CMD_RSP_MAX_LEN);
+}
+
+bool esput_otb_i2c_mqtt_get_addr(char *byte, uint8_t *addr)
+{
+  unsigned int val;
+  char extra;
+
+  if ((strlen(byte) != 2) || (sscanf(byte, "%2x%c", &val, &extra) != 1))
+  {
+    return FALSE;
+  }
+  *addr = val;
+  return TRUE;
+}
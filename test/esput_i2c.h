@@ -0,0 +1,315 @@
+//
+// Simulated I2C bus, replacing brzo_i2c.  Each brzo_i2c_info points at a bus,
+// with devices attached at 7-bit addresses.  The non _info brzo functions use
+// esput_i2c_default_bus.
+//
+// brzo's API is transaction based.  Each write or read within a transaction
+// is a separate message (start, address, data) to the device the transaction
+// was started with.  The first failure is latched, the rest of the transaction
+// skipped, and the error returned by brzo_i2c_end_transaction_info.
+//
+// The simulated clock advances by the time each byte (9 bits, including the
+// address byte) takes at the transaction's SCL frequency, plus any clock
+// stretching by the device.
+//
+#define ESPUT_I2C_MAX_DEVICES  8
+
+// brzo_i2c_end_transaction_info return codes
+#define ESPUT_I2C_ERR_BUS_BUSY       1
+#define ESPUT_I2C_ERR_NAK            2
+#define ESPUT_I2C_ERR_CLOCK_STRETCH  8
+
+struct esput_i2c_device;
+typedef void esput_i2c_write_fn(struct esput_i2c_device *dev, uint8_t *data, uint32_t len);
+typedef void esput_i2c_read_fn(struct esput_i2c_device *dev, uint8_t *data, uint32_t len);
+
+typedef struct esput_i2c_device
+{
+  uint8_t addr;
+
+  // Set to FALSE to simulate the device dropping off the bus
+  bool present;
+
+  // Device doesn't ack its address until this time (e.g. during a write cycle)
+  unsigned long long busy_until;
+
+  // Fault injection - NAK the next nak_addr addresses, and the first data byte
+  // of the next nak_data writes
+  int nak_addr;
+  int nak_data;
+
+  // Clock stretching per byte.  If longer than the bus's clock stretch
+  // timeout the transaction fails.
+  unsigned long long stretch_us;
+
+  // Called with the data from each write message, and to fill each read
+  // message
+  esput_i2c_write_fn *write;
+  esput_i2c_read_fn *read;
+
+  // Statistics
+  int messages;
+} esput_i2c_device;
+
+typedef struct esput_i2c_bus
+{
+  int num_devices;
+  esput_i2c_device *devices[ESPUT_I2C_MAX_DEVICES];
+
+  // Set to simulate SDA or SCL being held low
+  bool stuck;
+
+  // Current transaction
+  bool in_transaction;
+  uint8_t addr;
+  uint8_t error;
+  uint16_t khz;
+  uint32_t stretch_timeout_us;
+  unsigned long long start;
+
+  // Statistics
+  int transactions;
+  int writes;
+  int reads;
+  int bytes_written;
+  int bytes_read;
+  int naks;
+  int stretch_timeouts;
+  unsigned long long busy_us;
+  unsigned long long last_txn_us;
+} esput_i2c_bus;
+
+typedef struct brzo_i2c_info
+{
+  uint8_t sda_pin;
+  uint8_t scl_pin;
+  uint32_t clock_stretch_time_out_usec;
+  esput_i2c_bus *bus;
+} brzo_i2c_info;
+
+void brzo_i2c_start_transaction_info(uint8_t slave_address, uint16_t SCL_frequency_KHz, brzo_i2c_info *info);
+void brzo_i2c_write_info(uint8_t *data, uint32_t no_of_bytes, bool repeated_start, brzo_i2c_info *info);
+void brzo_i2c_read_info(uint8_t *data, uint32_t nr_of_bytes, bool repeated_start, brzo_i2c_info *info);
+uint8_t brzo_i2c_end_transaction_info(brzo_i2c_info *info);
+void brzo_i2c_start_transaction(uint8_t slave_address, uint16_t SCL_frequency_KHz);
+void brzo_i2c_write(uint8_t *data, uint32_t no_of_bytes, bool repeated_start);
+void brzo_i2c_read(uint8_t *data, uint32_t nr_of_bytes, bool repeated_start);
+uint8_t brzo_i2c_end_transaction(void);
+
+extern esput_i2c_bus esput_i2c_default_bus;
+extern brzo_i2c_info esput_i2c_default_info;
+
+extern void esput_i2c_add_device(esput_i2c_bus *bus, esput_i2c_device *dev);
+extern void esput_i2c_reset_stats(esput_i2c_bus *bus);
+
+//
+// Simulated 24XXYY EEPROM.  Writes set the address pointer (word_addr_len
+// bytes, MSB first) and store any further bytes from there, wrapping within
+// the page, and start a write cycle.  Reads stream from the address pointer,
+// wrapping at the end of the device.
+//
+#define ESPUT_I2C_EEPROM_WRITE_CYCLE_US  5000
+
+typedef struct esput_i2c_eeprom
+{
+  // Must be first
+  esput_i2c_device dev;
+
+  uint8_t word_addr_len;
+  uint32_t size;
+  uint8_t *mem;
+  uint32_t page_size;
+  unsigned long long write_cycle_us;
+
+  // Number of bytes written to corrupt, after skipping corrupt_after
+  int corrupt;
+  int corrupt_after;
+
+  // Statistics
+  int write_cycles;
+
+  // Internal state
+  uint32_t ptr;
+} esput_i2c_eeprom;
+
+extern void esput_i2c_eeprom_init(esput_i2c_eeprom *eeprom,
+                                  uint8_t addr,
+                                  uint8_t word_addr_len,
+                                  uint8_t *mem,
+                                  uint32_t size,
+                                  uint32_t page_size);
+
+//
+// Simulated PCA9685 PWM controller.  The first byte of a write sets the
+// register pointer, which auto-increments if MODE1's AI bit is set.  Writes
+// to the ALL_LED registers apply to every LED.
+//
+#define ESPUT_I2C_PCA9685_REGS  256
+
+typedef struct esput_i2c_pca9685
+{
+  // Must be first
+  esput_i2c_device dev;
+
+  uint8_t regs[ESPUT_I2C_PCA9685_REGS];
+
+  // Statistics
+  int reg_writes;
+
+  // Internal state
+  uint8_t ptr;
+} esput_i2c_pca9685;
+
+extern void esput_i2c_pca9685_init(esput_i2c_pca9685 *pca, uint8_t addr);
+extern void esput_i2c_pca9685_led(esput_i2c_pca9685 *pca, int led, uint16_t *on, uint16_t *off);
+
+//
+// Simulated MCP23017 GPIO expander (IOCON.BANK = 0).  The first byte of a
+// write sets the register pointer, which increments unless IOCON.SEQOP is set.
+// GPIO reads return input pins from input, output pins from OLAT.
+//
+#define ESPUT_I2C_MCP23017_REGS  0x16
+
+typedef struct esput_i2c_mcp23017
+{
+  // Must be first
+  esput_i2c_device dev;
+
+  uint8_t regs[ESPUT_I2C_MCP23017_REGS];
+
+  // State of externally driven pins, per port
+  uint8_t input[2];
+
+  // Statistics
+  int reg_writes;
+  int reg_reads;
+
+  // Internal state
+  uint8_t ptr;
+} esput_i2c_mcp23017;
+
+extern void esput_i2c_mcp23017_init(esput_i2c_mcp23017 *mcp, uint8_t addr);
+extern uint8_t esput_i2c_mcp23017_outputs(esput_i2c_mcp23017 *mcp, int port);
+
+//
+// Simulated PCF8574 quasi-bidirectional GPIO expander.  Each byte written
+// sets the output latch, and reads return the latch ANDed with whatever is
+// pulling the pins low externally.
+//
+typedef struct esput_i2c_pcf8574
+{
+  // Must be first
+  esput_i2c_device dev;
+
+  uint8_t latch;
+
+  // Pins not being pulled low externally
+  uint8_t input;
+} esput_i2c_pcf8574;
+
+extern void esput_i2c_pcf8574_init(esput_i2c_pcf8574 *pcf, uint8_t addr);
+
+//
+// Simulated ADS1115 ADC.  The first byte of a write sets the register
+// pointer, and two further bytes write that register, MSB first.  Setting
+// CONF's OS bit in single-shot mode starts a conversion, which takes 1/data
+// rate - until then OS reads as 0.  Conversions return val[mux], or sample()
+// if set.
+//
+#define ESPUT_I2C_ADS_REG_CONV   0
+#define ESPUT_I2C_ADS_REG_CONF   1
+#define ESPUT_I2C_ADS_REG_LO     2
+#define ESPUT_I2C_ADS_REG_HI     3
+#define ESPUT_I2C_ADS_CONF_OS    0x8000
+#define ESPUT_I2C_ADS_CONF_MODE  0x0100
+
+struct esput_i2c_ads;
+typedef int16_t esput_i2c_ads_sample_fn(struct esput_i2c_ads *ads, uint8_t mux);
+
+typedef struct esput_i2c_ads
+{
+  // Must be first
+  esput_i2c_device dev;
+
+  uint16_t regs[4];
+
+  int16_t val[8];
+  esput_i2c_ads_sample_fn *sample;
+
+  // Statistics
+  int conversions;
+
+  // Internal state
+  uint8_t ptr;
+  unsigned long long conv_done;
+} esput_i2c_ads;
+
+extern void esput_i2c_ads_init(esput_i2c_ads *ads, uint8_t addr);
+extern unsigned long long esput_i2c_ads_conv_us(esput_i2c_ads *ads);
+
+//
+// Simulated SC16IS7xx I2C UART bridge.  The first byte of a write is the
+// sub-address - register in bits 6:3 and channel in bits 2:1.  Further bytes
+// are written to that register, with writes to THR queued for transmission
+// and reads from RHR taken from the receive FIFO.
+//
+#define ESPUT_I2C_SC16IS_CHANNELS   2
+#define ESPUT_I2C_SC16IS_REGS       16
+#define ESPUT_I2C_SC16IS_FIFO       64
+#define ESPUT_I2C_SC16IS_TX_LOG     256
+#define ESPUT_I2C_SC16IS_REG_RHR    0x00
+#define ESPUT_I2C_SC16IS_REG_LCR    0x03
+#define ESPUT_I2C_SC16IS_REG_LSR    0x05
+#define ESPUT_I2C_SC16IS_REG_TXLVL  0x08
+#define ESPUT_I2C_SC16IS_REG_RXLVL  0x09
+#define ESPUT_I2C_SC16IS_REG_IODIR  0x0A
+#define ESPUT_I2C_SC16IS_REG_IOSTATE 0x0B
+
+typedef struct esput_i2c_sc16is_channel
+{
+  uint8_t regs[ESPUT_I2C_SC16IS_REGS];
+
+  uint8_t rx[ESPUT_I2C_SC16IS_FIFO];
+  int rx_count;
+
+  // Everything transmitted
+  uint8_t tx[ESPUT_I2C_SC16IS_TX_LOG];
+  int tx_count;
+} esput_i2c_sc16is_channel;
+
+typedef struct esput_i2c_sc16is
+{
+  // Must be first
+  esput_i2c_device dev;
+
+  esput_i2c_sc16is_channel channel[ESPUT_I2C_SC16IS_CHANNELS];
+
+  // GPIO pins - shared between channels
+  uint8_t iodir;
+  uint8_t iostate;
+
+  // Internal state
+  uint8_t reg;
+  uint8_t chan;
+} esput_i2c_sc16is;
+
+extern void esput_i2c_sc16is_init(esput_i2c_sc16is *uart, uint8_t addr);
+extern void esput_i2c_sc16is_rx(esput_i2c_sc16is *uart, int chan, uint8_t *data, int len);
+
+//
+// otb replacements
+//
+extern brzo_i2c_info otb_i2c_bus_internal;
+void esput_otb_util_timer_set(os_timer_t *timer,
+                              os_timer_func_t *timerfunc,
+                              void *arg,
+                              uint32_t timeout,
+                              bool repeat);
+#define otb_util_timer_set(...) esput_otb_util_timer_set(__VA_ARGS__)
+#define OTB_CMD_RSP_MAX_LEN  256
+extern uint16_t otb_cmd_rsp_next;
+extern unsigned char otb_cmd_rsp[OTB_CMD_RSP_MAX_LEN];
+void esput_otb_cmd_rsp_append(char *format, ...);
+#define otb_cmd_rsp_append(...) esput_otb_cmd_rsp_append(__VA_ARGS__)
+bool esput_otb_i2c_mqtt_get_addr(char *byte, uint8_t *addr);
+#define otb_i2c_mqtt_get_addr(...) esput_otb_i2c_mqtt_get_addr(__VA_ARGS__)
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <stdarg.h>
 #include "string.h"
 #include "esput.h"
 #include "otb_conf.h"
@@ -9,3 +10,31 @@
 #include "esput_httpd.h"
 #include "otb_httpd.h"
 #endif // TEST_HTTPD
+#ifdef TEST_DS18B20
+#include "otb_def.h"
+#include "esput_ds18b20.h"
+#include "otb_ds18b20.h"
+#endif // TEST_DS18B20
+#ifdef TEST_POWER
+#include "otb_power.h"
+#endif // TEST_POWER
+#ifdef TEST_24XXYY
+#include "esput_i2c.h"
+#include "otb_i2c_24xxyy.h"
+#endif // TEST_24XXYY
+#ifdef TEST_I2C
+#include "esput_i2c.h"
+#include "otb_i2c_bus.h"
+#include "otb_i2c_mcp23017.h"
+#include "otb_i2c_pca9685.h"
+#include "otb_i2c_pcf8574.h"
+#endif // TEST_I2C
+#ifdef TEST_EEPROM_IMAGE
+#include "esput_i2c.h"
+#include "otb_eeprom.h"
+#include "otb_eeprom_image.h"
+#endif // TEST_EEPROM_IMAGE
+#ifdef TEST_CONF_JOURNAL
+#include "esput_flash.h"
+#include "otb_conf_journal.h"
+#endif // TEST_CONF_JOURNAL
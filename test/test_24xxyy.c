@@ -0,0 +1,256 @@
+#include "otb.h"
+
+#define TEST_ADDR_16  0x50
+#define TEST_ADDR_8   0x51
+#define TEST_ABSENT   0x57
+
+static esput_i2c_bus test_bus;
+static brzo_i2c_info test_info = {0, 0, 0, &test_bus};
+
+// 24XX128 - 16KB, 16-bit word address
+static uint8_t test_mem_16[16384];
+static esput_i2c_eeprom test_eeprom_16;
+
+// 24XX02 - 256 bytes, 8-bit word address
+static uint8_t test_mem_8[256];
+static esput_i2c_eeprom test_eeprom_8;
+
+static uint8_t test_buf[16384];
+
+static void test_setup(void)
+{
+  int ii;
+
+  memset(&test_bus, 0, sizeof(test_bus));
+  for (ii = 0; ii < sizeof(test_mem_16); ii++)
+  {
+    test_mem_16[ii] = (ii * 7) ^ (ii >> 8);
+  }
+  for (ii = 0; ii < sizeof(test_mem_8); ii++)
+  {
+    test_mem_8[ii] = 0xff - ii;
+  }
+  esput_i2c_eeprom_init(&test_eeprom_16,
+                        TEST_ADDR_16,
+                        2,
+                        test_mem_16,
+                        sizeof(test_mem_16),
+                        OTB_I2C_24XX128_PAGE_SIZE);
+  esput_i2c_eeprom_init(&test_eeprom_8,
+                        TEST_ADDR_8,
+                        1,
+                        test_mem_8,
+                        sizeof(test_mem_8),
+                        OTB_I2C_24XX02_PAGE_SIZE);
+  esput_i2c_add_device(&test_bus, &test_eeprom_16.dev);
+  esput_i2c_add_device(&test_bus, &test_eeprom_8.dev);
+  memset(test_buf, 0, sizeof(test_buf));
+}
+
+// Number of page writes needed to write bytes from addr
+static int test_pages(int addr, int bytes, int page_size)
+{
+  return ((addr + bytes - 1) / page_size) - (addr / page_size) + 1;
+}
+
+static int test_chunks(int bytes)
+{
+  return (bytes + OTB_I2C_24XXYY_READ_CHUNK - 1) / OTB_I2C_24XXYY_READ_CHUNK;
+}
+
+bool test_read_16(char *test_name)
+{
+  bool rc;
+  int lens[] = {1, OTB_I2C_24XXYY_READ_CHUNK, OTB_I2C_24XXYY_READ_CHUNK + 1, 1000, 16384};
+  int starts[] = {0, 0x0123, 0x1fff, 0x3000, 0};
+  int ii;
+
+  test_setup();
+  for (ii = 0; ii < sizeof(lens)/sizeof(lens[0]); ii++)
+  {
+    esput_i2c_reset_stats(&test_bus);
+    memset(test_buf, 0, sizeof(test_buf));
+    rc = otb_i2c_24xx128_read_data(TEST_ADDR_16, starts[ii], lens[ii], test_buf, &test_info);
+    ESPUT_ASSERT(rc);
+    ESPUT_ASSERT(!memcmp(test_buf, test_mem_16 + starts[ii], lens[ii]));
+
+    // Address is written once, then the data streamed a chunk per transaction
+    ESPUT_ASSERT(test_bus.transactions == test_chunks(lens[ii]));
+    ESPUT_ASSERT(test_bus.writes == 1);
+    ESPUT_ASSERT(test_bus.bytes_written == 2);
+    ESPUT_ASSERT(test_bus.bytes_read == lens[ii]);
+    LOG("%d bytes from 0x%04x: %d transactions", lens[ii], starts[ii], test_bus.transactions);
+  }
+
+  return TRUE;
+}
+
+bool test_read_8(char *test_name)
+{
+  bool rc;
+  int ii;
+
+  test_setup();
+  for (ii = 1; ii <= 255; ii += 17)
+  {
+    esput_i2c_reset_stats(&test_bus);
+    memset(test_buf, 0, sizeof(test_buf));
+    rc = otb_i2c_24xxyy_read_bytes(TEST_ADDR_8, 0x100 - ii, test_buf, ii, &test_info);
+    ESPUT_ASSERT(rc);
+    ESPUT_ASSERT(!memcmp(test_buf, test_mem_8 + 0x100 - ii, ii));
+    ESPUT_ASSERT(test_bus.transactions == test_chunks(ii));
+    ESPUT_ASSERT(test_bus.writes == 1);
+    ESPUT_ASSERT(test_bus.bytes_written == 1);
+    ESPUT_ASSERT(test_bus.bytes_read == ii);
+  }
+
+  // Previously each byte took two transactions
+  LOG("255 bytes: %d transactions (was 510)", test_bus.transactions);
+
+  return TRUE;
+}
+
+bool test_read_fail(char *test_name)
+{
+  bool rc;
+
+  test_setup();
+
+  // Nothing at this address - fails on the first transaction
+  rc = otb_i2c_24xx128_read_data(TEST_ABSENT, 0, 1000, test_buf, &test_info);
+  ESPUT_ASSERT(!rc);
+  ESPUT_ASSERT(test_bus.transactions == 1);
+  ESPUT_ASSERT(test_bus.naks == 1);
+
+  // Device drops off the bus
+  esput_i2c_reset_stats(&test_bus);
+  test_eeprom_8.dev.present = FALSE;
+  rc = otb_i2c_24xxyy_read_bytes(TEST_ADDR_8, 0, test_buf, 100, &test_info);
+  ESPUT_ASSERT(!rc);
+  ESPUT_ASSERT(test_bus.transactions == 1);
+  ESPUT_ASSERT(!test_bus.in_transaction);
+
+  // Other device unaffected
+  rc = otb_i2c_24xx128_read_data(TEST_ADDR_16, 0, 100, test_buf, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(!memcmp(test_buf, test_mem_16, 100));
+
+  return TRUE;
+}
+
+bool test_write_16(char *test_name)
+{
+  bool rc;
+  int lens[] = {1, OTB_I2C_24XX128_PAGE_SIZE, OTB_I2C_24XX128_PAGE_SIZE, 1000};
+  int starts[] = {0x0000, 0x0040, 0x0041, 0x0123};
+  unsigned long long start;
+  int pages;
+  int ii;
+  int jj;
+
+  for (ii = 0; ii < sizeof(lens)/sizeof(lens[0]); ii++)
+  {
+    test_setup();
+    for (jj = 0; jj < lens[ii]; jj++)
+    {
+      test_buf[jj] = jj + ii;
+    }
+    start = esput_now;
+    rc = otb_i2c_24xx128_write_data(TEST_ADDR_16, starts[ii], lens[ii], test_buf, &test_info);
+    ESPUT_ASSERT(rc);
+    ESPUT_ASSERT(!memcmp(test_mem_16 + starts[ii], test_buf, lens[ii]));
+
+    // Surrounding data untouched
+    if (starts[ii] > 0)
+    {
+      ESPUT_ASSERT(test_mem_16[starts[ii]-1] == (uint8_t)(((starts[ii]-1) * 7) ^ ((starts[ii]-1) >> 8)));
+    }
+    jj = starts[ii] + lens[ii];
+    ESPUT_ASSERT(test_mem_16[jj] == (uint8_t)((jj * 7) ^ (jj >> 8)));
+
+    // One write cycle per page touched
+    pages = test_pages(starts[ii], lens[ii], OTB_I2C_24XX128_PAGE_SIZE);
+    ESPUT_ASSERT(test_eeprom_16.write_cycles == pages);
+    LOG("%d bytes to 0x%04x: %d pages, %d transactions, %lluus (was at least %dus)",
+        lens[ii],
+        starts[ii],
+        pages,
+        test_bus.transactions,
+        esput_now - start,
+        lens[ii] * ESPUT_I2C_EEPROM_WRITE_CYCLE_US);
+  }
+
+  return TRUE;
+}
+
+bool test_write_8(char *test_name)
+{
+  bool rc;
+  int jj;
+
+  test_setup();
+  for (jj = 0; jj < 100; jj++)
+  {
+    test_buf[jj] = jj;
+  }
+  rc = otb_i2c_24xxyy_write_bytes(TEST_ADDR_8, 0x05, test_buf, 100, OTB_I2C_24XX02_PAGE_SIZE, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(!memcmp(test_mem_8 + 0x05, test_buf, 100));
+  ESPUT_ASSERT(test_mem_8[0x04] == 0xff - 0x04);
+  ESPUT_ASSERT(test_mem_8[0x69] == 0xff - 0x69);
+  ESPUT_ASSERT(test_eeprom_8.write_cycles == test_pages(0x05, 100, OTB_I2C_24XX02_PAGE_SIZE));
+
+  // A byte at a time still works
+  test_eeprom_8.write_cycles = 0;
+  rc = otb_i2c_24xxyy_write_bytes(TEST_ADDR_8, 0x80, test_buf, 10, OTB_I2C_24XX00_PAGE_SIZE, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(!memcmp(test_mem_8 + 0x80, test_buf, 10));
+  ESPUT_ASSERT(test_eeprom_8.write_cycles == 10);
+
+  return TRUE;
+}
+
+bool test_write_fail(char *test_name)
+{
+  bool rc;
+
+  test_setup();
+  memset(test_buf, 0x5a, 200);
+
+  // Byte not written correctly - write stops at the bad page
+  test_eeprom_16.corrupt = 1;
+  test_eeprom_16.corrupt_after = 70;
+  rc = otb_i2c_24xx128_write_data(TEST_ADDR_16, 0, 200, test_buf, &test_info);
+  ESPUT_ASSERT(!rc);
+  ESPUT_ASSERT(test_eeprom_16.write_cycles == 2);
+
+  // Write cycle never completes
+  test_eeprom_16.write_cycle_us = 1000000;
+  rc = otb_i2c_24xx128_write_data(TEST_ADDR_16, 0, 200, test_buf, &test_info);
+  ESPUT_ASSERT(!rc);
+  esput_now += test_eeprom_16.write_cycle_us;
+  test_eeprom_16.write_cycle_us = ESPUT_I2C_EEPROM_WRITE_CYCLE_US;
+  rc = otb_i2c_24xx128_write_data(TEST_ADDR_16, 0, 200, test_buf, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(!memcmp(test_mem_16, test_buf, 200));
+
+  // Device absent
+  test_eeprom_16.dev.present = FALSE;
+  esput_i2c_reset_stats(&test_bus);
+  rc = otb_i2c_24xx128_write_data(TEST_ADDR_16, 0, 200, test_buf, &test_info);
+  ESPUT_ASSERT(!rc);
+  ESPUT_ASSERT(test_bus.transactions == 1);
+
+  return TRUE;
+}
+
+esput_test esput_tests[] =
+{
+  {test_read_16, "Read 16-bit", "Sequential reads, 16-bit word address"},
+  {test_read_8, "Read 8-bit", "Sequential reads, 8-bit word address"},
+  {test_read_fail, "Read failure", "Reads from absent devices"},
+  {test_write_16, "Write 16-bit", "Page writes, 16-bit word address"},
+  {test_write_8, "Write 8-bit", "Page writes, 8-bit word address"},
+  {test_write_fail, "Write failure", "Write verify, timeout and absent devices"},
+  {NULL, NULL, NULL},
+};
@@ -0,0 +1,388 @@
+#include "otb.h"
+
+// Same sort of size as otb_conf_struct, and the same number of sectors as the
+// firmware
+#define TEST_LOCATION   0x204000
+#define TEST_SECTORS    4
+#define TEST_CONF_LEN   1396
+
+#define TEST_WEAR_ITERATIONS  5000
+
+static otb_conf_journal test_journal;
+static uint8_t test_conf[TEST_CONF_LEN];
+static uint8_t test_old[TEST_CONF_LEN];
+static uint8_t test_loaded[TEST_CONF_LEN];
+static uint32_t test_seed;
+
+// Copies of the flash and journal, to repeat a save with a different power cut
+static esput_flash test_flash_copy;
+static otb_conf_journal test_journal_copy;
+
+static uint32_t test_rand(void)
+{
+  test_seed = (test_seed * 1103515245) + 12345;
+  return (test_seed >> 8) & 0xffffff;
+}
+
+static void test_setup(void)
+{
+  uint32_t ii;
+
+  test_seed = 1;
+  esput_flash_init(TEST_LOCATION);
+  otb_conf_journal_init(&test_journal, TEST_LOCATION, TEST_SECTORS, TEST_CONF_LEN);
+  for (ii = 0; ii < TEST_CONF_LEN; ii++)
+  {
+    test_conf[ii] = test_rand();
+  }
+}
+
+// Changes a few bytes in one place, like updating a single setting
+static void test_change(void)
+{
+  uint32_t off;
+  uint32_t len;
+  uint32_t ii;
+
+  off = test_rand() % TEST_CONF_LEN;
+  len = 1 + (test_rand() % 4);
+  for (ii = off; (ii < (off + len)) && (ii < TEST_CONF_LEN); ii++)
+  {
+    test_conf[ii]++;
+  }
+}
+
+// Power cycles, and loads the config into test_loaded
+static bool test_reboot(void)
+{
+  esput_flash_power_on();
+  otb_conf_journal_init(&test_journal, TEST_LOCATION, TEST_SECTORS, TEST_CONF_LEN);
+  memset(test_loaded, 0xaa, sizeof(test_loaded));
+  return otb_conf_journal_load(&test_journal, test_loaded);
+}
+
+static bool test_reboot_check(const uint8_t *expected)
+{
+  return test_reboot() && !memcmp(test_loaded, expected, TEST_CONF_LEN);
+}
+
+// Saves test_conf with the power cut after every possible number of bytes,
+// checking the config after a reboot is either the old or the new one - and
+// the new one if the save succeeded.  Also checks saving works after the cut.
+// The save is done for real on return.
+static bool test_power_cut_save(char *test_name, uint32_t *cuts)
+{
+  bool done = FALSE;
+  bool saved;
+  int cut;
+
+  memcpy(&test_flash_copy, &esput_flash_chip, sizeof(test_flash_copy));
+  memcpy(&test_journal_copy, &test_journal, sizeof(test_journal_copy));
+
+  for (cut = 0; !done; cut++)
+  {
+    memcpy(&esput_flash_chip, &test_flash_copy, sizeof(esput_flash_chip));
+    memcpy(&test_journal, &test_journal_copy, sizeof(test_journal));
+    esput_flash_chip.cut_after = cut;
+    saved = otb_conf_journal_save(&test_journal, test_conf);
+    done = !esput_flash_chip.off;
+    ESPUT_ASSERT(saved == done);
+
+    ESPUT_ASSERT(test_reboot());
+    if (saved)
+    {
+      ESPUT_ASSERT(!memcmp(test_loaded, test_conf, TEST_CONF_LEN));
+    }
+    else
+    {
+      ESPUT_ASSERT(!memcmp(test_loaded, test_conf, TEST_CONF_LEN) ||
+                   !memcmp(test_loaded, test_old, TEST_CONF_LEN));
+    }
+
+    // Carry on from whatever was loaded
+    ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+    ESPUT_ASSERT(test_reboot_check(test_conf));
+    ESPUT_ASSERT(esput_flash_chip.overwrites == 0);
+  }
+  *cuts = cut;
+
+  memcpy(&esput_flash_chip, &test_flash_copy, sizeof(esput_flash_chip));
+  memcpy(&test_journal, &test_journal_copy, sizeof(test_journal));
+  ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+
+  return TRUE;
+}
+
+bool test_first_save(char *test_name)
+{
+  int bytes;
+
+  test_setup();
+  ESPUT_ASSERT(!test_reboot());
+
+  ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+  ESPUT_ASSERT(test_journal.compactions == 1);
+  ESPUT_ASSERT(test_journal.sector == 0);
+  ESPUT_ASSERT(esput_flash_chip.erases[0] == 1);
+  ESPUT_ASSERT(esput_flash_erases() == 1);
+  ESPUT_ASSERT(test_reboot_check(test_conf));
+  ESPUT_ASSERT(test_journal.sector == 0);
+  ESPUT_ASSERT(test_journal.seq == 1);
+
+  // Nothing changed, so nothing written
+  bytes = esput_flash_chip.bytes_written;
+  ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+  ESPUT_ASSERT(esput_flash_chip.bytes_written == bytes);
+
+  // Erasing the journal leaves nothing to load
+  otb_conf_journal_erase(&test_journal);
+  ESPUT_ASSERT(!test_reboot());
+  ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+  ESPUT_ASSERT(test_reboot_check(test_conf));
+  ESPUT_ASSERT(esput_flash_chip.overwrites == 0);
+
+  return TRUE;
+}
+
+bool test_append(char *test_name)
+{
+  int bytes;
+  int erases;
+
+  test_setup();
+  ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+  erases = esput_flash_erases();
+
+  // One byte changed is one block appended
+  bytes = esput_flash_chip.bytes_written;
+  test_conf[100]++;
+  ESPUT_ASSERT(otb_conf_journal_changed(&test_journal, test_conf) == 1);
+  ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+  ESPUT_ASSERT(esput_flash_chip.bytes_written - bytes ==
+               sizeof(otb_conf_journal_rec_hdr) + sizeof(otb_conf_journal_block));
+  ESPUT_ASSERT(test_journal.appends == 1);
+  ESPUT_ASSERT(test_reboot_check(test_conf));
+
+  // Changes in different blocks, including the last partial block
+  bytes = esput_flash_chip.bytes_written;
+  test_conf[0]++;
+  test_conf[TEST_CONF_LEN - 1]++;
+  ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+  ESPUT_ASSERT(esput_flash_chip.bytes_written - bytes ==
+               sizeof(otb_conf_journal_rec_hdr) + (2 * sizeof(otb_conf_journal_block)));
+  ESPUT_ASSERT(test_reboot_check(test_conf));
+
+  // A change spanning two blocks
+  test_conf[OTB_CONF_JOURNAL_BLOCK_LEN - 1]++;
+  test_conf[OTB_CONF_JOURNAL_BLOCK_LEN]++;
+  ESPUT_ASSERT(otb_conf_journal_changed(&test_journal, test_conf) == 2);
+  ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+  ESPUT_ASSERT(test_reboot_check(test_conf));
+
+  ESPUT_ASSERT(esput_flash_erases() == erases);
+  ESPUT_ASSERT(esput_flash_chip.overwrites == 0);
+
+  return TRUE;
+}
+
+bool test_wear(char *test_name)
+{
+  int min = -1;
+  int max = 0;
+  int ii;
+
+  test_setup();
+  for (ii = 0; ii < TEST_WEAR_ITERATIONS; ii++)
+  {
+    test_change();
+    ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+    if ((ii % 97) == 0)
+    {
+      ESPUT_ASSERT(test_reboot_check(test_conf));
+    }
+  }
+  ESPUT_ASSERT(test_reboot_check(test_conf));
+
+  for (ii = 0; ii < TEST_SECTORS; ii++)
+  {
+    if ((min < 0) || (esput_flash_chip.erases[ii] < min))
+    {
+      min = esput_flash_chip.erases[ii];
+    }
+    if (esput_flash_chip.erases[ii] > max)
+    {
+      max = esput_flash_chip.erases[ii];
+    }
+  }
+  ESPUT_ASSERT((max - min) <= 1);
+
+  // Many saves to each erase - rather than one erase per save
+  ESPUT_ASSERT(esput_flash_erases() < (TEST_WEAR_ITERATIONS / 20));
+  LOG("%d saves, %d erases, %d bytes written",
+      TEST_WEAR_ITERATIONS,
+      esput_flash_erases(),
+      esput_flash_chip.bytes_written);
+  ESPUT_ASSERT(esput_flash_chip.overwrites == 0);
+
+  return TRUE;
+}
+
+bool test_power_cut_append(char *test_name)
+{
+  uint32_t cuts;
+  int ii;
+
+  test_setup();
+  ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+
+  for (ii = 0; ii < 3; ii++)
+  {
+    memcpy(test_old, test_conf, TEST_CONF_LEN);
+    test_change();
+    test_conf[(ii * 500) + 200]++;
+    ESPUT_ASSERT(test_power_cut_save(test_name, &cuts));
+    ESPUT_ASSERT(esput_flash_erases() == 1);
+    ESPUT_ASSERT(test_reboot_check(test_conf));
+  }
+  ESPUT_ASSERT(esput_flash_chip.overwrites == 0);
+
+  return TRUE;
+}
+
+bool test_power_cut_compact(char *test_name)
+{
+  uint32_t compactions;
+  uint32_t cuts;
+  int ii;
+
+  test_setup();
+  ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+
+  // Go round the ring, so the sector being compacted into isn't erased
+  for (ii = 0; ii < TEST_SECTORS + 1; ii++)
+  {
+    // Fill the current sector up, so the next save moves to the next one
+    compactions = test_journal.compactions;
+    while (1)
+    {
+      memcpy(test_old, test_conf, TEST_CONF_LEN);
+      test_change();
+      if ((test_journal.next +
+           sizeof(otb_conf_journal_rec_hdr) +
+           (otb_conf_journal_changed(&test_journal, test_conf) *
+                                           sizeof(otb_conf_journal_block))) >
+                                                          OTB_CONF_JOURNAL_SECTOR_LEN)
+      {
+        break;
+      }
+      ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+    }
+    ESPUT_ASSERT(test_journal.compactions == compactions);
+
+    ESPUT_ASSERT(test_power_cut_save(test_name, &cuts));
+    ESPUT_ASSERT(test_journal.compactions == compactions + 1);
+    ESPUT_ASSERT(cuts > otb_conf_journal_blocks(TEST_CONF_LEN) * sizeof(otb_conf_journal_block));
+    ESPUT_ASSERT(test_reboot_check(test_conf));
+  }
+  ESPUT_ASSERT(esput_flash_chip.overwrites == 0);
+
+  return TRUE;
+}
+
+bool test_corrupt(char *test_name)
+{
+  uint32_t addr;
+  uint32_t sector;
+  int ii;
+
+  test_setup();
+  ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+  for (ii = 0; ii < 10; ii++)
+  {
+    test_change();
+    ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+  }
+  memcpy(test_old, test_conf, TEST_CONF_LEN);
+
+  // Damage the newest record's data - the previous config is loaded
+  addr = (test_journal.sector * OTB_CONF_JOURNAL_SECTOR_LEN) + test_journal.next;
+  test_conf[700]++;
+  ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+  esput_flash_chip.mem[addr + sizeof(otb_conf_journal_rec_hdr) + 8] ^= 0x10;
+  ESPUT_ASSERT(test_reboot_check(test_old));
+  ESPUT_ASSERT(test_journal.dirty);
+
+  // The next save goes to a fresh sector, rather than after the bad record
+  sector = test_journal.sector;
+  ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+  ESPUT_ASSERT(test_journal.sector == (sector + 1) % TEST_SECTORS);
+  ESPUT_ASSERT(test_reboot_check(test_conf));
+  ESPUT_ASSERT(!test_journal.dirty);
+
+  // Damage the snapshot in the newest sector - the older sector is used, as
+  // it was before the move
+  esput_flash_chip.mem[(test_journal.sector * OTB_CONF_JOURNAL_SECTOR_LEN) +
+                       sizeof(otb_conf_journal_sector_hdr) +
+                       sizeof(otb_conf_journal_rec_hdr) + 40] ^= 0x01;
+  ESPUT_ASSERT(test_reboot_check(test_old));
+  ESPUT_ASSERT(test_journal.sector == sector);
+
+  // Saving moves on past both sectors, with a higher seq than either
+  ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+  ESPUT_ASSERT(test_journal.sector == (sector + 1) % TEST_SECTORS);
+  ESPUT_ASSERT(test_reboot_check(test_conf));
+  ESPUT_ASSERT(test_journal.seq == 3);
+
+  // Damage the newest sector's header
+  esput_flash_chip.mem[(test_journal.sector * OTB_CONF_JOURNAL_SECTOR_LEN) + 4] ^= 0x80;
+  ESPUT_ASSERT(test_reboot_check(test_old));
+
+  // Nothing left
+  esput_flash_chip.mem[sector * OTB_CONF_JOURNAL_SECTOR_LEN] ^= 0x01;
+  ESPUT_ASSERT(!test_reboot());
+
+  return TRUE;
+}
+
+bool test_conf_len(char *test_name)
+{
+  uint8_t *conf;
+
+  test_setup();
+
+  // Written by firmware with a shorter config
+  otb_conf_journal_init(&test_journal, TEST_LOCATION, TEST_SECTORS, TEST_CONF_LEN - 100);
+  ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+
+  // The extra config is zeroed, and the next change starts a new sector
+  memset(test_conf + TEST_CONF_LEN - 100, 0, 100);
+  ESPUT_ASSERT(test_reboot_check(test_conf));
+  ESPUT_ASSERT(test_journal.dirty);
+  test_conf[TEST_CONF_LEN - 1]++;
+  ESPUT_ASSERT(otb_conf_journal_save(&test_journal, test_conf));
+  ESPUT_ASSERT(test_journal.compactions == 1);
+  ESPUT_ASSERT(test_reboot_check(test_conf));
+  ESPUT_ASSERT(!test_journal.dirty);
+
+  // Read by firmware with a shorter config - which gets the start of it
+  conf = malloc(TEST_CONF_LEN - 50);
+  otb_conf_journal_init(&test_journal, TEST_LOCATION, TEST_SECTORS, TEST_CONF_LEN - 50);
+  ESPUT_ASSERT(otb_conf_journal_load(&test_journal, conf));
+  ESPUT_ASSERT(!memcmp(conf, test_conf, TEST_CONF_LEN - 50));
+  ESPUT_ASSERT(test_journal.dirty);
+  free(conf);
+
+  return TRUE;
+}
+
+esput_test esput_tests[] =
+{
+  {test_first_save, "First save", "Loading with no journal, saving, and erasing"},
+  {test_append, "Append", "Only changed blocks are written, without erasing"},
+  {test_wear, "Wear", "Many saves spread erases evenly over the sectors"},
+  {test_power_cut_append, "Power cut append", "Power cut at every point while appending"},
+  {test_power_cut_compact, "Power cut compact", "Power cut at every point while moving sector"},
+  {test_corrupt, "Corruption", "Bad records and sectors fall back to older config"},
+  {test_conf_len, "Config length", "Journals from firmware with a different length config"},
+  {NULL, NULL, NULL},
+};
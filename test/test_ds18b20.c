@@ -0,0 +1,534 @@
+#include "otb.h"
+
+#define TEST_PIN_A  4
+#define TEST_PIN_B  5
+#define TEST_PIN_C  13
+
+static otb_conf_struct test_conf;
+
+// Time the first bus was initialized - the sample timer runs from here
+static unsigned long long test_start;
+
+// Bus A - a mix of DS18B20s and a DS18S20
+static esput_ow_device dev_a[] =
+{
+  {{DS18B20, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00}, 21 * 16, 0, 0, 0, TRUE},
+  {{DS18B20, 0x81, 0x00, 0x00, 0x00, 0x00, 0x00}, -10 * 16 - 2, 0, 0, 0, TRUE},
+  {{DS18B20, 0x01, 0x00, 0x00, 0x00, 0x00, 0x80}, 100 * 16 + 1, 0, 0, 0, TRUE},
+  {{DS18S20, 0x55, 0xaa, 0x00, 0x12, 0x34, 0x56}, -16 * 8, 0, 0, 0, TRUE},
+};
+
+// Bus B - DS18B20s which will be configured for reduced resolution
+static esput_ow_device dev_b[] =
+{
+  {{DS18B20, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01}, 20 * 16 + 15, 0, 0, 0, TRUE},
+  {{DS18B20, 0x02, 0x00, 0x00, 0x00, 0x00, 0x02}, 30 * 16 + 15, 0, 0, 0, TRUE},
+};
+
+// Bus C - more devices than there is room for
+static esput_ow_device dev_c[] =
+{
+  {{DS18B20, 0x03, 0x00, 0x00, 0x00, 0x00, 0x01}, 0, 0, 0, 0, TRUE},
+  {{DS18B20, 0x03, 0x00, 0x00, 0x00, 0x00, 0x02}, 0, 0, 0, 0, TRUE},
+  {{DS18B20, 0x03, 0x00, 0x00, 0x00, 0x00, 0x03}, 0, 0, 0, 0, TRUE},
+};
+
+static void test_friendly(esput_ow_device *dev, char *friendly)
+{
+  snprintf(friendly,
+           OTB_DS18B20_MAX_ADDRESS_STRING_LENGTH,
+           "%02x-%02x%02x%02x%02x%02x%02x",
+           dev->rom[0],
+           dev->rom[6],
+           dev->rom[5],
+           dev->rom[4],
+           dev->rom[3],
+           dev->rom[2],
+           dev->rom[1]);
+}
+
+// Returns index of the device in otb_ds18b20_addresses, or -1
+static int test_find(esput_ow_device *dev)
+{
+  char friendly[OTB_DS18B20_MAX_ADDRESS_STRING_LENGTH];
+  int ii;
+
+  test_friendly(dev, friendly);
+  for (ii = 0; ii < otb_ds18b20_count; ii++)
+  {
+    if (!strcmp(otb_ds18b20_addresses[ii].friendly, friendly))
+    {
+      return ii;
+    }
+  }
+
+  return -1;
+}
+
+// Formats temp (in 1/16ths) as the firmware should report it
+static void test_temp_s(esput_ow_device *dev, int temp, char *temp_s)
+{
+  int whole, fract;
+  char *sign = "";
+
+  if (temp < 0)
+  {
+    sign = "-";
+    temp = -temp;
+  }
+  if (dev->rom[0] == DS18S20)
+  {
+    temp &= ~7;
+  }
+  whole = temp / 16;
+  fract = (temp % 16) * 100 / 16;
+  snprintf(temp_s, OTB_DS18B20_MAX_TEMP_LEN, "%s%d.%02d", sign, whole, fract);
+}
+
+// Runs the clock to offset us into the current report interval (or the next
+// one, if already past it)
+static void test_run_to(unsigned long long offset)
+{
+  unsigned long long interval = OTB_DS18B20_REPORT_INTERVAL * 1000ULL;
+  unsigned long long now = (esput_now - test_start) % interval;
+
+  esput_timer_run((offset + interval - now) % interval);
+}
+
+// Formats the last reading from the device at index
+static char *test_last_temp_s(int index)
+{
+  static char temp_s[OTB_DS18B20_MAX_TEMP_LEN];
+
+  otb_ds18b20_temp_to_str(otb_ds18b20_last_temp + index, temp_s);
+
+  return temp_s;
+}
+
+static bool test_check_temps(char *test_name, esput_ow_device *devs, int num)
+{
+  int ii;
+  int index;
+  char temp_s[OTB_DS18B20_MAX_TEMP_LEN];
+
+  for (ii = 0; ii < num; ii++)
+  {
+    index = test_find(devs + ii);
+    ESPUT_ASSERT(index >= 0);
+    test_temp_s(devs + ii, devs[ii].temp, temp_s);
+    LOG("Device %s expected %s got %s",
+        otb_ds18b20_addresses[index].friendly,
+        temp_s,
+        test_last_temp_s(index));
+    ESPUT_ASSERT(!strcmp(test_last_temp_s(index), temp_s));
+  }
+
+  return TRUE;
+}
+
+bool test_decode(char *test_name)
+{
+  struct
+  {
+    uint8 family;
+    uint8 lsb;
+    uint8 msb;
+    bool crc_ok;
+    char *expected;
+    int16_t centi;
+    uint8 state;
+    uint8 config;  // 12 bits if 0
+  } data[] =
+  {
+    {DS18B20, 0xd0, 0x07, TRUE,  "125.00", 12500, OTB_DS18B20_TEMP_VALID},
+    {DS18B20, 0x50, 0x05, TRUE,  "85.00",   8500, OTB_DS18B20_TEMP_POWER_ON},
+    {DS18B20, 0x91, 0x01, TRUE,  "25.06",   2506, OTB_DS18B20_TEMP_VALID},
+    {DS18B20, 0x08, 0x00, TRUE,  "0.50",      50, OTB_DS18B20_TEMP_VALID},
+    {DS18B20, 0x00, 0x00, TRUE,  "0.00",       0, OTB_DS18B20_TEMP_VALID},
+    {DS18B20, 0xf8, 0xff, TRUE,  "-0.50",    -50, OTB_DS18B20_TEMP_VALID},
+    {DS18B20, 0x5e, 0xff, TRUE,  "-10.12", -1012, OTB_DS18B20_TEMP_VALID},
+    {DS18B20, 0x90, 0xfc, TRUE,  "-55.00", -5500, OTB_DS18B20_TEMP_VALID},
+    {DS18B20, 0xe0, 0x07, TRUE,  NULL},      // 126 - out of range
+    {DS18B20, 0x00, 0x08, TRUE,  NULL},      // Invalid sign bits
+    {DS18B20, 0x91, 0x01, FALSE, NULL},      // Bad CRC
+    {DS18B20, 0x97, 0x01, TRUE,  "25.00",   2500, OTB_DS18B20_TEMP_VALID, 0x1f},  // 9 bits
+    {DS18B20, 0x97, 0x01, TRUE,  "25.25",   2525, OTB_DS18B20_TEMP_VALID, 0x3f},  // 10 bits
+    {DS18B20, 0x97, 0x01, TRUE,  "25.37",   2537, OTB_DS18B20_TEMP_VALID, 0x5f},  // 11 bits
+    {DS18B20, 0x5f, 0xff, TRUE,  "-10.50", -1050, OTB_DS18B20_TEMP_VALID, 0x1f},  // 9 bits
+    {DS18S20, 0xaa, 0x00, TRUE,  "85.00",   8500, OTB_DS18B20_TEMP_POWER_ON},
+    {DS18S20, 0x32, 0x00, TRUE,  "25.00",   2500, OTB_DS18B20_TEMP_VALID},
+    {DS18S20, 0x01, 0x00, TRUE,  "0.50",      50, OTB_DS18B20_TEMP_VALID},
+    {DS18S20, 0xff, 0xff, TRUE,  "-0.50",    -50, OTB_DS18B20_TEMP_VALID},
+    {DS18S20, 0x92, 0xff, TRUE,  "-55.00", -5500, OTB_DS18B20_TEMP_VALID},
+    {DS18S20, 0x92, 0x0f, TRUE,  NULL},      // Invalid sign bits
+    {0, 0, 0, 0, NULL},
+  };
+  int ii;
+  uint8 scratchpad[9] = {0, 0, 0x4b, 0x46, 0x7f, 0xff, 0x0c, 0x10, 0};
+  char addr[8] = {0};
+  otb_ds18b20_temp temp;
+  char temp_s[OTB_DS18B20_MAX_TEMP_LEN];
+  bool rc;
+
+  for (ii = 0; data[ii].family != 0; ii++)
+  {
+    addr[0] = data[ii].family;
+    scratchpad[0] = data[ii].lsb;
+    scratchpad[1] = data[ii].msb;
+    scratchpad[4] = data[ii].config ? data[ii].config : 0x7f;
+    scratchpad[8] = esput_ow_crc8(scratchpad, 8);
+    if (!data[ii].crc_ok)
+    {
+      scratchpad[8] ^= 0x80;
+    }
+    temp.state = OTB_DS18B20_TEMP_NONE;
+    rc = otb_ds18b20_decode_temp(addr, scratchpad, &temp);
+    otb_ds18b20_temp_to_str(&temp, temp_s);
+    LOG("0x%02x: 0x%02x%02x -> %d %s", data[ii].family, data[ii].msb, data[ii].lsb, rc, temp_s);
+    if (data[ii].expected == NULL)
+    {
+      ESPUT_ASSERT(!rc);
+    }
+    else
+    {
+      ESPUT_ASSERT(rc);
+      ESPUT_ASSERT(temp.centi == data[ii].centi);
+      ESPUT_ASSERT(temp.state == data[ii].state);
+      ESPUT_ASSERT(!strcmp(temp_s, data[ii].expected));
+    }
+  }
+
+  return TRUE;
+}
+
+bool test_search(char *test_name)
+{
+  int ii;
+
+  otb_conf = &test_conf;
+  otb_mqtt_client.connState = MQTT_DATA;
+
+  for (ii = 0; ii < sizeof(dev_a)/sizeof(dev_a[0]); ii++)
+  {
+    esput_ow_add_device(TEST_PIN_A, dev_a + ii);
+  }
+
+  test_start = esput_now;
+  otb_ds18b20_initialize(TEST_PIN_A);
+
+  // Search, and the sample that follows it, complete in the background
+  ESPUT_ASSERT(otb_ds18b20_count == 0);
+  esput_timer_run(2000000);
+  ESPUT_ASSERT(otb_ds18b20_count == sizeof(dev_a)/sizeof(dev_a[0]));
+  for (ii = 0; ii < sizeof(dev_a)/sizeof(dev_a[0]); ii++)
+  {
+    ESPUT_ASSERT(test_find(dev_a + ii) >= 0);
+    ESPUT_ASSERT(otb_ds18b20_find_device(dev_a[ii].rom) == test_find(dev_a + ii));
+    ESPUT_ASSERT(otb_ds18b20_addresses[test_find(dev_a + ii)].bus == 0);
+  }
+
+  return TRUE;
+}
+
+bool test_sample(char *test_name)
+{
+  int publishes;
+
+  // Values from the sample after the search
+  if (!test_check_temps(test_name, dev_a, sizeof(dev_a)/sizeof(dev_a[0])))
+  {
+    return FALSE;
+  }
+
+  // Values from the next sample cycle - only one conversion
+  dev_a[0].temp = 22 * 16 + 4;
+  dev_a[3].temp = 3 * 16 + 8;
+  publishes = esput_temp_publishes;
+  esput_ow_buses[TEST_PIN_A].converts = 0;
+  esput_timer_run(OTB_DS18B20_REPORT_INTERVAL * 1000);
+  ESPUT_ASSERT(esput_ow_buses[TEST_PIN_A].converts == 1);
+  ESPUT_ASSERT(esput_temp_publishes == publishes + (sizeof(dev_a)/sizeof(dev_a[0])));
+  if (!test_check_temps(test_name, dev_a, sizeof(dev_a)/sizeof(dev_a[0])))
+  {
+    return FALSE;
+  }
+
+  // Reads must not be attempted before the conversion completes
+  ESPUT_ASSERT((esput_ow_buses[TEST_PIN_A].first_read_after_convert -
+                esput_ow_buses[TEST_PIN_A].last_convert) >= 750000);
+
+  return TRUE;
+}
+
+bool test_retry(char *test_name)
+{
+  int index;
+  int errors;
+
+  index = test_find(dev_a + 1);
+  ESPUT_ASSERT(index >= 0);
+
+  // A couple of CRC errors - should be retried and succeed
+  dev_a[1].temp = -5 * 16;
+  dev_a[1].crc_errors = 2;
+  errors = esput_error_publishes;
+  esput_timer_run(OTB_DS18B20_REPORT_INTERVAL * 1000);
+  ESPUT_ASSERT(dev_a[1].crc_errors == 0);
+  ESPUT_ASSERT(esput_error_publishes == errors + 1);
+  ESPUT_ASSERT(!strcmp(test_last_temp_s(index), "-5.00"));
+
+  // Too many - should give up
+  dev_a[1].crc_errors = OTB_DS18B20_OW_READ_TRIES;
+  esput_timer_run(OTB_DS18B20_REPORT_INTERVAL * 1000);
+  ESPUT_ASSERT(dev_a[1].crc_errors == 0);
+  ESPUT_ASSERT(!strcmp(test_last_temp_s(index), OTB_DS18B20_INTERNAL_ERROR_TEMP));
+
+  // And recover
+  esput_timer_run(OTB_DS18B20_REPORT_INTERVAL * 1000);
+  ESPUT_ASSERT(!strcmp(test_last_temp_s(index), "-5.00"));
+
+  return TRUE;
+}
+
+bool test_dropout(char *test_name)
+{
+  int count;
+  int statuses;
+  char friendly[OTB_DS18B20_MAX_ADDRESS_STRING_LENGTH];
+
+  count = otb_ds18b20_count;
+  ESPUT_ASSERT(test_find(dev_a + 2) >= 0);
+  test_friendly(dev_a + 2, friendly);
+
+  // The failed read leads to a search, which removes the device
+  dev_a[2].present = FALSE;
+  statuses = esput_status_sends;
+  esput_timer_run(OTB_DS18B20_REPORT_INTERVAL * 1000);
+  ESPUT_ASSERT(test_find(dev_a + 2) < 0);
+  ESPUT_ASSERT(otb_ds18b20_find_device(dev_a[2].rom) < 0);
+  ESPUT_ASSERT(otb_ds18b20_count == count - 1);
+  ESPUT_ASSERT(esput_status_sends == statuses + 1);
+  LOG("Status: %s", esput_last_status);
+  ESPUT_ASSERT(strstr(esput_last_status, "removed") != NULL);
+  ESPUT_ASSERT(strstr(esput_last_status, friendly) != NULL);
+
+  // Other devices unaffected, including the one which moved down a slot
+  if (!test_check_temps(test_name, dev_a, 2) ||
+      !test_check_temps(test_name, dev_a + 3, 1))
+  {
+    return FALSE;
+  }
+  ESPUT_ASSERT(otb_ds18b20_find_device(dev_a[3].rom) == test_find(dev_a + 3));
+
+  // Found again by the next search, and read straight away
+  dev_a[2].present = TRUE;
+  otb_ds18b20_device_callback(NULL);
+  esput_timer_run(2000000);
+  ESPUT_ASSERT(otb_ds18b20_count == count);
+  ESPUT_ASSERT(strstr(esput_last_status, "added") != NULL);
+  if (!test_check_temps(test_name, dev_a, sizeof(dev_a)/sizeof(dev_a[0])))
+  {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+bool test_multi_bus(char *test_name)
+{
+  int ii;
+  int count;
+
+  count = otb_ds18b20_count;
+  for (ii = 0; ii < sizeof(dev_b)/sizeof(dev_b[0]); ii++)
+  {
+    esput_ow_add_device(TEST_PIN_B, dev_b + ii);
+  }
+  otb_ds18b20_initialize(TEST_PIN_B);
+
+  // Initializing the same pin again is ignored
+  otb_ds18b20_initialize(TEST_PIN_B);
+  esput_timer_run(2000000);
+  ESPUT_ASSERT(otb_ds18b20_count == count + sizeof(dev_b)/sizeof(dev_b[0]));
+  for (ii = 0; ii < sizeof(dev_b)/sizeof(dev_b[0]); ii++)
+  {
+    ESPUT_ASSERT(test_find(dev_b + ii) >= 0);
+    ESPUT_ASSERT(otb_ds18b20_addresses[test_find(dev_b + ii)].bus == 1);
+  }
+  if (!test_check_temps(test_name, dev_b, sizeof(dev_b)/sizeof(dev_b[0])))
+  {
+    return FALSE;
+  }
+
+  // Both buses are sampled in parallel
+  esput_timer_run(OTB_DS18B20_REPORT_INTERVAL * 1000);
+  LOG("Bus A converted at %llu, bus B at %llu",
+      esput_ow_buses[TEST_PIN_A].last_convert,
+      esput_ow_buses[TEST_PIN_B].last_convert);
+  ESPUT_ASSERT(esput_ow_buses[TEST_PIN_B].last_convert <
+               esput_ow_buses[TEST_PIN_A].last_convert + 10000);
+  ESPUT_ASSERT(esput_ow_buses[TEST_PIN_A].last_convert <
+               esput_ow_buses[TEST_PIN_B].last_convert + 10000);
+
+  return TRUE;
+}
+
+bool test_resolution(char *test_name)
+{
+  unsigned long long conv_time;
+
+  // Configure bus B's devices for 9 and 10 bits
+  test_friendly(dev_b + 0, test_conf.ds18b20[0].id);
+  test_conf.ds18b20[0].res = 9;
+  test_friendly(dev_b + 1, test_conf.ds18b20[1].id);
+  test_conf.ds18b20[1].res = 10;
+  test_conf.ds18b20s = 2;
+  otb_ds18b20_conf_changed();
+
+  // First cycle reads at 12 bits and then reconfigures
+  esput_timer_run(OTB_DS18B20_REPORT_INTERVAL * 1000);
+  ESPUT_ASSERT(dev_b[0].config == 0x1f);
+  ESPUT_ASSERT(dev_b[1].config == 0x3f);
+
+  // Second cycle only waits as long as the 10 bit device needs
+  esput_timer_run(OTB_DS18B20_REPORT_INTERVAL * 1000);
+  conv_time = esput_ow_buses[TEST_PIN_B].first_read_after_convert -
+              esput_ow_buses[TEST_PIN_B].last_convert;
+  LOG("Bus B conversion time %llu us", conv_time);
+  ESPUT_ASSERT(conv_time >= 187500);
+  ESPUT_ASSERT(conv_time < 375000);
+
+  // Bus A is still at 12 bits
+  conv_time = esput_ow_buses[TEST_PIN_A].first_read_after_convert -
+              esput_ow_buses[TEST_PIN_A].last_convert;
+  ESPUT_ASSERT(conv_time >= 750000);
+
+  // Reduced resolution readings
+  ESPUT_ASSERT(!strcmp(test_last_temp_s(test_find(dev_b + 0)), "20.50"));
+  ESPUT_ASSERT(!strcmp(test_last_temp_s(test_find(dev_b + 1)), "30.75"));
+
+  // Sensor loses its configuration (power cycled) - gets rewritten
+  dev_b[0].config = 0x7f;
+  esput_timer_run(OTB_DS18B20_REPORT_INTERVAL * 1000);
+  ESPUT_ASSERT(dev_b[0].config == 0x1f);
+
+  return TRUE;
+}
+
+bool test_alarm(char *test_name)
+{
+  int publishes;
+  int converts;
+  int converts_b;
+  int statuses;
+  char friendly[OTB_DS18B20_MAX_ADDRESS_STRING_LENGTH];
+
+  // Configure thresholds for one of bus A's devices.  The others have TH and
+  // TL of 0, so are in alarm, but must be ignored.
+  test_friendly(dev_a + 0, friendly);
+  strcpy(test_conf.ds18b20[2].id, friendly);
+  test_conf.ds18b20_alarm[2].low = 10;
+  test_conf.ds18b20_alarm[2].high = 30;
+  test_conf.ds18b20_alarm[2].enabled = OTB_CONF_DS18B20_ALARM_ENABLED;
+  test_conf.ds18b20s = 3;
+  otb_ds18b20_conf_changed();
+
+  // Written to the device when it's next read
+  test_run_to(5000000);
+  esput_timer_run(OTB_DS18B20_REPORT_INTERVAL * 1000);
+  ESPUT_ASSERT(dev_a[0].th == 30);
+  ESPUT_ASSERT(dev_a[0].tl == 10);
+
+  // In range - bus A is converted, but nothing is read.  Bus B has no alarms
+  // configured so is left alone.
+  publishes = esput_temp_publishes;
+  converts = esput_ow_buses[TEST_PIN_A].converts;
+  converts_b = esput_ow_buses[TEST_PIN_B].converts;
+  esput_timer_run(OTB_DS18B20_ALARM_INTERVAL * 1000);
+  ESPUT_ASSERT(esput_ow_buses[TEST_PIN_A].converts == converts + 1);
+  ESPUT_ASSERT(esput_ow_buses[TEST_PIN_B].converts == converts_b);
+  ESPUT_ASSERT(esput_temp_publishes == publishes);
+
+  // Above the high threshold - only this device is read
+  dev_a[0].temp = 35 * 16;
+  statuses = esput_status_sends;
+  esput_timer_run(OTB_DS18B20_ALARM_INTERVAL * 1000);
+  ESPUT_ASSERT(esput_temp_publishes == publishes + 1);
+  ESPUT_ASSERT(!strcmp(esput_last_temp_loc, friendly));
+  ESPUT_ASSERT(!strcmp(esput_last_temp, "35.00"));
+  ESPUT_ASSERT(esput_status_sends == statuses + 1);
+  ESPUT_ASSERT(strstr(esput_last_status, "alarm") != NULL);
+
+  // At the low threshold
+  dev_a[0].temp = 10 * 16;
+  esput_timer_run(OTB_DS18B20_ALARM_INTERVAL * 1000);
+  ESPUT_ASSERT(esput_temp_publishes == publishes + 2);
+  ESPUT_ASSERT(!strcmp(esput_last_temp, "10.00"));
+
+  // Disabled - no more conversions
+  test_conf.ds18b20_alarm[2].enabled = OTB_CONF_DS18B20_ALARM_DISABLED;
+  converts = esput_ow_buses[TEST_PIN_A].converts;
+  esput_timer_run(OTB_DS18B20_ALARM_INTERVAL * 1000);
+  ESPUT_ASSERT(esput_ow_buses[TEST_PIN_A].converts == converts);
+  ESPUT_ASSERT(esput_temp_publishes == publishes + 2);
+
+  dev_a[0].temp = 22 * 16 + 4;
+
+  return TRUE;
+}
+
+bool test_max_devices(char *test_name)
+{
+  int ii;
+
+  ESPUT_ASSERT(otb_ds18b20_count + sizeof(dev_c)/sizeof(dev_c[0]) > OTB_DS18B20_MAX_DS18B20S);
+  for (ii = 0; ii < sizeof(dev_c)/sizeof(dev_c[0]); ii++)
+  {
+    esput_ow_add_device(TEST_PIN_C, dev_c + ii);
+  }
+  otb_ds18b20_initialize(TEST_PIN_C);
+  esput_timer_run(2000000);
+  ESPUT_ASSERT(otb_ds18b20_count == OTB_DS18B20_MAX_DS18B20S);
+
+  return TRUE;
+}
+
+bool test_timing(char *test_name)
+{
+  unsigned long long start;
+  unsigned long long cycle;
+
+  // Time a full sample cycle on all buses
+  esput_intr_lock_max = 0;
+  start = esput_now;
+  otb_ds18b20_ow_request(OTB_DS18B20_OW_PENDING_SAMPLE);
+  esput_timer_run(2000000);
+  cycle = esput_last_temp_time - start;
+  LOG("Sample cycle for %d devices took %llu us", otb_ds18b20_count, cycle);
+  LOG("Longest time with interrupts disabled %llu us", esput_intr_lock_max);
+
+  // All buses convert in parallel, so a cycle takes little more than one
+  // conversion
+  ESPUT_ASSERT(cycle < 1000000);
+
+  // Interrupts must only be disabled for a single slot at a time
+  ESPUT_ASSERT(esput_intr_lock_max > 0);
+  ESPUT_ASSERT(esput_intr_lock_max <= 70);
+
+  return TRUE;
+}
+
+esput_test esput_tests[] =
+{
+  {test_decode, "Decode", "Decode scratchpad temperatures"},
+  {test_search, "Search", "Search a bus for devices"},
+  {test_sample, "Sample", "Sample all devices on a bus"},
+  {test_retry, "Retry", "Retry scratchpad reads with CRC errors"},
+  {test_dropout, "Dropout", "Device drops off the bus"},
+  {test_multi_bus, "Multi bus", "Search and sample a second bus"},
+  {test_resolution, "Resolution", "Configure reduced resolution"},
+  {test_alarm, "Alarm", "Alarm search fast path"},
+  {test_max_devices, "Max devices", "More devices than supported"},
+  {test_timing, "Timing", "Sample cycle timing and interrupt latency"},
+  {NULL, NULL, NULL},
+};
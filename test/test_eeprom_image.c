@@ -0,0 +1,436 @@
+#include "otb.h"
+
+#define TEST_TYPE_INFO   OTB_EEPROM_INFO_TYPE_INFO
+#define TEST_TYPE_FIXED  1
+#define TEST_TYPE_VAR    2
+#define TEST_TYPES_NUM   3
+
+#define TEST_FUZZ_ITERATIONS  5000
+
+// Sizes are as on the eeprom - so not sizeof() the host's structs
+static otb_eeprom_main_comp_type test_types[TEST_TYPES_NUM] =
+{
+  {.name = (unsigned char *)"info",
+   .magic = OTB_EEPROM_INFO_MAGIC,
+   .struct_size_min = OTB_EEPROM_IMAGE_INFO_COMP,
+   .struct_size_max = OTB_EEPROM_IMAGE_INFO_COMP,
+   .version_min = 1,
+   .version_max = 1},
+  {.name = (unsigned char *)"fixed",
+   .magic = 0x11223344,
+   .struct_size_min = 40,
+   .struct_size_max = 40,
+   .version_min = 1,
+   .version_max = 2},
+  {.name = (unsigned char *)"variable",
+   .magic = 0xa5a5f00f,
+   .struct_size_min = 28,
+   .struct_size_max = 32,
+   .version_min = 1,
+   .version_max = 1},
+};
+
+static uint8_t test_image[4096];
+static uint8_t test_copy[4096];
+static uint32_t test_seed;
+
+static uint32_t test_rand(void)
+{
+  test_seed = (test_seed * 1103515245) + 12345;
+  return (test_seed >> 8) & 0xffffff;
+}
+
+static uint32_t test_entry(uint32_t num)
+{
+  return OTB_EEPROM_IMAGE_INFO_COMP + (num * OTB_EEPROM_IMAGE_INFO_COMP_LEN);
+}
+
+// Builds an image in test_image, as hwinfo would: otb_eeprom_info listing num
+// comps of the given types, laid out straight after it.  Variable comps have
+// extra bytes after the struct.  Returns the image's length.
+static uint32_t test_build(const uint32_t *types, uint32_t num, uint32_t extra)
+{
+  uint32_t loc;
+  uint32_t len;
+  uint32_t ii;
+  uint32_t jj;
+
+  memset(test_image, 0, sizeof(test_image));
+  loc = test_entry(num);
+  otb_eeprom_image_hdr_set(test_image, TEST_TYPE_INFO, test_types + TEST_TYPE_INFO, loc);
+  otb_eeprom_image_put32(test_image + OTB_EEPROM_IMAGE_INFO_EEPROM_SIZE, sizeof(test_image));
+  otb_eeprom_image_put32(test_image + OTB_EEPROM_IMAGE_INFO_COMP_NUM, num);
+  otb_eeprom_image_put32(test_image + OTB_EEPROM_IMAGE_INFO_WRITE_DATE, 0x07e40a13);
+
+  for (ii = 0; ii < num; ii++)
+  {
+    len = test_types[types[ii]].struct_size_max;
+    if (types[ii] == TEST_TYPE_VAR)
+    {
+      len += extra;
+    }
+    otb_eeprom_image_put32(test_image + test_entry(ii) + OTB_EEPROM_IMAGE_COMP_TYPE, types[ii]);
+    otb_eeprom_image_put32(test_image + test_entry(ii) + OTB_EEPROM_IMAGE_COMP_LOCATION, loc);
+    otb_eeprom_image_put32(test_image + test_entry(ii) + OTB_EEPROM_IMAGE_COMP_LENGTH, len);
+
+    otb_eeprom_image_hdr_set(test_image + loc, types[ii], test_types + types[ii], len);
+    for (jj = OTB_EEPROM_IMAGE_HDR_LEN; jj < len; jj++)
+    {
+      test_image[loc + jj] = test_rand();
+    }
+    otb_eeprom_image_seal(test_image + loc);
+    loc += len;
+  }
+  otb_eeprom_image_seal(test_image);
+
+  return loc;
+}
+
+static uint32_t test_verify(uint32_t len)
+{
+  return otb_eeprom_image_verify(test_image, len, test_types, TEST_TYPES_NUM);
+}
+
+// Changes one of the listed comps' entry in otb_eeprom_info, and reseals it
+static void test_set_entry(uint32_t num, uint32_t field, uint32_t val)
+{
+  otb_eeprom_image_put32(test_image + test_entry(num) + field, val);
+  otb_eeprom_image_seal(test_image);
+}
+
+bool test_fields(char *test_name)
+{
+  uint8_t data[4];
+  uint8_t top[4] = {0xff, 0x00, 0x00, 0x80};
+
+  otb_eeprom_image_put32(data, 0x12345678);
+  ESPUT_ASSERT((data[0] == 0x78) && (data[1] == 0x56) && (data[2] == 0x34) && (data[3] == 0x12));
+  ESPUT_ASSERT(otb_eeprom_image_get32(data) == 0x12345678);
+  ESPUT_ASSERT(otb_eeprom_image_get32(top) == 0x800000ff);
+
+  return TRUE;
+}
+
+bool test_checksum(char *test_name)
+{
+  uint8_t data[64];
+  uint32_t expected;
+  uint32_t checksum;
+  int ii;
+
+  // Bytes >= 0x80 are added unsigned - a signed char sum gives 0x123455f8
+  memset(data, 0, sizeof(data));
+  data[0] = 0x80;
+  ESPUT_ASSERT(otb_eeprom_image_checksum(data, 8, 4) == 0x123456f8);
+
+  for (ii = 0; ii < sizeof(data); ii++)
+  {
+    data[ii] = 0xc3 ^ (ii * 29);
+  }
+  expected = OTB_EEPROM_CHECKSUM_INITIAL;
+  for (ii = 0; ii < sizeof(data); ii++)
+  {
+    if ((ii < OTB_EEPROM_IMAGE_HDR_CHECKSUM) || (ii >= (OTB_EEPROM_IMAGE_HDR_CHECKSUM + 4)))
+    {
+      expected += (uint32_t)data[ii] << ((ii % 4) * 8);
+    }
+  }
+  checksum = otb_eeprom_image_checksum(data, sizeof(data), OTB_EEPROM_IMAGE_HDR_CHECKSUM);
+  ESPUT_ASSERT(checksum == (expected & 0xffffffff));
+
+  // The checksum itself isn't included, anything else is
+  data[OTB_EEPROM_IMAGE_HDR_CHECKSUM + 2] ^= 0xff;
+  ESPUT_ASSERT(otb_eeprom_image_checksum(data, sizeof(data), OTB_EEPROM_IMAGE_HDR_CHECKSUM) == checksum);
+  data[sizeof(data) - 1] ^= 0x01;
+  ESPUT_ASSERT(otb_eeprom_image_checksum(data, sizeof(data), OTB_EEPROM_IMAGE_HDR_CHECKSUM) != checksum);
+
+  return TRUE;
+}
+
+bool test_valid(char *test_name)
+{
+  uint32_t types[] = {TEST_TYPE_FIXED, TEST_TYPE_VAR, TEST_TYPE_VAR};
+  uint32_t len;
+  uint32_t loc;
+  uint32_t length;
+  bool found;
+
+  test_seed = 1;
+  len = test_build(types, 3, 8);
+  ESPUT_ASSERT(len == (test_entry(3) + 40 + 40 + 40));
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_OK);
+
+  // Eeprom is bigger than the image
+  ESPUT_ASSERT(test_verify(sizeof(test_image)) == OTB_EEPROM_ERR_OK);
+
+  found = otb_eeprom_image_find(test_image, TEST_TYPE_FIXED, 0, &loc, &length);
+  ESPUT_ASSERT(found && (loc == test_entry(3)) && (length == 40));
+  found = otb_eeprom_image_find(test_image, TEST_TYPE_VAR, 1, &loc, &length);
+  ESPUT_ASSERT(found && (loc == (test_entry(3) + 80)) && (length == 40));
+  ESPUT_ASSERT(otb_eeprom_image_get32(test_image + loc + OTB_EEPROM_IMAGE_HDR_MAGIC) == test_types[TEST_TYPE_VAR].magic);
+  ESPUT_ASSERT(otb_eeprom_image_checksum_ok(test_image + loc));
+  ESPUT_ASSERT(!otb_eeprom_image_find(test_image, TEST_TYPE_VAR, 2, &loc, &length));
+  ESPUT_ASSERT(!otb_eeprom_image_find(test_image, TEST_TYPE_INFO, 0, &loc, &length));
+
+  // No components at all
+  len = test_build(types, 0, 0);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_OK);
+
+  return TRUE;
+}
+
+// Every byte of an image is covered by a checksum, so any single byte change
+// must be caught
+bool test_corrupt(char *test_name)
+{
+  uint32_t types[] = {TEST_TYPE_VAR, TEST_TYPE_FIXED, TEST_TYPE_VAR};
+  uint8_t masks[] = {0x01, 0x80, 0xff};
+  uint32_t len;
+  uint32_t ii;
+  int jj;
+
+  test_seed = 2;
+  len = test_build(types, 3, 20);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_OK);
+  for (ii = 0; ii < len; ii++)
+  {
+    for (jj = 0; jj < sizeof(masks); jj++)
+    {
+      test_image[ii] ^= masks[jj];
+      ESPUT_ASSERT(test_verify(len) != OTB_EEPROM_ERR_OK);
+      test_image[ii] ^= masks[jj];
+    }
+  }
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_OK);
+
+  return TRUE;
+}
+
+bool test_truncate(char *test_name)
+{
+  uint32_t types[] = {TEST_TYPE_FIXED, TEST_TYPE_VAR};
+  uint32_t len;
+  uint32_t ii;
+
+  test_seed = 3;
+  len = test_build(types, 2, 4);
+  for (ii = 0; ii < len; ii++)
+  {
+    ESPUT_ASSERT(test_verify(ii) != OTB_EEPROM_ERR_OK);
+  }
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_OK);
+
+  return TRUE;
+}
+
+bool test_bounds(char *test_name)
+{
+  uint32_t types[] = {TEST_TYPE_FIXED, TEST_TYPE_VAR};
+  uint32_t len;
+  uint32_t loc;
+
+  // Component entries pointing outside the image, or wrapping
+  test_seed = 4;
+  len = test_build(types, 2, 0);
+  loc = test_entry(2) + 40;
+  test_set_entry(1, OTB_EEPROM_IMAGE_COMP_LOCATION, 0xffffffff);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_LENGTH);
+  test_set_entry(1, OTB_EEPROM_IMAGE_COMP_LOCATION, 0xfffffff0);
+  test_set_entry(1, OTB_EEPROM_IMAGE_COMP_LENGTH, 0x20);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_LENGTH);
+  test_set_entry(1, OTB_EEPROM_IMAGE_COMP_LOCATION, loc);
+  test_set_entry(1, OTB_EEPROM_IMAGE_COMP_LENGTH, 0xffffffff);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_LENGTH);
+  test_set_entry(1, OTB_EEPROM_IMAGE_COMP_LENGTH, OTB_EEPROM_IMAGE_HDR_LEN - 1);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_LENGTH);
+
+  // Listed length shorter than the component's header says
+  test_set_entry(1, OTB_EEPROM_IMAGE_COMP_LENGTH, 28);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_BUF_LEN_COMP);
+  test_set_entry(1, OTB_EEPROM_IMAGE_COMP_LENGTH, 32);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_OK);
+
+  // Types
+  test_set_entry(1, OTB_EEPROM_IMAGE_COMP_TYPE, TEST_TYPES_NUM);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_TYPE);
+  test_set_entry(1, OTB_EEPROM_IMAGE_COMP_TYPE, TEST_TYPE_INFO);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_TYPE);
+  test_set_entry(1, OTB_EEPROM_IMAGE_COMP_TYPE, TEST_TYPE_FIXED);
+  ESPUT_ASSERT(test_verify(len) & OTB_EEPROM_ERR_TYPE);
+  test_set_entry(1, OTB_EEPROM_IMAGE_COMP_TYPE, TEST_TYPE_VAR);
+
+  // Too many components for otb_eeprom_info to hold
+  otb_eeprom_image_put32(test_image + OTB_EEPROM_IMAGE_INFO_COMP_NUM, OTB_EEPROM_INFO_MAX_COMP + 1);
+  otb_eeprom_image_seal(test_image);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_LENGTH);
+  otb_eeprom_image_put32(test_image + OTB_EEPROM_IMAGE_INFO_COMP_NUM, 0xffffffff);
+  otb_eeprom_image_seal(test_image);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_LENGTH);
+  otb_eeprom_image_put32(test_image + OTB_EEPROM_IMAGE_INFO_COMP_NUM, 3);
+  otb_eeprom_image_seal(test_image);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_LENGTH);
+  otb_eeprom_image_put32(test_image + OTB_EEPROM_IMAGE_INFO_COMP_NUM, 2);
+  otb_eeprom_image_seal(test_image);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_OK);
+
+  // Component headers
+  otb_eeprom_image_put32(test_image + loc + OTB_EEPROM_IMAGE_HDR_VERSION, 2);
+  otb_eeprom_image_seal(test_image + loc);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_VERSION);
+  otb_eeprom_image_put32(test_image + loc + OTB_EEPROM_IMAGE_HDR_VERSION, 1);
+  otb_eeprom_image_put32(test_image + loc + OTB_EEPROM_IMAGE_HDR_STRUCT_SIZE, 24);
+  otb_eeprom_image_seal(test_image + loc);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_STRUCT_SIZE);
+  otb_eeprom_image_put32(test_image + loc + OTB_EEPROM_IMAGE_HDR_STRUCT_SIZE, 28);
+  otb_eeprom_image_seal(test_image + loc);
+  ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_OK);
+  ESPUT_ASSERT(otb_eeprom_image_hdr_check(test_image + loc, TEST_TYPE_VAR, test_types + TEST_TYPE_VAR, 31) == OTB_EEPROM_ERR_BUF_LEN_COMP);
+  otb_eeprom_image_put32(test_image + loc + OTB_EEPROM_IMAGE_HDR_LENGTH, 27);
+  ESPUT_ASSERT(otb_eeprom_image_hdr_check(test_image + loc, TEST_TYPE_VAR, test_types + TEST_TYPE_VAR, len) == OTB_EEPROM_ERR_LENGTH);
+
+  // Too short to hold otb_eeprom_info, or the wrong table
+  ESPUT_ASSERT(test_verify(OTB_EEPROM_IMAGE_INFO_COMP - 1) == OTB_EEPROM_ERR_LENGTH);
+  ESPUT_ASSERT(otb_eeprom_image_verify(test_image, len, test_types, 0) == OTB_EEPROM_ERR_LENGTH);
+
+  return TRUE;
+}
+
+//
+// Builds random valid images, checking they verify and decode to what was
+// built, and then that random damage to them is caught.  Finally checks
+// random data (with a valid otb_eeprom_info header, to get further) doesn't
+// upset verify.
+//
+bool test_fuzz(char *test_name)
+{
+  uint32_t types[OTB_EEPROM_INFO_MAX_COMP];
+  uint32_t num;
+  uint32_t len;
+  uint32_t loc;
+  uint32_t length;
+  uint32_t byte;
+  uint8_t mask;
+  uint32_t ii;
+  uint32_t jj;
+  uint32_t found;
+
+  test_seed = 0x5eed;
+  for (ii = 0; ii < TEST_FUZZ_ITERATIONS; ii++)
+  {
+    num = test_rand() % (OTB_EEPROM_INFO_MAX_COMP + 1);
+    for (jj = 0; jj < num; jj++)
+    {
+      types[jj] = 1 + (test_rand() % (TEST_TYPES_NUM - 1));
+    }
+    len = test_build(types, num, test_rand() % 64);
+    ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_OK);
+
+    // Every component can be found, in order
+    found = 0;
+    for (jj = 0; jj < num; jj++)
+    {
+      if (types[jj] == TEST_TYPE_FIXED)
+      {
+        ESPUT_ASSERT(otb_eeprom_image_find(test_image, TEST_TYPE_FIXED, found, &loc, &length));
+        ESPUT_ASSERT(otb_eeprom_image_get32(test_image + test_entry(jj) + OTB_EEPROM_IMAGE_COMP_LOCATION) == loc);
+        ESPUT_ASSERT(length == 40);
+        found++;
+      }
+    }
+    ESPUT_ASSERT(!otb_eeprom_image_find(test_image, TEST_TYPE_FIXED, found, &loc, &length));
+
+    // One byte changed, then some more
+    memcpy(test_copy, test_image, len);
+    byte = test_rand() % len;
+    mask = 1 + (test_rand() % 0xff);
+    test_image[byte] ^= mask;
+    ESPUT_ASSERT(test_verify(len) != OTB_EEPROM_ERR_OK);
+    for (jj = test_rand() % 8; jj > 0; jj--)
+    {
+      test_image[test_rand() % len] = test_rand();
+    }
+    test_verify(len);
+    test_verify(test_rand() % len);
+    memcpy(test_image, test_copy, len);
+    ESPUT_ASSERT(test_verify(len) == OTB_EEPROM_ERR_OK);
+  }
+
+  for (ii = 0; ii < TEST_FUZZ_ITERATIONS; ii++)
+  {
+    for (jj = 0; jj < sizeof(test_image); jj++)
+    {
+      test_image[jj] = test_rand();
+    }
+    len = OTB_EEPROM_IMAGE_INFO_COMP + (test_rand() % sizeof(test_image));
+    len = (len > sizeof(test_image)) ? sizeof(test_image) : len;
+    ESPUT_ASSERT(test_verify(len) != OTB_EEPROM_ERR_OK);
+
+    otb_eeprom_image_hdr_set(test_image, TEST_TYPE_INFO, test_types + TEST_TYPE_INFO, len);
+    if (ii % 2)
+    {
+      otb_eeprom_image_put32(test_image + OTB_EEPROM_IMAGE_INFO_COMP_NUM, test_rand() % (OTB_EEPROM_INFO_MAX_COMP + 1));
+    }
+    otb_eeprom_image_seal(test_image);
+    test_verify(len);
+  }
+
+  return TRUE;
+}
+
+//
+// Only a temperature mezzanine board is given its GPIOs, for 1-Wire buses -
+// other boards get their own init (or none), and never start a 1-Wire bus on
+// their pins
+//
+bool test_mezz_init(char *test_name)
+{
+  uint32_t gpios = (5 << 8) | 4;
+  void *param;
+  uint32_t types[] =
+  {
+    OTB_EEPROM_MODULE_TYPE_PROG_V0_1,
+    OTB_EEPROM_MODULE_TYPE_NIXIE_V0_2,
+    OTB_EEPROM_MODULE_TYPE_RELAY_V0_2,
+    OTB_EEPROM_MODULE_TYPE_MBUS_V0_1,
+    OTB_EEPROM_MODULE_TYPE_ADC_V0_1,
+    OTB_EEPROM_MODULE_TYPE_LL_V0_1,
+    0x12345678,
+  };
+  uint32_t ii;
+
+  ESPUT_ASSERT(otb_eeprom_image_mezz_init(OTB_EEPROM_MODULE_TYPE_TEMP_V0_2, gpios, &param) == OTB_EEPROM_IMAGE_MEZZ_INIT_DS18B20);
+  ESPUT_ASSERT((uint32_t)(long)param == gpios);
+
+  for (ii = 0; ii < sizeof(types)/sizeof(types[0]); ii++)
+  {
+    param = (void *)1;
+    ESPUT_ASSERT(otb_eeprom_image_mezz_init(types[ii], gpios, &param) != OTB_EEPROM_IMAGE_MEZZ_INIT_DS18B20);
+    ESPUT_ASSERT((uint32_t)(long)param != gpios);
+  }
+
+  ESPUT_ASSERT(otb_eeprom_image_mezz_init(OTB_EEPROM_MODULE_TYPE_LL_V0_1, gpios, &param) == OTB_EEPROM_IMAGE_MEZZ_INIT_NONE);
+  ESPUT_ASSERT(param == NULL);
+  ESPUT_ASSERT(otb_eeprom_image_mezz_init(OTB_EEPROM_MODULE_TYPE_NIXIE_V0_2, gpios, &param) == OTB_EEPROM_IMAGE_MEZZ_INIT_NONE);
+  ESPUT_ASSERT(param == NULL);
+  ESPUT_ASSERT(otb_eeprom_image_mezz_init(0x12345678, gpios, &param) == OTB_EEPROM_IMAGE_MEZZ_INIT_NONE);
+  ESPUT_ASSERT(param == NULL);
+  ESPUT_ASSERT(otb_eeprom_image_mezz_init(OTB_EEPROM_MODULE_TYPE_RELAY_V0_2, gpios, &param) == OTB_EEPROM_IMAGE_MEZZ_INIT_RELAY);
+  ESPUT_ASSERT(param == NULL);
+  ESPUT_ASSERT(otb_eeprom_image_mezz_init(OTB_EEPROM_MODULE_TYPE_MBUS_V0_1, gpios, &param) == OTB_EEPROM_IMAGE_MEZZ_INIT_MBUS);
+  ESPUT_ASSERT((uint32_t)(long)param == OTB_EEPROM_MODULE_TYPE_MBUS_V0_1);
+
+  return TRUE;
+}
+
+esput_test esput_tests[] =
+{
+  {test_fields, "Fields", "Little endian field encoding"},
+  {test_checksum, "Checksum", "Checksum calculation"},
+  {test_valid, "Valid image", "Verifying and finding components in a valid image"},
+  {test_corrupt, "Corruption", "Every single byte corruption is detected"},
+  {test_truncate, "Truncation", "Every truncation is detected"},
+  {test_bounds, "Bounds", "Out of range locations, lengths, types and counts"},
+  {test_fuzz, "Fuzz", "Random images, damage and garbage"},
+  {test_mezz_init, "Mezzanine init", "Only temperature boards start 1-Wire buses on their GPIOs"},
+  {NULL, NULL, NULL},
+};
@@ -0,0 +1,729 @@
+#include "otb.h"
+
+#define TEST_ADDR_PCA9685  0x40
+#define TEST_ADDR_MCP23017 0x20
+#define TEST_ADDR_PCF8574  0x27
+#define TEST_ADDR_ADS      0x48
+#define TEST_ADDR_SC16IS   0x4d
+#define TEST_ABSENT        0x70
+
+// 100KHz, so 90us per byte including the ack
+#define TEST_BYTE_US       90
+#define TEST_STRETCH_US    1000
+
+static esput_i2c_bus test_bus;
+static brzo_i2c_info test_info = {0, 0, TEST_STRETCH_US, &test_bus};
+
+static esput_i2c_pca9685 test_pca;
+static esput_i2c_mcp23017 test_mcp;
+static esput_i2c_pcf8574 test_pcf;
+static esput_i2c_ads test_ads;
+static esput_i2c_sc16is test_uart;
+
+static int test_cb_count;
+
+static void test_setup(void)
+{
+  memset(&test_bus, 0, sizeof(test_bus));
+  esput_i2c_pca9685_init(&test_pca, TEST_ADDR_PCA9685);
+  esput_i2c_mcp23017_init(&test_mcp, TEST_ADDR_MCP23017);
+  esput_i2c_pcf8574_init(&test_pcf, TEST_ADDR_PCF8574);
+  esput_i2c_ads_init(&test_ads, TEST_ADDR_ADS);
+  esput_i2c_sc16is_init(&test_uart, TEST_ADDR_SC16IS);
+  esput_i2c_add_device(&test_bus, &test_pca.dev);
+  esput_i2c_add_device(&test_bus, &test_mcp.dev);
+  esput_i2c_add_device(&test_bus, &test_pcf.dev);
+  esput_i2c_add_device(&test_bus, &test_ads.dev);
+  esput_i2c_add_device(&test_bus, &test_uart.dev);
+  otb_i2c_shadow_reset();
+  test_cb_count = 0;
+}
+
+bool test_pca9685(char *test_name)
+{
+  bool rc;
+  uint8_t val[4] = {0x00, 0x01, 0x00, 0x08};
+  uint8_t all_off[4] = {0x00, 0x00, 0x00, 0x10};
+  uint8_t buf[4];
+  uint16_t on;
+  uint16_t off;
+  int ii;
+
+  test_setup();
+
+  // Power on state
+  rc = otb_i2c_read_one_reg_info(TEST_ADDR_PCA9685, 0x00, buf, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(buf[0] == 0x11);
+
+  // Wake, with auto-increment, then write all of LED3's registers
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_PCA9685, 0x00, 0x20, &test_info);
+  ESPUT_ASSERT(rc);
+  rc = otb_i2c_write_reg_seq_info(TEST_ADDR_PCA9685, 0x06 + (3 * 4), 4, val, &test_info);
+  ESPUT_ASSERT(rc);
+  esput_i2c_pca9685_led(&test_pca, 3, &on, &off);
+  ESPUT_ASSERT((on == 0x0100) && (off == 0x0800));
+  esput_i2c_pca9685_led(&test_pca, 4, &on, &off);
+  ESPUT_ASSERT((on == 0) && (off == 0x1000));
+  rc = otb_i2c_read_reg_seq_info(TEST_ADDR_PCA9685, 0x06 + (3 * 4), 4, buf, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(!memcmp(buf, val, 4));
+
+  // Without auto-increment every byte goes to the same register
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_PCA9685, 0x00, 0x00, &test_info);
+  ESPUT_ASSERT(rc);
+  rc = otb_i2c_write_reg_seq_info(TEST_ADDR_PCA9685, 0x06 + (4 * 4), 4, val, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_pca.regs[0x06 + (4 * 4)] == val[3]);
+  ESPUT_ASSERT(test_pca.regs[0x06 + (4 * 4) + 1] == 0);
+
+  // ALL_LED
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_PCA9685, 0x00, 0x20, &test_info);
+  ESPUT_ASSERT(rc);
+  rc = otb_i2c_write_reg_seq_info(TEST_ADDR_PCA9685, 0xfa, 4, all_off, &test_info);
+  ESPUT_ASSERT(rc);
+  for (ii = 0; ii < 16; ii++)
+  {
+    esput_i2c_pca9685_led(&test_pca, ii, &on, &off);
+    ESPUT_ASSERT((on == 0) && (off == 0x1000));
+  }
+
+  return TRUE;
+}
+
+bool test_mcp23017(char *test_name)
+{
+  bool rc;
+  uint8_t gpa;
+  uint8_t gpb;
+
+  test_setup();
+
+  rc = otb_i2c_mcp23017_init(TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_mcp.regs[OTB_I2C_MCP23017_REG_IODIRA] == 0);
+  ESPUT_ASSERT(test_mcp.regs[OTB_I2C_MCP23017_REG_IODIRB] == 0);
+
+  rc = otb_i2c_mcp23017_write_gpios(0xa5, 0x5a, TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(esput_i2c_mcp23017_outputs(&test_mcp, 0) == 0xa5);
+  ESPUT_ASSERT(esput_i2c_mcp23017_outputs(&test_mcp, 1) == 0x5a);
+
+  // Port B as inputs - output pins read back OLAT, inputs the pins
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_MCP23017, OTB_I2C_MCP23017_REG_IODIRB, 0xff, &test_info);
+  ESPUT_ASSERT(rc);
+  test_mcp.input[1] = 0x3c;
+  rc = otb_i2c_mcp23017_read_gpios(&gpa, &gpb, TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(gpa == 0xa5);
+  ESPUT_ASSERT(gpb == 0x3c);
+  ESPUT_ASSERT(esput_i2c_mcp23017_outputs(&test_mcp, 1) == 0);
+
+  // Inverted inputs
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_MCP23017, OTB_I2C_MCP23017_REG_IPOLB, 0x0f, &test_info);
+  ESPUT_ASSERT(rc);
+  rc = otb_i2c_mcp23017_read_gpios(&gpa, &gpb, TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(gpb == 0x33);
+
+  return TRUE;
+}
+
+bool test_pcf8574(char *test_name)
+{
+  bool rc;
+  uint8_t val;
+
+  test_setup();
+
+  rc = otb_i2c_write_one_val_info(TEST_ADDR_PCF8574, 0xf0, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_pcf.latch == 0xf0);
+
+  // Pins written high can be pulled low externally
+  test_pcf.input = 0x5f;
+  rc = otb_i2c_read_one_val_info(TEST_ADDR_PCF8574, &val, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(val == 0x50);
+
+  // Default bus
+  memset(&esput_i2c_default_bus, 0, sizeof(esput_i2c_default_bus));
+  esput_i2c_add_device(&esput_i2c_default_bus, &test_pcf.dev);
+  rc = otb_i2c_write_one_val(TEST_ADDR_PCF8574, 0x0f);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_pcf.latch == 0x0f);
+  ESPUT_ASSERT(esput_i2c_default_bus.transactions == 1);
+
+  return TRUE;
+}
+
+bool test_ads1115(char *test_name)
+{
+  bool rc;
+  // OS, AIN0 single ended, +/-4.096V, single-shot, 128SPS
+  uint8_t conf[2] = {0xc3, 0x83};
+  uint8_t buf[2];
+
+  test_setup();
+  test_ads.val[4] = 0x1234;
+  test_ads.val[5] = -2;
+
+  rc = otb_i2c_write_reg_seq_info(TEST_ADDR_ADS, ESPUT_I2C_ADS_REG_CONF, 2, conf, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(esput_i2c_ads_conv_us(&test_ads) == 1000000 / 128);
+
+  // Converting
+  rc = otb_i2c_read_reg_seq_info(TEST_ADDR_ADS, ESPUT_I2C_ADS_REG_CONF, 2, buf, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(!(buf[0] & 0x80));
+  ESPUT_ASSERT(test_ads.conversions == 0);
+
+  // Done
+  esput_now += esput_i2c_ads_conv_us(&test_ads);
+  rc = otb_i2c_read_reg_seq_info(TEST_ADDR_ADS, ESPUT_I2C_ADS_REG_CONF, 2, buf, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(buf[0] == 0xc3);
+  ESPUT_ASSERT(test_ads.conversions == 1);
+  rc = otb_i2c_read_reg_seq_info(TEST_ADDR_ADS, ESPUT_I2C_ADS_REG_CONV, 2, buf, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT((buf[0] == 0x12) && (buf[1] == 0x34));
+
+  // Next channel
+  conf[0] = 0xd3;
+  rc = otb_i2c_write_reg_seq_info(TEST_ADDR_ADS, ESPUT_I2C_ADS_REG_CONF, 2, conf, &test_info);
+  ESPUT_ASSERT(rc);
+  esput_now += esput_i2c_ads_conv_us(&test_ads);
+  rc = otb_i2c_read_reg_seq_info(TEST_ADDR_ADS, ESPUT_I2C_ADS_REG_CONV, 2, buf, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT((buf[0] == 0xff) && (buf[1] == 0xfe));
+
+  return TRUE;
+}
+
+// ALERT/RDY only fires once in single-shot mode, so a config with a rdy pin
+// must be continuous
+bool test_ads_conf(char *test_name)
+{
+  otb_conf_ads ads;
+
+  memset(&ads, 0, sizeof(ads));
+  ESPUT_ASSERT(OTB_CONF_ADS_RDY_CONT_OK(ads.rdy, ads.cont));
+  ads.cont = 1;
+  ESPUT_ASSERT(OTB_CONF_ADS_RDY_CONT_OK(ads.rdy, ads.cont));
+
+  // Setting rdy in single-shot mode, or single-shot mode with rdy set
+  ads.rdy = 4;
+  ESPUT_ASSERT(!OTB_CONF_ADS_RDY_CONT_OK(ads.rdy, ads.cont));
+  ads.cont = 0;
+  ESPUT_ASSERT(OTB_CONF_ADS_RDY_CONT_OK(ads.rdy, ads.cont));
+  ESPUT_ASSERT(!OTB_CONF_ADS_RDY_CONT_OK(ads.rdy, 1));
+  ESPUT_ASSERT(OTB_CONF_ADS_RDY_CONT_OK(OTB_CONF_ADS_RDY_NONE, 1));
+
+  return TRUE;
+}
+
+bool test_sc16is(char *test_name)
+{
+  bool rc;
+  uint8_t buf[8];
+
+  test_setup();
+
+  // THR, channels A and B
+  rc = otb_i2c_write_reg_seq_info(TEST_ADDR_SC16IS, 0x00, 5, (uint8_t *)"hello", &test_info);
+  ESPUT_ASSERT(rc);
+  rc = otb_i2c_write_reg_seq_info(TEST_ADDR_SC16IS, 0x02, 3, (uint8_t *)"abc", &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT((test_uart.channel[0].tx_count == 5) && !memcmp(test_uart.channel[0].tx, "hello", 5));
+  ESPUT_ASSERT((test_uart.channel[1].tx_count == 3) && !memcmp(test_uart.channel[1].tx, "abc", 3));
+
+  // Nothing received
+  rc = otb_i2c_read_one_reg_info(TEST_ADDR_SC16IS, ESPUT_I2C_SC16IS_REG_LSR << 3, buf, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(buf[0] == 0x60);
+
+  esput_i2c_sc16is_rx(&test_uart, 0, (uint8_t *)"xyz", 3);
+  rc = otb_i2c_read_one_reg_info(TEST_ADDR_SC16IS, ESPUT_I2C_SC16IS_REG_RXLVL << 3, buf, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(buf[0] == 3);
+  rc = otb_i2c_read_one_reg_info(TEST_ADDR_SC16IS, ESPUT_I2C_SC16IS_REG_LSR << 3, buf, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(buf[0] == 0x61);
+  rc = otb_i2c_read_reg_seq_info(TEST_ADDR_SC16IS, 0x00, 3, buf, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(!memcmp(buf, "xyz", 3));
+  ESPUT_ASSERT(test_uart.channel[0].rx_count == 0);
+
+  // GPIOs
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_SC16IS, ESPUT_I2C_SC16IS_REG_IODIR << 3, 0x0f, &test_info);
+  ESPUT_ASSERT(rc);
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_SC16IS, ESPUT_I2C_SC16IS_REG_IOSTATE << 3, 0x05, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT((test_uart.iodir == 0x0f) && (test_uart.iostate == 0x05));
+
+  return TRUE;
+}
+
+bool test_faults(char *test_name)
+{
+  bool rc;
+  uint8_t val;
+
+  test_setup();
+
+  // One byte write - address, register and value
+  esput_i2c_reset_stats(&test_bus);
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_PCA9685, 0x00, 0x20, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_bus.last_txn_us == 3 * TEST_BYTE_US);
+
+  // Register read - write the register, then read
+  rc = otb_i2c_read_one_reg_info(TEST_ADDR_PCA9685, 0x00, &val, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_bus.last_txn_us == 4 * TEST_BYTE_US);
+  ESPUT_ASSERT(test_bus.busy_us == 7 * TEST_BYTE_US);
+
+  // Address NAK, once
+  esput_i2c_reset_stats(&test_bus);
+  test_pca.dev.nak_addr = 1;
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_PCA9685, 0x01, 0x00, &test_info);
+  ESPUT_ASSERT(!rc);
+  ESPUT_ASSERT(test_bus.naks == 1);
+  ESPUT_ASSERT(test_pca.regs[0x01] == 0x04);
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_PCA9685, 0x01, 0x00, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_pca.regs[0x01] == 0x00);
+
+  // Data NAK - the rest of the transaction is skipped
+  esput_i2c_reset_stats(&test_bus);
+  test_pca.dev.nak_data = 1;
+  rc = otb_i2c_read_one_reg_info(TEST_ADDR_PCA9685, 0x00, &val, &test_info);
+  ESPUT_ASSERT(!rc);
+  ESPUT_ASSERT(test_bus.naks == 1);
+  ESPUT_ASSERT(test_bus.bytes_read == 0);
+
+  // Absent device
+  esput_i2c_reset_stats(&test_bus);
+  rc = otb_i2c_write_one_val_info(TEST_ABSENT, 0x00, &test_info);
+  ESPUT_ASSERT(!rc);
+  ESPUT_ASSERT(test_bus.naks == 1);
+  test_pcf.dev.present = FALSE;
+  rc = otb_i2c_write_one_val_info(TEST_ADDR_PCF8574, 0x00, &test_info);
+  ESPUT_ASSERT(!rc);
+  ESPUT_ASSERT(test_pcf.latch == 0xff);
+
+  // Clock stretching within the timeout just slows things down
+  esput_i2c_reset_stats(&test_bus);
+  test_pca.dev.stretch_us = 10;
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_PCA9685, 0x01, 0x04, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_bus.last_txn_us == 3 * (TEST_BYTE_US + 10));
+
+  // Beyond it the transaction fails
+  test_pca.dev.stretch_us = TEST_STRETCH_US + 1;
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_PCA9685, 0x01, 0x00, &test_info);
+  ESPUT_ASSERT(!rc);
+  ESPUT_ASSERT(test_bus.stretch_timeouts == 1);
+  ESPUT_ASSERT(test_bus.last_txn_us == TEST_BYTE_US + TEST_STRETCH_US);
+  ESPUT_ASSERT(test_pca.regs[0x01] == 0x04);
+  test_pca.dev.stretch_us = 0;
+
+  // Stuck bus - nothing reaches the device
+  esput_i2c_reset_stats(&test_bus);
+  test_bus.stuck = TRUE;
+  val = test_pca.dev.messages;
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_PCA9685, 0x01, 0x00, &test_info);
+  ESPUT_ASSERT(!rc);
+  ESPUT_ASSERT(test_pca.dev.messages == val);
+  ESPUT_ASSERT(test_bus.last_txn_us == 0);
+  test_bus.stuck = FALSE;
+
+  return TRUE;
+}
+
+static void test_txn_done(otb_i2c_txn *txn)
+{
+  test_cb_count++;
+}
+
+#define TEST_TXNS  40
+bool test_queue(char *test_name)
+{
+  bool rc;
+  otb_i2c_txn txn[TEST_TXNS];
+  uint8_t wr[TEST_TXNS][5];
+  otb_i2c_queue *queue;
+  uint16_t on;
+  uint16_t off;
+  int ii;
+
+  test_setup();
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_PCA9685, 0x00, 0x20, &test_info);
+  ESPUT_ASSERT(rc);
+
+  // A batch setting every LED, twice over - more than fits in one slice
+  memset(txn, 0, sizeof(txn));
+  for (ii = 0; ii < TEST_TXNS; ii++)
+  {
+    wr[ii][0] = 0x06 + ((ii % 16) * 4);
+    wr[ii][1] = 0;
+    wr[ii][2] = 0;
+    wr[ii][3] = ii;
+    wr[ii][4] = 0;
+    txn[ii].info = &test_info;
+    txn[ii].addr = TEST_ADDR_PCA9685;
+    txn[ii].wr_len = 5;
+    txn[ii].wr = wr[ii];
+    txn[ii].cb = test_txn_done;
+    txn[ii].next = (ii < (TEST_TXNS - 1)) ? &txn[ii+1] : NULL;
+  }
+  esput_i2c_reset_stats(&test_bus);
+  rc = otb_i2c_txn_submit(txn);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_bus.transactions == 0);
+
+  // Run one slice by hand
+  queue = otb_i2c_queue_get(&test_info);
+  ESPUT_ASSERT(queue != NULL);
+  otb_i2c_queue_timer(queue);
+  LOG("First slice: %d transactions, %lluus", test_cb_count, test_bus.busy_us);
+  ESPUT_ASSERT((test_cb_count > 0) && (test_cb_count < TEST_TXNS));
+  ESPUT_ASSERT(test_bus.busy_us >= OTB_I2C_QUEUE_SLICE_US);
+
+  esput_timer_run(100000);
+  ESPUT_ASSERT(test_cb_count == TEST_TXNS);
+  ESPUT_ASSERT(test_bus.transactions == TEST_TXNS);
+  ESPUT_ASSERT(test_bus.last_txn_us == 6 * TEST_BYTE_US);
+  for (ii = 0; ii < 16; ii++)
+  {
+    esput_i2c_pca9685_led(&test_pca, ii, &on, &off);
+    ESPUT_ASSERT(off == ((ii < (TEST_TXNS - 32)) ? ii + 32 : ii + 16));
+  }
+
+  // A failure part way through a batch skips the rest of it
+  test_cb_count = 0;
+  for (ii = 0; ii < 3; ii++)
+  {
+    txn[ii].flags = OTB_I2C_TXN_FLAG_STOP_ON_ERROR;
+    txn[ii].next = (ii < 2) ? &txn[ii+1] : NULL;
+  }
+  txn[1].addr = TEST_ABSENT;
+  rc = otb_i2c_txn_submit(txn);
+  ESPUT_ASSERT(rc);
+  esput_timer_run(100000);
+  ESPUT_ASSERT(test_cb_count == 3);
+  ESPUT_ASSERT(txn[0].brzo_rc == 0);
+  ESPUT_ASSERT(txn[1].brzo_rc == ESPUT_I2C_ERR_NAK);
+  ESPUT_ASSERT(txn[2].brzo_rc == OTB_I2C_TXN_SKIPPED);
+
+  return TRUE;
+}
+
+bool test_stats(char *test_name)
+{
+  bool rc;
+  uint8_t val;
+  otb_i2c_stats *stats;
+  otb_i2c_stats total;
+  brzo_i2c_info other_info = {4, 5, TEST_STRETCH_US, &test_bus};
+
+  test_setup();
+  otb_i2c_stats_reset();
+  esput_i2c_reset_stats(&test_bus);
+
+  // Successful transactions
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_PCA9685, 0x00, 0x20, &test_info);
+  ESPUT_ASSERT(rc);
+  rc = otb_i2c_read_one_reg_info(TEST_ADDR_PCA9685, 0x00, &val, &test_info);
+  ESPUT_ASSERT(rc);
+  rc = otb_i2c_write_one_val_info(TEST_ADDR_PCF8574, 0x00, &test_info);
+  ESPUT_ASSERT(rc);
+  stats = otb_i2c_stats_get(&test_info, TEST_ADDR_PCA9685);
+  ESPUT_ASSERT(stats != NULL);
+  ESPUT_ASSERT(stats->transactions == 2);
+  ESPUT_ASSERT(stats->bytes == 4);
+  ESPUT_ASSERT(stats->errors == 0);
+  ESPUT_ASSERT(stats->busy_us == 7 * TEST_BYTE_US);
+
+  // Failures
+  test_pca.dev.nak_addr = 1;
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_PCA9685, 0x00, 0x20, &test_info);
+  ESPUT_ASSERT(!rc);
+  test_pca.dev.stretch_us = TEST_STRETCH_US + 1;
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_PCA9685, 0x00, 0x20, &test_info);
+  ESPUT_ASSERT(!rc);
+  test_pca.dev.stretch_us = 0;
+  ESPUT_ASSERT(stats->transactions == 4);
+  ESPUT_ASSERT(stats->bytes == 4);
+  ESPUT_ASSERT(stats->errors == 2);
+  ESPUT_ASSERT(stats->naks == 1);
+  ESPUT_ASSERT(stats->stretch_timeouts == 1);
+
+  // Bus totals match the bus
+  otb_i2c_stats_sum(&test_info, &total);
+  ESPUT_ASSERT(total.transactions == (uint32_t)test_bus.transactions);
+  ESPUT_ASSERT(total.bytes == (uint32_t)(test_bus.bytes_written + test_bus.bytes_read));
+  ESPUT_ASSERT(((unsigned long long)total.busy_ms * 1000 + total.busy_us) == test_bus.busy_us);
+
+  // Same address, another bus, is counted separately
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_PCA9685, 0x00, 0x20, &other_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(stats->transactions == 4);
+  ESPUT_ASSERT(otb_i2c_stats_get(&other_info, TEST_ADDR_PCA9685)->transactions == 1);
+
+  // Commands
+  otb_cmd_rsp_next = 0;
+  rc = otb_i2c_stats_cmd(NULL, (void *)OTB_CMD_I2C_STATS_GET, NULL);
+  ESPUT_ASSERT(rc);
+  LOG("Buses: %s", otb_cmd_rsp);
+  ESPUT_ASSERT(!strncmp((char *)otb_cmd_rsp, "sda0_scl0 txns:5 ", 17));
+  ESPUT_ASSERT(strstr((char *)otb_cmd_rsp, "/sda4_scl5 txns:1 ") != NULL);
+  otb_cmd_rsp_next = 0;
+  rc = otb_i2c_stats_cmd((unsigned char *)"40", (void *)OTB_CMD_I2C_STATS_GET, NULL);
+  ESPUT_ASSERT(rc);
+  LOG("0x40: %s", otb_cmd_rsp);
+  ESPUT_ASSERT(!strncmp((char *)otb_cmd_rsp, "sda0_scl0 0x40 txns:4 bytes:4 errs:2 naks:1 stretch:1 ", 54));
+  otb_cmd_rsp_next = 0;
+  rc = otb_i2c_stats_cmd((unsigned char *)"41", (void *)OTB_CMD_I2C_STATS_GET, NULL);
+  ESPUT_ASSERT(!rc);
+  rc = otb_i2c_stats_cmd(NULL, (void *)OTB_CMD_I2C_STATS_RESET, NULL);
+  ESPUT_ASSERT(rc);
+  otb_i2c_stats_sum(&test_info, &total);
+  ESPUT_ASSERT(!total.in_use && (total.transactions == 0));
+
+  // A full table stops counting new devices, but not existing ones
+  for (val = 0; val < OTB_I2C_STATS_MAX; val++)
+  {
+    otb_i2c_write_one_val_info(TEST_ABSENT + val, 0x00, &test_info);
+  }
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_PCA9685, 0x00, 0x20, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(otb_i2c_stats_get(&test_info, TEST_ADDR_PCA9685) == NULL);
+  ESPUT_ASSERT(otb_i2c_stats_get(&test_info, TEST_ABSENT)->naks == 1);
+
+  // The response is truncated rather than overflowing
+  otb_cmd_rsp_next = 0;
+  rc = otb_i2c_stats_cmd(NULL, (void *)OTB_CMD_I2C_STATS_GET, NULL);
+  ESPUT_ASSERT(rc);
+  otb_i2c_stats_reset();
+  for (val = 0; val < OTB_I2C_STATS_MAX; val++)
+  {
+    other_info.sda_pin = val;
+    otb_i2c_write_one_val_info(TEST_ADDR_PCF8574, 0x00, &other_info);
+  }
+  otb_cmd_rsp_next = 0;
+  rc = otb_i2c_stats_cmd(NULL, (void *)OTB_CMD_I2C_STATS_GET, NULL);
+  ESPUT_ASSERT(rc);
+  otb_i2c_stats_reset();
+
+  return TRUE;
+}
+
+bool test_shadow(char *test_name)
+{
+  bool rc;
+  int ii;
+
+  test_setup();
+
+  // IOCON, then IODIRA/B and GPIOA/B in pairs
+  rc = otb_i2c_mcp23017_init(TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_bus.transactions == 3);
+
+  // Nothing changed, nothing written
+  esput_i2c_reset_stats(&test_bus);
+  rc = otb_i2c_mcp23017_write_gpios(0, 0, TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_bus.transactions == 0);
+
+  // Just the port which changed
+  rc = otb_i2c_mcp23017_write_gpios(0, 0x81, TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_bus.transactions == 1);
+  ESPUT_ASSERT(test_bus.last_txn_us == 3 * TEST_BYTE_US);
+  ESPUT_ASSERT(esput_i2c_mcp23017_outputs(&test_mcp, 1) == 0x81);
+
+  // Single pins - one write each, none if already set
+  esput_i2c_reset_stats(&test_bus);
+  rc = otb_i2c_mcp23017_write_gpio(3, TRUE, TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(rc);
+  rc = otb_i2c_mcp23017_write_gpio(8, FALSE, TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_bus.transactions == 2);
+  ESPUT_ASSERT(esput_i2c_mcp23017_outputs(&test_mcp, 0) == 0x08);
+  ESPUT_ASSERT(esput_i2c_mcp23017_outputs(&test_mcp, 1) == 0x80);
+  rc = otb_i2c_mcp23017_write_gpio(15, TRUE, TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_bus.transactions == 2);
+
+  // A failed write means the latch is unknown - so the next single pin write
+  // reads it first, and a repeat of the same values goes out again
+  test_mcp.dev.nak_data = 1;
+  rc = otb_i2c_mcp23017_write_gpios(0x08, 0x00, TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(!rc);
+  ESPUT_ASSERT(esput_i2c_mcp23017_outputs(&test_mcp, 1) == 0x80);
+  esput_i2c_reset_stats(&test_bus);
+  rc = otb_i2c_mcp23017_write_gpio(9, TRUE, TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_bus.transactions == 2);
+  ESPUT_ASSERT(esput_i2c_mcp23017_outputs(&test_mcp, 1) == 0x82);
+  esput_i2c_reset_stats(&test_bus);
+  test_mcp.dev.nak_addr = 1;
+  rc = otb_i2c_mcp23017_write_gpios(0x0c, 0x82, TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(!rc);
+  rc = otb_i2c_mcp23017_write_gpios(0x0c, 0x82, TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_bus.transactions == 2);
+  ESPUT_ASSERT(esput_i2c_mcp23017_outputs(&test_mcp, 0) == 0x0c);
+
+  // Re-init forgets what was there
+  esput_i2c_reset_stats(&test_bus);
+  rc = otb_i2c_mcp23017_init(TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(rc);
+  rc = otb_i2c_mcp23017_write_gpios(0, 0, TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_bus.transactions == 3);
+  ESPUT_ASSERT(esput_i2c_mcp23017_outputs(&test_mcp, 1) == 0);
+
+  // PCF8574, on the default bus
+  memset(&esput_i2c_default_bus, 0, sizeof(esput_i2c_default_bus));
+  esput_i2c_add_device(&esput_i2c_default_bus, &test_pcf.dev);
+  rc = otb_i2c_pcf8574_init(TEST_ADDR_PCF8574);
+  ESPUT_ASSERT(rc);
+  rc = otb_i2c_pcf8574_led_conf(TEST_ADDR_PCF8574, 2, TRUE);
+  ESPUT_ASSERT(rc);
+  rc = otb_i2c_pcf8574_led_conf(TEST_ADDR_PCF8574, 2, TRUE);
+  ESPUT_ASSERT(rc);
+  rc = otb_i2c_pcf8574_led_conf(TEST_ADDR_PCF8574, 6, TRUE);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_pcf.latch == 0x44);
+  ESPUT_ASSERT(esput_i2c_default_bus.transactions == 3);
+
+  // A full table just means no skipping - MCP23017 and PCF8574 already in it
+  for (ii = 0; ii < OTB_I2C_SHADOW_MAX - 2; ii++)
+  {
+    ESPUT_ASSERT(otb_i2c_shadow_get(NULL, TEST_ABSENT + ii) != NULL);
+  }
+  ESPUT_ASSERT(otb_i2c_shadow_get(&test_info, TEST_ADDR_PCA9685) == NULL);
+  ESPUT_ASSERT(otb_i2c_shadow_get(&test_info, TEST_ADDR_MCP23017) != NULL);
+  esput_i2c_reset_stats(&test_bus);
+  rc = otb_i2c_mcp23017_write_gpios(0, 0, TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_bus.transactions == 0);
+
+  // Re-initializing a bus forgets its devices, but not other buses'
+  otb_i2c_shadow_reset_bus(&test_info);
+  esput_i2c_reset_stats(&test_bus);
+  esput_i2c_reset_stats(&esput_i2c_default_bus);
+  rc = otb_i2c_mcp23017_write_gpios(0, 0, TEST_ADDR_MCP23017, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_bus.transactions == 1);
+  rc = otb_i2c_pcf8574_led_conf(TEST_ADDR_PCF8574, 6, TRUE);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(esput_i2c_default_bus.transactions == 0);
+
+  return TRUE;
+}
+
+bool test_pca9685_frame(char *test_name)
+{
+  bool rc;
+  otb_i2c_pca9685_frame frame;
+  uint16_t on;
+  uint16_t off;
+  uint8_t first;
+  uint8_t num;
+  int ii;
+
+  test_setup();
+  rc = otb_i2c_write_one_reg_info(TEST_ADDR_PCA9685, 0x00, 0x20, &test_info);
+  ESPUT_ASSERT(rc);
+
+  // All 16 channels in one transaction
+  esput_i2c_reset_stats(&test_bus);
+  otb_i2c_pca9685_frame_clear(&frame);
+  for (ii = 0; ii < OTB_I2C_PCA9685_NUM_PINS; ii++)
+  {
+    otb_i2c_pca9685_frame_set(&frame, ii, ii, 0x100 + ii);
+  }
+  rc = otb_i2c_pca9685_frame_write(&frame, TEST_ADDR_PCA9685, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(frame.staged == 0);
+  ESPUT_ASSERT(test_bus.transactions == 1);
+  ESPUT_ASSERT(test_bus.last_txn_us == (2 + (16 * 4)) * TEST_BYTE_US);
+  for (ii = 0; ii < OTB_I2C_PCA9685_NUM_PINS; ii++)
+  {
+    esput_i2c_pca9685_led(&test_pca, ii, &on, &off);
+    ESPUT_ASSERT((on == ii) && (off == 0x100 + ii));
+  }
+
+  // Relay module layout - relays on 0-7, status LED on 15
+  esput_i2c_reset_stats(&test_bus);
+  otb_i2c_pca9685_frame_clear(&frame);
+  otb_i2c_pca9685_frame_set_state(&frame, 15, TRUE);
+  for (ii = 0; ii < 8; ii++)
+  {
+    otb_i2c_pca9685_frame_set_state(&frame, 7-ii, ii & 1);
+  }
+  ESPUT_ASSERT(otb_i2c_pca9685_frame_build(&frame, TEST_ADDR_PCA9685, &test_info) == 2);
+  ESPUT_ASSERT(frame.txn[0].next == frame.txn + 1);
+  ESPUT_ASSERT(frame.txn[1].next == NULL);
+  otb_i2c_pca9685_frame_txn_leds(frame.txn + 1, &first, &num);
+  ESPUT_ASSERT((first == 15) && (num == 1));
+  rc = otb_i2c_pca9685_frame_write(&frame, TEST_ADDR_PCA9685, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(test_bus.transactions == 2);
+  esput_i2c_pca9685_led(&test_pca, 15, &on, &off);
+  ESPUT_ASSERT((on == 0x1000) && (off == 0));
+  esput_i2c_pca9685_led(&test_pca, 6, &on, &off);
+  ESPUT_ASSERT((on == 0x1000) && (off == 0));
+  esput_i2c_pca9685_led(&test_pca, 7, &on, &off);
+  ESPUT_ASSERT((on == 0) && (off == 0x1000));
+  esput_i2c_pca9685_led(&test_pca, 8, &on, &off);
+  ESPUT_ASSERT((on == 8) && (off == 0x108));
+
+  // Alternate channels - the worst case
+  otb_i2c_pca9685_frame_clear(&frame);
+  for (ii = 0; ii < OTB_I2C_PCA9685_NUM_PINS; ii += 2)
+  {
+    otb_i2c_pca9685_frame_set_state(&frame, ii, FALSE);
+  }
+  ESPUT_ASSERT(otb_i2c_pca9685_frame_build(&frame, TEST_ADDR_PCA9685, &test_info) == OTB_I2C_PCA9685_FRAME_MAX_RUNS);
+
+  // A failure stops the write, leaving what wasn't written staged
+  otb_i2c_pca9685_frame_clear(&frame);
+  otb_i2c_pca9685_frame_set_state(&frame, 1, TRUE);
+  otb_i2c_pca9685_frame_set_state(&frame, 3, TRUE);
+  otb_i2c_pca9685_frame_set_state(&frame, 4, TRUE);
+  test_pca.dev.nak_addr = 2;
+  test_pca.dev.nak_data = 0;
+  rc = otb_i2c_pca9685_frame_write(&frame, TEST_ADDR_PCA9685, &test_info);
+  ESPUT_ASSERT(!rc);
+  ESPUT_ASSERT(frame.staged == 0x1a);
+  rc = otb_i2c_pca9685_frame_write(&frame, TEST_ADDR_PCA9685, &test_info);
+  ESPUT_ASSERT(!rc);
+  rc = otb_i2c_pca9685_frame_write(&frame, TEST_ADDR_PCA9685, &test_info);
+  ESPUT_ASSERT(rc);
+  ESPUT_ASSERT(frame.staged == 0);
+  esput_i2c_pca9685_led(&test_pca, 4, &on, &off);
+  ESPUT_ASSERT((on == 0x1000) && (off == 0));
+
+  return TRUE;
+}
+
+esput_test esput_tests[] =
+{
+  {test_pca9685, "PCA9685", "Register writes, auto-increment and ALL_LED"},
+  {test_pca9685_frame, "PCA9685 frame", "Staged channels written in runs"},
+  {test_mcp23017, "MCP23017", "Driver init, GPIO writes and reads"},
+  {test_pcf8574, "PCF8574", "Latch writes and reads, default bus"},
+  {test_ads1115, "ADS1115", "Single-shot conversions"},
+  {test_ads_conf, "ADS config", "ALERT/RDY only in continuous mode"},
+  {test_sc16is, "SC16IS7xx", "Transmit, receive and GPIOs"},
+  {test_faults, "Faults", "Timing, NAKs, clock stretching and stuck bus"},
+  {test_queue, "Queue", "Asynchronous transaction batches"},
+  {test_stats, "Stats", "Per bus and device counters"},
+  {test_shadow, "Shadow", "Skipping unchanged output register writes"},
+  {NULL, NULL, NULL},
+};
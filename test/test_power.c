@@ -0,0 +1,347 @@
+#include "otb.h"
+#include <math.h>
+#include <time.h>
+
+// Values previously hardcoded in otb_i2c_ads_finish_sample()
+#define TEST_BURDEN_OHM  22.14
+#define TEST_BURDEN_MOHM 22140
+#define TEST_TURNS       2000
+#define TEST_MAINS_V     245
+
+// Reference implementation - the double arithmetic this module replaces
+static double test_gain_to_v[OTB_POWER_ADS_GAIN_VALUES] =
+{
+  6.144, 4.096, 2.048, 1.024, 0.512, 0.256, 0.256, 0.256
+};
+
+typedef struct test_ref
+{
+  int mv_hundredths;
+  int sens_ua;
+  int primary_ma;
+  int w;
+} test_ref;
+
+static void test_ref_convert(int16_t val, uint8_t gain, test_ref *ref)
+{
+  double voltage;
+  double current;
+
+  voltage = test_gain_to_v[gain] * val * 1000 / 0x8000;
+  ref->mv_hundredths = (int)(voltage * 100);
+  ref->sens_ua = (int)(voltage / TEST_BURDEN_OHM * 1000);
+  current = voltage * TEST_TURNS / TEST_BURDEN_OHM / 1000;
+  ref->primary_ma = (int)(current * 1000);
+  ref->w = (int)(TEST_MAINS_V * current);
+}
+
+static bool test_close(int a, int b)
+{
+  return ((a - b) <= 1) && ((b - a) <= 1);
+}
+
+bool test_lsb(char *test_name)
+{
+  int val;
+  uint8_t gain;
+  double ref;
+  int32_t uv;
+
+  // Gain scaling is exact, so only truncation differs
+  for (gain = 0; gain < OTB_POWER_ADS_GAIN_VALUES; gain++)
+  {
+    for (val = -0x8000; val <= 0x7fff; val++)
+    {
+      ref = test_gain_to_v[gain] * val * 1000000 / 0x8000;
+      uv = otb_power_ads_to_uv(val, gain);
+      if (!test_close(uv, (int)ref))
+      {
+        LOG("gain %d val %d: %d uV, expected %f", gain, val, uv, ref);
+      }
+      ESPUT_ASSERT(test_close(uv, (int)ref));
+    }
+  }
+
+  ESPUT_ASSERT(otb_power_ads_to_uv(0x7fff, 0) == 6143812);
+  ESPUT_ASSERT(otb_power_ads_to_uv(-0x8000, 0) == -6144000);
+  ESPUT_ASSERT(otb_power_ads_to_uv(1, 5) == 7);
+  ESPUT_ASSERT(otb_power_ads_to_uv(-1, 5) == -7);
+
+  return TRUE;
+}
+
+bool test_convert(char *test_name)
+{
+  otb_power_cal cal;
+  otb_power_reading reading;
+  test_ref ref;
+  int val;
+  uint8_t gain;
+
+  ESPUT_ASSERT(otb_power_cal_init(&cal, TEST_BURDEN_MOHM, TEST_TURNS, TEST_MAINS_V));
+
+  for (gain = 0; gain < OTB_POWER_ADS_GAIN_VALUES; gain++)
+  {
+    for (val = -0x8000; val <= 0x7fff; val++)
+    {
+      otb_power_convert(&cal, val, gain, &reading);
+      test_ref_convert(val, gain, &ref);
+      if (!test_close(reading.uv / 10, ref.mv_hundredths) ||
+          !test_close(reading.sens_ua, ref.sens_ua) ||
+          !test_close(reading.primary_ma, ref.primary_ma) ||
+          !test_close(reading.w, ref.w))
+      {
+        LOG("gain %d val %d: %d %d %d %d, expected %d %d %d %d",
+            gain, val,
+            reading.uv / 10, reading.sens_ua, reading.primary_ma, reading.w,
+            ref.mv_hundredths, ref.sens_ua, ref.primary_ma, ref.w);
+        ESPUT_ASSERT(FALSE);
+      }
+    }
+  }
+
+  // A typical reading
+  otb_power_convert(&cal, 5856, 2, &reading);
+  LOG("uV %d sens uA %d primary mA %d W %d",
+      reading.uv, reading.sens_ua, reading.primary_ma, reading.w);
+  ESPUT_ASSERT(reading.uv == 366000);
+  ESPUT_ASSERT(reading.primary_ma == 33062);
+  ESPUT_ASSERT(reading.w == 8100);
+
+  return TRUE;
+}
+
+bool test_cal(char *test_name)
+{
+  otb_power_cal cal;
+
+  ESPUT_ASSERT(!otb_power_cal_init(&cal, 0, TEST_TURNS, TEST_MAINS_V));
+
+  // Multipliers would overflow
+  ESPUT_ASSERT(!otb_power_cal_init(&cal, 1, TEST_TURNS, TEST_MAINS_V));
+  ESPUT_ASSERT(!otb_power_cal_init(&cal, 1000, 0xffff, 0xffff));
+
+  ESPUT_ASSERT(otb_power_cal_init(&cal, 10000, 1000, 230));
+  ESPUT_ASSERT(cal.sens_ua == (100 << OTB_POWER_CAL_Q) / 1000);
+  ESPUT_ASSERT(cal.primary_ma == (100 << OTB_POWER_CAL_Q) / 1000);
+  ESPUT_ASSERT(cal.mains_v == 230);
+
+  return TRUE;
+}
+
+bool test_format(char *test_name)
+{
+  char buf[32];
+
+  otb_power_milli_to_str(buf, sizeof(buf), 366000, 2);
+  ESPUT_ASSERT(!strcmp(buf, "366.00"));
+  otb_power_milli_to_str(buf, sizeof(buf), 16531, 3);
+  ESPUT_ASSERT(!strcmp(buf, "16.531"));
+  otb_power_milli_to_str(buf, sizeof(buf), 16539, 2);
+  ESPUT_ASSERT(!strcmp(buf, "16.53"));
+  otb_power_milli_to_str(buf, sizeof(buf), 16539, 1);
+  ESPUT_ASSERT(!strcmp(buf, "16.5"));
+  otb_power_milli_to_str(buf, sizeof(buf), 5, 3);
+  ESPUT_ASSERT(!strcmp(buf, "0.005"));
+  otb_power_milli_to_str(buf, sizeof(buf), -1500, 3);
+  ESPUT_ASSERT(!strcmp(buf, "-1.500"));
+
+  return TRUE;
+}
+
+bool test_energy(char *test_name)
+{
+  otb_power_energy energy;
+  otb_power_checkpoint cp;
+  int ii;
+
+  os_memset(&energy, 0, sizeof(energy));
+
+  // 1kW for an hour, in 10s periods
+  for (ii = 0; ii < 360; ii++)
+  {
+    otb_power_energy_add(&energy, 1000, 10000);
+  }
+  ESPUT_ASSERT(energy.wh == 1000);
+  ESPUT_ASSERT(energy.wms == 0);
+
+  // Small amounts aren't lost to rounding
+  for (ii = 0; ii < 3600; ii++)
+  {
+    otb_power_energy_add(&energy, 1, 1000);
+  }
+  ESPUT_ASSERT(energy.wh == 1001);
+  ESPUT_ASSERT(energy.wms == 0);
+  otb_power_energy_add(&energy, 7, 1000);
+  ESPUT_ASSERT(energy.wh == 1001);
+  ESPUT_ASSERT(energy.wms == 7000);
+
+  // Negative power isn't metered
+  otb_power_energy_add(&energy, -500, 1000);
+  ESPUT_ASSERT(energy.wh == 1001);
+  ESPUT_ASSERT(energy.wms == 7000);
+
+  // Intermediate W.ms doesn't overflow
+  otb_power_energy_add(&energy, 0x7fffffff, 2000);
+  LOG("Wh %u W.ms %u", (unsigned int)energy.wh, (unsigned int)energy.wms);
+  ESPUT_ASSERT(energy.wh == 1001 + 1193046);
+  ESPUT_ASSERT(energy.wms == 1701000);
+
+  // Checkpoints
+  os_memset(&cp, 0, sizeof(cp));
+  ESPUT_ASSERT(!otb_power_checkpoint_valid(&cp));
+  os_memset(&cp, 0xff, sizeof(cp));
+  ESPUT_ASSERT(!otb_power_checkpoint_valid(&cp));
+  cp.magic = OTB_POWER_CHECKPOINT_MAGIC;
+  cp.seq = 5;
+  cp.checksum = otb_power_checkpoint_sum(&cp);
+  ESPUT_ASSERT(otb_power_checkpoint_valid(&cp));
+  cp.wh[1]++;
+  ESPUT_ASSERT(!otb_power_checkpoint_valid(&cp));
+
+  return TRUE;
+}
+
+bool test_cos(char *test_name)
+{
+  int phase;
+  double ref;
+  int32_t val;
+
+  for (phase = 0; phase < 0x10000; phase++)
+  {
+    ref = cos(2 * M_PI * phase / 0x10000) * (1 << 14);
+    val = otb_power_cos(phase);
+    if (fabs(val - ref) > 2)
+    {
+      LOG("phase 0x%04x: %d, expected %f", phase, val, ref);
+      ESPUT_ASSERT(FALSE);
+    }
+  }
+
+  ESPUT_ASSERT(otb_power_cos(0) == 16384);
+  ESPUT_ASSERT(otb_power_cos(0x4000) == 0);
+  ESPUT_ASSERT(otb_power_cos(0x8000) == -16384);
+
+  return TRUE;
+}
+
+// 50Hz mains at the polled sample rate (see otb_i2c_ads_sample_mhz), with
+// some 3rd harmonic and noise
+#define TEST_FS_MHZ   (1000000000 / ((1000000/860)+1))
+static int16_t test_mains_sample(int ii, double h1, double h3)
+{
+  double t;
+
+  t = (double)ii * 1000 / TEST_FS_MHZ;
+  return (int16_t)(h1 * sin(2 * M_PI * 50 * t) +
+                   h3 * sin(2 * M_PI * 150 * t + 0.3) +
+                   (rand() % 21) - 10);
+}
+
+static bool test_within(double val, double ref, double pct)
+{
+  return fabs(val - ref) <= (fabs(ref) * pct / 100);
+}
+
+bool test_goertzel(char *test_name)
+{
+  otb_power_goertzel g;
+  int ii;
+  double h1;
+  double h3;
+  double h5;
+
+  // Nyquist is ~430Hz, so the 8th harmonic (400Hz) is analysed at 50Hz but
+  // not at 60Hz
+  otb_power_goertzel_init(&g, 0xff, 50, TEST_FS_MHZ);
+  ESPUT_ASSERT(g.num == 8);
+  otb_power_goertzel_init(&g, 0xff, 60, TEST_FS_MHZ);
+  ESPUT_ASSERT(g.num == 7);
+  otb_power_goertzel_init(&g, 0, 50, TEST_FS_MHZ);
+  ESPUT_ASSERT(g.num == 0);
+
+  // 1st, 3rd and 5th
+  otb_power_goertzel_init(&g, 0b10101, 50, TEST_FS_MHZ);
+  ESPUT_ASSERT(g.num == 3);
+  ESPUT_ASSERT(g.harmonic[0] == 1);
+  ESPUT_ASSERT(g.harmonic[1] == 3);
+  ESPUT_ASSERT(g.harmonic[2] == 5);
+
+  // Two seconds - 100 cycles
+  srand(1);
+  for (ii = 0; ii < 1718; ii++)
+  {
+    otb_power_goertzel_add(&g, test_mains_sample(ii, 20000, 3000));
+  }
+  h1 = otb_power_goertzel_rms(&g, 0) / 256.0;
+  h3 = otb_power_goertzel_rms(&g, 1) / 256.0;
+  h5 = otb_power_goertzel_rms(&g, 2) / 256.0;
+  LOG("h1 %f h3 %f h5 %f", h1, h3, h5);
+  ESPUT_ASSERT(test_within(h1, 20000 / M_SQRT2, 1));
+  ESPUT_ASSERT(test_within(h3, 3000 / M_SQRT2, 2));
+  ESPUT_ASSERT(h5 < 50);
+
+  // Full scale for the maximum number of samples doesn't overflow
+  otb_power_goertzel_init(&g, 0b1, 50, TEST_FS_MHZ);
+  for (ii = 0; ii < OTB_POWER_GOERTZEL_MAX_SAMPLES + 100; ii++)
+  {
+    otb_power_goertzel_add(&g, test_mains_sample(ii, 32000, 0));
+  }
+  ESPUT_ASSERT(g.count == OTB_POWER_GOERTZEL_MAX_SAMPLES);
+  h1 = otb_power_goertzel_rms(&g, 0) / 256.0;
+  LOG("h1 %f", h1);
+  ESPUT_ASSERT(test_within(h1, 32000 / M_SQRT2, 1));
+
+  return TRUE;
+}
+
+// Not a pass/fail test - logs the cost per sample of the analysis, with all
+// harmonics enabled, on the host
+bool test_goertzel_bench(char *test_name)
+{
+  otb_power_goertzel g;
+  int16_t samples[OTB_POWER_GOERTZEL_MAX_SAMPLES];
+  int ii;
+  int jj;
+  int runs = 200;
+  struct timespec start;
+  struct timespec end;
+  double ns;
+
+  for (ii = 0; ii < OTB_POWER_GOERTZEL_MAX_SAMPLES; ii++)
+  {
+    samples[ii] = test_mains_sample(ii, 20000, 3000);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (jj = 0; jj < runs; jj++)
+  {
+    otb_power_goertzel_init(&g, 0xff, 50, TEST_FS_MHZ);
+    for (ii = 0; ii < OTB_POWER_GOERTZEL_MAX_SAMPLES; ii++)
+    {
+      otb_power_goertzel_add(&g, samples[ii]);
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  ESPUT_ASSERT(g.count == OTB_POWER_GOERTZEL_MAX_SAMPLES);
+
+  ns = ((end.tv_sec - start.tv_sec) * 1e9) + (end.tv_nsec - start.tv_nsec);
+  ns /= (double)runs * OTB_POWER_GOERTZEL_MAX_SAMPLES;
+  LOG("%d harmonics: %.1fns per sample", g.num, ns);
+
+  return TRUE;
+}
+
+esput_test esput_tests[] =
+{
+  {test_lsb, "LSB", "ADS gain scaling"},
+  {test_convert, "Convert", "Fixed point against double implementation"},
+  {test_cal, "Calibration", "Calibration limits"},
+  {test_format, "Format", "Fixed point formatting"},
+  {test_energy, "Energy", "Energy accumulation and checkpoints"},
+  {test_cos, "Cos", "Fixed point cosine"},
+  {test_goertzel, "Goertzel", "Harmonic analysis"},
+  {test_goertzel_bench, "Goertzel benchmark", "Harmonic analysis cost per sample"},
+  {NULL, NULL, NULL},
+};
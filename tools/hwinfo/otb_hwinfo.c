@@ -28,10 +28,12 @@
 #include <argp.h>
 #include <assert.h>
 #include <time.h>
+#include <stddef.h>
 #include "otb_hwinfo_types.h"
 
 #define OTB_EEPROM_C
 #include "otb_eeprom.h"
+#include "otb_eeprom_image.h"
 #include "otb_board.h"
 
 #include "otb_hwinfo.h"
@@ -66,15 +68,30 @@ int main(int argc, char **argv)
     rc = -1;
     goto EXIT_LABEL;
   }
+
+  if (otb_hwinfo_batch_fn != NULL)
+  {
+    bool_rc = otb_hwinfo_batch();
+    rc = bool_rc ? 0 : -1;
+    goto EXIT_LABEL;
+  }
   
   // Set up the hardware info buffer to be written to the file
   otb_hwinfo_setup();
 
+  // Check it decodes as the firmware will
+  bool_rc = otb_hwinfo_verify();
+  if (!bool_rc)
+  {
+    rc = -1;
+    goto EXIT_LABEL;
+  }
+
   // Output the file
   otb_hwinfo_output();
 
   // Store the structures off into files
-  bool_rc = otb_hwinfo_store();
+  bool_rc = otb_hwinfo_store(otb_hwinfo_fn);
   if (!bool_rc)
   {
     printf("Failed to store off structures into files\n");
@@ -139,22 +156,9 @@ static error_t otb_hwinfo_parse_opt(int key, char *arg, struct argp_state *state
       
     case 'z':
       // serial
-      len = strnlen(arg, 16);
-      if ((len <= 0) || (len >= 16))
+      if (!otb_hwinfo_set_serial(arg))
       {
         rc = EINVAL;
-        printf("Serial string too long: %s", arg);
-      }
-      else
-      {
-        ii = 0;
-        while (len < 15)
-        {
-          hwinfo.serial[ii] = ' ';
-          ii++;
-          len++;
-        }
-        strcpy(hwinfo.serial, arg);
       }
       break;
       
@@ -175,9 +179,7 @@ static error_t otb_hwinfo_parse_opt(int key, char *arg, struct argp_state *state
     case 'i':
       // chipid
       iarg = strtol(arg, NULL, 16);
-      hwinfo.chipid[0] = (iarg >> 16) & 0xff;
-      hwinfo.chipid[1] = (iarg >> 8) & 0xff;
-      hwinfo.chipid[2] = (iarg) & 0xff;
+      otb_hwinfo_set_chipid((uint32)iarg);
       break;
       
     case '1':
@@ -249,6 +251,11 @@ static error_t otb_hwinfo_parse_opt(int key, char *arg, struct argp_state *state
       otb_hwinfo_verbose = TRUE;
       break;
 
+    case 'n':
+      // batch
+      otb_hwinfo_batch_fn = arg;
+      break;
+
     case 'b':
       rc = EINVAL;
       for (ii = 0; otb_hwinfo_boards[ii] != NULL; ii++)
@@ -279,6 +286,43 @@ static error_t otb_hwinfo_parse_opt(int key, char *arg, struct argp_state *state
   return rc;
 }
 
+bool otb_hwinfo_set_serial(char *serial)
+{
+  bool rc = TRUE;
+  size_t len;
+  int ii;
+
+  memset(hwinfo.serial, 0, sizeof(hwinfo.serial));
+  len = strnlen(serial, 16);
+  if ((len <= 0) || (len >= 16))
+  {
+    rc = FALSE;
+    printf("Serial string too long: %s", serial);
+  }
+  else
+  {
+    ii = 0;
+    while (len < 15)
+    {
+      hwinfo.serial[ii] = ' ';
+      ii++;
+      len++;
+    }
+    strcpy(hwinfo.serial, serial);
+  }
+
+  return rc;
+}
+
+void otb_hwinfo_set_chipid(uint32 chipid)
+{
+  hwinfo.chipid[0] = (chipid >> 16) & 0xff;
+  hwinfo.chipid[1] = (chipid >> 8) & 0xff;
+  hwinfo.chipid[2] = (chipid) & 0xff;
+
+  return;
+}
+
 uint32 sdk_size;
 
 //
@@ -505,16 +549,10 @@ void otb_hwinfo_setup(void)
             OTB_HWINFO_STORE(info_comp_ptr->length, len);
             info_comp_ptr++;
 
-            // Fill in all header fields except checksum (which is last)
-            // Note hdr is updated to point to new module so use module->hdr
-            OTB_HWINFO_STORE(module->hdr.magic, magic);
-            OTB_HWINFO_STORE(module->hdr.type, ii);
-            OTB_HWINFO_STORE(module->hdr.struct_size, struct_size);
-            OTB_HWINFO_STORE(module->hdr.version, version);
-            OTB_HWINFO_STORE(module->hdr.length, len);
-
-            // Now do the checksums
-            OTB_HWINFO_CHECKSUM_DO((&(module->hdr)));
+            // Fill in all header fields, then the checksum (which is last)
+            // Note hdr is updated to point to new module so use module
+            otb_eeprom_image_hdr_set((uint8 *)module, ii, otb_eeprom_main_comp_types + ii, len);
+            otb_eeprom_image_seal((uint8 *)module);
 
             // Figure out where next module starts
             module = (otb_eeprom_main_board_module *)(((uint8 *)hdr) + working_len);
@@ -549,7 +587,7 @@ void otb_hwinfo_setup(void)
         {        
           // Copy in GPIO pin information
           otb_eeprom_main_board_gpio_pins *gpio_pins = (otb_eeprom_main_board_gpio_pins *)hdr;
-          gpio_pins->num_pins = hwinfo.board_info->pin_count; 
+          OTB_HWINFO_STORE(gpio_pins->num_pins, hwinfo.board_info->pin_count);
           for (jj = 0; jj < hwinfo.board_info->pin_count; jj++)
           {
             OTB_HWINFO_STORE(gpio_pins->pin_info[jj].num, (*hwinfo.board_info->pin_info)[jj].num);
@@ -606,100 +644,198 @@ void otb_hwinfo_setup(void)
          assert(FALSE);
     }
 
-    if (ii != OTB_EEPROM_INFO_TYPE_MAIN_BOARD_MODULE)
+    // Types this board doesn't have (len 0) have no header - new_ptr may be
+    // past the end of the buffer
+    if ((ii != OTB_EEPROM_INFO_TYPE_MAIN_BOARD_MODULE) && (len > 0))
     {
       // Fill in all header fields except checksum (which is last)
-      OTB_HWINFO_STORE(hdr->magic, magic);
-      OTB_HWINFO_STORE(hdr->type, ii);
-      OTB_HWINFO_STORE(hdr->struct_size, struct_size);
-      OTB_HWINFO_STORE(hdr->version, version);
-      OTB_HWINFO_STORE(hdr->length, len);
+      otb_eeprom_image_hdr_set((uint8 *)hdr, ii, otb_eeprom_main_comp_types + ii, len);
 
       // Now do the checksums
       // Can't do for otb_eeprom_info yet, as need info comps first.
       if (ii != OTB_EEPROM_INFO_TYPE_INFO)
       {
-        OTB_HWINFO_CHECKSUM_DO(hdr);
+        otb_eeprom_image_seal((uint8 *)hdr);
       }
     }
   }
 
   // Now do otb_eeprom_info checksum
-  hdr = (otb_eeprom_hdr*)ptr;
-  OTB_HWINFO_CHECKSUM_DO(hdr);
+  otb_eeprom_image_seal(ptr);
 
   hwinfo.output = ptr;
 
   return;
 }
 
-void otb_hwinfo_checksum_store(void *data, size_t total_size, int checksum_loc, size_t checksum_size)
+//
+// Checks the image decodes - as the firmware will read it - to what was asked
+// for
+//
+bool otb_hwinfo_verify(void)
 {
-  uint32 checksum;
-  uint32 checksum2;
-  uint32 *checksum_store;
-  int ii;
-  char *datac;
-  
-  // Checks
-  assert(checksum_size == sizeof(checksum));
-  assert(checksum_size == sizeof(*checksum_store));
-  
-  // Set up point to where we need to store the checksum
-  datac = (char *)data;
-  checksum_store = (uint32*)(datac + checksum_loc);
-  checksum = OTB_EEPROM_CHECKSUM_INITIAL;
-  for (ii = 0; ii < total_size; ii++)
+  bool rc = FALSE;
+  uint32 err;
+  uint32 type;
+  uint32 loc;
+  uint32 len;
+  size_t serial_off;
+  otb_eeprom_main_board *main_board;
+
+  err = otb_eeprom_image_verify(hwinfo.output,
+                                hwinfo.output_len,
+                                otb_eeprom_main_comp_types,
+                                OTB_EEPROM_INFO_TYPE_NUM);
+  if (err != OTB_EEPROM_ERR_OK)
   {
-    if ((ii < checksum_loc) || (ii >= (checksum_loc + checksum_size)))
-    {
-      checksum += (*(datac+ii) << ((ii%4) * 8));
-    }
-  }  
-  
-  OTB_HWINFO_STORE(*checksum_store, checksum);
+    printf("Generated image failed verification: 0x%x\n", err);
+    goto EXIT_LABEL;
+  }
 
-  // Double check it!
-  datac = (char *)data;
-  checksum_store = (uint32*)(datac + checksum_loc);
-  checksum2 = OTB_EEPROM_CHECKSUM_INITIAL;
-  for (ii = 0; ii < total_size; ii++)
+  if (hwinfo.board_info->main_mod_info == NULL)
+  {
+    type = OTB_EEPROM_INFO_TYPE_MAIN_BOARD;
+    serial_off = offsetof(otb_eeprom_main_board, common.serial);
+  }
+  else
+  {
+    type = OTB_EEPROM_INFO_TYPE_MAIN_MODULE;
+    serial_off = offsetof(otb_eeprom_main_module, common.serial);
+  }
+  if (!otb_eeprom_image_find(hwinfo.output, type, 0, &loc, &len))
+  {
+    printf("Generated image has no %s\n", otb_eeprom_main_comp_types[type].name);
+    goto EXIT_LABEL;
+  }
+  if (memcmp(hwinfo.output + loc + serial_off, hwinfo.serial, OTB_EEPROM_HW_SERIAL_LEN+1))
+  {
+    printf("Generated image has wrong serial\n");
+    goto EXIT_LABEL;
+  }
+  if (type == OTB_EEPROM_INFO_TYPE_MAIN_BOARD)
   {
-    if ((ii < checksum_loc) || (ii >= (checksum_loc + checksum_size)))
+    main_board = (otb_eeprom_main_board *)(hwinfo.output + loc);
+    if (memcmp(main_board->chipid, hwinfo.chipid, 3) ||
+        memcmp(main_board->mac1+3, hwinfo.chipid, 3) ||
+        memcmp(main_board->mac2+3, hwinfo.chipid, 3))
     {
-      checksum2 += (*(datac+ii) << ((ii%4) * 8));
+      printf("Generated image has wrong chipid\n");
+      goto EXIT_LABEL;
     }
-  }  
-  assert(checksum == checksum2);
-  
-  return;
+  }
+
+  rc = TRUE;
+
+EXIT_LABEL:
+
+  return rc;
 }
 
-bool otb_hwinfo_store(void)
+//
+// Generates, verifies and stores an image for each line of the batch file -
+// "<serial> <chipid>", with the chip ID in hex.  Blank lines and lines
+// starting # are skipped.  Other options apply to every image.
+//
+bool otb_hwinfo_batch(void)
 {
   bool rc = TRUE;
   FILE *fp = NULL;
-  int ii;
-  char *write;
-  int irc;
-  
-  // Just one file to write
-  fp = fopen(otb_hwinfo_fn, "wb");
+  char line[128];
+  char serial[16];
+  char fn[32];
+  unsigned int chipid;
+  int line_num = 0;
+  uint32 count = 0;
+  uint32 bytes = 0;
+  struct timespec start;
+  struct timespec end;
+  double secs;
+
+  fp = fopen(otb_hwinfo_batch_fn, "r");
   if (fp == NULL)
   {
-    printf("Failed to open %s for writing\n", otb_hwinfo_fn);  
+    printf("Failed to open %s for reading\n", otb_hwinfo_batch_fn);
     rc = FALSE;
     goto EXIT_LABEL;
   }
-  write = (char *)hwinfo.output;
-  for (ii = 0; ii < hwinfo.output_len; ii++)
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while (fgets(line, sizeof(line), fp) != NULL)
   {
-    irc = fputc(*(write+ii), fp);
-    if (irc == EOF)
+    line_num++;
+    if ((line[0] == '#') || (line[0] == '\n') || (line[0] == '\r') || (line[0] == 0))
+    {
+      continue;
+    }
+    if ((sscanf(line, "%15s %x", serial, &chipid) != 2) ||
+        !otb_hwinfo_set_serial(serial))
     {
+      printf("Bad line %d in %s\n", line_num, otb_hwinfo_batch_fn);
       rc = FALSE;
       goto EXIT_LABEL;
     }
+    otb_hwinfo_set_chipid(chipid);
+
+    otb_hwinfo_setup();
+    rc = otb_hwinfo_verify();
+    if (rc)
+    {
+      snprintf(fn, sizeof(fn), "hwinfo_%s.out", serial);
+      rc = otb_hwinfo_store(fn);
+    }
+    free(hwinfo.output);
+    hwinfo.output = NULL;
+    if (!rc)
+    {
+      printf("Failed on line %d of %s\n", line_num, otb_hwinfo_batch_fn);
+      goto EXIT_LABEL;
+    }
+
+    count++;
+    bytes += hwinfo.output_len;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  secs = (end.tv_sec - start.tv_sec) + ((end.tv_nsec - start.tv_nsec) / 1e9);
+  printf("Generated and verified %u images (%u bytes) in %.3fs",
+         count,
+         bytes,
+         secs);
+  if (secs > 0)
+  {
+    printf(" - %.0f images/s", count / secs);
+  }
+  printf("\n");
+
+EXIT_LABEL:
+
+  if (fp != NULL)
+  {
+    fclose(fp);
+  }
+
+  return rc;
+}
+
+bool otb_hwinfo_store(char *fn)
+{
+  bool rc = TRUE;
+  FILE *fp = NULL;
+  size_t written;
+  
+  // Just one file to write
+  fp = fopen(fn, "wb");
+  if (fp == NULL)
+  {
+    printf("Failed to open %s for writing\n", fn);  
+    rc = FALSE;
+    goto EXIT_LABEL;
+  }
+  written = fwrite(hwinfo.output, 1, hwinfo.output_len, fp);
+  if (written != hwinfo.output_len)
+  {
+    rc = FALSE;
+    goto EXIT_LABEL;
   }
   fclose(fp);
   fp = NULL;
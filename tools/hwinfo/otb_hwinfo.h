@@ -50,17 +50,6 @@
   }                                                                          \
 }
 
-#define OTB_HWINFO_CHECKSUM_DO(S)                                            \
-{                                                                            \
-  int checksum_loc;                                                          \
-  size_t checksum_size;                                                      \
-  size_t total_size;                                                         \
-  checksum_size = sizeof(S->checksum);                                       \
-  checksum_loc = (char *)&(S->checksum) - (char *)(S);                       \
-  total_size = S->length;                                                    \
-  otb_hwinfo_checksum_store(S, total_size, checksum_loc, checksum_size);     \
-}
-
 // Used by hwinfo to store information to write to flash
 typedef struct otb_hwinfo_info
 {
@@ -86,15 +75,19 @@ uint8 otb_hwinfo_host_endian;
 uint8 otb_hwinfo_target_endian;
 bool otb_hwinfo_verbose;
 char otb_hwinfo_fn[] = "hwinfo.out";
+char *otb_hwinfo_batch_fn;
 otb_hwinfo_info hwinfo;
 #endif
 
 // Function prototypes
 int main(int argc, char **argv);
 static error_t otb_hwinfo_parse_opt(int key, char *arg, struct argp_state *state);
+bool otb_hwinfo_set_serial(char *serial);
+void otb_hwinfo_set_chipid(uint32 chipid);
 void otb_hwinfo_setup(void);
-void otb_hwinfo_checksum_store(void *data, size_t total_size, int checksum_loc, size_t checksum_size);
-bool otb_hwinfo_store(void);
+bool otb_hwinfo_verify(void);
+bool otb_hwinfo_batch(void);
+bool otb_hwinfo_store(char *fn);
 bool otb_hwinfo_test_sizes(void);
 void otb_hwinfo_setup_endian(void);
 void otb_hwinfo_store_field(char *s, char *d, uint8 b);
@@ -144,6 +137,7 @@ static struct argp_option otb_hwinfo_options[] =
   {"adc_config", 't', "TYPE", 0, "Internal ADC configuration, 0=None, 1=3V3_10K_2K49, 2=3V3_220K_100K"},
   {"board_type", 'b', "BOARD_TYPE", 0, "otbiot_v0_3, otbiot_v0_4, otbiot_v0_5, d1_mini, espi_v1_0a, nixie_v0_2 (mz), temp_v0_2 (mz), prog_v0_2 (mz), relay_v0_2 (mz), mbus_v0_1 (mz) are allowed values"},
   {"verbose", 'v', 0, 0, "Verbose output"},
+  {"batch", 'n', "FILE", 0, "Generate and verify an image for each line of FILE, \"SERIAL_NO CHIPID\", writing each to hwinfo_SERIAL_NO.out"},
   {0}
 };
 static struct argp otb_hwinfo_argp = {otb_hwinfo_options, otb_hwinfo_parse_opt, otb_hwinfo_args_doc, otb_hwinfo_doc};